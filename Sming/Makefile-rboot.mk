@@ -35,6 +35,8 @@ RBOOT_LD_1 ?= rom1.ld
 ESPTOOL2 ?= esptool2
 # path to spiffy
 SPIFFY ?= $(SMING_HOME)/spiffy/spiffy
+# path to deltaimg, creates delta OTA patches
+DELTAIMG ?= $(SMING_HOME)/deltaimg/deltaimg
 # filenames and options for generating rBoot rom images with esptool2
 RBOOT_E2_SECTS     ?= .text .data .rodata
 RBOOT_E2_USER_ARGS ?= -quiet -bin -boot2
@@ -368,7 +370,7 @@ $1/%.o: %.cpp
 	$(Q) $(CXX) $(INCDIR) $(MODULE_INCDIR) $(EXTRA_INCDIR) $(SDK_INCDIR) $(CXXFLAGS) -c $$< -o $$@
 endef
 
-.PHONY: all checkdirs spiff_update spiff_clean clean
+.PHONY: all checkdirs spiff_update spiff_clean delta clean
 
 all: checkdirs $(LIBMAIN_DST) $(RBOOT_BIN) $(RBOOT_ROM_0) $(RBOOT_ROM_1) $(SPIFF_BIN_OUT) $(FW_FILE_1) $(FW_FILE_2)
 
@@ -381,6 +383,17 @@ $(LIBMAIN_DST): $(LIBMAIN_SRC)
 
 spiff_update: spiff_clean $(SPIFF_BIN_OUT)
 
+# Patch for rBootHttpUpdate::addPatchItem from rom image the devices are running now:
+# make delta DELTA_SOURCE=<old rom image> [DELTA_TARGET=<new rom image>]
+# Target is rom1 with RBOOT_TWO_ROMS, the only rom with big flash
+DELTA_TARGET ?= $(if $(RBOOT_ROM_1),$(RBOOT_ROM_1),$(RBOOT_ROM_0))
+delta: all
+ifeq ($(DELTA_SOURCE),)
+	$(error DELTA_SOURCE is not set)
+endif
+	$(vecho) "Creating $(DELTA_TARGET:.bin=.delta)"
+	$(Q) $(DELTAIMG) $(DELTA_SOURCE) $(DELTA_TARGET) $(DELTA_TARGET:.bin=.delta)
+
 $(RBOOT_ROM_0): $(TARGET_OUT_0)
 	@echo "E2 $@"
 	@$(ESPTOOL2) $(RBOOT_E2_USER_ARGS) $(TARGET_OUT_0) $@ $(RBOOT_E2_SECTS)
@@ -3,6 +3,7 @@
 #define LOG_PAGE_SIZE       256
 
 spiffs _filesystemStorageHandle;
+u32_t spiffs_mount_count = 0;
 
 static u8_t spiffs_work_buf[LOG_PAGE_SIZE*2];
 static u8_t spiffs_fds[32*7]; // sizeof(spiffs_fd) * K
@@ -131,6 +132,7 @@ static void spiffs_mount_internal(spiffs_config *cfg)
     sizeof(spiffs_cache),
     NULL);
   debugf("mount res: %d\n", res);
+  spiffs_mount_count++;
 
   if (writeFirst)
   {
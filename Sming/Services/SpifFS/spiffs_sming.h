@@ -17,6 +17,7 @@ spiffs_config spiffs_get_storage_config();
 extern void test_spiffs();
 
 extern spiffs _filesystemStorageHandle;
+extern u32_t spiffs_mount_count; // Changes with every mount, information cached about files is invalid then
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,433 @@
+/* deflate.cpp : compact raw DEFLATE (RFC 1951) encoder and decoder */
+/* decoder follows the canonical Huffman decoding of zlib's puff.c */
+#include "deflate.h"
+
+#include <c_types.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFLATE_MAX_BITS 15
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 10
+
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/* ---- encoder ---- */
+
+struct bit_writer {
+	uint8_t *out;
+	size_t len;
+	size_t pos;
+	uint32_t buf;
+	int cnt;
+	int overflow;
+};
+
+static void put_bits(struct bit_writer *w, uint32_t value, int count)
+{
+	w->buf |= value << w->cnt;
+	w->cnt += count;
+	while (w->cnt >= 8) {
+		if (w->pos < w->len)
+			w->out[w->pos++] = (uint8_t)w->buf;
+		else
+			w->overflow = 1;
+		w->buf >>= 8;
+		w->cnt -= 8;
+	}
+}
+
+/* Huffman codes are stored starting with the most significant bit */
+static void put_code(struct bit_writer *w, uint32_t code, int count)
+{
+	uint32_t reversed = 0;
+	for (int i = 0; i < count; i++) {
+		reversed = (reversed << 1) | (code & 1);
+		code >>= 1;
+	}
+	put_bits(w, reversed, count);
+}
+
+static void put_symbol(struct bit_writer *w, int symbol)
+{
+	if (symbol < 144)
+		put_code(w, 0x30 + symbol, 8);
+	else if (symbol < 256)
+		put_code(w, 0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		put_code(w, symbol - 256, 7);
+	else
+		put_code(w, 0xC0 + symbol - 280, 8);
+}
+
+static void put_match(struct bit_writer *w, int length, int distance)
+{
+	int code = 28;
+	while (length_base[code] > length)
+		code--;
+	put_symbol(w, 257 + code);
+	put_bits(w, length - length_base[code], length_extra[code]);
+
+	code = 29;
+	while (dist_base[code] > distance)
+		code--;
+	put_code(w, code, 5);
+	put_bits(w, distance - dist_base[code], dist_extra[code]);
+}
+
+static inline unsigned hash3(const uint8_t *p)
+{
+	return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+int raw_deflate(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len, unsigned window_bits, int final)
+{
+	/* last position + 1 of each hash, 0 for none */
+	uint32_t *head = (uint32_t *)calloc(1 << DEFLATE_HASH_BITS, sizeof(uint32_t));
+	if (head == NULL)
+		return -1;
+
+	size_t window = 1 << (window_bits > DEFLATE_MAX_BITS ? DEFLATE_MAX_BITS : window_bits);
+	if (window > 32768)
+		window = 32768;
+
+	struct bit_writer w = {out, out_len, 0, 0, 0, 0};
+	put_bits(&w, final ? 1 : 0, 1);
+	put_bits(&w, 1, 2); /* fixed Huffman codes */
+
+	size_t pos = 0;
+	while (pos < in_len && !w.overflow) {
+		int best = 0;
+		if (pos + DEFLATE_MIN_MATCH <= in_len) {
+			unsigned h = hash3(in + pos);
+			size_t candidate = head[h];
+			head[h] = pos + 1;
+			if (candidate > 0 && pos - (candidate - 1) <= window) {
+				const uint8_t *match = in + candidate - 1;
+				size_t max = in_len - pos;
+				if (max > DEFLATE_MAX_MATCH)
+					max = DEFLATE_MAX_MATCH;
+				while ((size_t)best < max && match[best] == in[pos + best])
+					best++;
+				if (best >= DEFLATE_MIN_MATCH)
+					put_match(&w, best, in + pos - match);
+			}
+		}
+
+		if (best < DEFLATE_MIN_MATCH) {
+			put_symbol(&w, in[pos]);
+			pos++;
+			continue;
+		}
+
+		/* Remember positions inside the match for next searches */
+		for (size_t end = pos + best, p = pos + 1; p < end; p++)
+			if (p + DEFLATE_MIN_MATCH <= in_len)
+				head[hash3(in + p)] = p + 1;
+		pos += best;
+	}
+	free(head);
+
+	put_symbol(&w, 256); /* end of block */
+	if (!final)
+		put_bits(&w, 0, 3); /* empty stored block, its LEN/NLEN are left out */
+	if (w.cnt > 0)
+		put_bits(&w, 0, 8 - w.cnt);
+
+	return w.overflow ? -1 : (int)w.pos;
+}
+
+/* ---- decoder ---- */
+
+struct huffman {
+	short count[DEFLATE_MAX_BITS + 1];
+	short symbol[288];
+};
+
+struct inflate_state {
+	const uint8_t *in;
+	size_t in_len;
+	size_t in_pos;
+	uint32_t bit_buf;
+	int bit_cnt;
+	int error;
+	int overflow;
+
+	uint8_t *out;
+	size_t out_pos;
+	size_t out_cap;
+	size_t out_max;
+
+	struct huffman lencode;
+	struct huffman distcode;
+};
+
+static int get_bits(struct inflate_state *s, int need)
+{
+	uint32_t val = s->bit_buf;
+	while (s->bit_cnt < need) {
+		if (s->in_pos == s->in_len) {
+			s->error = 1;
+			return 0;
+		}
+		val |= (uint32_t)s->in[s->in_pos++] << s->bit_cnt;
+		s->bit_cnt += 8;
+	}
+	s->bit_buf = val >> need;
+	s->bit_cnt -= need;
+	return val & ((1L << need) - 1);
+}
+
+static int put_byte(struct inflate_state *s, uint8_t value)
+{
+	if (s->out_pos == s->out_cap) {
+		size_t cap = s->out_cap * 2;
+		if (cap > s->out_max)
+			cap = s->out_max;
+		uint8_t *out = (cap > s->out_cap) ? (uint8_t *)realloc(s->out, cap) : NULL;
+		if (out == NULL) {
+			s->overflow = 1;
+			return 0;
+		}
+		s->out = out;
+		s->out_cap = cap;
+	}
+	s->out[s->out_pos++] = value;
+	return 1;
+}
+
+/* returns 0 on success, tables must not be over-subscribed */
+static int construct(struct huffman *h, const short *length, int n)
+{
+	short offs[DEFLATE_MAX_BITS + 1];
+
+	memset(h->count, 0, sizeof(h->count));
+	for (int symbol = 0; symbol < n; symbol++)
+		h->count[length[symbol]]++;
+	if (h->count[0] == n)
+		return 0; /* no codes, fails only when used */
+
+	int left = 1;
+	for (int len = 1; len <= DEFLATE_MAX_BITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return -1;
+	}
+
+	offs[1] = 0;
+	for (int len = 1; len < DEFLATE_MAX_BITS; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+	for (int symbol = 0; symbol < n; symbol++)
+		if (length[symbol] != 0)
+			h->symbol[offs[length[symbol]]++] = symbol;
+
+	return 0;
+}
+
+static int decode(struct inflate_state *s, const struct huffman *h)
+{
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len <= DEFLATE_MAX_BITS; len++) {
+		code |= get_bits(s, 1);
+		if (s->error)
+			return -1;
+		int count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static int stored(struct inflate_state *s)
+{
+	s->bit_buf = 0;
+	s->bit_cnt = 0;
+	if (s->in_pos == s->in_len)
+		return 0; /* flush marker with LEN/NLEN left out */
+	if (s->in_pos + 4 > s->in_len)
+		return -1;
+
+	unsigned len = s->in[s->in_pos] | (s->in[s->in_pos + 1] << 8);
+	unsigned nlen = s->in[s->in_pos + 2] | (s->in[s->in_pos + 3] << 8);
+	s->in_pos += 4;
+	if (len != (~nlen & 0xffff) || s->in_pos + len > s->in_len)
+		return -1;
+
+	while (len--)
+		if (!put_byte(s, s->in[s->in_pos++]))
+			return -1;
+	return 0;
+}
+
+static int codes(struct inflate_state *s)
+{
+	for (;;) {
+		int symbol = decode(s, &s->lencode);
+		if (symbol < 0)
+			return -1;
+		if (symbol < 256) {
+			if (!put_byte(s, symbol))
+				return -1;
+			continue;
+		}
+		if (symbol == 256)
+			return 0;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return -1;
+		int len = length_base[symbol] + get_bits(s, length_extra[symbol]);
+
+		symbol = decode(s, &s->distcode);
+		if (symbol < 0 || symbol >= 30)
+			return -1;
+		size_t dist = dist_base[symbol] + get_bits(s, dist_extra[symbol]);
+		if (s->error || dist > s->out_pos)
+			return -1;
+
+		while (len--)
+			if (!put_byte(s, s->out[s->out_pos - dist]))
+				return -1;
+	}
+}
+
+static int fixed(struct inflate_state *s)
+{
+	short lengths[288];
+	int symbol = 0;
+	for (; symbol < 144; symbol++)
+		lengths[symbol] = 8;
+	for (; symbol < 256; symbol++)
+		lengths[symbol] = 9;
+	for (; symbol < 280; symbol++)
+		lengths[symbol] = 7;
+	for (; symbol < 288; symbol++)
+		lengths[symbol] = 8;
+	construct(&s->lencode, lengths, 288);
+
+	for (symbol = 0; symbol < 30; symbol++)
+		lengths[symbol] = 5;
+	construct(&s->distcode, lengths, 30);
+
+	return codes(s);
+}
+
+static int dynamic(struct inflate_state *s)
+{
+	static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+	short lengths[320];
+
+	int nlen = get_bits(s, 5) + 257;
+	int ndist = get_bits(s, 5) + 1;
+	int ncode = get_bits(s, 4) + 4;
+	if (s->error || nlen > 286 || ndist > 30)
+		return -1;
+
+	int index = 0;
+	for (; index < ncode; index++)
+		lengths[order[index]] = get_bits(s, 3);
+	for (; index < 19; index++)
+		lengths[order[index]] = 0;
+	if (s->error || construct(&s->lencode, lengths, 19) != 0)
+		return -1;
+
+	index = 0;
+	while (index < nlen + ndist) {
+		int symbol = decode(s, &s->lencode);
+		if (symbol < 0)
+			return -1;
+		if (symbol < 16) {
+			lengths[index++] = symbol;
+			continue;
+		}
+
+		int len = 0; /* repeated length */
+		if (symbol == 16) {
+			if (index == 0)
+				return -1;
+			len = lengths[index - 1];
+			symbol = 3 + get_bits(s, 2);
+		} else if (symbol == 17)
+			symbol = 3 + get_bits(s, 3);
+		else
+			symbol = 11 + get_bits(s, 7);
+		if (s->error || index + symbol > nlen + ndist)
+			return -1;
+		while (symbol--)
+			lengths[index++] = len;
+	}
+
+	if (lengths[256] == 0)
+		return -1; /* no end of block code */
+	if (construct(&s->lencode, lengths, nlen) != 0 || construct(&s->distcode, lengths + nlen, ndist) != 0)
+		return -1;
+
+	return codes(s);
+}
+
+int raw_inflate(const uint8_t *in, size_t in_len, uint8_t **out, size_t max_len)
+{
+	*out = NULL;
+	struct inflate_state *s = (struct inflate_state *)malloc(sizeof(struct inflate_state));
+	if (s == NULL)
+		return -1;
+
+	memset(s, 0, sizeof(*s));
+	s->in = in;
+	s->in_len = in_len;
+	s->out_max = max_len;
+	s->out_cap = (in_len < 8) ? 16 : in_len * 2;
+	if (s->out_cap > max_len)
+		s->out_cap = max_len;
+	s->out = (uint8_t *)malloc(s->out_cap + 1); /* not NULL for empty output */
+	s->overflow = (s->out == NULL);
+
+	int res = s->overflow ? -1 : 0;
+	int last = 0;
+	/* Stream without final block ends with the input */
+	while (res == 0 && !last && s->in_pos < s->in_len) {
+		last = get_bits(s, 1);
+		int type = get_bits(s, 2);
+		if (s->error)
+			break;
+		if (type == 0)
+			res = stored(s);
+		else if (type == 1)
+			res = fixed(s);
+		else if (type == 2)
+			res = dynamic(s);
+		else
+			res = -1;
+	}
+	if (s->error)
+		res = -1;
+
+	if (res == 0) {
+		*out = s->out;
+		res = s->out_pos;
+	} else {
+		free(s->out);
+		if (s->overflow)
+			res = -2;
+	}
+	free(s);
+
+	return res;
+}
@@ -0,0 +1,25 @@
+/* deflate.h : compact raw DEFLATE (RFC 1951) encoder and decoder */
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <user_config.h>
+
+/* compress in one block with fixed Huffman codes, back references reach at most 2^window_bits bytes.
+ * final = 0 leaves the stream open and ends it with an empty stored block header (sync flush without 00 00 FF FF).
+ * returns compressed length or -1 if out is too small or no memory */
+int raw_deflate(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len, unsigned window_bits, int final);
+
+/* decompress whole input, output buffer is allocated (and grown) up to max_len bytes, free it with free().
+ * input may end with stored block header only (sync flush with 00 00 FF FF removed).
+ * returns decompressed length, -1 on invalid data or -2 if output exceeds max_len or no memory */
+int raw_inflate(const uint8_t *in, size_t in_len, uint8_t **out, size_t max_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_H */
@@ -340,3 +340,171 @@ uint16_t JsonObjectStream::readMemoryBlock(char* data, int bufSize)
 
 	return MemoryDataStream::readMemoryBlock(data, bufSize);
 }
+
+int JsonObjectStream::length()
+{
+	// Object can't be changed after it was queued for sending, render it now
+	if (rootNode != JsonObject::invalid() && send)
+	{
+		rootNode.printTo(*this);
+		send = false;
+	}
+
+	return MemoryDataStream::length();
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+ProducerStream::ProducerStream(StreamProducerDelegate producer)
+	: producer(producer), buf(NULL), size(0), capacity(0), pos(0), completed(false)
+{
+}
+
+ProducerStream::~ProducerStream()
+{
+	free(buf);
+	buf = NULL;
+}
+
+size_t ProducerStream::write(uint8_t charToWrite)
+{
+	return write(&charToWrite, 1);
+}
+
+size_t ProducerStream::write(const uint8_t* data, size_t len)
+{
+	int required = size + len;
+	if (required > capacity)
+	{
+		// Producers often print byte by byte, grow geometrically
+		int newCapacity = max(max(capacity * 2, required), 64);
+		char* new_buf = (char*)realloc(buf, newCapacity);
+		if (new_buf == NULL)
+			return 0;
+		buf = new_buf;
+		capacity = newCapacity;
+	}
+	memcpy(buf + size, data, len);
+	size += len;
+	return len;
+}
+
+uint16_t ProducerStream::readMemoryBlock(char* data, int bufSize)
+{
+	if (pos == size && !completed)
+	{
+		// Everything produced before was sent, ask for the next part
+		pos = 0;
+		size = 0;
+		completed = producer(*this, bufSize);
+	}
+
+	int available = min(size - pos, bufSize);
+	memcpy(data, buf + pos, available);
+	return available;
+}
+
+bool ProducerStream::seek(int len)
+{
+	if (len < 0 || pos + len > size) return false;
+
+	pos += len;
+	return true;
+}
+
+bool ProducerStream::isFinished()
+{
+	return completed && pos == size;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+#define CHUNK_HEADER_MAX_LEN 6 // "FFFF\r\n"
+
+ChunkedStream::ChunkedStream(IDataSourceStream* source)
+	: source(source), headerLength(0), headerPos(0), trailerPos(0), chunkRemaining(0),
+	  lastChunk(false), finished(false)
+{
+}
+
+ChunkedStream::~ChunkedStream()
+{
+	delete source;
+	source = NULL;
+}
+
+uint16_t ChunkedStream::readMemoryBlock(char* data, int bufSize)
+{
+	if (finished) return 0;
+
+	if (headerLength == 0)
+	{
+		// Start the next chunk, its size must be known before header is written
+		if (bufSize < CHUNK_HEADER_MAX_LEN + 1 + 2) return 0;
+
+		int maxPayload = min(bufSize - CHUNK_HEADER_MAX_LEN - 2, 0xFFFF);
+		int len = source->readMemoryBlock(data + CHUNK_HEADER_MAX_LEN, maxPayload);
+		if (len == 0 && !source->isFinished())
+			return 0; // Nothing to send yet
+
+		headerLength = m_snprintf(header, sizeof(header), "%X\r\n", len);
+		headerPos = 0;
+		trailerPos = 0;
+		chunkRemaining = len;
+		lastChunk = (len == 0);
+
+		memmove(data + headerLength, data + CHUNK_HEADER_MAX_LEN, len);
+		memcpy(data, header, headerLength);
+		memcpy(data + headerLength + len, "\r\n", 2);
+		return headerLength + len + 2;
+	}
+
+	// Continue partially sent chunk
+	int count = min(headerLength - headerPos, bufSize);
+	memcpy(data, header + headerPos, count);
+	if (headerPos + count < headerLength) return count;
+
+	if (chunkRemaining > 0)
+	{
+		int len = source->readMemoryBlock(data + count, min(chunkRemaining, bufSize - count));
+		count += len;
+		if (len < chunkRemaining) return count;
+	}
+
+	int trailer = min(2 - trailerPos, bufSize - count);
+	memcpy(data + count, "\r\n" + trailerPos, trailer);
+	return count + trailer;
+}
+
+bool ChunkedStream::seek(int len)
+{
+	if (len < 0 || headerLength == 0) return len == 0;
+
+	int part = min(headerLength - headerPos, len);
+	headerPos += part;
+	len -= part;
+
+	part = min(chunkRemaining, len);
+	if (part > 0)
+	{
+		source->seek(part);
+		chunkRemaining -= part;
+		len -= part;
+	}
+
+	part = min(2 - trailerPos, len);
+	trailerPos += part;
+
+	if (headerPos == headerLength && chunkRemaining == 0 && trailerPos == 2)
+	{
+		// Chunk completely sent
+		headerLength = 0;
+		finished = lastChunk;
+	}
+	return true;
+}
+
+bool ChunkedStream::isFinished()
+{
+	return finished;
+}
@@ -13,6 +13,7 @@
 #include "../Services/ArduinoJson/include/ArduinoJson.h"
 #include "../Wiring/WString.h"
 #include "../Wiring/WHashMap.h"
+#include "../SmingCore/Delegate.h"
 
 #define TEMPLATE_MAX_VAR_NAME_LEN	16
 
@@ -42,6 +43,8 @@ public:
 	virtual uint16_t readMemoryBlock(char* data, int bufSize) = 0;
 	virtual bool seek(int len) = 0;
 	virtual bool isFinished() = 0;
+	// Total stream size in bytes, -1 when it is not known in advance
+	virtual int length() { return -1; }
 };
 
 class MemoryDataStream : public Print, public IDataSourceStream
@@ -60,6 +63,7 @@ public:
 	virtual uint16_t readMemoryBlock(char* data, int bufSize);
 	virtual bool seek(int len);
 	virtual bool isFinished();
+	virtual int length() { return size; }
 
 private:
 	char* buf;
@@ -84,6 +88,7 @@ public:
 	virtual uint16_t readMemoryBlock(char* data, int bufSize);
 	virtual bool seek(int len);
 	virtual bool isFinished();
+	virtual int length() { return size; }
 
 	String fileName();
 	bool fileExist();
@@ -113,6 +118,7 @@ public:
 
 	virtual uint16_t readMemoryBlock(char* data, int bufSize);
 	virtual bool seek(int len);
+	virtual int length() { return -1; } // Unknown until variables are expanded
 
 	void setVar(String name, String value);
 	void setVarsFromRequest(const HttpRequest& request);
@@ -138,6 +144,7 @@ public:
 	JsonObject& getRoot();
 
 	virtual uint16_t readMemoryBlock(char* data, int bufSize);
+	virtual int length();
 
 private:
 	DynamicJsonBuffer buffer;
@@ -145,5 +152,61 @@ private:
 	bool send;
 };
 
+/**
+ * @brief Data is requested from the producer only when there is free space in send buffer
+ * Producer writes up to maxLength bytes (more is allowed, it will be kept until sent)
+ * and returns true when all data was written.
+ */
+typedef Delegate<bool(Print& out, int maxLength)> StreamProducerDelegate;
+
+class ProducerStream : public Print, public IDataSourceStream
+{
+public:
+	ProducerStream(StreamProducerDelegate producer);
+	virtual ~ProducerStream();
+
+	virtual StreamType getStreamType() { return eSST_User; }
+
+	virtual size_t write(uint8_t charToWrite);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+
+	virtual uint16_t readMemoryBlock(char* data, int bufSize);
+	virtual bool seek(int len);
+	virtual bool isFinished();
+
+private:
+	StreamProducerDelegate producer;
+	char* buf;
+	int size;
+	int capacity;
+	int pos;
+	bool completed;
+};
+
+/**
+ * @brief Encodes source stream with HTTP chunked transfer coding, source is deleted with this stream
+ */
+class ChunkedStream : public IDataSourceStream
+{
+public:
+	ChunkedStream(IDataSourceStream* source);
+	virtual ~ChunkedStream();
+
+	virtual StreamType getStreamType() { return source->getStreamType(); }
+
+	virtual uint16_t readMemoryBlock(char* data, int bufSize);
+	virtual bool seek(int len);
+	virtual bool isFinished();
+
+private:
+	IDataSourceStream* source;
+	char header[8]; // Chunk size line
+	uint8_t headerLength; // 0 when next chunk wasn't started yet
+	uint8_t headerPos;
+	uint8_t trailerPos;
+	int chunkRemaining; // Payload bytes of the current chunk not sent yet
+	bool lastChunk;
+	bool finished;
+};
 
 #endif /* _SMING_CORE_DATASTREAM_H_ */
@@ -7,6 +7,94 @@
 
 #include "FileSystem.h"
 #include "../Wiring/WString.h"
+#include "../Wiring/WHashMap.h"
+
+// Change stamps of files written by these functions, by SPIFFS object id.
+// Kept in a side file as appended records, the first one holds the stamp base.
+// Base is random when the side file is created, so files of a newly flashed
+// image don't get the stamps of the previous one.
+#define FILE_STAMPS_NAME ".stamps"
+#define FILE_STAMPS_MAX_SIZE 1024 // Rewritten without old records beyond this
+
+struct FileStampRecord
+{
+	uint32_t objId;
+	uint32_t stamp;
+};
+
+static HashMap<spiffs_obj_id, uint32_t> fileStamps;
+static uint32_t fileStampBase = 0;
+static uint32_t fileStampNext = 0;
+static uint32_t fileStampsMount = 0; // spiffs_mount_count of the loaded stamps
+static uint32_t fileWrittenMask = 0; // File handles written since open
+
+// Appends the record, or writes all stamps again for objId 0 or a too large file
+static void fileStampsSave(spiffs_obj_id objId, uint32_t stamp)
+{
+	spiffs* fs = &_filesystemStorageHandle;
+	spiffs_stat stat;
+	bool rewrite = objId == 0 || SPIFFS_stat(fs, FILE_STAMPS_NAME, &stat) < 0 || stat.size >= FILE_STAMPS_MAX_SIZE;
+	if (rewrite)
+		SPIFFS_remove(fs, FILE_STAMPS_NAME); // Same spifFS truncation fix as fileOpen()
+	file_t file = SPIFFS_open(fs, FILE_STAMPS_NAME, rewrite ? SPIFFS_CREAT | SPIFFS_WRONLY : SPIFFS_APPEND | SPIFFS_WRONLY, 0);
+	if (file < 0)
+		return;
+
+	FileStampRecord record;
+	if (rewrite)
+	{
+		record = {0, fileStampBase};
+		SPIFFS_write(fs, file, &record, sizeof(record));
+		for (unsigned i = 0; i < fileStamps.count(); i++)
+		{
+			record = {fileStamps.keyAt(i), fileStamps.valueAt(i)};
+			SPIFFS_write(fs, file, &record, sizeof(record));
+		}
+	}
+	else
+	{
+		record = {objId, stamp};
+		SPIFFS_write(fs, file, &record, sizeof(record));
+	}
+	SPIFFS_close(fs, file);
+}
+
+static void fileStampsLoad()
+{
+	if (fileStampsMount == spiffs_mount_count)
+		return;
+	fileStampsMount = spiffs_mount_count;
+	fileStamps.clear();
+
+	spiffs* fs = &_filesystemStorageHandle;
+	FileStampRecord record;
+	file_t file = SPIFFS_open(fs, FILE_STAMPS_NAME, SPIFFS_RDONLY, 0);
+	if (file >= 0 && SPIFFS_read(fs, file, &record, sizeof(record)) == sizeof(record) && record.objId == 0)
+	{
+		fileStampBase = record.stamp;
+		fileStampNext = record.stamp + 1;
+		while (SPIFFS_read(fs, file, &record, sizeof(record)) == sizeof(record))
+		{
+			fileStamps[record.objId] = record.stamp;
+			if (record.stamp - fileStampBase >= fileStampNext - fileStampBase)
+				fileStampNext = record.stamp + 1;
+		}
+		SPIFFS_close(fs, file);
+		return;
+	}
+
+	if (file >= 0)
+		SPIFFS_close(fs, file);
+	fileStampBase = os_random();
+	fileStampNext = fileStampBase + 1;
+	fileStampsSave(0, 0);
+}
+
+static void fileSetWritten(file_t file)
+{
+	if (file > 0 && file < 32)
+		fileWrittenMask |= 1U << file;
+}
 
 file_t fileOpen(const String name, FileOpenFlags flags)
 {
@@ -23,17 +111,33 @@ file_t fileOpen(const String name, FileOpenFlags flags)
   res = SPIFFS_open(&_filesystemStorageHandle, name.c_str(), (spiffs_flags)flags, 0);
   if (res < 0)
 	  debugf("open errno %d\n", SPIFFS_errno(&_filesystemStorageHandle));
+  else if (flags & (eFO_CreateIfNotExist | eFO_Truncate))
+	  fileSetWritten(res);
 
   return res;
 }
 
 void fileClose(file_t file)
 {
+  // New stamp once per written file, not on every write
+  if (file > 0 && file < 32 && (fileWrittenMask & (1U << file)))
+  {
+	  fileWrittenMask &= ~(1U << file);
+	  spiffs_stat stat;
+	  if (fileStats(file, &stat) >= 0)
+	  {
+		  fileStampsLoad();
+		  uint32_t stamp = fileStampNext++;
+		  fileStamps[stat.obj_id] = stamp;
+		  fileStampsSave(stat.obj_id, stamp);
+	  }
+  }
   SPIFFS_close(&_filesystemStorageHandle, file);
 }
 
 size_t fileWrite(file_t file, const void* data, size_t size)
 {
+  fileSetWritten(file);
   int res = SPIFFS_write(&_filesystemStorageHandle, file, (void *)data, size);
   if (res < 0)
   {
@@ -86,11 +190,19 @@ int fileStats(file_t file, spiffs_stat *stat)
 
 void fileDelete(const String name)
 {
+	spiffs_stat stat;
+	if (fileStampsMount == spiffs_mount_count && fileStats(name, &stat) >= 0)
+		fileStamps.remove(stat.obj_id);
 	SPIFFS_remove(&_filesystemStorageHandle, name.c_str());
 }
 
 void fileDelete(file_t file)
 {
+	spiffs_stat stat;
+	if (fileStampsMount == spiffs_mount_count && fileStats(file, &stat) >= 0)
+		fileStamps.remove(stat.obj_id);
+	if (file > 0 && file < 32)
+		fileWrittenMask &= ~(1U << file);
 	SPIFFS_fremove(&_filesystemStorageHandle, file);
 }
 
@@ -196,3 +308,10 @@ int fileGetContent(const String fileName, char* buffer, int bufSize)
 	fileClose(file);
 	return size;
 }
+
+uint32_t fileGetChangeStamp(const spiffs_stat& stat)
+{
+	fileStampsLoad();
+	int i = (int)fileStamps.indexOf(stat.obj_id);
+	return i < 0 ? fileStampBase : fileStamps.valueAt(i);
+}
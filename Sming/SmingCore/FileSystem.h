@@ -196,5 +196,13 @@ void fileDelete(file_t file);
  */
 bool fileExist(const String name);
 
+/** @brief  Get change stamp of a file
+ *  @param  stat File information from fileStats
+ *  @retval uint32_t Stamp which changes when the file is closed after writing, creation or truncation
+ *  @note   Read from memory, the file isn't opened. Files of the flashed image share one stamp,
+ *          which changes when another image is flashed.
+ */
+uint32_t fileGetChangeStamp(const spiffs_stat& stat);
+
 /** @} */
 #endif /* _SMING_CORE_FILESYSTEM_H_ */
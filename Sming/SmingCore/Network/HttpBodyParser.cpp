@@ -0,0 +1,125 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpBodyParser.h"
+#include "HttpRequest.h"
+#include "../DataSourceStream.h"
+#include "../Clock.h"
+
+bool bodyToStringParser(HttpRequest& request, const char* at, int length)
+{
+	if (length == PARSE_DATASTART)
+	{
+		if (request.getContentLength() > NETWORK_MAX_HTTP_PARSING_LEN)
+		{
+			debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+			return false;
+		}
+		request.tmpbuf = "";
+		return request.tmpbuf.reserve(request.getContentLength());
+	}
+
+	if (length < 0) return true;
+
+	return request.tmpbuf.concat(at, length);
+}
+
+bool formUrlParser(HttpRequest& request, const char* at, int length)
+{
+	// Parse "name=value" item collected in tmpbuf
+	auto addItem = [&request]() {
+		if (request.tmpbuf.length() == 0) return;
+		request.extractParsingItemsList(request.tmpbuf, 0, request.tmpbuf.length(), '&', ' ', request.requestPostParameters);
+		request.tmpbuf = "";
+	};
+
+	if (length == PARSE_DATASTART)
+	{
+		if (request.requestPostParameters == NULL)
+			request.requestPostParameters = new HashMap<String, String>();
+		request.tmpbuf = "";
+		return true;
+	}
+	else if (length == PARSE_DATAEND)
+	{
+		addItem();
+		return true;
+	}
+	else if (length < 0)
+	{
+		request.tmpbuf = "";
+		return true;
+	}
+
+	// Only the current item is kept in memory
+	const char* end = at + length;
+	while (at < end)
+	{
+		const char* delim = (const char*)memchr(at, '&', end - at);
+		const char* itemEnd = (delim != NULL) ? delim : end;
+		if (request.tmpbuf.length() + (itemEnd - at) > NETWORK_MAX_HTTP_PARSING_LEN)
+		{
+			debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+			return false;
+		}
+		if (!request.tmpbuf.concat(at, itemEnd - at))
+			return false;
+
+		if (delim == NULL)
+			break;
+
+		addItem();
+		at = delim + 1;
+	}
+
+	return true;
+}
+
+FileUploadParser::FileUploadParser(String fileName)
+	: fileName(fileName)
+{
+}
+
+bool FileUploadParser::parse(HttpRequest& request, const char* at, int length)
+{
+	FileStream* file = (FileStream*)request.args;
+
+	if (length == PARSE_DATASTART)
+	{
+		file = new FileStream();
+		if (!file->attach(fileName, (FileOpenFlags)(eFO_CreateNewAlways | eFO_WriteOnly)))
+		{
+			delete file;
+			return false;
+		}
+		request.args = file;
+		return true;
+	}
+	else if (length < 0)
+	{
+		// PARSE_DATAEND or PARSE_DATAABORT
+		throttle.cancel();
+		delete file;
+		request.args = NULL;
+		if (length == PARSE_DATAABORT)
+		{
+			debugf("Upload aborted, removing %s", fileName.c_str());
+			fileDelete(fileName);
+		}
+		return true;
+	}
+
+	if (file == NULL)
+		return false;
+
+	uint32_t startTime = micros();
+	if (file->write((const uint8_t*)at, length) != (size_t)length) // length >= 0 here
+		return false;
+
+	throttle.writeDone(request, startTime);
+	return true;
+}
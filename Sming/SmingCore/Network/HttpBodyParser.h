@@ -0,0 +1,55 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPBODYPARSER_H_
+#define _SMING_CORE_NETWORK_HTTPBODYPARSER_H_
+
+#include "../Wiring/WString.h"
+#include "../Delegate.h"
+#include "HttpBodyThrottle.h"
+
+class HttpRequest;
+class FileStream;
+
+// Special values of the length argument, data pointer is NULL for them
+#define PARSE_DATASTART -1 // Body is about to be received
+#define PARSE_DATAEND -2 // Whole body was received
+#define PARSE_DATAABORT -3 // Connection was lost before the body end, release resources
+
+/**
+ * @brief Receives request body by chunks as they arrive from network
+ *
+ * Chunks point directly into received packets and are valid only during the call.
+ * Per request state can be kept in HttpRequest::args.
+ * Slow parser can call HttpRequest::pauseBody(), the client doesn't send more until resumeBody().
+ * @return false to reject the request (400 Bad Request is sent)
+ */
+typedef Delegate<bool(HttpRequest& request, const char* at, int length)> HttpBodyParserDelegate;
+
+// Stores body into request, available with HttpRequest::getBody(). Limited to NETWORK_MAX_HTTP_PARSING_LEN
+bool bodyToStringParser(HttpRequest& request, const char* at, int length);
+
+// Incrementally parses application/x-www-form-urlencoded body into post parameters
+bool formUrlParser(HttpRequest& request, const char* at, int length);
+
+/**
+ * @brief Writes request body to the file
+ * Usage: server.addPath("/upload", onUploaded, HttpBodyParserDelegate(&FileUploadParser::parse, &uploader));
+ */
+class FileUploadParser
+{
+public:
+	FileUploadParser(String fileName);
+
+	bool parse(HttpRequest& request, const char* at, int length);
+
+private:
+	String fileName;
+	HttpBodyThrottle throttle;
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPBODYPARSER_H_ */
@@ -0,0 +1,35 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpBodyThrottle.h"
+#include "HttpRequest.h"
+#include "../Clock.h"
+
+void HttpBodyThrottle::writeDone(HttpRequest& request, uint32_t startTime)
+{
+	if (micros() - startTime < HTTP_BODY_SLOW_WRITE_US)
+		return;
+
+	this->request = &request;
+	request.pauseBody();
+	timer.initializeMs(1, TimerDelegate(&HttpBodyThrottle::resume, this)).startOnce();
+}
+
+void HttpBodyThrottle::cancel()
+{
+	timer.stop();
+	request = NULL;
+}
+
+void HttpBodyThrottle::resume()
+{
+	// Parser is called again from here and can pause the body again
+	HttpRequest* paused = request;
+	request = NULL;
+	if (paused != NULL)
+		paused->resumeBody();
+}
@@ -0,0 +1,40 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPBODYTHROTTLE_H_
+#define _SMING_CORE_NETWORK_HTTPBODYTHROTTLE_H_
+
+#include "../Timer.h"
+
+class HttpRequest;
+
+// Body parser writes taking longer (us) let other tasks run before the next chunk
+#ifndef HTTP_BODY_SLOW_WRITE_US
+#define HTTP_BODY_SLOW_WRITE_US 5000
+#endif
+
+/**
+ * @brief Pauses request body for a moment after a slow write (flash sector erase, SPIFFS garbage collection)
+ * Network stack and other tasks run before the next chunk and the client waits with the rest.
+ */
+class HttpBodyThrottle
+{
+public:
+	// startTime is micros() before the write
+	void writeDone(HttpRequest& request, uint32_t startTime);
+	// Body was completed or aborted
+	void cancel();
+
+private:
+	void resume();
+
+private:
+	Timer timer;
+	HttpRequest* request = NULL;
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPBODYTHROTTLE_H_ */
@@ -16,11 +16,14 @@ HttpClient::HttpClient(bool autoDestruct /* = false */) : TcpClient(autoDestruct
 
 HttpClient::~HttpClient()
 {
+	queueTimer.stop();
+	for (int i = 0; i < queue.count(); i++)
+		delete queue[i];
 }
 
 bool HttpClient::downloadString(String url, HttpClientCompletedDelegate onCompleted)
 {
-	if (isProcessing()) return false;
+	if (!keepAlive && isProcessing()) return false;
 	URL uri = URL(url);
 
 	return startDownload(uri, eHCM_String, onCompleted);
@@ -33,7 +36,7 @@ bool HttpClient::downloadFile(String url, HttpClientCompletedDelegate onComplete
 
 bool HttpClient::downloadFile(String url, String saveFileName, HttpClientCompletedDelegate onCompleted /* = NULL */)
 {
-	if (isProcessing()) return false;
+	if (!keepAlive && isProcessing()) return false;
 	URL uri = URL(url);
 
 	String file;
@@ -47,39 +50,179 @@ bool HttpClient::downloadFile(String url, String saveFileName, HttpClientComplet
 	else
 		file = saveFileName;
 
-	saveFile = fileOpen(file.c_str(), eFO_CreateNewAlways | eFO_WriteOnly);
-	debugf("Download file: %s %d", file.c_str(), saveFile);
+	return startDownload(uri, eHCM_File, onCompleted, file);
+}
+
+bool HttpClient::downloadStream(String url, HttpClientBodyDelegate onBody, HttpClientCompletedDelegate onCompleted /* = NULL */)
+{
+	if (!keepAlive && isProcessing()) return false;
+	URL uri = URL(url);
 
-	return startDownload(uri, eHCM_File, onCompleted);
+	return startDownload(uri, eHCM_Stream, onCompleted, "", onBody);
 }
 
-bool HttpClient::startDownload(URL uri, HttpClientMode mode, HttpClientCompletedDelegate onCompleted)
+bool HttpClient::startDownload(URL uri, HttpClientMode mode, HttpClientCompletedDelegate onCompleted, String fileName /* = "" */,
+		HttpClientBodyDelegate onBody /* = NULL */)
 {
-	reset();
-	this->mode = mode;
-	this->onCompleted = onCompleted;
+	if (queue.count() >= (keepAlive ? HTTP_CLIENT_QUEUE_SIZE : 1))
+	{
+		debugf("HttpClient queue is full");
+		return false;
+	}
 
 	debugf("Download: %s", uri.toString().c_str());
 
-	if(uri.Protocol == HTTPS_URL_PROTOCOL) {
-		connect(uri.Host, uri.Port, true);
+	bool isPost = body.length();
+
+	// Request is prepared now, headers and body can be changed for the next one
+	HttpClientRequest* req = new HttpClientRequest;
+	req->host = uri.Host;
+	req->port = uri.Port;
+	req->secure = uri.Protocol == HTTPS_URL_PROTOCOL;
+	req->idempotent = !isPost;
+	req->mode = mode;
+	req->fileName = fileName;
+	req->onBody = onBody;
+	req->onCompleted = onCompleted;
+
+	String& request = req->request;
+	request = (isPost ? "POST " : "GET ") + uri.getPathWithQuery() + " HTTP/1.1\r\n";
+	request += "Host: " + uri.Host + "\r\n";
+	for (int i = 0; i < requestHeaders.count(); i++)
+		request += requestHeaders.keyAt(i) + ": " + requestHeaders.valueAt(i) + "\r\n";
+	if (!hasRequestHeader("Connection"))
+		request += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+	request += "\r\n";
+	request += body;
+
+	queue.add(req);
+	// Not sent from here, this can be called by completion callback inside of TCP event
+	queueTimer.initializeMs(1, TimerDelegate(&HttpClient::sendNext, this)).startOnce();
+	return true;
+}
+
+void HttpClient::setKeepAlive(bool enable)
+{
+	keepAlive = enable;
+}
+
+bool HttpClient::isProcessing()
+{
+	// Idle keep-alive connection isn't processing anything
+	return queue.count() > 0 || (!keepAlive && TcpClient::isProcessing());
+}
+
+bool HttpClient::isConnectedTo(HttpClientRequest* request)
+{
+	return request->host == connectedHost && request->port == connectedPort && request->secure == connectedSecure;
+}
+
+void HttpClient::sendNext()
+{
+	if (sentCount >= queue.count())
+		return;
+
+	if (TcpClient::isProcessing() && !isConnectedTo(queue[sentCount]))
+	{
+		if (sentCount > 0)
+			return; // Responses from current host come first
+		TcpClient::close();
 	}
-	else {
-		connect(uri.Host, uri.Port);
+
+	if (!TcpClient::isProcessing())
+	{
+		HttpClientRequest* req = queue[0];
+		connectedHost = req->host;
+		connectedPort = req->port;
+		connectedSecure = req->secure;
+		reused = false;
+		sentCount = 0;
+		if (!connect(req->host, req->port, req->secure))
+		{
+			debugf("HttpClient can't connect to %s", req->host.c_str());
+			beginResponse();
+			completeResponse(false);
+			if (queue.count() > 0)
+				queueTimer.initializeMs(1, TimerDelegate(&HttpClient::sendNext, this)).startOnce();
+			return;
+		}
 	}
 
-	bool isPost = body.length();
+	while (sentCount < queue.count())
+	{
+		HttpClientRequest* req = queue[sentCount];
+		if (!isConnectedTo(req))
+			break;
 
-	sendString((isPost ? "POST " : "GET ") + uri.getPathWithQuery() + " HTTP/1.0\r\nHost: " + uri.Host + "\r\n");
-	for (int i = 0; i < requestHeaders.count(); i++)
+		// Only GET requests are pipelined, and only when the server has kept the connection open before
+		if (sentCount > 0 && !(keepAlive && reused && req->idempotent && queue[sentCount - 1]->idempotent
+				&& sentCount < HTTP_CLIENT_PIPELINE_DEPTH))
+			break;
+
+		sendString(req->request);
+		sentCount++;
+	}
+
+	if (TcpClient::getConnectionState() == eTCS_Connected)
+		pushAsyncPart();
+}
+
+void HttpClient::beginResponse()
+{
+	HttpClientRequest* req = queue[0];
+	reset();
+	mode = req->mode;
+	onCompleted = req->onCompleted;
+	onBody = req->onBody;
+	streamStarted = false;
+	bodyOffset = 0;
+	HttpResponseParser::reset();
+	responseActive = true;
+
+	if (mode == eHCM_File)
 	{
-		String write = requestHeaders.keyAt(i) + ": " + requestHeaders.valueAt(i) + "\r\n";
-		sendString(write.c_str());
+		saveFile = fileOpen(req->fileName.c_str(), eFO_CreateNewAlways | eFO_WriteOnly);
+		debugf("Download file: %s %d", req->fileName.c_str(), saveFile);
 	}
-	sendString("\r\n");
-	sendString(body);
+}
 
-	return true;
+void HttpClient::completeResponse(bool persistent)
+{
+	HttpClientRequest* req = queue[0];
+	queue.remove(0);
+	sentCount = (sentCount > 0) ? sentCount - 1 : 0;
+	responseActive = false;
+	waitParse = false;
+
+	if (mode == eHCM_File)
+	{
+		debugf("Download file len written: %d, res^ %d", fileTell(saveFile), isSuccessful());
+		if (!isSuccessful())
+			fileDelete(saveFile);
+		fileClose(saveFile);
+	}
+	else if (mode == eHCM_Stream && streamStarted)
+	{
+		streamStarted = false;
+		if (code == 0 || writeError)
+			writeStream(NULL, PARSE_DATAABORT);
+		else
+			writeStream(NULL, PARSE_DATAEND);
+	}
+
+	if (persistent)
+		reused = true;
+	else
+	{
+		// Pipelined requests are sent again on the next connection
+		sentCount = 0;
+		if (TcpClient::isProcessing())
+			TcpClient::close();
+	}
+
+	if (req->onCompleted)
+		req->onCompleted(*this, isSuccessful());
+	delete req;
 }
 
 void HttpClient::setRequestHeader(const String name, const String value)
@@ -92,6 +235,11 @@ bool HttpClient::hasRequestHeader(const String name)
 	return requestHeaders.contains(name);
 }
 
+void HttpClient::removeRequestHeader(const String name)
+{
+	requestHeaders.remove(name);
+}
+
 void HttpClient::setRequestContentType(String contentType)
 {
     setRequestHeader("Content-Type", contentType);
@@ -150,76 +298,119 @@ DateTime HttpClient::getServerDate()
 
 void HttpClient::onFinished(TcpClientState finishState)
 {
-	if (finishState == eTCS_Failed) code = 0;
-
-	if (mode == eHCM_File)
+	if (sentCount > 0 && responseActive && finishState != eTCS_Failed && HttpResponseParser::finish())
+		completeResponse(false); // Body was read until the connection end
+	else if (sentCount > 0)
 	{
-		debugf("Download file len written: %d, res^ %d", fileTell(saveFile), isSuccessful());
-		if (!isSuccessful())
-			fileDelete(saveFile);
-		fileClose(saveFile);
+		HttpClientRequest* req = queue[0];
+		bool started = responseActive && HttpResponseParser::isStarted();
+		if (reused && !started && req->idempotent && !req->retried)
+		{
+			// Server closed idle connection while the request was on its way
+			debugf("HttpClient request is sent again");
+			req->retried = true;
+			if (responseActive && mode == eHCM_File)
+				fileClose(saveFile);
+			responseActive = false;
+		}
+		else
+		{
+			if (!responseActive)
+				beginResponse();
+			code = 0;
+			completeResponse(false);
+		}
 	}
 
-	if (onCompleted)
-		onCompleted(*this, isSuccessful());
-
+	sentCount = 0;
+	reused = false;
 	TcpClient::onFinished(finishState);
+
+	if (queue.count() > 0)
+		queueTimer.initializeMs(1, TimerDelegate(&HttpClient::sendNext, this)).startOnce();
 }
 
-void HttpClient::parseHeaders(pbuf* buf, int headerEnd)
+void HttpClient::onResponseStatus(int code)
 {
-	int line, nextLine;
-	line = NetUtils::pbufFindStr(buf, "\r\n", 0) + 2;
-	do
+	this->code = code;
+}
+
+void HttpClient::onResponseHeader(const PbufSlice& name, const PbufSlice& value)
+{
+	// Only stored headers are copied
+	String headerName = name.toString();
+	String& stored = responseHeaders[headerName];
+	stored = value.toString();
+	debugf("%s === %s", headerName.c_str(), stored.c_str());
+}
+
+void HttpClient::onResponseHeadersComplete()
+{
+	int length = getContentLength();
+	if (mode == eHCM_String && length > HTTP_CLIENT_MAX_STRING_LENGTH)
 	{
-		nextLine = NetUtils::pbufFindStr(buf, "\r\n", line);
-		if (nextLine - line > 2)
-		{
-			int delim = NetUtils::pbufFindStr(buf, ":", line);
-			if (delim != -1)
-			{
-				String name = NetUtils::pbufStrCopy(buf, line, delim - line);
-				//if (server->isHeaderProcessingEnabled(name))
-				{
-					String value = NetUtils::pbufStrCopy(buf, delim + 1,
-							nextLine - (delim + 1));
-					value.trim();
-					responseHeaders[name] = value;
-					debugf("%s === %s", name.c_str(), value.c_str());
-				}
-			}
-		}
-		line = nextLine + 2;
-	} while (nextLine != -1 && nextLine < headerEnd);
+		debugf("HTTP_CLIENT_MAX_STRING_LENGTH");
+		writeError = true;
+	}
+	else if (mode == eHCM_Stream && code >= 200 && code <= 299 && onBody)
+	{
+		streamStarted = true;
+		writeStream(NULL, PARSE_DATASTART);
+	}
+}
+
+void HttpClient::onResponseBody(uint8_t* data, size_t size)
+{
+	waitParse = false;
+	if (!writeError)
+		writeRawData(data, size);
 }
 
-void HttpClient::writeRawData(pbuf* buf, int startPos)
+void HttpClient::writeRawData(uint8_t* data, size_t size)
 {
 	switch (mode)
 	{
 		case eHCM_String:
 		{
-			responseStringData += NetUtils::pbufStrCopy(buf, startPos,
-					buf->tot_len - startPos);
+			if (responseStringData.length() + size > HTTP_CLIENT_MAX_STRING_LENGTH)
+			{
+				debugf("HTTP_CLIENT_MAX_STRING_LENGTH");
+				writeError = true;
+			}
+			else
+				writeError |= !responseStringData.concat((const char*)data, size);
 			break;
 		}
 		case eHCM_File:
 		{
-			pbuf *cur = buf;
-			while (cur != NULL && cur->len > 0 && !writeError)
-			{
-				char* ptr = (char*) cur->payload + startPos;
-				int len = cur->len - startPos;
-				int res = fileWrite(saveFile, ptr, len);
-				writeError |= (res < 0);
-				cur = cur->next;
-				startPos = 0;
-			}
-
-			if (writeError)
-				close();
+			int res = fileWrite(saveFile, data, size);
+			writeError |= (res < 0);
+			break;
 		}
+		case eHCM_Stream:
+		{
+			// Body of error responses isn't passed
+			if (streamStarted)
+				writeStream(data, size);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+bool HttpClient::writeStream(const uint8_t* data, int size)
+{
+	if (!onBody(*this, data, size, bodyOffset, getContentLength()))
+	{
+		debugf("HttpClient body was refused");
+		writeError = true;
+		return false;
 	}
+
+	if (size > 0)
+		bodyOffset += size;
+	return true;
 }
 
 err_t HttpClient::onReceive(pbuf *buf)
@@ -228,43 +419,39 @@ err_t HttpClient::onReceive(pbuf *buf)
 	{
 		// Disconnected, close it
 		TcpClient::onReceive(buf);
+		return ERR_OK;
 	}
-	else
+
+	// Several pipelined responses can come in one segment
+	int pos = 0;
+	while (pos < buf->tot_len && sentCount > 0)
 	{
-		int startPos = 0;
-		if (waitParse)
+		if (!responseActive)
+			beginResponse();
+
+		HttpParseResult result = HttpResponseParser::parse(buf, pos);
+		if (result == eHPR_Wait && !writeError)
+			break;
+
+		if (result == eHPR_Successful && !writeError)
+			completeResponse(keepAlive && isPersistent());
+		else
 		{
-			String http = NetUtils::pbufStrCopy(buf, 0, 4);
-			http.toUpperCase();
-			if (http == "HTTP" && code == 0)
-			{
-				int codeStart = NetUtils::pbufFindChar(buf, ' ', 4);
-				int codeEnd = NetUtils::pbufFindChar(buf, ' ', codeStart + 1);
-				if (codeStart != -1 && codeEnd != -1 && codeEnd - codeStart < 5)
-				{
-					String strCode = NetUtils::pbufStrCopy(buf, codeStart, codeEnd);
-					code = strCode.toInt();
-				}
-				else
-					code = 0;
-			}
-			int headerEnd = NetUtils::pbufFindStr(buf, "\r\n\r\n");
-			if (headerEnd != -1)
-			{
-				debugf("Header pos: %d", headerEnd);
-				startPos = headerEnd + 4;
-				waitParse = false;
-				if (headerEnd < NETWORK_MAX_HTTP_PARSING_LEN)
-					parseHeaders(buf, headerEnd);
-			}
+			debugf("HttpClient response failed");
+			if (result == eHPR_Failed)
+				code = 0;
+			completeResponse(false);
 		}
 
-		if (!waitParse) writeRawData(buf, startPos);
-
-		// Fire ReadyToSend callback
-		TcpClient::onReceive(buf);
+		if (TcpClient::getConnectionState() != eTCS_Connected)
+			break; // Closed
 	}
 
+	if (queue.count() > sentCount)
+		queueTimer.initializeMs(1, TimerDelegate(&HttpClient::sendNext, this)).startOnce();
+
+	// Fire ReadyToSend callback
+	TcpClient::onReceive(buf);
 	return ERR_OK;
 }
 
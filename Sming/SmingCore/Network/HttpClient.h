@@ -9,25 +9,63 @@
 #define _SMING_CORE_NETWORK_HTTPCLIENT_H_
 
 #include "TcpClient.h"
+#include "HttpResponseParser.h"
+#include "HttpBodyParser.h"
+#include "../Timer.h"
 #include "../../Wiring/WString.h"
 #include "../../Wiring/WHashMap.h"
+#include "../../Wiring/WVector.h"
 #include "../../Services/DateTime/DateTime.h"
 #include "../Delegate.h"
 
+// Requests waiting in keep-alive mode
+#define HTTP_CLIENT_QUEUE_SIZE 8
+// Requests sent before the first of them is answered
+#define HTTP_CLIENT_PIPELINE_DEPTH 4
+// Longest body accepted by downloadString, use downloadStream for bigger ones
+#define HTTP_CLIENT_MAX_STRING_LENGTH 4096
+
 class HttpClient;
 class URL;
 
 //typedef void (*HttpClientCompletedCallback)(HttpClient& client, bool successful);
 typedef Delegate<void(HttpClient& client, bool successful)> HttpClientCompletedDelegate;
 
+/**
+ * @brief Receives response body by chunks as they arrive, chunked transfer coding is already decoded
+ *
+ * size is PARSE_DATASTART before the body (also an empty one), PARSE_DATAEND after it and PARSE_DATAABORT
+ * when the response fails, data is NULL for them. Only body of 2xx response is passed.
+ * @param offset Position of data in the body
+ * @param totalLength Content-Length, -1 if not known in advance
+ * @return false to abort the response, it completes as failed
+ */
+typedef Delegate<bool(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength)> HttpClientBodyDelegate;
+
 enum HttpClientMode
 {
 	eHCM_String = 0,
 	eHCM_File,
-	eHCM_UserDefined
+	eHCM_UserDefined,
+	eHCM_Stream
+};
+
+// Request prepared for sending
+struct HttpClientRequest
+{
+	String host;
+	int port;
+	bool secure;
+	String request; // Request line, headers and body
+	bool idempotent; // GET, can be pipelined and sent again
+	bool retried = false;
+	HttpClientMode mode;
+	String fileName;
+	HttpClientBodyDelegate onBody;
+	HttpClientCompletedDelegate onCompleted;
 };
 
-class HttpClient: protected TcpClient
+class HttpClient: protected TcpClient, protected HttpResponseParser
 {
 public:
 	HttpClient(bool autoDestruct = false);
@@ -41,18 +79,27 @@ public:
 	bool downloadFile(String url, HttpClientCompletedDelegate onCompleted = NULL);
 	bool downloadFile(String url, String saveFileName, HttpClientCompletedDelegate onCompleted = NULL);
 
+	// Stream mode, body is passed to onBody without being kept in memory (see HttpClientSink.h)
+	bool downloadStream(String url, HttpClientBodyDelegate onBody, HttpClientCompletedDelegate onCompleted = NULL);
+
 	void setPostBody(const String& _method);
 	String getPostBody();
 
 	void setRequestHeader(const String name, const String value);
 	bool hasRequestHeader(const String name);
+	void removeRequestHeader(const String name);
 	void setRequestContentType(String _content_type);
 
+	// HTTP/1.1 connection is kept open for next requests to the same host, they are queued
+	// instead of refused while one is processed and GET requests are pipelined
+	void setKeepAlive(bool enable);
+	__forceinline int getQueueCount() { return queue.count(); }
+
 	// Resulting HTTP status code
 	__forceinline int getResponseCode() { return code; }
 	__forceinline bool isSuccessful() { return (!writeError) && (code >= 200 && code <= 399); }
 
-	__forceinline bool isProcessing()  { return TcpClient::isProcessing(); }
+	bool isProcessing();
 	__forceinline TcpClientState getConnectionState() { return TcpClient::getConnectionState(); }
 
 	String getResponseHeader(String headerName, String defaultValue = "");
@@ -70,16 +117,29 @@ public:
 #endif
 
 protected:
-	bool startDownload(URL uri, HttpClientMode mode, HttpClientCompletedDelegate onCompleted);
+	bool startDownload(URL uri, HttpClientMode mode, HttpClientCompletedDelegate onCompleted, String fileName = "",
+			HttpClientBodyDelegate onBody = NULL);
 	void onFinished(TcpClientState finishState);
 	virtual err_t onReceive(pbuf *buf);
-	virtual void writeRawData(pbuf* buf, int startPos);
-	void parseHeaders(pbuf* buf, int headerEnd);
+	// Decoded body data of current response
+	virtual void writeRawData(uint8_t* data, size_t size);
+
+	virtual void onResponseStatus(int code);
+	virtual void onResponseHeader(const PbufSlice& name, const PbufSlice& value);
+	virtual void onResponseHeadersComplete();
+	virtual void onResponseBody(uint8_t* data, size_t size);
 
 protected:
 	bool waitParse = false;
 	bool writeError = false;
 
+private:
+	void sendNext();
+	bool isConnectedTo(HttpClientRequest* request);
+	void beginResponse();
+	void completeResponse(bool persistent);
+	bool writeStream(const uint8_t* data, int size);
+
 private:
 	int code;
 	HttpClientCompletedDelegate onCompleted;
@@ -89,7 +149,20 @@ private:
 
 	String responseStringData;
 	String body = "";
-	file_t saveFile;
+	file_t saveFile = 0;
+	HttpClientBodyDelegate onBody;
+	bool streamStarted = false; // PARSE_DATASTART was passed to onBody
+	size_t bodyOffset = 0;
+
+	bool keepAlive = false;
+	Vector<HttpClientRequest*> queue;
+	int sentCount = 0; // Requests at the queue start waiting for response
+	bool responseActive = false; // First request got its response prepared
+	String connectedHost;
+	int connectedPort = 0;
+	bool connectedSecure = false;
+	bool reused = false; // Connection answered a request before
+	Timer queueTimer; // Next request after connection was closed
 };
 
 #endif /* _SMING_CORE_NETWORK_HTTPCLIENT_H_ */
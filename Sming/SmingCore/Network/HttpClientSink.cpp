@@ -0,0 +1,344 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpClientSink.h"
+
+FileDownloadSink::FileDownloadSink(String fileName)
+	: fileName(fileName)
+{
+}
+
+bool FileDownloadSink::write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength)
+{
+	if (size == PARSE_DATASTART)
+	{
+		file = fileOpen(fileName, eFO_CreateNewAlways | eFO_WriteOnly);
+		debugf("Download file: %s %d", fileName.c_str(), file);
+		return file >= 0;
+	}
+	else if (size < 0)
+	{
+		// PARSE_DATAEND or PARSE_DATAABORT
+		if (file >= 0)
+			fileClose(file);
+		file = 0;
+		if (size == PARSE_DATAABORT)
+		{
+			debugf("Download aborted, removing %s", fileName.c_str());
+			fileDelete(fileName);
+		}
+		return true;
+	}
+
+	return (int)fileWrite(file, data, size) == size;
+}
+
+rBootDownloadSink::rBootDownloadSink(uint32_t targetOffset)
+	: targetOffset(targetOffset)
+{
+}
+
+void rBootDownloadSink::setTargetOffset(uint32_t targetOffset)
+{
+	this->targetOffset = targetOffset;
+}
+
+bool rBootDownloadSink::write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength)
+{
+	if (size == PARSE_DATASTART)
+	{
+		debugf("rBoot download to 0x%X, %d bytes", targetOffset, totalLength);
+		writeStatus = rboot_write_init(targetOffset);
+		return true;
+	}
+	else if (size == PARSE_DATAEND)
+		return rboot_write_end(&writeStatus);
+	else if (size < 0)
+	{
+		debugf("rBoot download aborted");
+		return true;
+	}
+
+	return rboot_write_flash(&writeStatus, (uint8*)data, size);
+}
+
+JsonDownloadSink::JsonDownloadSink(JsonValueDelegate onValue)
+	: onValue(onValue)
+{
+}
+
+bool JsonDownloadSink::write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength)
+{
+	if (size == PARSE_DATASTART)
+	{
+		state = eJSS_Value;
+		token = "";
+		depth = 0;
+		return true;
+	}
+	else if (size == PARSE_DATAEND)
+	{
+		// Number at the top level ends with the document
+		if (state == eJSS_Literal && depth == 0)
+		{
+			emitValue();
+			endValue();
+		}
+		token = "";
+		if (state != eJSS_Done)
+		{
+			debugf("JSON document is incomplete");
+			return false;
+		}
+		return true;
+	}
+	else if (size < 0)
+	{
+		token = "";
+		return true;
+	}
+
+	for (int i = 0; i < size; i++)
+	{
+		if (!parseChar((char)data[i]))
+		{
+			debugf("JSON parsing failed at %d", offset + i);
+			state = eJSS_Failed;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool JsonDownloadSink::parseChar(char ch)
+{
+	bool space = (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n');
+
+	switch (state)
+	{
+	case eJSS_Value:
+		if (space)
+			return true;
+		return beginValue(ch);
+
+	case eJSS_Key:
+		if (space)
+			return true;
+		if (ch == '}')
+			return closeContainer(ch);
+		if (ch != '"')
+			return false;
+		token = "";
+		inKey = true;
+		state = eJSS_String;
+		return true;
+
+	case eJSS_Colon:
+		if (space)
+			return true;
+		if (ch != ':')
+			return false;
+		state = eJSS_Value;
+		return true;
+
+	case eJSS_String:
+		if (ch == '"')
+		{
+			if (inKey)
+			{
+				keys[depth - 1] = token;
+				token = "";
+				state = eJSS_Colon;
+			}
+			else
+			{
+				emitValue();
+				endValue();
+			}
+			return true;
+		}
+		if (ch == '\\')
+		{
+			state = eJSS_Escape;
+			return true;
+		}
+		if ((uint8_t)ch < 0x20)
+			return false;
+		return appendChar(ch);
+
+	case eJSS_Escape:
+		state = eJSS_String;
+		switch (ch)
+		{
+		case 'b': return appendChar('\b');
+		case 'f': return appendChar('\f');
+		case 'n': return appendChar('\n');
+		case 'r': return appendChar('\r');
+		case 't': return appendChar('\t');
+		case 'u':
+			codePoint = 0;
+			hexDigits = 0;
+			state = eJSS_Unicode;
+			return true;
+		default:
+			return appendChar(ch); // \" \\ and \/
+		}
+
+	case eJSS_Unicode:
+	{
+		int value;
+		if (ch >= '0' && ch <= '9')
+			value = ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			value = ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			value = ch - 'A' + 10;
+		else
+			return false;
+		codePoint = (codePoint << 4) | value;
+		if (++hexDigits < 4)
+			return true;
+
+		// UTF-8, surrogate pairs are encoded separately
+		state = eJSS_String;
+		if (codePoint == 0)
+			return true; // Can't be stored in String
+		if (codePoint < 0x80)
+			return appendChar(codePoint);
+		if (codePoint < 0x800)
+			return appendChar(0xC0 | (codePoint >> 6)) && appendChar(0x80 | (codePoint & 0x3F));
+		return appendChar(0xE0 | (codePoint >> 12)) && appendChar(0x80 | ((codePoint >> 6) & 0x3F))
+				&& appendChar(0x80 | (codePoint & 0x3F));
+	}
+
+	case eJSS_Literal:
+		if ((ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')
+				|| ch == '-' || ch == '+' || ch == '.')
+			return appendChar(ch);
+		emitValue();
+		endValue();
+		return parseChar(ch);
+
+	case eJSS_Next:
+		if (space)
+			return true;
+		if (ch == ',')
+		{
+			if (isArray[depth - 1])
+			{
+				indexes[depth - 1]++;
+				state = eJSS_Value;
+			}
+			else
+				state = eJSS_Key;
+			return true;
+		}
+		return closeContainer(ch);
+
+	case eJSS_Done:
+		return space;
+
+	default:
+		return false;
+	}
+}
+
+bool JsonDownloadSink::beginValue(char ch)
+{
+	if (ch == '{' || ch == '[')
+		return openContainer(ch == '[');
+
+	if (ch == ']')
+		return closeContainer(ch); // Empty array
+
+	token = "";
+	if (ch == '"')
+	{
+		inKey = false;
+		state = eJSS_String;
+		return true;
+	}
+
+	if ((ch >= '0' && ch <= '9') || ch == '-' || ch == 't' || ch == 'f' || ch == 'n')
+	{
+		state = eJSS_Literal;
+		return appendChar(ch);
+	}
+
+	return false;
+}
+
+bool JsonDownloadSink::appendChar(char ch)
+{
+	if (token.length() >= JSON_SINK_MAX_TOKEN)
+	{
+		debugf("JSON_SINK_MAX_TOKEN");
+		return false;
+	}
+	return token.concat(ch);
+}
+
+bool JsonDownloadSink::openContainer(bool array)
+{
+	if (depth >= JSON_SINK_MAX_DEPTH)
+	{
+		debugf("JSON_SINK_MAX_DEPTH");
+		return false;
+	}
+
+	isArray[depth] = array;
+	keys[depth] = "";
+	indexes[depth] = 0;
+	depth++;
+	state = array ? eJSS_Value : eJSS_Key;
+	return true;
+}
+
+bool JsonDownloadSink::closeContainer(char ch)
+{
+	if (depth == 0 || ch != (isArray[depth - 1] ? ']' : '}'))
+		return false;
+
+	keys[depth - 1] = "";
+	depth--;
+	endValue();
+	return true;
+}
+
+void JsonDownloadSink::emitValue()
+{
+	if (onValue)
+		onValue(getPath(), token);
+	token = "";
+}
+
+void JsonDownloadSink::endValue()
+{
+	state = (depth > 0) ? eJSS_Next : eJSS_Done;
+}
+
+String JsonDownloadSink::getPath()
+{
+	String path;
+	for (int i = 0; i < depth; i++)
+	{
+		if (isArray[i])
+		{
+			path += '[';
+			path += indexes[i];
+			path += ']';
+		}
+		else
+		{
+			if (i > 0)
+				path += '.';
+			path += keys[i];
+		}
+	}
+	return path;
+}
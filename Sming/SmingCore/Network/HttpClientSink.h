@@ -0,0 +1,116 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPCLIENTSINK_H_
+#define _SMING_CORE_NETWORK_HTTPCLIENTSINK_H_
+
+#include "HttpClient.h"
+#include "../FileSystem.h"
+#include "../../Wiring/WString.h"
+#include "../Delegate.h"
+
+#include <rboot-api.h>
+
+// Sinks for HttpClient::downloadStream, each of them handles one download at a time
+
+/**
+ * @brief Writes response body to the file, removed again if the download fails
+ * Usage: client.downloadStream(url, HttpClientBodyDelegate(&FileDownloadSink::write, &fileSink), onCompleted);
+ */
+class FileDownloadSink
+{
+public:
+	FileDownloadSink(String fileName);
+
+	bool write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength);
+
+private:
+	String fileName;
+	file_t file = 0;
+};
+
+/**
+ * @brief Writes response body directly to the rBoot rom slot
+ * Usage: client.downloadStream(url, HttpClientBodyDelegate(&rBootDownloadSink::write, &romSink), onCompleted);
+ * Download completes as successful only when the whole image was written.
+ */
+class rBootDownloadSink
+{
+public:
+	rBootDownloadSink(uint32_t targetOffset);
+
+	void setTargetOffset(uint32_t targetOffset);
+	bool write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength);
+
+private:
+	uint32_t targetOffset;
+	rboot_write_status writeStatus;
+};
+
+// Deepest nesting of objects and arrays
+#define JSON_SINK_MAX_DEPTH 8
+// Longest key or value
+#define JSON_SINK_MAX_TOKEN 256
+
+/**
+ * @brief Scalar value found in JSON document
+ * @param path Keys and array indexes leading to the value, like "sensors[2].name", empty for top level value
+ * @param value Decoded string, or text of the number, true, false or null
+ */
+typedef Delegate<void(const String& path, const String& value)> JsonValueDelegate;
+
+enum JsonSinkState
+{
+	eJSS_Value = 0,
+	eJSS_Key,
+	eJSS_Colon,
+	eJSS_String,
+	eJSS_Escape,
+	eJSS_Unicode,
+	eJSS_Literal,
+	eJSS_Next, // After value, ',' or end of object / array
+	eJSS_Done,
+	eJSS_Failed
+};
+
+/**
+ * @brief Parses JSON response body as it arrives, memory use doesn't depend on document size
+ * Usage: client.downloadStream(url, HttpClientBodyDelegate(&JsonDownloadSink::write, &jsonSink), onCompleted);
+ * Values are reported one by one, objects and arrays themselves aren't kept.
+ */
+class JsonDownloadSink
+{
+public:
+	JsonDownloadSink(JsonValueDelegate onValue);
+
+	bool write(HttpClient& client, const uint8_t* data, int size, size_t offset, int totalLength);
+
+private:
+	bool parseChar(char ch);
+	bool beginValue(char ch);
+	bool appendChar(char ch);
+	bool openContainer(bool array);
+	bool closeContainer(char ch);
+	void emitValue();
+	void endValue();
+	String getPath();
+
+private:
+	JsonValueDelegate onValue;
+	JsonSinkState state = eJSS_Value;
+	bool inKey = false;
+	String token;
+	uint16_t codePoint = 0; // Of \uXXXX escape
+	uint8_t hexDigits = 0;
+
+	uint8_t depth = 0;
+	bool isArray[JSON_SINK_MAX_DEPTH];
+	String keys[JSON_SINK_MAX_DEPTH];
+	uint16_t indexes[JSON_SINK_MAX_DEPTH];
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPCLIENTSINK_H_ */
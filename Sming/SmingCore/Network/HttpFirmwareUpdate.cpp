@@ -90,22 +90,14 @@ void HttpFirmwareUpdate::onTimer()
 	startDownload(URL(it.url), eHCM_UserDefined, NULL);
 }
 
-void HttpFirmwareUpdate::writeRawData(pbuf* buf, int startPos)
+void HttpFirmwareUpdate::writeRawData(uint8_t* data, size_t size)
 {
-	pbuf *cur = buf;
-	while (cur != NULL && cur->len > 0 && !writeError)
-	{
-		char* ptr = (char*) cur->payload + startPos;
-		int len = cur->len - startPos;
-		int res = writeFlash(ptr, pos, len);
-		//debugf("Write 0x%X %d %d", pos, len, res);
-		pos += res;
-		writeError |= (res != len);
-		if (writeError)
-			debugf("WriteError %d != %d", res, len);
-		cur = cur->next;
-		startPos = 0;
-	}
+	int res = writeFlash((char*)data, pos, size);
+	//debugf("Write 0x%X %d %d", pos, size, res);
+	pos += res;
+	writeError |= (res != (int)size);
+	if (writeError)
+		debugf("WriteError %d != %d", res, size);
 }
 
 uint32_t HttpFirmwareUpdate::writeFlash(char* data, uint32_t pos, int size)
@@ -33,7 +33,7 @@ public:
 
 protected:
 	void onTimer();
-	virtual void writeRawData(pbuf* buf, int startPos);
+	virtual void writeRawData(uint8_t* data, size_t size);
 	uint32_t writeFlash(char* data, uint32_t pos, int size);
 	void applyUpdate();
 	void updateFailed();
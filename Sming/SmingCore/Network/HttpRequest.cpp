@@ -7,33 +7,64 @@
 
 #include "HttpRequest.h"
 #include "HttpServer.h"
+#include "HttpServerConnection.h"
 #include "NetUtils.h"
 #include <stdlib.h>
 #include "../../Services/WebHelpers/escape.h"
 
 HttpRequest::HttpRequest()
 {
+	server = NULL;
 	requestHeaders = NULL;
 	requestGetParameters = NULL;
+	requestPathParameters = NULL;
 	requestPostParameters = NULL;
 	cookies = NULL;
-	headerDataProcessed = 0;
 	postDataProcessed = 0;
-	bodyBuf = NULL;
+	http10 = false;
+	args = NULL;
+	route = NULL;
+	routeFound = false;
+	bodyPaused = false;
+	parsingBody = false;
+	connection = NULL;
 	tmpbuf = "";
 }
 
 HttpRequest::~HttpRequest()
 {
+	abortBody();
 	delete requestHeaders;
 	delete requestGetParameters;
+	delete requestPathParameters;
 	delete requestPostParameters;
 	delete cookies;
 	postDataProcessed = 0;
-	if (bodyBuf != NULL)
-	{
-		os_free(bodyBuf);
-	}
+}
+
+void HttpRequest::reset()
+{
+	abortBody();
+	delete requestHeaders;
+	delete requestGetParameters;
+	delete requestPathParameters;
+	delete requestPostParameters;
+	delete cookies;
+	requestHeaders = NULL;
+	requestGetParameters = NULL;
+	requestPathParameters = NULL;
+	requestPostParameters = NULL;
+	cookies = NULL;
+	postDataProcessed = 0;
+	http10 = false;
+	args = NULL;
+	route = NULL;
+	routeFound = false;
+	bodyPaused = false;
+	method = "";
+	path = "";
+	tmpbuf = "";
+	HttpRequestParser::reset();
 }
 
 String HttpRequest::getQueryParameter(String parameterName, String defaultValue /* = "" */)
@@ -43,6 +74,20 @@ String HttpRequest::getQueryParameter(String parameterName, String defaultValue
 
 	return defaultValue;
 }
+String HttpRequest::getPathParameter(String parameterName, String defaultValue /* = "" */)
+{
+	if (requestPathParameters && requestPathParameters->contains(parameterName))
+			return (*requestPathParameters)[parameterName];
+
+	return defaultValue;
+}
+
+void HttpRequest::setPathParameter(String parameterName, String value)
+{
+	if (requestPathParameters == NULL) requestPathParameters = new HashMap<String, String>();
+	(*requestPathParameters)[parameterName] = value;
+}
+
 String HttpRequest::getPostParameter(String parameterName, String defaultValue /* = "" */)
 {
 	if (requestPostParameters && requestPostParameters->contains(parameterName))
@@ -70,148 +115,165 @@ String HttpRequest::getCookie(String name, String defaultValue /* = "" */)
 
 int HttpRequest::getContentLength()
 {
-	String len = getHeader("Content-Length");
+	String len = getHeader(F("content-length"));
 	if (len.length() == 0) return -1;
 
 	return len.toInt();
 }
 
+bool HttpRequest::hasTransferEncoding()
+{
+	String encoding = getHeader(F("transfer-encoding"));
+	return encoding.length() > 0 && !encoding.equalsIgnoreCase("identity");
+}
+
 String HttpRequest::getContentType()
 {
-	return getHeader("Content-Type");
+	return getHeader(F("content-type"));
 }
 
-HttpParseResult HttpRequest::parseHeader(HttpServer *server, pbuf* buf)
+HttpParseResult HttpRequest::parseHeader(HttpServer *server, pbuf* buf, int& bufPos)
 {
-	int headerEnd = NetUtils::pbufFindStr(buf, "\r\n\r\n");
-	if (headerEnd > NETWORK_MAX_HTTP_PARSING_LEN || headerDataProcessed > NETWORK_MAX_HTTP_PARSING_LEN \
-		|| (headerEnd != -1 && buf->tot_len > NETWORK_MAX_HTTP_PARSING_LEN))
-	{
-		debugf("NETWORK_MAX_HTTP_PARSING_LEN");
-		return eHPR_Failed;
-	}
-	int urlEnd = 0;
-	tmpbuf += NetUtils::pbufStrCopy(buf, 0, buf->tot_len);
-	if (requestHeaders == NULL) {
-		// first time calling header
-		requestHeaders = new HashMap<String, String>();
-
-		int urlStart = tmpbuf.indexOf(" ")+1;
-		urlEnd = tmpbuf.indexOf(" ", urlStart);
-		if (urlStart == 0 || urlEnd == -1)
-		{
-			debugf("!BadRequest");
-			return eHPR_Failed;
-		}
+	this->server = server;
+	HttpParseResult res = parse(buf, bufPos);
+	if (res == eHPR_Successful)
+		debugf("parsed");
+	else if (res == eHPR_Failed)
+		debugf("!BadRequest");
 
-		method = tmpbuf.substring(0, urlStart-1);
-		int urlParamsStart = tmpbuf.indexOf("?", urlStart);
-		if (urlParamsStart != -1 && urlParamsStart < urlEnd)
-		{
-			path = tmpbuf.substring(urlStart, urlParamsStart);
-			if (requestGetParameters == NULL) requestGetParameters = new HashMap<String, String>();
-			extractParsingItemsList(tmpbuf, urlParamsStart + 1, urlEnd, '&', ' ', requestGetParameters);
-		}
-		else
-			path = tmpbuf.substring(urlStart, urlEnd);
-		debugf("path=%s", path.c_str());
-		urlEnd = tmpbuf.indexOf("\r\n", urlEnd)+2;
-	}
+	return res;
+}
 
-	int line, nextLine;
-	line = urlEnd;
-	do
-	{
+void HttpRequest::onRequestMethod(const char* method)
+{
+	this->method = method;
+}
 
-		nextLine = tmpbuf.indexOf("\r\n", line);
-		if (nextLine - line > 2)
+void HttpRequest::onRequestPath(const char* path)
+{
+	this->path = path;
+	debugf("path=%s", path);
+}
 
-		{
-			int delim = tmpbuf.indexOf(":", line);
-			if (delim != -1)
-			{
-				String name = tmpbuf.substring(line, delim);
-				name.toLowerCase();
-				if (server->isHeaderProcessingEnabled(name))
-				{
-					debugf("Name: %s", name.c_str());
-					if (name == "cookie")
-					{
-						if (cookies == NULL) cookies = new HashMap<String, String>();
-						extractParsingItemsList(tmpbuf, delim + 1, nextLine, ';', '\r', cookies);
-					}
-					else
-					{
-						String value = tmpbuf.substring(delim + 1, nextLine);
-						value.trim();
-						(*requestHeaders)[name] = value;
-						debugf("%s === %s", name.c_str(), value.c_str());
-					}
-
-				}
-			}
+void HttpRequest::onQueryParameter(const char* name, const char* value)
+{
+	if (requestGetParameters == NULL) requestGetParameters = new HashMap<String, String>();
+	String itemName = name;
+	itemName.trim();
+	(*requestGetParameters)[itemName] = value;
+}
 
-		}
-		if (nextLine != -1) {
-			line = nextLine + 2;
-		}
+void HttpRequest::onRequestVersion(const char* version)
+{
+	http10 = strcmp(version, "HTTP/1.0") == 0;
+}
 
-	} while(nextLine != -1);
+bool HttpRequest::onHeaderName(const StringView& name)
+{
+	// Body framing must be known even if the application doesn't process the header
+	if (name.equalsIgnoreCase("transfer-encoding"))
+		return true;
+	return server != NULL && server->isHeaderProcessingEnabled(name);
+}
 
-	if (headerEnd != -1)
+void HttpRequest::onHeader(const char* name, const char* value)
+{
+	debugf("%s === %s", name, value);
+	if (strcmp(name, "cookie") == 0)
 	{
-		tmpbuf = "";
-		debugf("parsed");
-		return eHPR_Successful;
+		if (cookies == NULL) cookies = new HashMap<String, String>();
+		String items = value;
+		extractParsingItemsList(items, 0, items.length(), ';', '\r', cookies);
+	}
+	else
+	{
+		if (requestHeaders == NULL) requestHeaders = new HashMap<String, String>();
+		(*requestHeaders)[name] = value;
 	}
-	headerDataProcessed += buf->tot_len;
-	tmpbuf = tmpbuf.substring(line, buf->tot_len);
-	return eHPR_Wait;
 }
 
-HttpParseResult HttpRequest::parsePostData(HttpServer *server, pbuf* buf)
+HttpParseResult HttpRequest::parsePostData(HttpServer *server, pbuf* buf, int& bufPos)
 {
-	int start = 0;
-	tmpbuf += NetUtils::pbufStrCopy(buf, 0, buf->tot_len);
+	int contentLength = getContentLength();
 	// First enter
-	if (requestPostParameters == NULL)
+	if (postDataProcessed == 0 && !bodyParser)
 	{
-		int headerEnd = NetUtils::pbufFindStr(buf, "\r\n\r\n");
-		if (headerEnd == -1) return eHPR_Failed;
-		if (headerEnd + getContentLength() > NETWORK_MAX_HTTP_PARSING_LEN)
+		bodyParser = server->getBodyParser(*this);
+		if (bodyParser && !callBodyParser(NULL, PARSE_DATASTART))
 		{
-			debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+			debugf("Body rejected");
+			bodyParser = nullptr;
 			return eHPR_Failed;
 		}
-		requestPostParameters = new HashMap<String, String>();
-		start = headerEnd + 4;
-		tmpbuf = tmpbuf.substring(start, tmpbuf.length());
 	}
 
-	//parse if it is FormUrlEncoded - otherwise keep in buffer
-	String contType = getContentType();
-	contType.toLowerCase();
-	if (contType.indexOf(ContentType::FormUrlEncoded) != -1)
+	// Find segment with the first unprocessed byte
+	pbuf* cur = buf;
+	int offset = bufPos;
+	while (cur != NULL && offset >= cur->len)
 	{
-		tmpbuf = extractParsingItemsList(tmpbuf, 0, tmpbuf.length(), '&', ' ', requestPostParameters);
+		offset -= cur->len;
+		cur = cur->next;
 	}
 
-	postDataProcessed += buf->tot_len - start ;
-
-	if (postDataProcessed == getContentLength())
+	// Pass received segments as is
+	while (cur != NULL && postDataProcessed < contentLength && !bodyPaused)
 	{
-		return eHPR_Successful;
-	}
-	else if (postDataProcessed > getContentLength())
-	{
-		//avoid bufferoverflow if client announces non-correct content-length
-		debugf("NETWORK_MAX_HTTP_PARSING_LEN");
-		return eHPR_Failed;
+		int available = min(cur->len - offset, contentLength - postDataProcessed);
+		if (bodyParser && !callBodyParser((const char*)cur->payload + offset, available))
+		{
+			debugf("Body parsing failed");
+			abortBody();
+			return eHPR_Failed;
+		}
+		bufPos += available;
+		postDataProcessed += available;
+		offset = 0;
+		cur = cur->next;
 	}
-	else
-	{
+
+	if (postDataProcessed < contentLength || bodyPaused)
 		return eHPR_Wait;
-	}
+
+	if (!bodyParser)
+		return eHPR_Successful; // Nobody is interested in body, it was skipped
+
+	HttpBodyParserDelegate parser = bodyParser;
+	bodyParser = nullptr;
+	return parser(*this, NULL, PARSE_DATAEND) ? eHPR_Successful : eHPR_Failed;
+}
+
+bool HttpRequest::callBodyParser(const char* at, int length)
+{
+	parsingBody = true;
+	bool res = bodyParser(*this, at, length);
+	parsingBody = false;
+	return res;
+}
+
+void HttpRequest::pauseBody()
+{
+	bodyPaused = true;
+}
+
+void HttpRequest::resumeBody()
+{
+	if (!bodyPaused) return;
+
+	bodyPaused = false;
+	// Called from the parser itself, passing data simply continues
+	if (!parsingBody && connection != NULL)
+		connection->onBodyResumed();
+}
+
+void HttpRequest::abortBody()
+{
+	bodyPaused = false;
+	if (!bodyParser) return;
+
+	HttpBodyParserDelegate parser = bodyParser;
+	bodyParser = nullptr;
+	parser(*this, NULL, PARSE_DATAABORT);
 }
 
 String HttpRequest::extractParsingItemsList(String& buf, int startPos, int endPos, char delimChar, char endChar,
@@ -256,12 +318,22 @@ String HttpRequest::getBody()
 
 bool HttpRequest::isAjax()
 {
-	String req = getHeader("HTTP_X_REQUESTED_WITH");
+	String req = getHeader(F("http_x_requested_with"));
 	return req.equalsIgnoreCase("xmlhttprequest");
 }
 
 bool HttpRequest::isWebSocket()
 {
-	String req = getHeader("Upgrade");
+	String req = getHeader(F("upgrade"));
 	return req.equalsIgnoreCase("websocket");
 }
+
+bool HttpRequest::isKeepAlive()
+{
+	String connection = getHeader(F("connection"));
+	connection.toLowerCase();
+	if (http10)
+		return connection.indexOf("keep-alive") != -1;
+	else
+		return connection.indexOf("close") == -1;
+}
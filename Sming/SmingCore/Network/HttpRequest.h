@@ -8,23 +8,17 @@
 #ifndef _SMING_CORE_NETWORK_HTTPREQUEST_H_
 #define _SMING_CORE_NETWORK_HTTPREQUEST_H_
 
-#define NETWORK_MAX_HTTP_PARSING_LEN 4096
-
+#include "HttpRequestParser.h"
+#include "HttpBodyParser.h"
 #include "../Wiring/WHashMap.h"
 #include "../Wiring/WString.h"
 
-class pbuf;
 class HttpServer;
+class HttpServerConnection;
+struct HttpRoute;
 class TemplateFileStream;
 
-enum HttpParseResult
-{
-	eHPR_Wait = 0,
-	eHPR_Successful,
-	eHPR_Failed
-};
-
-class HttpRequest
+class HttpRequest : protected HttpRequestParser
 {
 public:
 	HttpRequest();
@@ -34,36 +28,81 @@ public:
 	inline String getPath() { return path; }
 	String getContentType();
 	int getContentLength();
+	// Body is chunked or otherwise encoded, Content-Length doesn't apply
+	bool hasTransferEncoding();
 
 	bool isAjax();
 	bool isWebSocket();
+	// Client asked to keep connection opened after this request
+	bool isKeepAlive();
+	inline bool isHttp10() { return http10; }
 
 	String getQueryParameter(String parameterName, String defaultValue = "");
+	// Value of ":name" or "*" segment of the matched path
+	String getPathParameter(String parameterName, String defaultValue = "");
+	void setPathParameter(String parameterName, String value);
 	String getPostParameter(String parameterName, String defaultValue = "");
 	String getHeader(String headerName, String defaultValue = "");
 	String getCookie(String cookieName, String defaultValue = "");
+	// Available only when body was processed by bodyToStringParser
 	String getBody();
 
 public:
-	HttpParseResult parseHeader(HttpServer *server, pbuf* buf);
-	HttpParseResult parsePostData(HttpServer *server, pbuf* buf);
+	// bufPos: position of the first unprocessed byte in buf, updated on return
+	HttpParseResult parseHeader(HttpServer *server, pbuf* buf, int& bufPos);
+	// Body is passed to the body parser selected by HttpServer, without buffering
+	HttpParseResult parsePostData(HttpServer *server, pbuf* buf, int& bufPos);
+	// Notify body parser that body won't be completed
+	void abortBody();
+	// Body parser can't take more data yet: the rest isn't passed and the client isn't
+	// allowed to send more until resumeBody(), which can be called later (e.g. from a timer)
+	void pauseBody();
+	void resumeBody();
+	inline bool isBodyPaused() { return bodyPaused; }
+	// Prepare for the next request on persistent connection
+	void reset();
 	String extractParsingItemsList(String& buf, int startPos, int endPos,
 			char delimChar, char endChar,
 			HashMap<String, String>* resultItems);
 
+public:
+	void* args; // Body parser state for the current request
+
+protected:
+	virtual void onRequestMethod(const char* method);
+	virtual void onRequestPath(const char* path);
+	virtual void onQueryParameter(const char* name, const char* value);
+	virtual void onRequestVersion(const char* version);
+	virtual bool onHeaderName(const StringView& name);
+	virtual void onHeader(const char* name, const char* value);
+
+private:
+	bool callBodyParser(const char* at, int length);
+
 private:
+	HttpServer *server;
 	String method;
 	String path;
 	String tmpbuf;
 	HashMap<String, String> *requestHeaders;
 	HashMap<String, String> *requestGetParameters;
+	HashMap<String, String> *requestPathParameters;
 	HashMap<String, String> *requestPostParameters;
 	HashMap<String, String> *cookies;
 	int postDataProcessed;
-	int headerDataProcessed;
-	char *bodyBuf;
+	bool http10;
+	HttpBodyParserDelegate bodyParser;
+	bool bodyPaused;
+	bool parsingBody; // Body parser is being called
+	HttpServerConnection* connection; // Continues parsing on resumeBody()
+	HttpRoute* route; // Found by HttpServer once per request
+	bool routeFound;
 
+	friend class HttpServer;
+	friend class HttpServerConnection;
 	friend class TemplateFileStream;
+	friend bool bodyToStringParser(HttpRequest& request, const char* at, int length);
+	friend bool formUrlParser(HttpRequest& request, const char* at, int length);
 };
 
 #endif /* _SMING_CORE_NETWORK_HTTPREQUEST_H_ */
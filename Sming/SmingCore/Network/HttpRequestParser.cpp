@@ -0,0 +1,347 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpRequestParser.h"
+#include "../../Services/WebHelpers/escape.h"
+
+#define HTTP_PARSER_MIN_TOKEN_CAPACITY 32
+
+HttpRequestParser::HttpRequestParser()
+{
+	token = NULL;
+	tokenCapacity = 0;
+	reset();
+}
+
+HttpRequestParser::~HttpRequestParser()
+{
+	freeToken();
+}
+
+void HttpRequestParser::reset()
+{
+	parserState = eHRPS_Method;
+	tokenLength = 0;
+	valueStart = 0;
+	skipValue = false;
+	parsedLength = 0;
+}
+
+void HttpRequestParser::freeToken()
+{
+	free(token);
+	token = NULL;
+	tokenCapacity = 0;
+	tokenLength = 0;
+	valueStart = 0;
+}
+
+HttpParseResult HttpRequestParser::parse(pbuf* buf, int& bufPos)
+{
+	// Find segment with the first unparsed byte
+	pbuf* cur = buf;
+	int offset = bufPos;
+	while (cur != NULL && offset >= cur->len)
+	{
+		offset -= cur->len;
+		cur = cur->next;
+	}
+
+	while (cur != NULL && parserState != eHRPS_Completed && parserState != eHRPS_Failed)
+	{
+		int consumed = parseBlock((const char*)cur->payload + offset, cur->len - offset);
+		bufPos += consumed;
+		parsedLength += consumed;
+		if (parsedLength > NETWORK_MAX_HTTP_PARSING_LEN && parserState != eHRPS_Completed)
+		{
+			debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+			parserState = eHRPS_Failed;
+		}
+		offset = 0;
+		cur = cur->next;
+	}
+
+	if (parserState == eHRPS_Completed)
+	{
+		freeToken(); // Don't keep parsing buffer while request is processed
+		return eHPR_Successful;
+	}
+	else if (parserState == eHRPS_Failed)
+	{
+		freeToken();
+		return eHPR_Failed;
+	}
+
+	return eHPR_Wait;
+}
+
+static bool isTokenEnd(HttpRequestParserState state, char ch)
+{
+	switch (state)
+	{
+	case eHRPS_Method:
+		return ch == ' ' || ch == '\r' || ch == '\n';
+	case eHRPS_Path:
+		return ch == ' ' || ch == '?' || ch == '\r' || ch == '\n';
+	case eHRPS_QueryName:
+		return ch == '=' || ch == '&' || ch == ' ' || ch == '\r' || ch == '\n';
+	case eHRPS_QueryValue:
+		return ch == '&' || ch == ' ' || ch == '\r' || ch == '\n';
+	case eHRPS_HeaderName:
+		return ch == ':' || ch == '\r' || ch == '\n';
+	default:
+		return ch == '\r' || ch == '\n';
+	}
+}
+
+int HttpRequestParser::parseBlock(const char* data, int length)
+{
+	int pos = 0;
+	while (pos < length && parserState != eHRPS_Completed && parserState != eHRPS_Failed)
+	{
+		if (parserState == eHRPS_LineStart)
+		{
+			char ch = data[pos];
+			if (ch == '\r')
+			{
+				parserState = eHRPS_HeadersEnd;
+				pos++;
+			}
+			else if (ch == '\n')
+			{
+				parserState = eHRPS_Completed;
+				pos++;
+			}
+			else
+				parserState = eHRPS_HeaderName;
+			continue;
+		}
+		else if (parserState == eHRPS_HeadersEnd)
+		{
+			parserState = (data[pos++] == '\n') ? eHRPS_Completed : eHRPS_Failed;
+			continue;
+		}
+		else if (parserState == eHRPS_HeaderValueStart)
+		{
+			if (data[pos] == ' ' || data[pos] == '\t')
+				pos++;
+			else
+				parserState = eHRPS_HeaderValue;
+			continue;
+		}
+
+		// Take the whole run of token characters at once
+		int start = pos;
+		while (pos < length && !isTokenEnd(parserState, data[pos]))
+			pos++;
+
+		if (parserState == eHRPS_HeaderName && tokenLength == 0 && pos < length && data[pos] == ':')
+		{
+			finishHeaderName(StringView(data + start, pos - start));
+			pos++;
+			continue;
+		}
+
+		bool store = !(parserState == eHRPS_HeaderValue && skipValue);
+		if (store && !appendToken(data + start, pos - start))
+		{
+			parserState = eHRPS_Failed;
+			break;
+		}
+		if (pos == length)
+			break; // Token continues in the next segment
+
+		char ch = data[pos++];
+		switch (parserState)
+		{
+		case eHRPS_Method:
+			if ((ch == '\r' || ch == '\n') && tokenLength == 0)
+				break; // Empty lines before request line are allowed
+			if (ch != ' ' || tokenLength == 0)
+			{
+				parserState = eHRPS_Failed;
+				break;
+			}
+			if (!terminateToken())
+				break;
+			onRequestMethod(token);
+			tokenLength = 0;
+			parserState = eHRPS_Path;
+			break;
+
+		case eHRPS_Path:
+			if (ch != ' ' && ch != '?')
+			{
+				parserState = eHRPS_Failed;
+				break;
+			}
+			if (!terminateToken())
+				break;
+			onRequestPath(token);
+			tokenLength = 0;
+			parserState = (ch == '?') ? eHRPS_QueryName : eHRPS_Version;
+			break;
+
+		case eHRPS_QueryName:
+		case eHRPS_QueryValue:
+			if (ch == '=' && parserState == eHRPS_QueryName)
+			{
+				if (!terminateToken())
+					break;
+				valueStart = ++tokenLength;
+				parserState = eHRPS_QueryValue;
+			}
+			else if (ch == '&' || ch == ' ')
+			{
+				finishQueryParameter();
+				parserState = (ch == '&') ? eHRPS_QueryName : eHRPS_Version;
+			}
+			else
+				parserState = eHRPS_Failed;
+			break;
+
+		case eHRPS_Version:
+			if (ch == '\n')
+			{
+				if (!terminateToken())
+					break;
+				onRequestVersion(token);
+				tokenLength = 0;
+				parserState = eHRPS_LineStart;
+			}
+			break;
+
+		case eHRPS_HeaderName:
+			if (ch == ':')
+				finishHeaderName(StringView(token, tokenLength)); // Collected from several segments
+			else if (ch == '\n')
+			{
+				// Not a header, ignore this line
+				tokenLength = 0;
+				parserState = eHRPS_LineStart;
+			}
+			break;
+
+		case eHRPS_HeaderValue:
+			if (ch == '\n')
+			{
+				if (!skipValue)
+					finishHeader();
+				tokenLength = 0;
+				valueStart = 0;
+				skipValue = false;
+				parserState = eHRPS_LineStart;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return pos;
+}
+
+bool HttpRequestParser::reserveToken(int required)
+{
+	if (required <= tokenCapacity) return true;
+
+	if (required > NETWORK_MAX_HTTP_PARSING_LEN + 1)
+	{
+		debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+		return false;
+	}
+
+	// Grow geometrically, a long cookie shouldn't cost a realloc per segment
+	int newCapacity = max(tokenCapacity * 2, HTTP_PARSER_MIN_TOKEN_CAPACITY);
+	newCapacity = max(newCapacity, required);
+	newCapacity = min(newCapacity, NETWORK_MAX_HTTP_PARSING_LEN + 1);
+	char* newToken = (char*)realloc(token, newCapacity);
+	if (newToken == NULL)
+		return false;
+
+	token = newToken;
+	tokenCapacity = newCapacity;
+	return true;
+}
+
+bool HttpRequestParser::appendToken(const char* data, int length)
+{
+	if (length <= 0) return true;
+	if (!reserveToken(tokenLength + length + 1)) return false;
+
+	memcpy(token + tokenLength, data, length);
+	tokenLength += length;
+	return true;
+}
+
+bool HttpRequestParser::terminateToken()
+{
+	// Token stays unusable (maybe NULL) on failure, callbacks mustn't get it
+	if (!reserveToken(tokenLength + 1))
+	{
+		parserState = eHRPS_Failed;
+		return false;
+	}
+	token[tokenLength] = '\0';
+	return true;
+}
+
+void HttpRequestParser::finishHeaderName(const StringView& name)
+{
+	parserState = eHRPS_HeaderValueStart;
+	skipValue = !onHeaderName(name);
+	if (skipValue)
+	{
+		tokenLength = 0;
+		return;
+	}
+
+	// Accepted name is kept for onHeader()
+	if (tokenLength == 0 && !appendToken(name.data(), name.length()))
+	{
+		parserState = eHRPS_Failed;
+		return;
+	}
+	if (!terminateToken())
+		return;
+	for (char* p = token; *p; p++)
+		*p = tolower(*p);
+	valueStart = ++tokenLength;
+}
+
+void HttpRequestParser::finishQueryParameter()
+{
+	if (tokenLength == 0) return; // Empty item, e.g. "?&a=1"
+
+	if (valueStart == 0)
+	{
+		// Parameter without value
+		if (!terminateToken()) return;
+		valueStart = ++tokenLength;
+	}
+	if (!terminateToken()) return;
+
+	// Decoded string can only be shorter, unescape in place
+	char* name = token;
+	char* value = token + valueStart;
+	uri_unescape(name, valueStart, name, -1);
+	uri_unescape(value, tokenLength - valueStart + 1, value, -1);
+	onQueryParameter(name, value);
+
+	tokenLength = 0;
+	valueStart = 0;
+}
+
+void HttpRequestParser::finishHeader()
+{
+	while (tokenLength > valueStart && isspace(token[tokenLength - 1]))
+		tokenLength--;
+	if (!terminateToken()) return;
+
+	onHeader(token, token + valueStart);
+}
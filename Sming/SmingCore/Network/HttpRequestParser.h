@@ -0,0 +1,97 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPREQUESTPARSER_H_
+#define _SMING_CORE_NETWORK_HTTPREQUESTPARSER_H_
+
+#include "../Wiring/WiringFrameworkDependencies.h"
+#include "../StringView.h"
+
+#define NETWORK_MAX_HTTP_PARSING_LEN 4096
+
+struct pbuf;
+
+enum HttpParseResult
+{
+	eHPR_Wait = 0,
+	eHPR_Successful,
+	eHPR_Failed
+};
+
+enum HttpRequestParserState
+{
+	eHRPS_Method = 0,
+	eHRPS_Path,
+	eHRPS_QueryName,
+	eHRPS_QueryValue,
+	eHRPS_Version,
+	eHRPS_LineStart,
+	eHRPS_HeaderName,
+	eHRPS_HeaderValueStart,
+	eHRPS_HeaderValue,
+	eHRPS_HeadersEnd,
+	eHRPS_Completed,
+	eHRPS_Failed
+};
+
+/**
+ * @brief Incremental HTTP request header parser
+ *
+ * Walks the pbuf chain in place, keeps only the current partial token in memory
+ * and reports request items as soon as they are complete.
+ * Header name found whole in a segment is checked there, skipped headers aren't copied at all.
+ * A request split over any number of pbufs is parsed exactly once.
+ */
+class HttpRequestParser
+{
+public:
+	HttpRequestParser();
+	virtual ~HttpRequestParser();
+
+	/**
+	 * @brief Parse the next part of the request header
+	 * @param buf Received data
+	 * @param bufPos in: position of the first byte to parse, out: position of the first byte not consumed
+	 * @return eHPR_Successful once the empty line closing the header was found
+	 */
+	HttpParseResult parse(pbuf* buf, int& bufPos);
+	void reset();
+
+	__forceinline HttpRequestParserState getParserState() { return parserState; }
+
+protected:
+	virtual void onRequestMethod(const char* method) = 0;
+	virtual void onRequestPath(const char* path) = 0;
+	virtual void onQueryParameter(const char* name, const char* value) = 0;
+	virtual void onRequestVersion(const char* version) = 0;
+	// Return false to skip the header value (it will not be buffered at all).
+	// Name isn't lower case yet, compare it ignoring case
+	virtual bool onHeaderName(const StringView& name) = 0;
+	// Name is lower case
+	virtual void onHeader(const char* name, const char* value) = 0;
+
+private:
+	int parseBlock(const char* data, int length);
+	bool reserveToken(int required);
+	bool appendToken(const char* data, int length);
+	bool terminateToken();
+	void finishHeaderName(const StringView& name);
+	void finishQueryParameter();
+	void finishHeader();
+	void freeToken();
+
+private:
+	HttpRequestParserState parserState;
+	char* token;
+	uint16_t tokenLength;
+	uint16_t tokenCapacity;
+	uint16_t valueStart; // Value position inside token buffer (name '\0' value)
+	bool skipValue;
+	int parsedLength;
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPREQUESTPARSER_H_ */
@@ -8,6 +8,7 @@
 #include "HttpResponse.h"
 
 #include "HttpServerConnection.h"
+#include "HttpRequest.h"
 #include "../DataSourceStream.h"
 
 HttpResponse::HttpResponse()
@@ -25,6 +26,17 @@ HttpResponse::~HttpResponse()
 	stream = NULL;
 }
 
+void HttpResponse::reset()
+{
+	if (stream != NULL)
+		delete stream;
+	stream = NULL;
+	status = HttpStatusCode::OK;
+	headerSent = false;
+	bodySent = false;
+	responseHeaders.clear();
+}
+
 void HttpResponse::switchingProtocols()
 {
 	status = HttpStatusCode::SwitchingProtocols;
@@ -45,10 +57,26 @@ void HttpResponse::authorizationRequired()
 {
 	status = HttpStatusCode::Unauthorized;
 }
+void HttpResponse::methodNotAllowed()
+{
+	status = HttpStatusCode::MethodNotAllowed;
+}
+void HttpResponse::lengthRequired()
+{
+	status = HttpStatusCode::LengthRequired;
+}
+void HttpResponse::notImplemented()
+{
+	status = HttpStatusCode::NotImplemented;
+}
 void HttpResponse::redirect(String location /* = "" */)
 {
 	status = HttpStatusCode::Found;
-	setHeader("Location", location);
+	setHeader(F("Location"), location);
+}
+void HttpResponse::notModified()
+{
+	status = HttpStatusCode::NotModified;
 }
 
 String HttpResponse::getStatusName()
@@ -69,27 +97,33 @@ bool HttpResponse::hasBody()
 	return stream != NULL || bodySent;
 }
 
+int HttpResponse::getContentLength()
+{
+	if (stream == NULL) return 0;
+	return stream->length();
+}
+
 ///
 
 void HttpResponse::setContentType(const String type)
 {
-	setHeader("Content-Type", type);
+	setHeader(F("Content-Type"), type);
 }
 
 void HttpResponse::setCookie(const String name, const String value)
 {
-	setHeader("Set-Cookie", name + "=" + value);
+	setHeader(F("Set-Cookie"), name + "=" + value);
 }
 
 void HttpResponse::setCache(int maxAgeSeconds, bool isPublic /* = false */)
 {
 	String chache = String(isPublic ? "public" : "private") +", max-age=" + String(maxAgeSeconds) + ", must-revalidate";
-	setHeader("Cache-Control", chache);
+	setHeader(F("Cache-Control"), chache);
 }
 
 void HttpResponse::setAllowCrossDomainOrigin(String controlAllowOrigin)
 {
-	setHeader("Access-Control-Allow-Origin", controlAllowOrigin);
+	setHeader(F("Access-Control-Allow-Origin"), controlAllowOrigin);
 }
 
 void HttpResponse::setHeader(const String name, const String value)
@@ -135,22 +169,29 @@ bool HttpResponse::sendFile(String fileName, bool allowGzipFileCheck /* = true*/
 	}
 
 	String compressed = fileName + ".gz";
-	if (allowGzipFileCheck && fileExist(compressed))
-	{
-		debugf("found %s", compressed.c_str());
-		stream = new FileStream(compressed);
-		setHeader("Content-Encoding", "gzip");
-	}
-	else if (fileExist(fileName))
-	{
-		debugf("found %s", fileName.c_str());
-		stream = new FileStream(fileName);
-	}
+	bool acceptGzip = request == NULL || request->getHeader(F("accept-encoding")).indexOf("gzip") != -1;
+	bool gzip = false;
+	spiffs_stat stat = {0};
+	String sendName;
+
+	if (allowGzipFileCheck && acceptGzip && fileStats(compressed, &stat) >= 0 && stat.name[0] != '\0')
+		gzip = true;
+	else if (fileStats(fileName, &stat) >= 0 && stat.name[0] != '\0')
+		gzip = false;
+	else if (allowGzipFileCheck && fileStats(compressed, &stat) >= 0 && stat.name[0] != '\0')
+		gzip = true; // Better than nothing
 	else
 	{
 		notFound();
 		return false;
 	}
+	sendName = gzip ? compressed : fileName;
+	debugf("found %s", sendName.c_str());
+
+	if (gzip)
+		setHeader(F("Content-Encoding"), "gzip");
+	if (allowGzipFileCheck)
+		setHeader(F("Vary"), "Accept-Encoding");
 
 	if (!hasHeader("Content-Type"))
 	{
@@ -158,6 +199,24 @@ bool HttpResponse::sendFile(String fileName, bool allowGzipFileCheck /* = true*/
 		if (mime != NULL)
 			setContentType(mime);
 	}
+
+	// From file system metadata only, change stamp covers files rewritten in place with the same object id and size
+	String etag = "\"" + String((unsigned int)stat.obj_id, HEX) + "-" + String((unsigned int)stat.size, HEX) + "-"
+			+ String((unsigned int)fileGetChangeStamp(stat), HEX) + "\"";
+	setHeader(F("ETag"), etag);
+
+	if (request != NULL)
+	{
+		String match = request->getHeader(F("if-none-match"));
+		if (match == "*" || match.indexOf(etag) != -1)
+		{
+			debugf("%s not modified", sendName.c_str());
+			notModified();
+			return true;
+		}
+	}
+
+	stream = new FileStream(sendName);
 	return true;
 }
 
@@ -219,6 +278,19 @@ bool HttpResponse::sendDataStream( IDataSourceStream * newDataStream , String re
     return true;
 }
 
+bool HttpResponse::sendDataProducer(StreamProducerDelegate producer, String reqContentType /* = "" */)
+{
+	return sendDataStream(new ProducerStream(producer), reqContentType);
+}
+
+void HttpResponse::setChunked()
+{
+	if (stream == NULL || headerSent) return;
+
+	stream = new ChunkedStream(stream);
+	setHeader(F("Transfer-Encoding"), "chunked");
+}
+
 ///
 
 void HttpResponse::sendHeader(HttpServerConnection &connection)
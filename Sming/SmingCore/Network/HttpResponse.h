@@ -16,6 +16,7 @@
 class pbuf;
 class HttpServer;
 class HttpServerConnection;
+class HttpRequest;
 
 class HttpResponse
 {
@@ -28,7 +29,11 @@ public:
 	void notFound();
 	void forbidden();
 	void authorizationRequired();
+	void methodNotAllowed();
+	void lengthRequired();
+	void notImplemented();
 	void redirect(String location = "");
+	void notModified();
 
 	void setContentType(const String type);
 	void setCookie(const String name, const String value);
@@ -41,6 +46,8 @@ public:
 	String getStatusName();
 	int getStatusCode();
 	bool hasBody();
+	// Body size in bytes, -1 when it is not known before sending
+	int getContentLength();
 
 	//*** This methods processed in background
 
@@ -49,6 +56,9 @@ public:
 	void sendString(String string);
 
 	// Send file by name
+	// Precompressed "fileName.gz" is preferred when client accepts gzip.
+	// File gets ETag of its object id, size and change stamp, "304 Not Modified" is sent
+	// without opening the file when client already has it
 	bool sendFile(String fileName, bool allowGzipFileCheck = true);
 
 	// Parse and send template file
@@ -58,11 +68,17 @@ public:
 	bool sendJsonObject(JsonObjectStream* newJsonStreamInstance);
 	// Send Datastream, can be called with Classes derived from
 	bool sendDataStream( IDataSourceStream * newDataStream , String reqContentType = "" );
+	// Generate body on the fly, producer is called each time there is free space in send buffer
+	bool sendDataProducer(StreamProducerDelegate producer, String reqContentType = "");
 	//***
 
 public:
 	void sendHeader(HttpServerConnection &connection);
 	bool sendBody(HttpServerConnection &connection);
+	// Prepare for the next response on persistent connection
+	void reset();
+	// Send body with chunked transfer coding, used when body length isn't known
+	void setChunked();
 
 private:
 	bool headerSent;
@@ -71,6 +87,9 @@ private:
 	HashMap<String, String> responseHeaders;
 
 	IDataSourceStream* stream;
+	HttpRequest* request = NULL; // Request this response is for
+
+	friend class HttpServerConnection;
 };
 
 #endif /* _SMING_CORE_NETWORK_HTTPRESPONSE_H_ */
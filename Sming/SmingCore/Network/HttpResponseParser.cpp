@@ -0,0 +1,270 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpResponseParser.h"
+#include "lwip/pbuf.h"
+
+HttpResponseParser::HttpResponseParser()
+{
+	reset();
+}
+
+void HttpResponseParser::reset(bool withoutBody /* = false */)
+{
+	parserState = eHRSPS_StatusLine;
+	line = String();
+	headerLength = 0;
+	code = 0;
+	this->withoutBody = withoutBody;
+	persistent = false;
+	chunked = false;
+	contentLength = -1;
+	remaining = 0;
+}
+
+HttpParseResult HttpResponseParser::parse(pbuf* buf, int& bufPos)
+{
+	while (buf != NULL && bufPos < buf->tot_len && parserState != eHRSPS_Completed && parserState != eHRSPS_Failed)
+	{
+		if (parserState == eHRSPS_Body || parserState == eHRSPS_ChunkData)
+			bufPos += parseBody(buf, bufPos);
+		else
+			bufPos += parseLine(buf, bufPos);
+	}
+
+	if (parserState == eHRSPS_Completed)
+		return eHPR_Successful;
+	else if (parserState == eHRSPS_Failed)
+		return eHPR_Failed;
+
+	return eHPR_Wait;
+}
+
+bool HttpResponseParser::finish()
+{
+	if (parserState == eHRSPS_Body && remaining < 0)
+		parserState = eHRSPS_Completed;
+
+	return parserState == eHRSPS_Completed;
+}
+
+int HttpResponseParser::parseBody(pbuf* buf, int bufPos)
+{
+	// Body is reported from the segment with bufPos
+	while (bufPos >= buf->len)
+	{
+		bufPos -= buf->len;
+		buf = buf->next;
+	}
+
+	int count = buf->len - bufPos;
+	if (remaining >= 0 && remaining < count)
+		count = remaining;
+	onResponseBody((uint8_t*)buf->payload + bufPos, count);
+
+	if (remaining >= 0)
+	{
+		remaining -= count;
+		if (remaining == 0)
+			parserState = (parserState == eHRSPS_Body) ? eHRSPS_Completed : eHRSPS_ChunkEnd;
+	}
+
+	return count;
+}
+
+int HttpResponseParser::parseLine(pbuf* buf, int bufPos)
+{
+	PbufSlice data(buf, bufPos);
+	int end = data.indexOf('\n');
+	int count = (end >= 0) ? end + 1 : data.length();
+	if (line.length() + count > HTTP_RESPONSE_MAX_LINE_LENGTH)
+	{
+		debugf("HTTP response line is too long");
+		parserState = eHRSPS_Failed;
+		return count;
+	}
+
+	if (parserState == eHRSPS_StatusLine || parserState == eHRSPS_Header)
+	{
+		headerLength += count;
+		if (headerLength > NETWORK_MAX_HTTP_PARSING_LEN)
+		{
+			debugf("NETWORK_MAX_HTTP_PARSING_LEN");
+			parserState = eHRSPS_Failed;
+			return count;
+		}
+	}
+
+	if (end < 0 || line.length() > 0)
+	{
+		// Line continues in the next receive call or started in the previous one
+		if (!data.substring(0, count).appendTo(line))
+		{
+			parserState = eHRSPS_Failed;
+			return count;
+		}
+		if (end < 0)
+			return count;
+
+		// Buffered line is parsed like received data
+		pbuf lineBuf = {};
+		lineBuf.payload = (void*)line.c_str();
+		lineBuf.len = lineBuf.tot_len = line.length();
+		processLine(PbufSlice(&lineBuf));
+		line = String();
+	}
+	else
+		processLine(data.substring(0, count));
+
+	return count;
+}
+
+void HttpResponseParser::processLine(PbufSlice line)
+{
+	int length = line.length();
+	while (length > 0 && (line.charAt(length - 1) == '\n' || line.charAt(length - 1) == '\r'))
+		length--;
+	line = line.substring(0, length);
+
+	switch (parserState)
+	{
+	case eHRSPS_StatusLine:
+		if (length > 0) // Empty lines before response are tolerated
+			processStatusLine(line);
+		break;
+
+	case eHRSPS_Header:
+		if (length > 0)
+			processHeaderLine(line);
+		else if (code >= 100 && code < 200)
+		{
+			// Interim response, the real one follows
+			bool noBody = withoutBody;
+			reset(noBody);
+			return;
+		}
+		else
+			beginBody();
+		break;
+
+	case eHRSPS_ChunkSize:
+	{
+		// Hex size, optionally followed by extensions
+		int32_t size = 0;
+		int digits = 0;
+		for (; digits < length; digits++)
+		{
+			char ch = line.charAt(digits);
+			int value;
+			if (ch >= '0' && ch <= '9')
+				value = ch - '0';
+			else if (ch >= 'a' && ch <= 'f')
+				value = ch - 'a' + 10;
+			else if (ch >= 'A' && ch <= 'F')
+				value = ch - 'A' + 10;
+			else
+				break;
+			if (digits >= 7)
+			{
+				digits = 0; // Too big
+				break;
+			}
+			size = (size << 4) | value;
+		}
+
+		if (digits == 0)
+		{
+			debugf("HTTP invalid chunk size");
+			parserState = eHRSPS_Failed;
+		}
+		else if (size == 0)
+			parserState = eHRSPS_Trailer;
+		else
+		{
+			remaining = size;
+			parserState = eHRSPS_ChunkData;
+		}
+		break;
+	}
+
+	case eHRSPS_ChunkEnd:
+		parserState = (length == 0) ? eHRSPS_ChunkSize : eHRSPS_Failed;
+		break;
+
+	case eHRSPS_Trailer:
+		if (length == 0)
+			parserState = eHRSPS_Completed;
+		break;
+
+	default:
+		break;
+	}
+}
+
+void HttpResponseParser::processStatusLine(const PbufSlice& line)
+{
+	// HTTP/1.1 200 OK
+	int codeStart = line.indexOf(' ');
+	if (!line.startsWith("HTTP/") || codeStart < 0)
+	{
+		debugf("HTTP invalid status line");
+		parserState = eHRSPS_Failed;
+		return;
+	}
+
+	// Connections of HTTP/1.1 stay open unless the server says otherwise
+	persistent = !line.startsWith("HTTP/1.0");
+	code = line.substring(codeStart + 1, codeStart + 4).toInt();
+	parserState = eHRSPS_Header;
+	onResponseStatus(code);
+}
+
+void HttpResponseParser::processHeaderLine(const PbufSlice& line)
+{
+	int delim = line.indexOf(':');
+	if (delim <= 0)
+		return; // Continuation lines aren't supported
+
+	PbufSlice name = line.substring(0, delim);
+	PbufSlice value = line.substring(delim + 1).trim();
+
+	if (name.equalsIgnoreCase("Content-Length"))
+		contentLength = value.toInt();
+	else if (name.equalsIgnoreCase("Transfer-Encoding") || name.equalsIgnoreCase("Connection"))
+	{
+		if (value.indexOfIgnoreCase("chunked") >= 0)
+			chunked = true;
+		else if (value.indexOfIgnoreCase("close") >= 0)
+			persistent = false;
+		else if (value.indexOfIgnoreCase("keep-alive") >= 0)
+			persistent = true;
+	}
+
+	onResponseHeader(name, value);
+}
+
+void HttpResponseParser::beginBody()
+{
+	onResponseHeadersComplete();
+
+	if (withoutBody || code == 204 || code == 304)
+		parserState = eHRSPS_Completed;
+	else if (chunked)
+		parserState = eHRSPS_ChunkSize;
+	else if (contentLength >= 0)
+	{
+		remaining = contentLength;
+		parserState = (remaining > 0) ? eHRSPS_Body : eHRSPS_Completed;
+	}
+	else
+	{
+		// Body ends with the connection
+		remaining = -1;
+		persistent = false;
+		parserState = eHRSPS_Body;
+	}
+}
@@ -0,0 +1,94 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPRESPONSEPARSER_H_
+#define _SMING_CORE_NETWORK_HTTPRESPONSEPARSER_H_
+
+#include "HttpRequestParser.h"
+#include "PbufSlice.h"
+#include "../../Wiring/WString.h"
+
+// Status line, header line or chunk size line
+#define HTTP_RESPONSE_MAX_LINE_LENGTH 1024
+
+enum HttpResponseParserState
+{
+	eHRSPS_StatusLine = 0,
+	eHRSPS_Header,
+	eHRSPS_Body, // Content-Length or until connection is closed
+	eHRSPS_ChunkSize,
+	eHRSPS_ChunkData,
+	eHRSPS_ChunkEnd,
+	eHRSPS_Trailer,
+	eHRSPS_Completed,
+	eHRSPS_Failed
+};
+
+/**
+ * @brief Incremental HTTP response parser
+ *
+ * Finds where the response ends (Content-Length, chunked transfer coding or connection close),
+ * so more responses can follow on the same connection. Body is reported decoded as it arrives.
+ * Parsing stops at the end of response, the rest of received data belongs to the next one.
+ * Status and header lines are inspected in the received pbufs, only a line continuing
+ * in the next receive call is copied.
+ */
+class HttpResponseParser
+{
+public:
+	HttpResponseParser();
+	virtual ~HttpResponseParser() {}
+
+	/**
+	 * @brief Parse the next part of the response
+	 * @param buf Received data
+	 * @param bufPos in: position of the first byte to parse, out: position of the first byte not consumed
+	 * @return eHPR_Successful when the response is complete
+	 */
+	HttpParseResult parse(pbuf* buf, int& bufPos);
+	// Connection was closed, returns true if it completed the response
+	bool finish();
+	// Prepare for the next response, HEAD request gets one without body
+	void reset(bool withoutBody = false);
+
+	__forceinline HttpResponseParserState getParserState() { return parserState; }
+	// Connection can be used for the next request
+	__forceinline bool isPersistent() { return persistent; }
+	// Body length from Content-Length, -1 for chunked body or body ending with connection
+	__forceinline int getContentLength() { return chunked ? -1 : contentLength; }
+	// Some data of this response was received
+	__forceinline bool isStarted() { return parserState != eHRSPS_StatusLine || line.length() > 0; }
+
+protected:
+	virtual void onResponseStatus(int code) {}
+	// Name and value are valid during the call only
+	virtual void onResponseHeader(const PbufSlice& name, const PbufSlice& value) = 0;
+	// Called before the body, also for response without it
+	virtual void onResponseHeadersComplete() {}
+	virtual void onResponseBody(uint8_t* data, size_t size) = 0;
+
+private:
+	int parseBody(pbuf* buf, int bufPos);
+	int parseLine(pbuf* buf, int bufPos);
+	void processLine(PbufSlice line);
+	void processStatusLine(const PbufSlice& line);
+	void processHeaderLine(const PbufSlice& line);
+	void beginBody();
+
+private:
+	HttpResponseParserState parserState;
+	String line; // Beginning of the line continuing in the next receive call
+	int headerLength;
+	int code;
+	bool withoutBody;
+	bool persistent;
+	bool chunked;
+	int32_t contentLength; // -1 if unknown
+	int32_t remaining; // Of body or chunk, -1 until connection is closed
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPRESPONSEPARSER_H_ */
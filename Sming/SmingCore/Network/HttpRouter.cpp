@@ -0,0 +1,263 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "HttpRouter.h"
+#include "HttpRequest.h"
+#include "../../Services/WebHelpers/escape.h"
+
+HttpRouter::HttpRouter()
+{
+	root.type = eHRST_Literal;
+	root.parameters = NULL;
+	root.wildcard = NULL;
+	root.next = NULL;
+	root.routes = NULL;
+}
+
+HttpRouter::~HttpRouter()
+{
+	for (unsigned i = 0; i < root.literals.count(); i++)
+		freeNode(root.literals[i]);
+	root.literals.clear();
+	freeNode(root.parameters);
+	root.parameters = NULL;
+	freeNode(root.wildcard);
+	root.wildcard = NULL;
+
+	HttpRoute* route = root.routes;
+	while (route != NULL)
+	{
+		HttpRoute* next = route->next;
+		delete route;
+		route = next;
+	}
+	root.routes = NULL;
+}
+
+void HttpRouter::freeNode(HttpRouteNode* node)
+{
+	while (node != NULL)
+	{
+		for (unsigned i = 0; i < node->literals.count(); i++)
+			freeNode(node->literals[i]);
+		freeNode(node->parameters);
+		freeNode(node->wildcard);
+
+		HttpRoute* route = node->routes;
+		while (route != NULL)
+		{
+			HttpRoute* next = route->next;
+			delete route;
+			route = next;
+		}
+
+		HttpRouteNode* next = node->next;
+		delete node;
+		node = next;
+	}
+}
+
+int HttpRouter::findLiteral(HttpRouteNode* node, const char* segment, int length, bool& found)
+{
+	int low = 0;
+	int high = node->literals.count();
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		const String& text = node->literals[middle]->segment;
+		int common = min((int)text.length(), length);
+		int cmp = memcmp(text.c_str(), segment, common);
+		if (cmp == 0)
+			cmp = (int)text.length() - length;
+
+		if (cmp == 0)
+		{
+			found = true;
+			return middle;
+		}
+		if (cmp < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	found = false;
+	return low;
+}
+
+HttpRouteNode* HttpRouter::getChild(HttpRouteNode* node, HttpRouteSegmentType type, const char* segment, int length)
+{
+	int index = 0;
+	HttpRouteNode** place = NULL;
+	if (type == eHRST_Literal)
+	{
+		bool found;
+		index = findLiteral(node, segment, length, found);
+		if (found)
+			return node->literals[index];
+	}
+	else if (type == eHRST_Wildcard)
+	{
+		if (node->wildcard != NULL)
+			return node->wildcard;
+		place = &node->wildcard;
+	}
+	else
+	{
+		place = &node->parameters;
+		while (*place != NULL)
+		{
+			if ((*place)->segment.length() == (unsigned)length
+					&& memcmp((*place)->segment.c_str(), segment, length) == 0)
+				return *place;
+			place = &(*place)->next;
+		}
+	}
+
+	HttpRouteNode* child = new HttpRouteNode();
+	child->type = type;
+	child->segment.setString(segment, length);
+	child->parameters = NULL;
+	child->wildcard = NULL;
+	child->next = NULL;
+	child->routes = NULL;
+	if (place != NULL)
+		*place = child;
+	else
+		node->literals.insertElementAt(child, index);
+
+	return child;
+}
+
+void HttpRouter::add(String method, String path, HttpPathDelegate callback, HttpBodyParserDelegate bodyParser)
+{
+	HttpRouteNode* node = &root;
+	const char* cur = path.c_str();
+	while (*cur != '\0')
+	{
+		if (*cur == '/')
+		{
+			cur++;
+			continue;
+		}
+
+		const char* end = strchr(cur, '/');
+		if (end == NULL)
+			end = cur + strlen(cur);
+
+		if (*cur == ':')
+			node = getChild(node, eHRST_Parameter, cur + 1, end - cur - 1);
+		else if (*cur == '*' && end - cur == 1)
+		{
+			node = getChild(node, eHRST_Wildcard, cur, 1);
+			break; // Nothing can follow
+		}
+		else
+			node = getChild(node, eHRST_Literal, cur, end - cur);
+		cur = end;
+	}
+
+	// Replace existing route for the same method
+	HttpRoute** place = &node->routes;
+	while (*place != NULL && !(*place)->method.equals(method))
+		place = &(*place)->next;
+
+	if (*place == NULL)
+	{
+		*place = new HttpRoute();
+		(*place)->next = NULL;
+	}
+	(*place)->method = method;
+	(*place)->callback = callback;
+	(*place)->bodyParser = bodyParser;
+	debugf("'%s %s' registered", method.c_str(), path.c_str());
+}
+
+HttpRoute* HttpRouter::find(HttpRequest& request, const char* method, bool setParameters)
+{
+	String path = request.getPath();
+	HttpRouteNode* node = match(&root, path.c_str(), method, setParameters ? &request : NULL);
+	if (node == NULL)
+		return NULL;
+
+	return findRoute(node, method);
+}
+
+HttpRoute* HttpRouter::findRoute(HttpRouteNode* node, const char* method)
+{
+	HttpRoute* anyMethod = NULL;
+	for (HttpRoute* route = node->routes; route != NULL; route = route->next)
+	{
+		if (method == NULL || route->method.equals(method))
+			return route;
+		if (route->method.length() == 0)
+			anyMethod = route;
+	}
+
+	return anyMethod;
+}
+
+HttpRouteNode* HttpRouter::match(HttpRouteNode* node, const char* path, const char* method, HttpRequest* request)
+{
+	while (*path == '/')
+		path++;
+
+	if (*path == '\0')
+	{
+		if (findRoute(node, method) != NULL)
+			return node;
+
+		// Wildcard also matches empty rest of path
+		if (node->wildcard != NULL && findRoute(node->wildcard, method) != NULL)
+		{
+			if (request != NULL)
+				request->setPathParameter("*", "");
+			return node->wildcard;
+		}
+
+		return NULL;
+	}
+
+	const char* end = strchr(path, '/');
+	if (end == NULL)
+		end = path + strlen(path);
+	int length = end - path;
+
+	// Literal segments first, then parameters, then wildcards
+	bool found;
+	int index = findLiteral(node, path, length, found);
+	if (found)
+	{
+		HttpRouteNode* result = match(node->literals[index], end, method, request);
+		if (result != NULL)
+			return result;
+	}
+
+	for (HttpRouteNode* child = node->parameters; child != NULL; child = child->next)
+	{
+		HttpRouteNode* result = match(child, end, method, request);
+		if (result != NULL)
+		{
+			if (request != NULL)
+			{
+				char* value = uri_unescape(NULL, 0, path, length);
+				request->setPathParameter(child->segment, value ? value : "");
+				free(value);
+			}
+			return result;
+		}
+	}
+
+	if (node->wildcard != NULL && findRoute(node->wildcard, method) != NULL)
+	{
+		if (request != NULL)
+			request->setPathParameter("*", path);
+		return node->wildcard;
+	}
+
+	return NULL;
+}
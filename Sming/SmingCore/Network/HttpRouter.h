@@ -0,0 +1,81 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_HTTPROUTER_H_
+#define _SMING_CORE_NETWORK_HTTPROUTER_H_
+
+#include "HttpBodyParser.h"
+#include "../Wiring/WString.h"
+#include "../Wiring/WVector.h"
+#include "../Delegate.h"
+
+class HttpRequest;
+class HttpResponse;
+
+typedef Delegate<void(HttpRequest&, HttpResponse&)> HttpPathDelegate;
+
+struct HttpRoute
+{
+	String method; // Empty for any method
+	HttpPathDelegate callback;
+	HttpBodyParserDelegate bodyParser;
+	HttpRoute* next;
+};
+
+enum HttpRouteSegmentType
+{
+	eHRST_Literal = 0,
+	eHRST_Parameter, // ":name", matches one path segment
+	eHRST_Wildcard // "*", matches the rest of path
+};
+
+struct HttpRouteNode
+{
+	HttpRouteSegmentType type;
+	String segment; // Text or parameter name
+	Vector<HttpRouteNode*> literals; // Sorted by segment, searched by bisection
+	HttpRouteNode* parameters; // Linked by next, different names can lead to different subtrees
+	HttpRouteNode* wildcard;
+	HttpRouteNode* next; // Sibling parameter
+	HttpRoute* routes;
+};
+
+/**
+ * @brief Path routing table organized as a trie of path segments
+ *
+ * Lookup cost depends on path depth and only logarithmically on number of paths of one level.
+ * Path examples: "/api/sensors", "/api/sensors/:id" (parameter), "*" as the last segment matches rest of path.
+ * Literal segments are preferred over parameters, parameters over wildcards.
+ */
+class HttpRouter
+{
+public:
+	HttpRouter();
+	virtual ~HttpRouter();
+
+	// method: RequestMethod::GET, ... or empty string for any method
+	void add(String method, String path, HttpPathDelegate callback, HttpBodyParserDelegate bodyParser);
+
+	/**
+	 * @brief Find route for the request, path parameters are stored into request when setParameters is true
+	 * @param method Request method, NULL to accept route for any method (to check if the path exists at all)
+	 */
+	HttpRoute* find(HttpRequest& request, const char* method, bool setParameters);
+
+private:
+	HttpRouteNode* match(HttpRouteNode* node, const char* path, const char* method, HttpRequest* request);
+	HttpRoute* findRoute(HttpRouteNode* node, const char* method);
+	// Index of literal child or of the place where it should be inserted
+	int findLiteral(HttpRouteNode* node, const char* segment, int length, bool& found);
+	HttpRouteNode* getChild(HttpRouteNode* node, HttpRouteSegmentType type, const char* segment, int length);
+	void freeNode(HttpRouteNode* node);
+
+private:
+	HttpRouteNode root;
+};
+
+#endif /* _SMING_CORE_NETWORK_HTTPROUTER_H_ */
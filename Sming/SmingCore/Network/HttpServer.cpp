@@ -21,16 +21,24 @@ HttpServer::HttpServer()
 
 	// Default processing headers
 	// Add more in you app!
-	enableHeaderProcessing("Cookie");
-	enableHeaderProcessing("Host");
-	enableHeaderProcessing("Content-Type");
-	enableHeaderProcessing("Content-Length");
-
-	enableHeaderProcessing("Upgrade");
+	enableHeaderProcessing(F("cookie"));
+	enableHeaderProcessing(F("host"));
+	enableHeaderProcessing(F("content-type"));
+	enableHeaderProcessing(F("content-length"));
+	enableHeaderProcessing(F("connection"));
+	enableHeaderProcessing(F("accept-encoding"));
+	enableHeaderProcessing(F("if-none-match"));
+
+	enableHeaderProcessing(F("upgrade"));
+
+	setBodyParser(ContentType::FormUrlEncoded, formUrlParser);
+	setBodyParser("*", bodyToStringParser);
 }
 
 HttpServer::~HttpServer()
 {
+	for (unsigned i = 0; i < wsocks.count(); i++)
+		delete wsocks[i];
 }
 
 TcpConnection* HttpServer::createClient(tcp_pcb *clientTcp)
@@ -51,12 +59,17 @@ void HttpServer::enableHeaderProcessing(String headerName)
 
 void HttpServer::addPath(String path, HttpPathDelegate callback)
 {
-	if (path.length() > 1 && path.endsWith("/"))
-		path = path.substring(0, path.length() - 1);
-	if (!path.startsWith("/"))
-		path = "/" + path;
-	debugf("'%s' registered", path.c_str());
-	paths[path] = callback;
+	routes.add("", path, callback, HttpBodyParserDelegate());
+}
+
+void HttpServer::addPath(String path, HttpPathDelegate callback, HttpBodyParserDelegate bodyParser)
+{
+	routes.add("", path, callback, bodyParser);
+}
+
+void HttpServer::addPath(String method, String path, HttpPathDelegate callback, HttpBodyParserDelegate bodyParser)
+{
+	routes.add(method, path, callback, bodyParser);
 }
 
 void HttpServer::setDefaultHandler(HttpPathDelegate callback)
@@ -64,6 +77,54 @@ void HttpServer::setDefaultHandler(HttpPathDelegate callback)
 	defaultHandler = callback;
 }
 
+void HttpServer::setBodyParser(String contentType, HttpBodyParserDelegate parser)
+{
+	contentType.toLowerCase();
+	bodyParsers[contentType] = parser;
+}
+
+HttpRoute* HttpServer::findRoute(HttpRequest& request)
+{
+	// Body parser and request handler need the same route, path is walked only once
+	if (!request.routeFound)
+	{
+		String method = request.getRequestMethod();
+		request.route = routes.find(request, method.c_str(), true);
+		request.routeFound = true;
+	}
+
+	return request.route;
+}
+
+HttpBodyParserDelegate HttpServer::getBodyParser(HttpRequest &request)
+{
+	HttpRoute* route = findRoute(request);
+	if (route != NULL && route->bodyParser)
+		return route->bodyParser;
+
+	// Skip parameters like "; charset=UTF-8"
+	String contentType = request.getContentType();
+	int pos = contentType.indexOf(';');
+	if (pos != -1)
+		contentType = contentType.substring(0, pos);
+	contentType.trim();
+	contentType.toLowerCase();
+	if (bodyParsers.contains(contentType))
+		return bodyParsers[contentType];
+
+	return bodyParsers["*"];
+}
+
+void HttpServer::setKeepAliveTimeOut(uint16_t waitTimeOut)
+{
+	keepAliveTimeOut = waitTimeOut;
+}
+
+void HttpServer::setMaxRequestsPerConnection(uint16_t maxRequests)
+{
+	maxRequestsPerConnection = maxRequests;
+}
+
 bool HttpServer::processRequest(HttpServerConnection &connection, HttpRequest &request, HttpResponse &response)
 {
 	if (request.isWebSocket())
@@ -71,31 +132,36 @@ bool HttpServer::processRequest(HttpServerConnection &connection, HttpRequest &r
 		bool res = initWebSocket(connection, request, response);
 		if (!res) response.badRequest();
 	}
-	String path = request.getPath();
-	if (path.length() > 1 && path.endsWith("/"))
-		path = path.substring(0, path.length() - 1);
-
-	if (paths.contains(path))
+	String method = request.getRequestMethod();
+	HttpRoute* route = findRoute(request);
+	if (route != NULL && route->callback)
 	{
-		paths[path](request, response);
+		route->callback(request, response);
 		return true;
 	}
 
 	if (defaultHandler)
 	{
-		debugf("Default server handler for: '%s'", path.c_str());
+		debugf("Default server handler for: '%s'", request.getPath().c_str());
 		defaultHandler(request, response);
 		return true;
 	}
 
-	debugf("ERROR at server 404: '%s' not found", path.c_str());
+	if (routes.find(request, NULL, false) != NULL)
+	{
+		debugf("ERROR at server 405: '%s %s'", method.c_str(), request.getPath().c_str());
+		response.methodNotAllowed();
+		return true;
+	}
+
+	debugf("ERROR at server 404: '%s' not found", request.getPath().c_str());
 	return false;
 }
 
-bool HttpServer::isHeaderProcessingEnabled(String name)
+bool HttpServer::isHeaderProcessingEnabled(const StringView& name)
 {
 	for (int i = 0; i < processingHeaders.count(); i++)
-		if (processingHeaders[i].equals(name))
+		if (name.equalsIgnoreCase(processingHeaders[i]))
 			return true;
 
 	return false;
@@ -106,65 +172,99 @@ bool HttpServer::initWebSocket(HttpServerConnection& connection, HttpRequest& re
 	if (!wsEnabled)
 		return false;
 
-    WebSocket *sock = new WebSocket(&connection);
-    if (!sock->initialize(request, response))
-        return false;
+	WebSocket* sock = new WebSocket(&connection, this);
+	if (!sock->initialize(request, response))
+	{
+		delete sock;
+		return false;
+	}
 
 	connection.setDisconnectionHandler(HttpServerConnectionDelegate(&HttpServer::onCloseWebSocket, this)); // auto remove on close
 	response.sendHeader(connection); // Will push header before user data
 
-    wsocks.addElement(sock);
-    if (wsConnect) wsConnect(*sock);
+	wsocks.add(sock);
+	wsBusy++;
+	if (wsConnect) wsConnect(*sock);
 
-    if (wsCommandEnabled &&  (request.getQueryParameter(wsCommandRequestParam) == "true"))
-    {
-        debugf("WebSocket Commandprocessor started");
-    	sock->enableCommand();
-    }
+	if (!sock->removed && wsCommandEnabled && (request.getQueryParameter(wsCommandRequestParam) == "true"))
+	{
+		debugf("WebSocket Commandprocessor started");
+		sock->enableCommand();
+	}
+	endWebSocketCallback();
+
+	return true;
 }
 
-void HttpServer::processWebSocketFrame(pbuf *buf, HttpServerConnection& connection)
+bool HttpServer::processWebSocketFrame(pbuf *buf, HttpServerConnection& connection)
 {
-	//TODO: process splitted payload
-	uint8_t* data; size_t size;
-
-	wsFrameType frameType = (wsFrameType) 0x01;
-	uint8_t payloadFieldExtraBytes = 0;
-	size_t payloadLength = 0;
-	size_t payloadShift = 0;
-	do
-	{
-	payloadLength = getPayloadLength((uint8_t*)buf->payload + payloadShift, buf->len, &payloadFieldExtraBytes, &frameType);
+	WebSocket* sock = getWebSocket(connection);
+	if (sock == nullptr)
+		return false;
 
-//    debugf("payloadLength: %u, payLoadShift: %u, payloadFieldExtraBytes: %u\n", payloadLength, payloadShift, payloadFieldExtraBytes);
+	wsBusy++; // Message handlers can broadcast and close other sockets
+	bool res = sock->processFrames(buf);
+	endWebSocketCallback();
+	return res;
+}
 
-	wsFrameType frameType = wsParseInputFrame((uint8_t*)buf->payload + payloadShift, (payloadLength + 6 + payloadFieldExtraBytes), &data, &size);
+void HttpServer::sendWebSocketFrames(HttpServerConnection& connection)
+{
 	WebSocket* sock = getWebSocket(connection);
+	if (sock != nullptr)
+		sock->sendQueued();
+}
 
-	if (frameType == WS_TEXT_FRAME)
-	{
-		String msg;
-		msg.setString((char*)data, size);
-		debugf("WS: %s", msg.c_str());
-		if (sock && wsMessage) wsMessage(*sock, msg);
-		if (sock && sock->commandExecutor) sock->commandExecutor->executorReceive(msg+"\r");
-	}
-	else if (frameType == WS_BINARY_FRAME)
-	{
-		if (sock && wsMessage) wsBinary(*sock, data, size);
-	}
-	else if (frameType == WS_CLOSING_FRAME)
+void HttpServer::broadcast(const char* message, int length, wsFrameType type)
+{
+	// Plain and compressed frames are built only when some client needs them
+	SharedBuffer* plain = NULL;
+	SharedBuffer* packed = NULL;
+
+	// Slow client can be closed, it is only marked as removed until the loop ends
+	wsBusy++;
+	for (unsigned i = 0; i < wsocks.count(); i++)
 	{
-		connection.close(); // it will be processed automatically in onCloseWebSocket callback
+		if (wsocks[i]->removed)
+			continue;
+
+		WebSocket& sock = *wsocks[i];
+		uint8_t bits = sock.getDeflateWindowBits();
+		if (bits == 0)
+		{
+			if (plain == NULL)
+				plain = WebSocket::makeFrame(message, length, type);
+			if (plain != NULL)
+				sock.queueFrame(plain);
+		}
+		else if (bits == wsDeflateBits)
+		{
+			if (packed == NULL)
+				packed = WebSocket::makeFrame(message, length, type, bits);
+			if (packed != NULL)
+				sock.queueFrame(packed);
+		}
+		else
+			sock.send(message, length, type); // Smaller window was negotiated
 	}
-	else if (frameType == WS_INCOMPLETE_FRAME || frameType == WS_ERROR_FRAME)
-		debugf("WS error reading frame: %X", frameType);
-	else
-		debugf("WS frame type: %X", frameType);
 
-	payloadShift += payloadLength + 6 + payloadFieldExtraBytes;
-	}
-	while (buf->len > payloadShift);
+	if (plain != NULL)
+		plain->unref();
+	if (packed != NULL)
+		packed->unref();
+	endWebSocketCallback();
+}
+
+void HttpServer::setWebSocketQueuePolicy(WebSocketQueuePolicy policy)
+{
+	wsQueuePolicy = policy;
+}
+
+void HttpServer::setWebSocketCompression(bool enabled, uint8_t windowBits)
+{
+	wsDeflateBits = enabled ? constrain(windowBits, 8, 15) : 0;
+	if (enabled)
+		enableHeaderProcessing(F("sec-websocket-extensions"));
 }
 
 void HttpServer::setWebSocketConnectionHandler(WebSocketDelegate handler)
@@ -182,6 +282,11 @@ void HttpServer::setWebSocketBinaryHandler(WebSocketBinaryDelegate handler)
 	wsBinary = handler;
 }
 
+void HttpServer::setWebSocketBinaryStreamHandler(WebSocketBinaryStreamDelegate handler)
+{
+	wsBinaryStream = handler;
+}
+
 void HttpServer::setWebSocketDisconnectionHandler(WebSocketDelegate handler)
 {
 	wsDisconnect = handler;
@@ -189,9 +294,9 @@ void HttpServer::setWebSocketDisconnectionHandler(WebSocketDelegate handler)
 
 WebSocket* HttpServer::getWebSocket(HttpServerConnection& connection)
 {
-	for (int i = 0; i < wsocks.count(); i++)
-		if (wsocks[i].is(&connection))
-			return &wsocks[i];
+	for (unsigned i = 0; i < wsocks.count(); i++)
+		if (!wsocks[i]->removed && wsocks[i]->is(&connection))
+			return wsocks[i];
 
 	return nullptr;
 }
@@ -199,19 +304,53 @@ WebSocket* HttpServer::getWebSocket(HttpServerConnection& connection)
 void HttpServer::removeWebSocket(HttpServerConnection& connection)
 {
 	debugf("WS remove connection item");
-	for (int i = 0; i < wsocks.count(); i++)
-		if (wsocks[i].is(&connection))
-			wsocks.remove(i--);
+	for (int i = wsocks.count() - 1; i >= 0; i--)
+	{
+		WebSocket* sock = wsocks[i];
+		if (!sock->is(&connection))
+			continue;
+
+		if (wsBusy > 0)
+		{
+			// Some handler still uses the socket or iterates the list
+			sock->removed = true;
+			wsRemoved = true;
+			continue;
+		}
+
+		wsocks.remove(i);
+		delete sock;
+	}
 }
 
 void HttpServer::onCloseWebSocket(HttpServerConnection& connection)
 {
+	debugf("WS Close");
 	WebSocket* sock = getWebSocket(connection);
+	if (sock == nullptr)
+		return;
+
+	wsBusy++;
+	sock->removed = true; // Handler can't close it again
+	wsRemoved = true;
+	if (wsDisconnect) wsDisconnect(*sock);
+	endWebSocketCallback();
+}
 
-	removeWebSocket(connection);
+void HttpServer::endWebSocketCallback()
+{
+	if (--wsBusy > 0 || !wsRemoved)
+		return;
 
-	debugf("WS Close");
-	if (sock && wsDisconnect) wsDisconnect(*sock);
+	wsRemoved = false;
+	for (int i = wsocks.count() - 1; i >= 0; i--)
+	{
+		if (wsocks[i]->removed)
+		{
+			delete wsocks[i];
+			wsocks.remove(i);
+		}
+	}
 }
 
 void HttpServer::enableWebSockets(bool enabled)
@@ -219,8 +358,8 @@ void HttpServer::enableWebSockets(bool enabled)
 	wsEnabled = enabled;
 	if (wsEnabled)
 	{
-		enableHeaderProcessing("Sec-WebSocket-Key");
-		enableHeaderProcessing("Sec-WebSocket-Version");
+		enableHeaderProcessing(F("sec-websocket-key"));
+		enableHeaderProcessing(F("sec-websocket-version"));
 	}
 }
 
@@ -10,36 +10,63 @@
 
 #include "TcpServer.h"
 #include "WebSocket.h"
+#include "HttpBodyParser.h"
+#include "HttpRouter.h"
 #include "../../Wiring/WHashMap.h"
 #include "../../Wiring/WVector.h"
 #include "../Delegate.h"
+#include "../StringView.h"
 #include "../../Services/CommandProcessing/CommandProcessingIncludes.h"
 
+// Idle time to wait for the next request on persistent connection (in the same units as setTimeOut)
+#define HTTP_SERVER_KEEP_ALIVE_TIMEOUT 5
+// Connection is closed after this number of requests, 0 disables persistent connections
+#define HTTP_SERVER_MAX_REQUESTS_PER_CONNECTION 25
+
 class String;
 class HttpServerConnection;
 class HttpRequest;
 class HttpResponse;
 
-typedef Vector<WebSocket> WebSocketsList;
+// Sockets are allocated on heap, references passed to handlers stay valid when others connect or close
+typedef Vector<WebSocket*> WebSocketsList;
 
-typedef Delegate<void(HttpRequest&, HttpResponse&)> HttpPathDelegate;
 typedef Delegate<void(WebSocket&)> WebSocketDelegate;
 typedef Delegate<void(WebSocket&, const String&)> WebSocketMessageDelegate;
 typedef Delegate<void(WebSocket&, uint8_t* data, size_t size)> WebSocketBinaryDelegate;
+// Binary message part, called as data arrive, isLast is set for the last part of message
+typedef Delegate<void(WebSocket&, uint8_t* data, size_t size, bool isLast)> WebSocketBinaryStreamDelegate;
 
 class HttpServer: public TcpServer
 {
 	friend class HttpServerConnection;
+	friend class WebSocket;
 public:
 	HttpServer();
 	virtual ~HttpServer();
 
 	void enableHeaderProcessing(String headerName);
-	bool isHeaderProcessingEnabled(String name);
+	bool isHeaderProcessingEnabled(const StringView& name);
 
+	// Path can contain parameters ("/api/sensors/:id") and end with wildcard ("/files/*"), see HttpRouter
 	void addPath(String path, HttpPathDelegate callback);
+	// Request body for this path is streamed to bodyParser, callback is called when it is completed
+	void addPath(String path, HttpPathDelegate callback, HttpBodyParserDelegate bodyParser);
+	// Handler only for given request method (RequestMethod::GET, ...)
+	void addPath(String method, String path, HttpPathDelegate callback,
+			HttpBodyParserDelegate bodyParser = HttpBodyParserDelegate());
 	void setDefaultHandler(HttpPathDelegate callback);
 
+	// Body parser for requests with given Content-Type ("*" for any other type)
+	void setBodyParser(String contentType, HttpBodyParserDelegate parser);
+	HttpBodyParserDelegate getBodyParser(HttpRequest &request);
+
+	/// Persistent connections (HTTP/1.1 keep-alive)
+	void setKeepAliveTimeOut(uint16_t waitTimeOut);
+	void setMaxRequestsPerConnection(uint16_t maxRequests);
+	__forceinline uint16_t getKeepAliveTimeOut() { return keepAliveTimeOut; }
+	__forceinline uint16_t getMaxRequestsPerConnection() { return maxRequestsPerConnection; }
+
 	/// Web Sockets
 	void enableWebSockets(bool enabled);
 	void commandProcessing(bool enabled, String reqReqestParam);
@@ -47,29 +74,51 @@ public:
 	void setWebSocketConnectionHandler(WebSocketDelegate handler);
 	void setWebSocketMessageHandler(WebSocketMessageDelegate handler);
 	void setWebSocketBinaryHandler(WebSocketBinaryDelegate handler);
+	// Binary messages are passed to this handler without buffering, binary handler isn't called then
+	void setWebSocketBinaryStreamHandler(WebSocketBinaryStreamDelegate handler);
 	void setWebSocketDisconnectionHandler(WebSocketDelegate handler);
+	// Frame is built once and shared by all clients
+	void broadcast(const char* message, int length, wsFrameType type = WS_TEXT_FRAME);
+	void broadcast(const String& message) { broadcast(message.c_str(), message.length()); }
+	void setWebSocketQueuePolicy(WebSocketQueuePolicy policy);
+	// Offer permessage-deflate (RFC 7692) to clients, windowBits (8..15) limits memory needed by client
+	void setWebSocketCompression(bool enabled, uint8_t windowBits = 15);
 
 protected:
 	virtual TcpConnection* createClient(tcp_pcb *clientTcp);
 	virtual bool initWebSocket(HttpServerConnection &connection, HttpRequest &request, HttpResponse &response);
 	virtual bool processRequest(HttpServerConnection &connection, HttpRequest &request, HttpResponse &response);
-	virtual void processWebSocketFrame(pbuf *buf, HttpServerConnection &connection);
+	// Route of the request path and method, found once and kept in the request
+	HttpRoute* findRoute(HttpRequest& request);
+	// Returns false if connection must be closed
+	virtual bool processWebSocketFrame(pbuf *buf, HttpServerConnection &connection);
+	virtual void sendWebSocketFrames(HttpServerConnection &connection);
 
 	WebSocket* getWebSocket(HttpServerConnection &connection);
 	void removeWebSocket(HttpServerConnection &connection);
 	void onCloseWebSocket(HttpServerConnection &connection);
+	// Sockets closed from handlers are deleted when the outermost handler returns
+	void endWebSocketCallback();
 
 private:
 	HttpPathDelegate defaultHandler;
 	Vector<String> processingHeaders;
-	HashMap<String, HttpPathDelegate> paths;
+	HttpRouter routes;
+	HashMap<String, HttpBodyParserDelegate> bodyParsers;
 	WebSocketsList wsocks;
+	uint16_t keepAliveTimeOut = HTTP_SERVER_KEEP_ALIVE_TIMEOUT;
+	uint16_t maxRequestsPerConnection = HTTP_SERVER_MAX_REQUESTS_PER_CONNECTION;
 
 	bool wsEnabled = false;
 	WebSocketDelegate wsConnect;
 	WebSocketMessageDelegate wsMessage;
 	WebSocketBinaryDelegate wsBinary;
+	WebSocketBinaryStreamDelegate wsBinaryStream;
 	WebSocketDelegate wsDisconnect;
+	WebSocketQueuePolicy wsQueuePolicy = eWSQP_DropOldest;
+	uint8_t wsDeflateBits = 0; // Compression disabled
+	uint8_t wsBusy = 0; // Nesting of handler calls and broadcasts
+	bool wsRemoved = false; // Some sockets wait for deletion
 
 	bool wsCommandEnabled = false;
 	String wsCommandRequestParam;
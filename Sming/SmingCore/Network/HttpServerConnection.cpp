@@ -12,15 +12,20 @@
 #include "../../Services/cWebsocket/websocket.h"
 
 HttpServerConnection::HttpServerConnection(HttpServer *parentServer, tcp_pcb *clientTcp)
-	: TcpConnection(clientTcp, true), server(parentServer), state(eHCS_Ready)
+	: TcpConnection(clientTcp, true), server(parentServer), state(eHCS_Ready),
+	  keepAlive(false), requestCount(0), pendingBuf(NULL), pendingPos(0)
 {
 	TcpServer::totalConnections++;
-	response.setHeader("Connection", "close");
+	response.request = &request;
+	request.connection = this;
 }
 
 HttpServerConnection::~HttpServerConnection()
 {
 	TcpServer::totalConnections--;
+	if (pendingBuf != NULL)
+		pbuf_free(pendingBuf);
+	pendingBuf = NULL;
 }
 
 err_t HttpServerConnection::onReceive(pbuf *buf)
@@ -31,23 +36,48 @@ err_t HttpServerConnection::onReceive(pbuf *buf)
 		return ERR_OK;
 	}
 
-	/*{
-	 	// split.buf.test
-		pbuf* dbghack = new pbuf();
-		dbghack->payload = (char*)buf->payload + 100;
-		dbghack->len = buf->len - 100;
-		buf->len = 100;
-		buf->next = dbghack;
-	}*/
+	if (state == eHCS_WebSocketFrames)
+	{
+		if (!server->processWebSocketFrame(buf, *this))
+		{
+			close(); // WebSocket is removed by disconnection handler
+			return ERR_OK;
+		}
+		TcpConnection::onReceive(buf);
+		return ERR_OK;
+	}
+
+	// Keep data until it is parsed, it can contain the next pipelined requests
+	if (pendingBuf == NULL)
+	{
+		pbuf_ref(buf);
+		pendingBuf = buf;
+		pendingPos = 0;
+	}
+	else
+		pbuf_chain(pendingBuf, buf);
 
 	if (state == eHCS_Ready)
+		setTimeOut(server->getTimeOut()); // Not idle anymore
+
+	parseRequest();
+
+	TcpConnection::onReceive(buf);
+
+	return ERR_OK;
+}
+
+void HttpServerConnection::parseRequest()
+{
+	if (state == eHCS_Ready && pendingBuf != NULL)
 	{
-		HttpParseResult res = request.parseHeader(server, buf);
+		HttpParseResult res = request.parseHeader(server, pendingBuf, pendingPos);
 		if (res == eHPR_Wait)
 			debugf("HEADER WAIT");
 		else if (res == eHPR_Failed)
 		{
 			debugf("HEADER FAILED");
+			keepAlive = false;
 			response.badRequest();
 			sendError();
 		}
@@ -56,27 +86,37 @@ err_t HttpServerConnection::onReceive(pbuf *buf)
 			debugf("Request: %s, %s", request.getRequestMethod().c_str(),
 					(request.getContentLength() > 0 ? (String(request.getContentLength()) + " bytes").c_str() : "nodata"));
 
-			String contType = request.getContentType();
-			contType.toLowerCase();
-			if (request.getContentLength() > 0 && request.getRequestMethod() == RequestMethod::POST)
+			requestCount++;
+			keepAlive = server->getMaxRequestsPerConnection() > 0 && request.isKeepAlive()
+					&& requestCount < server->getMaxRequestsPerConnection();
+
+			if (request.hasTransferEncoding())
+			{
+				// Encoded body isn't decoded, its end can't be found to parse the next request
+				debugf("Transfer-Encoding is not supported");
+				keepAlive = false;
+				if (request.getHeader(F("transfer-encoding")).equalsIgnoreCase("chunked"))
+					response.lengthRequired();
+				else
+					response.notImplemented();
+				sendError();
+			}
+			else if (request.getContentLength() > 0)
 				state = eHCS_ParsePostData;
-					else
+			else
 				state = eHCS_ParsingCompleted;
 		}
 	}
-	else if (state == eHCS_WebSocketFrames)
-	{
-		server->processWebSocketFrame(buf, *this);
-	}
 
 	if (state == eHCS_ParsePostData)
 	{
-		HttpParseResult res = request.parsePostData(server, buf);
+		HttpParseResult res = request.parsePostData(server, pendingBuf, pendingPos);
 		if (res == eHPR_Wait)
 			debugf("POST WAIT");
 		else if (res == eHPR_Failed)
 		{
 			debugf("POST FAILED");
+			keepAlive = false;
 			response.badRequest();
 			sendError();
 		}
@@ -87,9 +127,70 @@ err_t HttpServerConnection::onReceive(pbuf *buf)
 		}
 	}
 
-	TcpConnection::onReceive(buf);
+	releaseParsedData();
+}
 
-	return ERR_OK;
+void HttpServerConnection::releaseParsedData()
+{
+	// Free fully parsed segments, keep the rest for the next request
+	while (pendingBuf != NULL && pendingPos >= pendingBuf->len)
+	{
+		pbuf* next = pendingBuf->next;
+		pendingPos -= pendingBuf->len;
+		if (next != NULL)
+			pbuf_ref(next);
+		pbuf_free(pendingBuf);
+		pendingBuf = next;
+	}
+	if (pendingBuf == NULL)
+		pendingPos = 0;
+
+	// Don't let the client send more while unparsed data is waiting for the current response
+	// or for the body parser
+	if (pendingBuf != NULL || request.isBodyPaused())
+		pauseReceiving();
+	else if (isReceivingPaused())
+		resumeReceiving();
+}
+
+void HttpServerConnection::onBodyResumed()
+{
+	if (state != eHCS_ParsePostData)
+		return;
+
+	// Kept data are passed now, more comes when receiving is resumed
+	parseRequest();
+	if (state != eHCS_ParsePostData)
+		onReadyToSendData(eTCE_Poll); // Response can start, connection may be closed here
+}
+
+void HttpServerConnection::setPersistence()
+{
+	int code = response.getStatusCode();
+	bool bodyAllowed = code >= 200 && code != 204 && code != 304;
+
+	if (bodyAllowed && !response.hasHeader("Content-Length"))
+	{
+		int length = response.getContentLength();
+		if (length >= 0)
+			response.setHeader(F("Content-Length"), String(length));
+		else if (request.isHttp10())
+			keepAlive = false; // Only the connection closing can mark the end of body
+		else
+			response.setChunked();
+	}
+
+	response.setHeader(F("Connection"), keepAlive ? "keep-alive" : "close");
+}
+
+void HttpServerConnection::prepareNextRequest()
+{
+	debugf("Keep-alive, waiting for the next request");
+	request.reset();
+	response.reset();
+	state = eHCS_Ready;
+	sleep = 0;
+	setTimeOut(server->getKeepAliveTimeOut());
 }
 
 void HttpServerConnection::beginSendData()
@@ -108,6 +209,9 @@ void HttpServerConnection::beginSendData()
 		return;
 	}
 
+	if (!request.isWebSocket())
+		setPersistence();
+
 	debugf("response sendHeader");
 	response.sendHeader(*this);
 
@@ -116,6 +220,11 @@ void HttpServerConnection::beginSendData()
 		debugf("Switched to WebSocket Protocol");
 		state = eHCS_WebSocketFrames; // Stay opened
 		setTimeOut(USHRT_MAX);
+		if (pendingBuf != NULL)
+			pbuf_free(pendingBuf);
+		pendingBuf = NULL;
+		pendingPos = 0;
+		resumeReceiving();
 	}
 	else
 		state = eHCS_Sending;
@@ -124,13 +233,16 @@ void HttpServerConnection::beginSendData()
 void HttpServerConnection::sendError(const char* message /* = NULL*/)
 {
 	debugf("SEND ERROR PAGE");
+	String html = "<H2 color='#444'>";
+	html += message ? message : response.getStatusName().c_str();
+	html += "</H2>";
+
 	response.setContentType(ContentType::HTML);
+	response.setHeader(F("Content-Length"), String(html.length()));
+	response.setHeader(F("Connection"), keepAlive ? "keep-alive" : "close");
 	response.sendHeader(*this);
 
-	writeString("<H2 color='#444'>", TCP_WRITE_FLAG_MORE);
-	const char* statusName = response.getStatusName().c_str();
-	writeString(message ? message : statusName, TCP_WRITE_FLAG_COPY);
-	writeString("</H2>");
+	writeString(html.c_str(), TCP_WRITE_FLAG_COPY);
 	state = eHCS_Sent;
 }
 
@@ -138,26 +250,52 @@ void HttpServerConnection::onReadyToSendData(TcpConnectionEvent sourceEvent)
 {
 	TcpConnection::onReadyToSendData(sourceEvent);
 
-	if (state == eHCS_ParsingCompleted)
-		beginSendData();
+	if (state == eHCS_WebSocketFrames)
+	{
+		server->sendWebSocketFrames(*this);
+		return;
+	}
 
-	if (state == eHCS_Sending)
+	while (true)
 	{
-		debugf("response sendBody");
-		if (response.sendBody(*this))
+		if (state == eHCS_ParsingCompleted)
+		{
+			if (getAvailableWriteSize() == 0)
+				break; // Will continue when previous response is sent
+			beginSendData();
+		}
+
+		if (state == eHCS_Sending)
+		{
+			debugf("response sendBody");
+			if (!response.sendBody(*this))
+				break;
 			state = eHCS_Sent; // Completed!
-	}
+		}
 
-	if (state == eHCS_Sent)
-		close();
+		if (state != eHCS_Sent)
+			break;
+
+		if (!keepAlive)
+		{
+			close();
+			return;
+		}
+
+		// Next request can be already received
+		prepareNextRequest();
+		parseRequest();
+	}
 }
 
 void HttpServerConnection::close()
 {
 	if (disconnection)
 	{
-		disconnection(*this);
+		// Handler can close the connection again
+		HttpServerConnectionDelegate handler = disconnection;
 		disconnection = nullptr;
+		handler(*this);
 	}
 	TcpConnection::close();
 }
@@ -166,8 +304,10 @@ void HttpServerConnection::onError(err_t err)
 {
 	if (disconnection)
 	{
-		disconnection(*this);
+		// Handler can close the connection again
+		HttpServerConnectionDelegate handler = disconnection;
 		disconnection = nullptr;
+		handler(*this);
 	}
 	TcpConnection::onError(err);
 }
@@ -45,6 +45,14 @@ protected:
 
 	virtual void onError(err_t err);
 
+private:
+	// Body parser can take data again, see HttpRequest::resumeBody()
+	void onBodyResumed();
+	void parseRequest();
+	void releaseParsedData();
+	void setPersistence();
+	void prepareNextRequest();
+
 private:
 	HttpServer *server;
 	HttpConnectionState state;
@@ -52,6 +60,12 @@ private:
 	HttpResponse response;
 	HttpServerConnectionDelegate disconnection;
 
+	bool keepAlive;
+	uint16_t requestCount;
+	// Received but not yet parsed data, may contain the next pipelined requests
+	pbuf *pendingBuf;
+	int pendingPos;
+
 	friend class HttpResponse;
 	friend class HttpRequest;
 };
@@ -15,9 +15,6 @@ MqttClient::MqttClient(String serverHost, int serverPort, MqttStringSubscription
 	server = serverHost;
 	port = serverPort;
 	this->callback = callback;
-	waitingSize = 0;
-	posHeader = 0;
-	current = NULL;
 	mqtt_init(&broker);
 }
 
@@ -27,15 +24,17 @@ MqttClient::MqttClient(IPAddress serverIp, int serverPort, MqttStringSubscriptio
 	this->serverIp = serverIp;
 	port = serverPort;
 	this->callback = callback;
-	waitingSize = 0;
-	posHeader = 0;
-	current = NULL;
 	mqtt_init(&broker);
 }
 
 MqttClient::~MqttClient()
 {
+	flushTimer.stop();
 	mqtt_free(&broker);
+	for (unsigned i = 0; i < inflight.count(); i++)
+		freeMessage(inflight[i]);
+	for (unsigned i = 0; i < outbox.count(); i++)
+		freeMessage(outbox[i]);
 }
 
 void MqttClient::setKeepAlive(int seconds)
@@ -70,6 +69,10 @@ bool MqttClient::connect(String clientName, String username, String password, bo
 	}
 
 	debugf("MQTT start connection");
+	sessionReady = false;
+	MqttPacketParser::reset();
+	incoming = String();
+	incomingTopic = String();
 	if (clientName.length() > 0)
 		 mqtt_set_clientid(&broker, clientName.c_str());
 
@@ -100,15 +103,305 @@ bool MqttClient::publish(String topic, String message, bool retained /* = false*
 
 bool MqttClient::publishWithQoS(String topic, String message, int QoS, bool retained /* = false*/, MqttMessageDeliveredCallback onDelivery /* = NULL */)
 {
-	uint16_t msgId = 0;
-	int res = mqtt_publish_with_qos(&broker, topic.c_str(), message.c_str(), retained, QoS, &msgId);
-	if(QoS == 0 && onDelivery) {
-		debugf("The delivery callback is ignored for QoS 0.");
+	if (QoS == 0)
+	{
+		if (onDelivery)
+			debugf("The delivery callback is ignored for QoS 0.");
+		return publish(topic, message, retained);
 	}
-	else if(QoS >0 && onDelivery && msgId) {
-		onDeliveryQueue[msgId] = onDelivery;
+	if (QoS > 2)
+		return false;
+
+	MqttOutboundMessage* msg = new MqttOutboundMessage;
+	msg->packet = makePublishPacket(topic, message, QoS, retained, msg->idOffset);
+	msg->onDelivery = onDelivery;
+	if (msg->packet == NULL)
+	{
+		delete msg;
+		return false;
 	}
-	return res > 0;
+
+	return queueMessage(msg);
+}
+
+void MqttClient::setInflightWindow(int messages)
+{
+	inflightWindow = max(messages, 1);
+	sendQueued();
+}
+
+void MqttClient::setRetransmitTimeout(int seconds)
+{
+	retransmitTimeout = seconds;
+}
+
+void MqttClient::setOutboundQueueSize(int messages)
+{
+	outboxSize = messages;
+}
+
+void MqttClient::setOutboundQueueFile(String fileName, int maxFileSize /* = MQTT_QUEUE_FILE_MAX_SIZE */)
+{
+	queueFile = fileName;
+	queueFileMaxSize = maxFileSize;
+	queueFileReadPos = 0; // Not acknowledged records from previous run are sent again
+}
+
+SharedBuffer* MqttClient::makePublishPacket(const String& topic, const String& message, int QoS, bool retained, uint16_t& idOffset)
+{
+	int remainingLength = 2 + topic.length() + 2 + message.length();
+	int lengthBytes = 1;
+	for (int len = remainingLength; len > 127; len /= 128)
+		lengthBytes++;
+	if (1 + lengthBytes + remainingLength > 0xFFFF)
+		return NULL; // Queued packet length is 16 bits
+
+	SharedBuffer* packet = SharedBuffer::create(1 + lengthBytes + remainingLength);
+	if (packet == NULL)
+		return NULL;
+
+	uint8_t* data = packet->data();
+	int pos = 0;
+	data[pos++] = MQTT_MSG_PUBLISH | (QoS << 1) | (retained ? 1 : 0);
+	for (int len = remainingLength; ; )
+	{
+		data[pos] = len % 128;
+		len /= 128;
+		if (len == 0)
+			break;
+		data[pos++] |= 0x80;
+	}
+	pos++;
+	data[pos++] = topic.length() >> 8;
+	data[pos++] = topic.length();
+	memcpy(&data[pos], topic.c_str(), topic.length());
+	pos += topic.length();
+	idOffset = pos; // Assigned when the message is sent
+	data[pos++] = 0;
+	data[pos++] = 0;
+	memcpy(&data[pos], message.c_str(), message.length());
+
+	return packet;
+}
+
+bool MqttClient::queueMessage(MqttOutboundMessage* msg)
+{
+	if (queueFile.length() == 0)
+	{
+		if ((int)outbox.count() >= outboxSize)
+		{
+			debugf("MQTT outbound queue is full");
+			freeMessage(msg);
+			return false;
+		}
+		outbox.add(msg);
+		sendQueued();
+		return true;
+	}
+
+	if (!appendToQueueFile(msg))
+	{
+		debugf("MQTT can't store message in %s", queueFile.c_str());
+		freeMessage(msg);
+		return false;
+	}
+
+	if (sessionReady && (int)inflight.count() < inflightWindow && queueFileReadPos == msg->fileOffset)
+	{
+		// Nothing older is waiting, no need to read it back
+		queueFileReadPos += MQTT_QUEUE_RECORD_HEADER + msg->packet->size();
+		startMessage(msg);
+		return true;
+	}
+
+	if (msg->onDelivery)
+		queueFileCallbacks[msg->fileOffset] = msg->onDelivery;
+	freeMessage(msg); // Loaded again when it can be sent
+	return true;
+}
+
+bool MqttClient::appendToQueueFile(MqttOutboundMessage* msg)
+{
+	int32_t size = fileExist(queueFile) ? fileGetSize(queueFile) : 0;
+	int length = msg->packet->size();
+	if (size + MQTT_QUEUE_RECORD_HEADER + length > queueFileMaxSize)
+		return false;
+
+	file_t file = fileOpen(queueFile, eFO_WriteOnly | eFO_CreateIfNotExist | eFO_Append);
+	if (file < 0)
+		return false;
+
+	// State (0xFF waiting, 0 delivered), packet length, message id offset
+	uint8_t header[MQTT_QUEUE_RECORD_HEADER] = { 0xFF, (uint8_t)length, (uint8_t)(length >> 8),
+			(uint8_t)msg->idOffset, (uint8_t)(msg->idOffset >> 8) };
+	bool res = fileWrite(file, header, sizeof(header)) == sizeof(header)
+			&& fileWrite(file, msg->packet->data(), length) == (size_t)length;
+	fileClose(file);
+
+	msg->fileOffset = size;
+	return res;
+}
+
+MqttOutboundMessage* MqttClient::takeQueued()
+{
+	if (queueFile.length() == 0)
+	{
+		if (outbox.count() == 0)
+			return NULL;
+		MqttOutboundMessage* msg = outbox[0];
+		outbox.remove(0);
+		return msg;
+	}
+
+	if (!fileExist(queueFile))
+		return NULL;
+	file_t file = fileOpen(queueFile, eFO_ReadOnly);
+	if (file < 0)
+		return NULL;
+
+	MqttOutboundMessage* msg = NULL;
+	uint8_t header[MQTT_QUEUE_RECORD_HEADER];
+	fileSeek(file, queueFileReadPos, eSO_FileStart);
+	while (msg == NULL && fileRead(file, header, sizeof(header)) == sizeof(header))
+	{
+		int32_t offset = queueFileReadPos;
+		int length = header[1] | (header[2] << 8);
+		if (header[0] != 0xFF)
+		{
+			// Already delivered
+			queueFileReadPos += sizeof(header) + length;
+			fileSeek(file, queueFileReadPos, eSO_FileStart);
+			continue;
+		}
+
+		SharedBuffer* packet = SharedBuffer::create(length);
+		if (packet == NULL)
+			break; // Try again later
+		queueFileReadPos += sizeof(header) + length;
+		if (fileRead(file, packet->data(), length) != (size_t)length)
+		{
+			packet->unref(); // Incomplete record
+			break;
+		}
+
+		msg = new MqttOutboundMessage;
+		msg->packet = packet;
+		msg->idOffset = header[3] | (header[4] << 8);
+		msg->fileOffset = offset;
+		if (queueFileCallbacks.contains(offset))
+		{
+			msg->onDelivery = queueFileCallbacks[offset];
+			queueFileCallbacks.remove(offset);
+		}
+	}
+	fileClose(file);
+
+	return msg;
+}
+
+void MqttClient::markDelivered(int32_t fileOffset)
+{
+	file_t file = fileOpen(queueFile, eFO_ReadWrite);
+	if (file < 0)
+		return;
+
+	uint8_t state = 0;
+	fileSeek(file, fileOffset, eSO_FileStart);
+	fileWrite(file, &state, 1);
+	fileClose(file);
+}
+
+void MqttClient::sendQueued()
+{
+	while (sessionReady && (int)inflight.count() < inflightWindow)
+	{
+		MqttOutboundMessage* msg = takeQueued();
+		if (msg == NULL)
+			break;
+		startMessage(msg);
+	}
+}
+
+void MqttClient::startMessage(MqttOutboundMessage* msg)
+{
+	if (broker.seq == 0)
+		broker.seq = 1; // Zero isn't valid message id
+	msg->id = broker.seq++;
+	msg->packet->data()[msg->idOffset] = msg->id >> 8;
+	msg->packet->data()[msg->idOffset + 1] = msg->id;
+	msg->expected = (MQTTParseMessageQos(msg->packet->data()) == 2) ? MQTT_MSG_PUBREC : MQTT_MSG_PUBACK;
+
+	inflight.add(msg);
+	sendMessage(msg, false);
+}
+
+void MqttClient::sendMessage(MqttOutboundMessage* msg, bool duplicate)
+{
+	if (msg->expected == MQTT_MSG_PUBCOMP)
+		sendAcknowledgement(MQTT_MSG_PUBREL, msg->id); // PUBLISH part is done
+	else
+	{
+		if (duplicate)
+			msg->packet->data()[0] |= MQTT_DUP_FLAG;
+		staticSendPacket(this, msg->packet->data(), msg->packet->size());
+	}
+	msg->sentTime = millis();
+}
+
+void MqttClient::acknowledge(int type, uint16_t msgId)
+{
+	for (unsigned i = 0; i < inflight.count(); i++)
+	{
+		MqttOutboundMessage* msg = inflight[i];
+		if (msg->id != msgId)
+			continue;
+
+		if (type == MQTT_MSG_PUBREC && msg->expected != MQTT_MSG_PUBACK)
+		{
+			// QoS 2, release it and wait for completion
+			msg->expected = MQTT_MSG_PUBCOMP;
+			sendMessage(msg, false);
+			return;
+		}
+		if (type != msg->expected)
+			return;
+
+		debugf("message with id: %d was delivered", msgId);
+		inflight.remove(i);
+		if (msg->fileOffset >= 0)
+			markDelivered(msg->fileOffset);
+		if (msg->onDelivery)
+			msg->onDelivery(msgId, type);
+		freeMessage(msg);
+
+		if (queueFile.length() > 0 && inflight.count() == 0
+				&& queueFileReadPos >= (int32_t)fileGetSize(queueFile))
+		{
+			// Everything was delivered
+			fileDelete(queueFile);
+			queueFileReadPos = 0;
+		}
+
+		sendQueued();
+		return;
+	}
+}
+
+void MqttClient::retransmit(bool all)
+{
+	unsigned long now = millis();
+	for (unsigned i = 0; i < inflight.count(); i++)
+		if (all || now - inflight[i]->sentTime >= (unsigned long)retransmitTimeout * 1000)
+		{
+			debugf("MQTT message %d sent again", inflight[i]->id);
+			sendMessage(inflight[i], true);
+		}
+}
+
+void MqttClient::freeMessage(MqttOutboundMessage* msg)
+{
+	msg->packet->unref();
+	delete msg;
 }
 
 int MqttClient::staticSendPacket(void* userInfo, const void* buf, unsigned int count)
@@ -116,7 +409,38 @@ int MqttClient::staticSendPacket(void* userInfo, const void* buf, unsigned int c
 	MqttClient* client = (MqttClient*)userInfo;
 	bool sent = client->send((const char*)buf, count);
 	client->lastMessage = millis();
-	return sent ? count : 0;
+	if (!sent)
+		return 0;
+
+	client->scheduleFlush(count);
+	return count;
+}
+
+void MqttClient::scheduleFlush(int size)
+{
+	pendingBytes += size;
+	if (flushDelay <= 0 || pendingBytes >= flushSize)
+		flushPending();
+	else if (!flushTimer.isStarted())
+		flushTimer.initializeMs(flushDelay, TimerDelegate(&MqttClient::flushPending, this)).startOnce();
+}
+
+void MqttClient::flushPending()
+{
+	flushTimer.stop();
+	pendingBytes = 0;
+	// Collected packets are written with TCP_WRITE_FLAG_MORE and pushed by single tcp_output.
+	// Before connection is established they wait for the connected event
+	if (getConnectionState() == eTCS_Connected)
+		pushAsyncPart();
+}
+
+void MqttClient::setFlushPolicy(int delayMs, int maxSize /* = MQTT_FLUSH_SIZE */)
+{
+	flushDelay = delayMs;
+	flushSize = maxSize;
+	if (flushDelay <= 0 && pendingBytes > 0)
+		flushPending();
 }
 
 bool MqttClient::subscribe(String topic)
@@ -127,17 +451,33 @@ bool MqttClient::subscribe(String topic)
 	return res > 0;
 }
 
+bool MqttClient::subscribe(String topic, MqttStringSubscriptionCallback handler)
+{
+	if (!subscriptions.add(topic, handler))
+	{
+		debugf("invalid topic filter '%s'", topic.c_str());
+		return false;
+	}
+
+	if (subscribe(topic))
+		return true;
+
+	subscriptions.remove(topic);
+	return false;
+}
+
 bool MqttClient::unsubscribe(String topic)
 {
 	uint16_t msgId = 0;
 	debugf("unsubscribing from '%s'", topic.c_str());
+	subscriptions.remove(topic);
 	int res = mqtt_unsubscribe(&broker, topic.c_str(), &msgId);
 	return res > 0;
 }
 
 void MqttClient::debugPrintResponseType(int type, int len)
 {
-	String tp;
+	const char* tp;
 	switch (type)
 	{
 	case MQTT_MSG_CONNACK:
@@ -165,9 +505,10 @@ void MqttClient::debugPrintResponseType(int type, int len)
 		tp = "MQTT_MSG_PUBLISH";
 		break;
 	default:
-		tp = "b" + String(type, 2);
+		debugf("> MQTT status: 0x%02X (len: %d)", type, len);
+		return;
 	}
-	debugf("> MQTT status: %s (len: %d)", tp.c_str(), len);
+	debugf("> MQTT status: %s (len: %d)", tp, len);
 }
 
 err_t MqttClient::onReceive(pbuf *buf)
@@ -179,119 +520,125 @@ err_t MqttClient::onReceive(pbuf *buf)
 	}
 	else
 	{
-		if (buf->len < 1)
+		if (!parse(buf))
 		{
-			// Bad packet?
-			debugf("> MQTT WRONG PACKET? (len: %d)", buf->len);
+			// Bad packet, stream can't be synchronized again
 			close();
 			return ERR_OK;
 		}
 
-		int received = 0;
-		while (received < buf->tot_len)
+		// Fire ReadyToSend callback
+		TcpClient::onReceive(buf);
+	}
+
+	return ERR_OK;
+}
+
+void MqttClient::onPublishData(const StringView& topic, uint8_t flags, uint16_t msgId,
+		size_t offset, uint8_t* data, size_t size, size_t totalLength)
+{
+	if (offset == 0)
+		debugPrintResponseType(MQTT_MSG_PUBLISH, totalLength);
+	bool completed = offset + size == totalLength;
+
+	// Topic is copied only for a handler
+	bool handled = callback || !subscriptions.isEmpty();
+
+	if (payloadStream)
+	{
+		if (offset == 0)
+			incomingTopic = topic.toString();
+		payloadStream(incomingTopic, offset, data, size, totalLength);
+		if (completed)
+			incomingTopic = String();
+	}
+	else if (handled && totalLength > MQTT_MAX_BUFFER_SIZE)
+	{
+		if (offset == 0)
+			debugf("MQTT message is too big (%d), use payload stream handler", totalLength);
+	}
+	else if (handled)
+	{
+		if (offset == 0 && completed)
+			deliver(topic.toString(), String((const char*)data, size)); // Whole message in one segment
+		else
 		{
-			int type = 0;
-			if (waitingSize == 0)
+			if (offset == 0)
 			{
-				// It's begining of new packet
-				int pos = received;
-				if (posHeader == 0)
-				{
-					//debugf("start posHeader");
-					pbuf_copy_partial(buf, &buffer[posHeader], 1, pos);
-					pos++;
-					posHeader = 1;
-				}
-				while (posHeader > 0 && pos < buf->tot_len)
-				{
-					//debugf("add posHeader");
-					pbuf_copy_partial(buf, &buffer[posHeader], 1, pos);
-					if ((buffer[posHeader] & 128) == 0)
-						posHeader = 0; // Remaining Length ended
-					else
-						posHeader++;
-					pos++;
-				}
-
-				if (posHeader == 0)
-				{
-					//debugf("start len calc");
-					// Remaining Length field processed
-					uint16_t rem_len = mqtt_parse_rem_len(buffer);
-					uint8_t rem_len_bytes = mqtt_num_rem_len_bytes(buffer);
-
-					// total packet length = remaining length + byte 1 of fixed header + remaning length part of fixed header
-					waitingSize = rem_len + rem_len_bytes + 1;
-
-					type = MQTTParseMessageType(buffer);
-					debugPrintResponseType(type, waitingSize);
-
-					// Prevent overflow
-					if (waitingSize < MQTT_MAX_BUFFER_SIZE)
-					{
-						current = buffer;
-						buffer[waitingSize] = 0;
-					}
-					else
-						current = NULL;
-				}
-				else
-					continue;
+				incoming = String();
+				incoming.reserve(totalLength);
 			}
-
-			int available = min(waitingSize, buf->tot_len - received);
-			waitingSize -= available;
-			if (current != NULL)
+			incoming.concat((const char*)data, size);
+			if (completed)
 			{
-				pbuf_copy_partial(buf, current, available, received);
-				current += available;
-
-				if (waitingSize == 0)
-				{
-					// Full packet received
-					if(type == MQTT_MSG_PUBLISH)
-					{
-						const uint8_t *ptrTopic, *ptrMsg;
-						uint16_t lenTopic, lenMsg;
-						lenTopic = mqtt_parse_pub_topic_ptr(buffer, &ptrTopic);
-						lenMsg = mqtt_parse_pub_msg_ptr(buffer, &ptrMsg);
-						// Additional check for wrong packet/parsing error
-						if (lenTopic + lenMsg < MQTT_MAX_BUFFER_SIZE)
-						{
-							debugf("%d: %d\n", lenTopic, lenMsg);
-							String topic, msg;
-							topic.setString((char*)ptrTopic, lenTopic);
-							msg.setString((char*)ptrMsg, lenMsg);
-							if (callback)
-								callback(topic, msg);
-						}
-						else
-						{
-							debugf("WRONG SIZES: %d: %d", lenTopic, lenMsg);
-						}
-					}
-					else if (type == MQTT_MSG_PUBACK || type == MQTT_MSG_PUBREC) {
-						// message with QoS 1 or 2 was received and this is the confirmation
-						const uint16_t msgId = mqtt_parse_msg_id(buffer);
-						debugf("message with id: %d was delivered", msgId);
-						if(onDeliveryQueue.contains(msgId)) {
-							// there is a callback for this message
-							onDeliveryQueue[msgId](msgId, type);
-							onDeliveryQueue.remove(msgId);
-						}
-					}
-				}
+				String message = static_cast<String&&>(incoming);
+				incoming = String();
+				deliver(topic.toString(), message);
 			}
-			else
-				debugf("SKIP: %d (%d)", available, waitingSize + available); // To large!
-			received += available;
 		}
+	}
 
-		// Fire ReadyToSend callback
-		TcpClient::onReceive(buf);
+	if (completed)
+		acknowledgePublish(flags, msgId);
+}
+
+void MqttClient::onPublishSkipped(uint8_t flags, uint16_t msgId)
+{
+	acknowledgePublish(flags, msgId); // Broker would resend it otherwise
+}
+
+void MqttClient::acknowledgePublish(uint8_t flags, uint16_t msgId)
+{
+	// Broker waits for confirmation of QoS 1 and 2 messages
+	uint8_t qos = MQTTParseMessageQos(&flags);
+	if (qos == 1)
+		sendAcknowledgement(MQTT_MSG_PUBACK, msgId);
+	else if (qos == 2)
+		sendAcknowledgement(MQTT_MSG_PUBREC, msgId);
+}
+
+void MqttClient::onPacket(uint8_t type, const uint8_t* body, size_t size, size_t totalLength)
+{
+	debugPrintResponseType(type, totalLength);
+	uint16_t msgId = (size >= 2) ? (body[0] << 8) | body[1] : 0;
+
+	if (type == MQTT_MSG_PUBACK || type == MQTT_MSG_PUBREC || type == MQTT_MSG_PUBCOMP)
+	{
+		// message with QoS 1 or 2 was received and this is the confirmation
+		acknowledge(type, msgId);
 	}
+	else if (type == MQTT_MSG_PUBREL)
+		sendAcknowledgement(MQTT_MSG_PUBCOMP, msgId);
+	else if (type == MQTT_MSG_CONNACK && size >= 2 && body[1] == 0)
+	{
+		// Unacknowledged messages go first, with DUP flag
+		sessionReady = true;
+		retransmit(true);
+		sendQueued();
+	}
+}
 
-	return ERR_OK;
+void MqttClient::sendAcknowledgement(uint8_t type, uint16_t msgId)
+{
+	uint8_t packet[] = {
+		(uint8_t)(type | ((type == MQTT_MSG_PUBREL) ? 0x02 : 0)),
+		0x02, // Remaining length
+		(uint8_t)(msgId >> 8),
+		(uint8_t)msgId
+	};
+	staticSendPacket(this, packet, sizeof(packet));
+}
+
+void MqttClient::deliver(const String& topic, const String& message)
+{
+	// Client callback gets messages of no other subscription
+	if (subscriptions.dispatch(topic, message) == 0 && callback)
+		callback(topic, message);
+}
+
+void MqttClient::setPayloadStreamHandler(MqttPayloadStreamCallback handler)
+{
+	payloadStream = handler;
 }
 
 void MqttClient::onReadyToSendData(TcpConnectionEvent sourceEvent)
@@ -302,5 +649,19 @@ void MqttClient::onReadyToSendData(TcpConnectionEvent sourceEvent)
 	{
 		mqtt_ping(&broker);
 	}
+	if (sessionReady && sourceEvent == eTCE_Poll)
+		retransmit(false);
+	// Everything collected is sent now
+	flushTimer.stop();
+	pendingBytes = 0;
 	TcpClient::onReadyToSendData(sourceEvent);
 }
+
+void MqttClient::onFinished(TcpClientState finishState)
+{
+	// Messages in flight are sent again after reconnection
+	sessionReady = false;
+	flushTimer.stop();
+	pendingBytes = 0;
+	TcpClient::onFinished(finishState);
+}
@@ -8,22 +8,54 @@
 #ifndef _SMING_CORE_NETWORK_MqttClient_H_
 #define _SMING_CORE_NETWORK_MqttClient_H_
 
+// Longest message delivered to MqttStringSubscriptionCallback, use payload stream handler for more
 #define MQTT_MAX_BUFFER_SIZE 1024
 
+// QoS 1 and 2 messages sent without waiting for acknowledgement
+#define MQTT_INFLIGHT_WINDOW 4
+// Seconds to wait for acknowledgement before message is sent again
+#define MQTT_RETRANSMIT_TIMEOUT 20
+// Messages waiting for connection or for room in the window
+#define MQTT_OUTBOUND_QUEUE_SIZE 16
+#define MQTT_QUEUE_FILE_MAX_SIZE 16384
+#define MQTT_QUEUE_RECORD_HEADER 5
+#define MQTT_DUP_FLAG 0x08
+
+// Outgoing packets are collected for this time (ms) or up to this size and written together
+#define MQTT_FLUSH_DELAY 20
+#define MQTT_FLUSH_SIZE 1024
+
 #include "TcpClient.h"
+#include "MqttPacketParser.h"
+#include "MqttTopicTrie.h"
+#include "SharedBuffer.h"
+#include "../Timer.h"
 #include "../Delegate.h"
 #include "../../Wiring/WString.h"
 #include "../../Wiring/WHashMap.h"
+#include "../../Wiring/WVector.h"
 #include "../../Services/libemqtt/libemqtt.h"
 
-//typedef void (*MqttStringSubscriptionCallback)(String topic, String message);
-typedef Delegate<void(String topic, String message)> MqttStringSubscriptionCallback;
 typedef Delegate<void(uint16_t msgId, int)> MqttMessageDeliveredCallback;
+// Part of received message, called as data arrive
+typedef Delegate<void(const String& topic, size_t offset, const uint8_t* data, size_t size, size_t totalLength)> MqttPayloadStreamCallback;
 
 class MqttClient;
 class URL;
 
-class MqttClient: protected TcpClient
+// QoS 1 or 2 PUBLISH waiting for sending or acknowledgement
+struct MqttOutboundMessage
+{
+	SharedBuffer* packet; // Complete packet, message id is written when it is sent
+	uint16_t idOffset;
+	uint16_t id = 0;
+	uint8_t expected = 0; // MQTT_MSG_PUBACK, MQTT_MSG_PUBREC or MQTT_MSG_PUBCOMP
+	unsigned long sentTime = 0;
+	int32_t fileOffset = -1; // Record in queue file
+	MqttMessageDeliveredCallback onDelivery;
+};
+
+class MqttClient: protected TcpClient, protected MqttPacketParser
 {
 public:
 	MqttClient(String serverHost, int serverPort, MqttStringSubscriptionCallback callback = NULL);
@@ -44,10 +76,25 @@ public:
 	__forceinline TcpClientState getConnectionState() { return TcpClient::getConnectionState(); }
 
 	bool publish(String topic, String message, bool retained = false);
+	// QoS 1 and 2 messages are queued while disconnected and sent again (with DUP flag) until acknowledged,
+	// onDelivery is called on PUBACK (QoS 1) or PUBCOMP (QoS 2). Returns false when the queue is full
 	bool publishWithQoS(String topic, String message, int QoS, bool retained = false, MqttMessageDeliveredCallback onDelivery = NULL);
 
+	void setInflightWindow(int messages);
+	void setRetransmitTimeout(int seconds);
+	void setOutboundQueueSize(int messages);
+	// Waiting messages are stored in SPIFFS file instead of memory and survive restart, call before publishing
+	void setOutboundQueueFile(String fileName, int maxFileSize = MQTT_QUEUE_FILE_MAX_SIZE);
+	__forceinline int getInflightCount() { return inflight.count(); }
+	// Packets published in a burst share TCP segments, delay 0 sends each packet right away
+	void setFlushPolicy(int delayMs, int maxSize = MQTT_FLUSH_SIZE);
+
 	bool subscribe(String topic);
+	// Messages matching the filter (with + and # wildcards) go to this handler instead of the client callback
+	bool subscribe(String topic, MqttStringSubscriptionCallback handler);
 	bool unsubscribe(String topic);
+	// Received messages are passed to this handler without buffering, subscription callback isn't called then
+	void setPayloadStreamHandler(MqttPayloadStreamCallback handler);
 
 	using TcpClient::addSslOptions;
 	using TcpClient::setSslFingerprint;
@@ -60,23 +107,61 @@ public:
 protected:
 	virtual err_t onReceive(pbuf *buf);
 	virtual void onReadyToSendData(TcpConnectionEvent sourceEvent);
+	virtual void onFinished(TcpClientState finishState);
+	virtual void onPublishData(const StringView& topic, uint8_t flags, uint16_t msgId,
+			size_t offset, uint8_t* data, size_t size, size_t totalLength);
+	virtual void onPublishSkipped(uint8_t flags, uint16_t msgId);
+	virtual void onPacket(uint8_t type, const uint8_t* body, size_t size, size_t totalLength);
 	void debugPrintResponseType(int type, int len);
 	static int staticSendPacket(void* userInfo, const void* buf, unsigned int count);
 
+private:
+	static SharedBuffer* makePublishPacket(const String& topic, const String& message, int QoS, bool retained, uint16_t& idOffset);
+	bool queueMessage(MqttOutboundMessage* msg);
+	MqttOutboundMessage* takeQueued();
+	void sendQueued();
+	void startMessage(MqttOutboundMessage* msg);
+	void sendMessage(MqttOutboundMessage* msg, bool duplicate);
+	void freeMessage(MqttOutboundMessage* msg);
+	void deliver(const String& topic, const String& message);
+	void scheduleFlush(int size);
+	void flushPending();
+	void sendAcknowledgement(uint8_t type, uint16_t msgId);
+	void acknowledgePublish(uint8_t flags, uint16_t msgId);
+	void acknowledge(int type, uint16_t msgId);
+	void retransmit(bool all);
+	bool appendToQueueFile(MqttOutboundMessage* msg);
+	void markDelivered(int32_t fileOffset);
+
 private:
 	String server;
 	IPAddress serverIp;
 	int port;
 	mqtt_broker_handle_t broker;
-	int waitingSize;
-	uint8_t buffer[MQTT_MAX_BUFFER_SIZE + 1];
-	uint8_t *current;
-	int posHeader;
 	MqttStringSubscriptionCallback callback;
+	MqttPayloadStreamCallback payloadStream;
+	MqttTopicTrie subscriptions;
+	String incoming; // Message split over several segments
+	String incomingTopic; // Topic of streamed message, handlers get the same String for every part
 	int keepAlive = 60;
 	int PingRepeatTime = 20;
 	unsigned long lastMessage;
-	HashMap<uint16_t, MqttMessageDeliveredCallback> onDeliveryQueue;
+
+	bool sessionReady = false; // CONNACK received
+	Vector<MqttOutboundMessage*> inflight;
+	Vector<MqttOutboundMessage*> outbox;
+	int inflightWindow = MQTT_INFLIGHT_WINDOW;
+	int retransmitTimeout = MQTT_RETRANSMIT_TIMEOUT;
+	int outboxSize = MQTT_OUTBOUND_QUEUE_SIZE;
+	String queueFile;
+	int queueFileMaxSize = 0;
+	int32_t queueFileReadPos = 0; // Next record to send
+	HashMap<int32_t, MqttMessageDeliveredCallback> queueFileCallbacks; // For records from this session
+
+	int flushDelay = MQTT_FLUSH_DELAY;
+	int flushSize = MQTT_FLUSH_SIZE;
+	int pendingBytes = 0; // Written since the last flush
+	Timer flushTimer;
 };
 
 #endif /* _SMING_CORE_NETWORK_MqttClient_H_ */
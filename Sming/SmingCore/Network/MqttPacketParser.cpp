@@ -0,0 +1,216 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "MqttPacketParser.h"
+#include "lwip/pbuf.h"
+#include "../../Services/libemqtt/libemqtt.h"
+
+MqttPacketParser::MqttPacketParser()
+{
+	reset();
+}
+
+void MqttPacketParser::reset()
+{
+	parserState = eMPS_Type;
+	header = 0;
+	remaining = 0;
+	length = 0;
+	lengthShift = 0;
+	fieldPos = 0;
+	topicLength = 0;
+	topic = StringView();
+	topicBuffer = String();
+	skipTopic = false;
+	msgId = 0;
+	payloadLength = 0;
+}
+
+bool MqttPacketParser::parse(pbuf* buf)
+{
+	for (pbuf* cur = buf; cur != NULL && parserState != eMPS_Failed; cur = cur->next)
+	{
+		uint8_t* data = (uint8_t*)cur->payload;
+		int length = cur->len;
+		while (length > 0 && parserState != eMPS_Failed)
+		{
+			int consumed = parseBlock(data, length);
+			data += consumed;
+			length -= consumed;
+		}
+	}
+
+	// Received data are released, message continuing in the next call keeps its own topic
+	bool publishing = parserState == eMPS_MessageId || parserState == eMPS_Payload;
+	if (publishing && !topic.isEmpty() && topic.data() != topicBuffer.c_str())
+	{
+		topicBuffer = topic.toString();
+		topic = StringView(topicBuffer);
+	}
+
+	return parserState != eMPS_Failed;
+}
+
+int MqttPacketParser::parseBlock(uint8_t* data, int len)
+{
+	int count;
+	switch (parserState)
+	{
+	case eMPS_Type:
+		header = data[0];
+		length = 0;
+		lengthShift = 0;
+		parserState = eMPS_Length;
+		return 1;
+
+	case eMPS_Length:
+		// Variable length encoding, up to 4 bytes
+		length |= (uint32_t)(data[0] & 0x7F) << lengthShift;
+		lengthShift += 7;
+		if ((data[0] & 0x80) == 0)
+		{
+			remaining = length;
+			beginBody();
+		}
+		else if (lengthShift > 21)
+			fail();
+		return 1;
+
+	case eMPS_TopicLength:
+		topicLength = (topicLength << 8) | data[0];
+		remaining--;
+		if (++fieldPos < 2)
+			return 1;
+
+		if (topicLength > remaining)
+		{
+			fail();
+			return 1;
+		}
+		fieldPos = 0;
+		skipTopic = topicLength > MQTT_MAX_TOPIC_LENGTH;
+		if (skipTopic)
+			debugf("MQTT topic is too long (%d), message skipped", topicLength);
+		parserState = eMPS_Topic;
+		if (topicLength == 0)
+			beginPayload();
+		return 1;
+
+	case eMPS_Topic:
+		count = min(len, topicLength - fieldPos);
+		if (!skipTopic)
+		{
+			if (fieldPos == 0 && count == topicLength)
+				topic = StringView((const char*)data, count); // Whole in this segment
+			else
+				topicBuffer.concat((const char*)data, count);
+		}
+		fieldPos += count;
+		remaining -= count;
+		if (fieldPos == topicLength)
+		{
+			if (!skipTopic && topic.isEmpty())
+				topic = StringView(topicBuffer);
+			beginPayload();
+		}
+		return count;
+
+	case eMPS_MessageId:
+		msgId = (msgId << 8) | data[0];
+		remaining--;
+		if (++fieldPos == 2)
+		{
+			parserState = eMPS_Payload;
+			payloadLength = remaining;
+			if (remaining == 0)
+				publishData(NULL, 0);
+		}
+		return 1;
+
+	case eMPS_Payload:
+		count = min((uint32_t)len, remaining);
+		publishData(data, count);
+		return count;
+
+	case eMPS_Body:
+		count = min((uint32_t)len, remaining);
+		for (int i = 0; i < count; i++)
+			if (length - remaining + i < MQTT_PACKET_BODY_SIZE)
+				body[length - remaining + i] = data[i];
+		remaining -= count;
+		if (remaining == 0)
+		{
+			parserState = eMPS_Type;
+			onPacket(header & 0xF0, body, min(length, (uint32_t)MQTT_PACKET_BODY_SIZE), length);
+		}
+		return count;
+
+	default:
+		return len;
+	}
+}
+
+void MqttPacketParser::beginBody()
+{
+	if ((header & 0xF0) == MQTT_MSG_PUBLISH)
+	{
+		parserState = eMPS_TopicLength;
+		fieldPos = 0;
+		topicLength = 0;
+		topic = StringView();
+		topicBuffer = String();
+		msgId = 0;
+		if (remaining < 2)
+			fail();
+		return;
+	}
+
+	parserState = eMPS_Body;
+	if (remaining == 0)
+	{
+		parserState = eMPS_Type;
+		onPacket(header & 0xF0, body, 0, 0);
+	}
+}
+
+void MqttPacketParser::beginPayload()
+{
+	// QoS 1 and 2 messages have id
+	fieldPos = 0;
+	if (MQTTParseMessageQos(&header) > 0)
+	{
+		if (remaining < 2)
+			fail();
+		else
+			parserState = eMPS_MessageId;
+		return;
+	}
+
+	parserState = eMPS_Payload;
+	payloadLength = remaining;
+	if (remaining == 0)
+		publishData(NULL, 0);
+}
+
+void MqttPacketParser::publishData(uint8_t* data, size_t size)
+{
+	uint32_t offset = payloadLength - remaining;
+	remaining -= size;
+	if (remaining == 0)
+		parserState = eMPS_Type; // Ready for the next packet before callback
+
+	if (!skipTopic)
+		onPublishData(topic, header & 0x0F, msgId, offset, data, size, payloadLength);
+	else if (remaining == 0)
+		onPublishSkipped(header & 0x0F, msgId);
+}
+
+void MqttPacketParser::fail()
+{
+	debugf("MQTT malformed packet");
+	parserState = eMPS_Failed;
+}
@@ -0,0 +1,87 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_MQTTPACKETPARSER_H_
+#define _SMING_CORE_NETWORK_MQTTPACKETPARSER_H_
+
+#include "../Wiring/WiringFrameworkDependencies.h"
+#include "../../Wiring/WString.h"
+#include "../StringView.h"
+
+struct pbuf;
+
+// PUBLISH with longer topic is skipped, only onPublishSkipped is called
+#define MQTT_MAX_TOPIC_LENGTH 256
+// Collected part of other packets, enough for message id or CONNACK
+#define MQTT_PACKET_BODY_SIZE 8
+
+enum MqttParserState
+{
+	eMPS_Type = 0,
+	eMPS_Length,
+	eMPS_TopicLength,
+	eMPS_Topic,
+	eMPS_MessageId,
+	eMPS_Payload,
+	eMPS_Body,
+	eMPS_Failed
+};
+
+/**
+ * @brief Incremental MQTT packet decoder
+ *
+ * Packets can be split over any number of pbufs and TCP segments. PUBLISH payload is reported
+ * in chunks as it arrives. Topic is referenced in the received segment, it's copied only when
+ * it is split or the message continues in the next receive call. Other packets are reported
+ * with the beginning of their body.
+ */
+class MqttPacketParser
+{
+public:
+	MqttPacketParser();
+	virtual ~MqttPacketParser() {}
+
+	// Returns false for malformed data, connection should be closed then
+	bool parse(pbuf* buf);
+	void reset();
+
+	__forceinline MqttParserState getParserState() { return parserState; }
+
+protected:
+	// Next part of PUBLISH payload, offset is position in message of totalLength bytes.
+	// Message with empty payload is reported once with size 0. Topic is valid during the call only
+	virtual void onPublishData(const StringView& topic, uint8_t flags, uint16_t msgId,
+			size_t offset, uint8_t* data, size_t size, size_t totalLength) = 0;
+	// PUBLISH with too long topic was received completely, QoS 1 and 2 messages still must be acknowledged
+	virtual void onPublishSkipped(uint8_t flags, uint16_t msgId) = 0;
+	// Any other packet, body is cut to MQTT_PACKET_BODY_SIZE
+	virtual void onPacket(uint8_t type, const uint8_t* body, size_t size, size_t totalLength) = 0;
+
+private:
+	int parseBlock(uint8_t* data, int length);
+	void beginBody();
+	void beginPayload();
+	void publishData(uint8_t* data, size_t size);
+	void fail();
+
+private:
+	MqttParserState parserState;
+	uint8_t header; // Type and flags
+	uint32_t remaining; // Bytes left in packet (after length field)
+	uint32_t length; // Remaining length of packet
+	uint8_t lengthShift;
+	uint16_t fieldPos; // Position in topic or two byte field
+	uint16_t topicLength;
+	StringView topic; // In received data or topicBuffer
+	String topicBuffer; // Topic split over segments or kept for the next receive call
+	bool skipTopic;
+	uint16_t msgId;
+	uint32_t payloadLength;
+	uint8_t body[MQTT_PACKET_BODY_SIZE];
+};
+
+#endif /* _SMING_CORE_NETWORK_MQTTPACKETPARSER_H_ */
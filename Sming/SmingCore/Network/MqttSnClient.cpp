@@ -0,0 +1,531 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "MqttSnClient.h"
+#include "../Clock.h"
+
+MqttSnClient::MqttSnClient(IPAddress gatewayIp, int gatewayPort /* = MQTT_SN_DEFAULT_PORT */, MqttStringSubscriptionCallback callback /* = NULL */)
+{
+	this->gatewayIp = gatewayIp;
+	this->gatewayPort = gatewayPort;
+	this->callback = callback;
+}
+
+MqttSnClient::~MqttSnClient()
+{
+	timer.stop();
+	for (int i = 0; i < queue.count(); i++)
+		delete queue[i];
+}
+
+bool MqttSnClient::connect(String clientName, int keepAliveSeconds /* = 60 */)
+{
+	if (!UdpConnection::connect(gatewayIp, gatewayPort))
+	{
+		debugf("MQTT-SN: can't connect to %s", gatewayIp.toString().c_str());
+		return false;
+	}
+
+	this->clientName = clientName;
+	keepAlive = keepAliveSeconds;
+	state = eMSCS_Connecting;
+	sendConnect();
+	timer.initializeMs(1000, TimerDelegate(&MqttSnClient::onTimer, this)).start();
+	return true;
+}
+
+void MqttSnClient::disconnect()
+{
+	if (state == eMSCS_Connected)
+		sendPacket(MQTT_SN_DISCONNECT, NULL, 0, NULL, 0, 0);
+
+	state = eMSCS_Disconnected;
+	timer.stop();
+	finishRequest();
+}
+
+bool MqttSnClient::publish(String topic, String message, bool retained /* = false */)
+{
+	return publishWithQoS(topic, message, 0, retained);
+}
+
+bool MqttSnClient::publishWithQoS(String topic, String message, int QoS, bool retained /* = false */, MqttMessageDeliveredCallback onDelivery /* = NULL */)
+{
+	if (QoS < 0 || QoS > 1)
+	{
+		debugf("MQTT-SN: QoS %d isn't supported", QoS);
+		return false;
+	}
+	if (topic.length() == 0)
+		return false;
+
+	MqttSnMessage* msg = new MqttSnMessage;
+	msg->type = MQTT_SN_PUBLISH;
+	msg->flags = (QoS == 1 ? MQTT_SN_FLAG_QOS1 : 0) | (retained ? MQTT_SN_FLAG_RETAIN : 0);
+	msg->topic = topic;
+	msg->data = message;
+	msg->onDelivery = onDelivery;
+	return queueMessage(msg);
+}
+
+bool MqttSnClient::subscribe(String topic)
+{
+	if (!subscriptions.contains(topic))
+		subscriptions.add(topic);
+
+	// Otherwise it is sent after connection
+	if (state != eMSCS_Connected)
+		return true;
+
+	MqttSnMessage* msg = new MqttSnMessage;
+	msg->type = MQTT_SN_SUBSCRIBE;
+	msg->topic = topic;
+	return queueMessage(msg);
+}
+
+bool MqttSnClient::subscribe(String topic, MqttStringSubscriptionCallback handler)
+{
+	if (!handlers.add(topic, handler))
+	{
+		debugf("MQTT-SN: invalid topic filter '%s'", topic.c_str());
+		return false;
+	}
+
+	if (subscribe(topic))
+		return true;
+
+	handlers.remove(topic);
+	return false;
+}
+
+bool MqttSnClient::unsubscribe(String topic)
+{
+	subscriptions.removeElement(topic);
+	handlers.remove(topic);
+	if (state != eMSCS_Connected)
+		return true;
+
+	MqttSnMessage* msg = new MqttSnMessage;
+	msg->type = MQTT_SN_UNSUBSCRIBE;
+	msg->topic = topic;
+	return queueMessage(msg);
+}
+
+bool MqttSnClient::queueMessage(MqttSnMessage* msg, bool first /* = false */)
+{
+	if (first)
+		queue.insertElementAt(msg, 0);
+	else if (queue.count() < MQTT_SN_QUEUE_SIZE)
+		queue.add(msg);
+	else
+	{
+		debugf("MQTT-SN: queue is full");
+		delete msg;
+		return false;
+	}
+
+	sendNext();
+	return true;
+}
+
+void MqttSnClient::sendConnect()
+{
+	// Clean session, gateway forgets registered topics
+	topicIds.clear();
+	uint8_t head[4] = { MQTT_SN_FLAG_CLEAN_SESSION, 0x01, (uint8_t)(keepAlive >> 8), (uint8_t)keepAlive };
+	sendPacket(MQTT_SN_CONNECT, head, sizeof(head), clientName.c_str(), clientName.length(), MQTT_SN_CONNACK);
+}
+
+void MqttSnClient::sendNext()
+{
+	while (state == eMSCS_Connected && awaiting == 0 && queue.count() > 0)
+	{
+		MqttSnMessage* msg = queue[0];
+		uint16_t id = 0;
+		bool sent;
+
+		if (msg->type == MQTT_SN_PUBLISH)
+		{
+			uint8_t flags = msg->flags;
+			uint16_t topicId;
+			if (msg->topic.length() == 2)
+			{
+				flags |= MQTT_SN_TOPIC_SHORT;
+				topicId = ((uint8_t)msg->topic[0] << 8) | (uint8_t)msg->topic[1];
+			}
+			else if (topicIds.contains(msg->topic))
+				topicId = topicIds[msg->topic];
+			else
+			{
+				// Full name is sent once, gateway assigns the id
+				id = nextMessageId();
+				uint8_t head[4] = { 0, 0, (uint8_t)(id >> 8), (uint8_t)id };
+				if (sendPacket(MQTT_SN_REGISTER, head, sizeof(head), msg->topic.c_str(), msg->topic.length(), MQTT_SN_REGACK))
+				{
+					awaitingId = id;
+					return;
+				}
+				sent = false;
+			}
+
+			if (id == 0)
+			{
+				if (flags & MQTT_SN_FLAG_QOS1)
+					id = nextMessageId();
+				uint8_t head[5] = { flags, (uint8_t)(topicId >> 8), (uint8_t)topicId, (uint8_t)(id >> 8), (uint8_t)id };
+				sent = sendPacket(MQTT_SN_PUBLISH, head, sizeof(head), msg->data.c_str(), msg->data.length(), id ? MQTT_SN_PUBACK : 0);
+				if (sent && id != 0)
+				{
+					awaitingId = id; // Removed on PUBACK
+					return;
+				}
+			}
+		}
+		else
+		{
+			id = nextMessageId();
+			uint8_t head[3] = { MQTT_SN_TOPIC_NORMAL, (uint8_t)(id >> 8), (uint8_t)id };
+			uint8_t reply = (msg->type == MQTT_SN_SUBSCRIBE) ? MQTT_SN_SUBACK : MQTT_SN_UNSUBACK;
+			sent = sendPacket(msg->type, head, sizeof(head), msg->topic.c_str(), msg->topic.length(), reply);
+			if (sent)
+			{
+				awaitingId = id;
+				return;
+			}
+		}
+
+		if (!sent)
+			debugf("MQTT-SN: message for '%s' dropped", msg->topic.c_str());
+		queue.remove(0);
+		delete msg;
+	}
+}
+
+bool MqttSnClient::sendPacket(uint8_t type, const uint8_t* head, int headLength, const char* data, int length, uint8_t awaitReply)
+{
+	// Length takes 3 bytes for longer packets
+	int total = 2 + headLength + length;
+	if (total > 255)
+		total += 2;
+	if (total > MQTT_SN_MAX_PACKET_SIZE)
+	{
+		debugf("MQTT-SN: packet is too long (%d)", total);
+		return false;
+	}
+
+	uint8_t header[4];
+	int headerLength = 0;
+	if (total > 255)
+	{
+		header[headerLength++] = 0x01;
+		header[headerLength++] = total >> 8;
+	}
+	header[headerLength++] = total;
+	header[headerLength++] = type;
+
+	// Request is kept for retransmission, String copy isn't binary safe so it is built in place
+	String reply;
+	String& packet = (awaitReply != 0) ? request : reply;
+	packet = String();
+	if (!packet.reserve(total))
+		return false;
+	packet.concat((const char*)header, headerLength);
+	packet.concat((const char*)head, headLength);
+	packet.concat(data, length);
+
+	UdpConnection::send(packet.c_str(), packet.length());
+	lastSent = millis();
+
+	if (awaitReply != 0)
+	{
+		awaiting = awaitReply;
+		awaitingId = 0;
+		retries = 0;
+		requestTime = lastSent;
+	}
+	return true;
+}
+
+void MqttSnClient::sendReply(uint8_t type, uint16_t topicId, uint16_t msgId, uint8_t code)
+{
+	uint8_t head[5] = { (uint8_t)(topicId >> 8), (uint8_t)topicId, (uint8_t)(msgId >> 8), (uint8_t)msgId, code };
+	sendPacket(type, head, sizeof(head), NULL, 0, 0);
+}
+
+void MqttSnClient::resend()
+{
+	retries++;
+	int typePos = (request[0] == 0x01) ? 3 : 1;
+	uint8_t type = request[typePos];
+	if (type == MQTT_SN_PUBLISH || type == MQTT_SN_SUBSCRIBE)
+		request[typePos + 1] |= MQTT_SN_FLAG_DUP;
+
+	debugf("MQTT-SN: request 0x%02X sent again", type);
+	UdpConnection::send(request.c_str(), request.length());
+	lastSent = requestTime = millis();
+}
+
+void MqttSnClient::reconnect()
+{
+	// Current message stays first in the queue
+	state = eMSCS_Connecting;
+	finishRequest();
+	sendConnect();
+}
+
+void MqttSnClient::finishRequest()
+{
+	awaiting = 0;
+	awaitingId = 0;
+	request = String();
+	retries = 0;
+}
+
+void MqttSnClient::onTimer()
+{
+	if (awaiting != 0)
+	{
+		if (millis() - requestTime < MQTT_SN_RETRY_TIMEOUT * 1000)
+			return;
+
+		if (retries < MQTT_SN_RETRY_COUNT)
+			resend();
+		else if (state == eMSCS_Connecting)
+			sendConnect(); // Gateway isn't reachable, keep trying
+		else
+		{
+			debugf("MQTT-SN: gateway doesn't answer");
+			reconnect();
+		}
+		return;
+	}
+
+	// Ping when there is no other traffic
+	if (state == eMSCS_Connected && keepAlive > 0 && millis() - lastSent >= (unsigned long)keepAlive * 500)
+		sendPacket(MQTT_SN_PINGREQ, NULL, 0, NULL, 0, MQTT_SN_PINGRESP);
+}
+
+void MqttSnClient::onReceive(pbuf *buf, IPAddress remoteIP, uint16_t remotePort)
+{
+	if (state == eMSCS_Disconnected || buf->tot_len < 2 || buf->tot_len > MQTT_SN_MAX_PACKET_SIZE)
+		return;
+
+	uint8_t* data = new uint8_t[buf->tot_len];
+	pbuf_copy_partial(buf, data, buf->tot_len, 0);
+
+	int length = data[0];
+	int headerLength = 1;
+	if (data[0] == 0x01 && buf->tot_len >= 4)
+	{
+		length = (data[1] << 8) | data[2];
+		headerLength = 3;
+	}
+
+	if (length <= headerLength || length > buf->tot_len)
+		debugf("MQTT-SN: invalid packet");
+	else
+		processPacket(data[headerLength], data + headerLength + 1, length - headerLength - 1);
+
+	delete[] data;
+}
+
+void MqttSnClient::processPacket(uint8_t type, const uint8_t* body, int length)
+{
+	uint16_t msgId;
+	uint16_t topicId;
+
+	switch (type)
+	{
+	case MQTT_SN_CONNACK:
+		if (awaiting != MQTT_SN_CONNACK || length < 1)
+			break;
+		if (body[0] != MQTT_SN_ACCEPTED)
+		{
+			debugf("MQTT-SN: connection refused (%d)", body[0]);
+			break; // Tried again later
+		}
+		finishRequest();
+		state = eMSCS_Connected;
+		debugf("MQTT-SN connected");
+		// Subscriptions go before waiting messages
+		for (int i = subscriptions.count() - 1; i >= 0; i--)
+		{
+			MqttSnMessage* msg = new MqttSnMessage;
+			msg->type = MQTT_SN_SUBSCRIBE;
+			msg->topic = subscriptions[i];
+			queue.insertElementAt(msg, 0);
+		}
+		sendNext();
+		break;
+
+	case MQTT_SN_REGACK:
+		if (length < 5)
+			break;
+		topicId = (body[0] << 8) | body[1];
+		msgId = (body[2] << 8) | body[3];
+		if (awaiting != MQTT_SN_REGACK || msgId != awaitingId || queue.count() == 0)
+			break;
+		finishRequest();
+		if (body[4] == MQTT_SN_ACCEPTED)
+			topicIds[queue[0]->topic] = topicId;
+		else
+		{
+			debugf("MQTT-SN: topic '%s' refused (%d)", queue[0]->topic.c_str(), body[4]);
+			delete queue[0];
+			queue.remove(0);
+		}
+		sendNext();
+		break;
+
+	case MQTT_SN_PUBACK:
+		if (length < 5)
+			break;
+		topicId = (body[0] << 8) | body[1];
+		msgId = (body[2] << 8) | body[3];
+		if (body[4] == MQTT_SN_INVALID_TOPIC_ID)
+		{
+			// Gateway lost the registration, topic is registered again
+			for (int i = 0; i < (int)topicIds.count(); i++)
+				if (topicIds.valueAt(i) == topicId)
+				{
+					topicIds.remove(topicIds.keyAt(i));
+					break;
+				}
+		}
+		if (awaiting != MQTT_SN_PUBACK || msgId != awaitingId || queue.count() == 0)
+			break;
+		finishRequest();
+		if (body[4] != MQTT_SN_INVALID_TOPIC_ID)
+		{
+			MqttSnMessage* msg = queue[0];
+			queue.remove(0);
+			if (body[4] != MQTT_SN_ACCEPTED)
+				debugf("MQTT-SN: message for '%s' rejected (%d)", msg->topic.c_str(), body[4]);
+			else if (msg->onDelivery)
+				msg->onDelivery(msgId, MQTT_SN_PUBACK);
+			delete msg;
+		}
+		sendNext();
+		break;
+
+	case MQTT_SN_SUBACK:
+		if (length < 6)
+			break;
+		topicId = (body[1] << 8) | body[2];
+		msgId = (body[3] << 8) | body[4];
+		if (awaiting != MQTT_SN_SUBACK || msgId != awaitingId || queue.count() == 0)
+			break;
+		finishRequest();
+		// Topic without wildcards gets its id now, others are registered by gateway before PUBLISH
+		if (body[5] != MQTT_SN_ACCEPTED)
+			debugf("MQTT-SN: subscription '%s' refused (%d)", queue[0]->topic.c_str(), body[5]);
+		else if (topicId != 0)
+			topicIds[queue[0]->topic] = topicId;
+		delete queue[0];
+		queue.remove(0);
+		sendNext();
+		break;
+
+	case MQTT_SN_UNSUBACK:
+		if (length < 2)
+			break;
+		msgId = (body[0] << 8) | body[1];
+		if (awaiting != MQTT_SN_UNSUBACK || msgId != awaitingId || queue.count() == 0)
+			break;
+		finishRequest();
+		delete queue[0];
+		queue.remove(0);
+		sendNext();
+		break;
+
+	case MQTT_SN_PINGRESP:
+		if (awaiting == MQTT_SN_PINGRESP)
+		{
+			finishRequest();
+			sendNext();
+		}
+		break;
+
+	case MQTT_SN_PINGREQ:
+		sendPacket(MQTT_SN_PINGRESP, NULL, 0, NULL, 0, 0);
+		break;
+
+	case MQTT_SN_REGISTER:
+		if (length < 4)
+			break;
+		topicId = (body[0] << 8) | body[1];
+		msgId = (body[2] << 8) | body[3];
+		topicIds[String((const char*)body + 4, length - 4)] = topicId;
+		sendReply(MQTT_SN_REGACK, topicId, msgId, MQTT_SN_ACCEPTED);
+		break;
+
+	case MQTT_SN_PUBLISH:
+		processPublish(body, length);
+		break;
+
+	case MQTT_SN_DISCONNECT:
+		debugf("MQTT-SN: disconnected by gateway");
+		if (state == eMSCS_Connected)
+			reconnect();
+		break;
+
+	default:
+		debugf("MQTT-SN: unexpected packet 0x%02X", type);
+	}
+}
+
+void MqttSnClient::processPublish(const uint8_t* body, int length)
+{
+	if (state != eMSCS_Connected || length < 5)
+		return;
+
+	uint8_t flags = body[0];
+	uint16_t topicId = (body[1] << 8) | body[2];
+	uint16_t msgId = (body[3] << 8) | body[4];
+	bool confirm = (flags & MQTT_SN_FLAG_QOS1) != 0;
+
+	String topic = getTopicName(flags, topicId);
+	if (topic.length() == 0)
+	{
+		debugf("MQTT-SN: unknown topic id %d", topicId);
+		if (confirm)
+			sendReply(MQTT_SN_PUBACK, topicId, msgId, MQTT_SN_INVALID_TOPIC_ID);
+		return;
+	}
+
+	if (confirm)
+		sendReply(MQTT_SN_PUBACK, topicId, msgId, MQTT_SN_ACCEPTED);
+
+	String message((const char*)body + 5, length - 5);
+	// Client callback gets messages of no other subscription
+	if (handlers.dispatch(topic, message) == 0 && callback)
+		callback(topic, message);
+}
+
+String MqttSnClient::getTopicName(uint8_t flags, uint16_t topicId)
+{
+	if ((flags & MQTT_SN_TOPIC_TYPE_MASK) == MQTT_SN_TOPIC_SHORT)
+	{
+		char name[2] = { (char)(topicId >> 8), (char)topicId };
+		return String(name, 2);
+	}
+
+	// Predefined ids aren't known
+	if ((flags & MQTT_SN_TOPIC_TYPE_MASK) == MQTT_SN_TOPIC_NORMAL)
+		for (int i = 0; i < (int)topicIds.count(); i++)
+			if (topicIds.valueAt(i) == topicId)
+				return topicIds.keyAt(i);
+
+	return String();
+}
+
+uint16_t MqttSnClient::nextMessageId()
+{
+	if (++messageId == 0)
+		messageId = 1;
+	return messageId;
+}
@@ -0,0 +1,143 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_MQTTSNCLIENT_H_
+#define _SMING_CORE_NETWORK_MQTTSNCLIENT_H_
+
+#include "UdpConnection.h"
+#include "MqttClient.h"
+#include "../Timer.h"
+#include "../Delegate.h"
+#include "../../Wiring/WString.h"
+#include "../../Wiring/WHashMap.h"
+#include "../../Wiring/WVector.h"
+
+#define MQTT_SN_DEFAULT_PORT 10000
+// Seconds to wait for gateway answer before request is sent again
+#define MQTT_SN_RETRY_TIMEOUT 10
+#define MQTT_SN_RETRY_COUNT 3
+// Messages waiting for connection or registration of their topic
+#define MQTT_SN_QUEUE_SIZE 8
+#define MQTT_SN_MAX_PACKET_SIZE 512
+
+// MQTT-SN 1.2 message types
+#define MQTT_SN_CONNECT 0x04
+#define MQTT_SN_CONNACK 0x05
+#define MQTT_SN_REGISTER 0x0A
+#define MQTT_SN_REGACK 0x0B
+#define MQTT_SN_PUBLISH 0x0C
+#define MQTT_SN_PUBACK 0x0D
+#define MQTT_SN_SUBSCRIBE 0x12
+#define MQTT_SN_SUBACK 0x13
+#define MQTT_SN_UNSUBSCRIBE 0x14
+#define MQTT_SN_UNSUBACK 0x15
+#define MQTT_SN_PINGREQ 0x16
+#define MQTT_SN_PINGRESP 0x17
+#define MQTT_SN_DISCONNECT 0x18
+
+#define MQTT_SN_FLAG_DUP 0x80
+#define MQTT_SN_FLAG_QOS1 0x20
+#define MQTT_SN_FLAG_RETAIN 0x10
+#define MQTT_SN_FLAG_CLEAN_SESSION 0x04
+#define MQTT_SN_TOPIC_NORMAL 0x00
+#define MQTT_SN_TOPIC_SHORT 0x02
+#define MQTT_SN_TOPIC_TYPE_MASK 0x03
+
+#define MQTT_SN_ACCEPTED 0x00
+#define MQTT_SN_INVALID_TOPIC_ID 0x02
+
+enum MqttSnClientState
+{
+	eMSCS_Disconnected = 0,
+	eMSCS_Connecting,
+	eMSCS_Connected
+};
+
+// PUBLISH, SUBSCRIBE or UNSUBSCRIBE waiting for its turn
+struct MqttSnMessage
+{
+	uint8_t type;
+	uint8_t flags = 0; // QoS and retain of PUBLISH
+	String topic;
+	String data;
+	MqttMessageDeliveredCallback onDelivery;
+};
+
+/**
+ * @brief MQTT-SN client, talks to a gateway over UDP
+ *
+ * Long topic names are registered once per session, then PUBLISH carries only the 2 byte
+ * topic id. Two character topics are sent as short topic names without registration.
+ * Only one request waits for the gateway answer at a time, others are queued.
+ * QoS 0 and 1 are supported.
+ */
+class MqttSnClient : protected UdpConnection
+{
+public:
+	MqttSnClient(IPAddress gatewayIp, int gatewayPort = MQTT_SN_DEFAULT_PORT, MqttStringSubscriptionCallback callback = NULL);
+	virtual ~MqttSnClient();
+
+	// Session is always clean, topics are registered again after reconnection
+	bool connect(String clientName, int keepAliveSeconds = 60);
+	void disconnect();
+
+	bool publish(String topic, String message, bool retained = false);
+	// onDelivery is called on PUBACK of QoS 1 message
+	bool publishWithQoS(String topic, String message, int QoS, bool retained = false, MqttMessageDeliveredCallback onDelivery = NULL);
+
+	// Subscriptions are restored on reconnection
+	bool subscribe(String topic);
+	bool subscribe(String topic, MqttStringSubscriptionCallback handler);
+	bool unsubscribe(String topic);
+
+	__forceinline MqttSnClientState getState() { return state; }
+	__forceinline int getQueueCount() { return queue.count(); }
+
+protected:
+	virtual void onReceive(pbuf *buf, IPAddress remoteIP, uint16_t remotePort);
+
+private:
+	bool queueMessage(MqttSnMessage* msg, bool first = false);
+	void sendConnect();
+	void sendNext();
+	bool sendPacket(uint8_t type, const uint8_t* head, int headLength, const char* data, int length, uint8_t awaitReply);
+	void sendReply(uint8_t type, uint16_t topicId, uint16_t msgId, uint8_t code);
+	void resend();
+	void reconnect();
+	void finishRequest();
+	void processPacket(uint8_t type, const uint8_t* body, int length);
+	void processPublish(const uint8_t* body, int length);
+	String getTopicName(uint8_t flags, uint16_t topicId);
+	void onTimer();
+	uint16_t nextMessageId();
+
+private:
+	IPAddress gatewayIp;
+	int gatewayPort;
+	String clientName;
+	int keepAlive = 60;
+	MqttSnClientState state = eMSCS_Disconnected;
+	MqttStringSubscriptionCallback callback;
+	MqttTopicTrie handlers;
+
+	HashMap<String, uint16_t> topicIds; // Registered in this session
+	Vector<String> subscriptions;
+	Vector<MqttSnMessage*> queue;
+
+	// Request waiting for answer
+	uint8_t awaiting = 0; // Expected reply type, 0 if none
+	uint16_t awaitingId = 0;
+	String request; // Sent again with DUP flag when answer doesn't come
+	uint8_t retries = 0;
+	unsigned long requestTime = 0;
+
+	unsigned long lastSent = 0;
+	uint16_t messageId = 0;
+	Timer timer;
+};
+
+#endif /* _SMING_CORE_NETWORK_MQTTSNCLIENT_H_ */
@@ -0,0 +1,293 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "MqttTopicTrie.h"
+
+MqttTopicTrie::~MqttTopicTrie()
+{
+	free(&root);
+}
+
+void MqttTopicTrie::clear()
+{
+	count = 0;
+	if (dispatching)
+	{
+		// Nodes are walked by dispatch, they are only disabled and deleted when it ends
+		clearHandlers(&root);
+		pruneNeeded = true;
+		return;
+	}
+
+	free(&root);
+}
+
+void MqttTopicTrie::clearHandlers(Node* node)
+{
+	node->handler = MqttStringSubscriptionCallback();
+	for (unsigned i = 0; i < node->literals.count(); i++)
+		clearHandlers(node->literals[i]);
+	if (node->single != NULL)
+		clearHandlers(node->single);
+	if (node->multi != NULL)
+		clearHandlers(node->multi);
+}
+
+void MqttTopicTrie::free(Node* node)
+{
+	// Children only, node itself is deleted by caller
+	for (unsigned i = 0; i < node->literals.count(); i++)
+	{
+		free(node->literals[i]);
+		delete node->literals[i];
+	}
+	node->literals.clear();
+
+	if (node->single != NULL)
+	{
+		free(node->single);
+		delete node->single;
+		node->single = NULL;
+	}
+
+	if (node->multi != NULL)
+	{
+		free(node->multi);
+		delete node->multi;
+		node->multi = NULL;
+	}
+}
+
+bool MqttTopicTrie::prune(Node* node)
+{
+	for (int i = node->literals.count() - 1; i >= 0; i--)
+	{
+		if (prune(node->literals[i]))
+		{
+			delete node->literals[i];
+			node->literals.remove(i);
+		}
+	}
+
+	if (node->single != NULL && prune(node->single))
+	{
+		delete node->single;
+		node->single = NULL;
+	}
+
+	if (node->multi != NULL && prune(node->multi))
+	{
+		delete node->multi;
+		node->multi = NULL;
+	}
+
+	return !node->handler && node->literals.count() == 0 && node->single == NULL && node->multi == NULL;
+}
+
+bool MqttTopicTrie::isValidFilter(const String& filter)
+{
+	if (filter.length() == 0)
+		return false;
+
+	// Wildcard takes whole level, '#' only the last one
+	const char* str = filter.c_str();
+	for (int i = 0; i < (int)filter.length(); i++)
+	{
+		if (str[i] != '+' && str[i] != '#')
+			continue;
+		if (i > 0 && str[i - 1] != '/')
+			return false;
+		if (str[i] == '#' && i != (int)filter.length() - 1)
+			return false;
+		if (str[i] == '+' && str[i + 1] != '/' && str[i + 1] != '\0')
+			return false;
+	}
+
+	return true;
+}
+
+int MqttTopicTrie::findLiteral(Node* node, const char* level, int length, bool& found)
+{
+	int low = 0;
+	int high = node->literals.count();
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		const String& text = node->literals[middle]->level;
+		int cmp = memcmp(text.c_str(), level, min((int)text.length(), length));
+		if (cmp == 0)
+			cmp = (int)text.length() - length;
+
+		if (cmp == 0)
+		{
+			found = true;
+			return middle;
+		}
+		if (cmp < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	found = false;
+	return low;
+}
+
+MqttTopicTrie::Node** MqttTopicTrie::findChild(Node* node, const char* level, int length)
+{
+	if (length == 1 && level[0] == '+')
+		return &node->single;
+	if (length == 1 && level[0] == '#')
+		return &node->multi;
+
+	bool found;
+	int index = findLiteral(node, level, length, found);
+	return found ? &node->literals[index] : NULL;
+}
+
+bool MqttTopicTrie::add(const String& filter, MqttStringSubscriptionCallback handler)
+{
+	if (!isValidFilter(filter))
+		return false;
+
+	Node* node = &root;
+	for (const char* level = filter.c_str(); level != NULL; )
+	{
+		const char* end = strchr(level, '/');
+		int length = (end != NULL) ? end - level : strlen(level);
+
+		Node** link = findChild(node, level, length);
+		Node* child = (link != NULL) ? *link : NULL;
+		if (child == NULL)
+		{
+			child = new Node;
+			child->level = String(level, length);
+			if (link != NULL)
+				*link = child; // Wildcard
+			else
+			{
+				bool found;
+				node->literals.insertElementAt(child, findLiteral(node, level, length, found));
+			}
+		}
+
+		node = child;
+		level = (end != NULL) ? end + 1 : NULL;
+	}
+
+	if (!node->handler)
+		count++;
+	node->handler = handler;
+	return true;
+}
+
+bool MqttTopicTrie::remove(const String& filter)
+{
+	return remove(&root, filter.c_str());
+}
+
+bool MqttTopicTrie::remove(Node* node, const char* level)
+{
+	const char* end = strchr(level, '/');
+	int length = (end != NULL) ? end - level : strlen(level);
+
+	Node** link = findChild(node, level, length);
+	Node* child = (link != NULL) ? *link : NULL;
+	if (child == NULL)
+		return false;
+
+	if (end != NULL)
+	{
+		if (!remove(child, end + 1))
+			return false;
+	}
+	else if (!child->handler)
+		return false;
+	else
+	{
+		child->handler = MqttStringSubscriptionCallback();
+		count--;
+	}
+
+	// Unused levels are removed
+	if (dispatching)
+		pruneNeeded = true;
+	else if (!child->handler && child->literals.count() == 0 && child->single == NULL && child->multi == NULL)
+	{
+		if (child == node->single)
+			node->single = NULL;
+		else if (child == node->multi)
+			node->multi = NULL;
+		else
+		{
+			bool found;
+			node->literals.remove(findLiteral(node, level, length, found));
+		}
+		delete child;
+	}
+
+	return true;
+}
+
+int MqttTopicTrie::dispatch(const String& topic, const String& message)
+{
+	if (count == 0 || topic.length() == 0)
+		return 0;
+
+	dispatching++;
+	int res = match(&root, topic.c_str(), true, topic, message);
+	if (--dispatching == 0 && pruneNeeded)
+	{
+		pruneNeeded = false;
+		prune(&root);
+	}
+	return res;
+}
+
+int MqttTopicTrie::match(Node* node, const char* level, bool first, const String& topic, const String& message)
+{
+	const char* end = strchr(level, '/');
+	int length = (end != NULL) ? end - level : strlen(level);
+	bool wildcards = !(first && level[0] == '$'); // System topics are matched only explicitly
+
+	int res = 0;
+	if (wildcards && node->multi != NULL)
+		res += call(node->multi, topic, message);
+
+	bool found;
+	int index = findLiteral(node, level, length, found);
+	if (found)
+		res += matchChild(node->literals[index], end, topic, message);
+
+	if (wildcards && node->single != NULL)
+		res += matchChild(node->single, end, topic, message);
+
+	return res;
+}
+
+int MqttTopicTrie::matchChild(Node* child, const char* end, const String& topic, const String& message)
+{
+	if (end != NULL)
+		return match(child, end + 1, false, topic, message);
+
+	// Last level, "a/#" matches "a" too
+	int res = call(child, topic, message);
+	if (child->multi != NULL)
+		res += call(child->multi, topic, message);
+	return res;
+}
+
+int MqttTopicTrie::call(Node* node, const String& topic, const String& message)
+{
+	if (!node->handler)
+		return 0;
+
+	// Handler can be replaced by the call
+	MqttStringSubscriptionCallback handler = node->handler;
+	handler(topic, message);
+	return 1;
+}
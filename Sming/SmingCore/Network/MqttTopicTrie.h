@@ -0,0 +1,73 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_MQTTTOPICTRIE_H_
+#define _SMING_CORE_NETWORK_MQTTTOPICTRIE_H_
+
+#include "../Delegate.h"
+#include "../../Wiring/WString.h"
+#include "../../Wiring/WVector.h"
+
+//typedef void (*MqttStringSubscriptionCallback)(String topic, String message);
+typedef Delegate<void(String topic, String message)> MqttStringSubscriptionCallback;
+
+/**
+ * @brief Subscription handlers by topic filter
+ *
+ * Filters are stored by levels, "+" matches one level and "#" (last level only) any number of levels
+ * including none. Literal levels are sorted and searched by bisection, wildcards have their own links,
+ * so matching cost depends on topic depth and only logarithmically on the number of filters.
+ * Topics beginning with '$' aren't matched by wildcards at the first level.
+ */
+class MqttTopicTrie
+{
+public:
+	MqttTopicTrie() {}
+	~MqttTopicTrie();
+
+	// Returns false for invalid filter, handler of the same filter is replaced
+	bool add(const String& filter, MqttStringSubscriptionCallback handler);
+	bool remove(const String& filter);
+	void clear();
+	__forceinline bool isEmpty() { return count == 0; }
+
+	// Calls handlers of all matching filters, returns their number
+	int dispatch(const String& topic, const String& message);
+
+	static bool isValidFilter(const String& filter);
+
+private:
+	struct Node
+	{
+		String level;
+		Vector<Node*> literals; // Sorted by level
+		Node* single = NULL; // "+"
+		Node* multi = NULL; // "#"
+		MqttStringSubscriptionCallback handler;
+	};
+
+	int match(Node* node, const char* level, bool first, const String& topic, const String& message);
+	int matchChild(Node* child, const char* end, const String& topic, const String& message);
+	int call(Node* node, const String& topic, const String& message);
+	bool remove(Node* node, const char* level);
+	void clearHandlers(Node* node);
+	static int findLiteral(Node* node, const char* level, int length, bool& found);
+	static Node** findChild(Node* node, const char* level, int length);
+	static bool prune(Node* node); // Deletes unused children, returns true if node itself is unused
+	static void free(Node* node);
+
+private:
+	Node root; // Level before the first one
+	int count = 0; // Filters with handler
+	uint8_t dispatching = 0; // Nodes aren't deleted while handlers run
+	bool pruneNeeded = false; // Handlers removed during dispatch left unused nodes
+
+	MqttTopicTrie(const MqttTopicTrie&);
+	MqttTopicTrie& operator=(const MqttTopicTrie&);
+};
+
+#endif /* _SMING_CORE_NETWORK_MQTTTOPICTRIE_H_ */
@@ -6,6 +6,7 @@
  ****/
 
 #include "NetUtils.h"
+#include "PbufSlice.h"
 
 #include "../Wiring/WString.h"
 #include "lwip/tcp_impl.h"
@@ -79,7 +80,7 @@ int NetUtils::pbufFindStr(pbuf *buf, const char* wtf, int startPos /* = 0*/)
 {
 	int cur = startPos;
 	if (startPos < 0) startPos = 0;
-	if (wtf == NULL || strlen(wtf) == -1) return -1;
+	if (wtf == NULL) return -1;
 
 	while (true)
 	{
@@ -104,12 +105,7 @@ char* NetUtils::pbufAllocateStrCopy(pbuf *buf, int startPos, int length)
 
 String NetUtils::pbufStrCopy(pbuf *buf, int startPos, int length)
 {
-	char* stringPtr = new char[length + 1];
-	stringPtr[length] = '\0';
-	pbuf_copy_partial(buf, stringPtr, length, startPos);
-	String res = String(stringPtr);
-	delete[] stringPtr;
-	return res;
+	return PbufSlice(buf, startPos, length).toString();
 }
 
 bool NetUtils::FixNetworkRouting()
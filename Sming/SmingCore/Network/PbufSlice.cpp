@@ -0,0 +1,268 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "PbufSlice.h"
+#include "lwip/pbuf.h"
+
+// Reads a slice byte by byte, moving to the next segment as needed
+class PbufReader
+{
+public:
+	PbufReader(pbuf* buf, int pos) : cur(buf), pos(pos)
+	{
+		while (cur != NULL && this->pos >= cur->len)
+		{
+			this->pos -= cur->len;
+			cur = cur->next;
+		}
+	}
+
+	char read()
+	{
+		while (pos >= cur->len)
+		{
+			pos = 0;
+			cur = cur->next;
+		}
+		return ((const char*)cur->payload)[pos++];
+	}
+
+private:
+	pbuf* cur;
+	int pos;
+};
+
+static bool sameChar(char a, char b, bool ignoreCase)
+{
+	return a == b || (ignoreCase && tolower((uint8_t)a) == tolower((uint8_t)b));
+}
+
+PbufSlice::PbufSlice(pbuf* buf, int startPos, int length)
+{
+	this->buf = NULL;
+	offset = 0;
+	len = 0;
+	if (buf == NULL || startPos < 0 || startPos >= buf->tot_len)
+		return;
+
+	if (length < 0 || length > buf->tot_len - startPos)
+		length = buf->tot_len - startPos;
+
+	while (startPos >= buf->len)
+	{
+		startPos -= buf->len;
+		buf = buf->next;
+	}
+
+	this->buf = buf;
+	offset = startPos;
+	len = length;
+}
+
+char PbufSlice::charAt(int index) const
+{
+	if (index < 0 || index >= len) return 0;
+
+	return PbufReader(buf, offset + index).read();
+}
+
+bool PbufSlice::equals(const StringView& str) const
+{
+	return str.length() == len && startsWith(str);
+}
+
+bool PbufSlice::equalsIgnoreCase(const StringView& str) const
+{
+	return str.length() == len && find(str, 0, true) == 0;
+}
+
+bool PbufSlice::startsWith(const StringView& prefix) const
+{
+	if (prefix.length() > len) return false;
+
+	PbufReader reader(buf, offset);
+	for (int i = 0; i < prefix.length(); i++)
+		if (reader.read() != prefix[i])
+			return false;
+
+	return true;
+}
+
+int PbufSlice::compareTo(const StringView& str) const
+{
+	PbufReader reader(buf, offset);
+	int count = min(len, str.length());
+	for (int i = 0; i < count; i++)
+	{
+		uint8_t ch = reader.read();
+		if (ch != (uint8_t)str[i])
+			return ch - (uint8_t)str[i];
+	}
+
+	return len - str.length();
+}
+
+int PbufSlice::indexOf(char ch, int fromIndex) const
+{
+	if (fromIndex < 0) fromIndex = 0;
+	if (fromIndex >= len) return -1;
+
+	// Search segment by segment
+	int segmentStart = -offset; // Slice position of the segment start
+	for (pbuf* cur = buf; cur != NULL && segmentStart < len; cur = cur->next)
+	{
+		int from = max(fromIndex - segmentStart, 0);
+		int to = min((int)cur->len, len - segmentStart);
+		if (from < to)
+		{
+			const char* data = (const char*)cur->payload;
+			const char* found = (const char*)memchr(data + from, ch, to - from);
+			if (found != NULL)
+				return segmentStart + (found - data);
+		}
+		segmentStart += cur->len;
+	}
+
+	return -1;
+}
+
+int PbufSlice::indexOf(const StringView& str, int fromIndex) const
+{
+	return find(str, fromIndex, false);
+}
+
+int PbufSlice::indexOfIgnoreCase(const StringView& str, int fromIndex) const
+{
+	return find(str, fromIndex, true);
+}
+
+int PbufSlice::find(const StringView& str, int fromIndex, bool ignoreCase) const
+{
+	if (fromIndex < 0) fromIndex = 0;
+	if (str.length() == 0) return (fromIndex <= len) ? fromIndex : -1;
+
+	// Candidates are compared with their own reader, the outer one only advances
+	PbufReader reader(buf, offset + fromIndex);
+	for (int pos = fromIndex; pos + str.length() <= len; pos++)
+	{
+		PbufReader candidate = reader;
+		if (sameChar(reader.read(), str[0], ignoreCase))
+		{
+			candidate.read();
+			int i = 1;
+			while (i < str.length() && sameChar(candidate.read(), str[i], ignoreCase))
+				i++;
+			if (i == str.length())
+				return pos;
+		}
+	}
+
+	return -1;
+}
+
+PbufSlice PbufSlice::substring(int beginIndex, int endIndex) const
+{
+	if (beginIndex < 0) beginIndex = 0;
+	if (endIndex > len) endIndex = len;
+	if (buf == NULL || beginIndex >= endIndex) return PbufSlice();
+
+	return PbufSlice(buf, offset + beginIndex, endIndex - beginIndex);
+}
+
+PbufSlice PbufSlice::trim() const
+{
+	int begin = 0;
+	int end = len;
+	while (begin < end && isspace((uint8_t)charAt(begin)))
+		begin++;
+	while (end > begin && isspace((uint8_t)charAt(end - 1)))
+		end--;
+
+	return substring(begin, end);
+}
+
+long PbufSlice::toInt() const
+{
+	StringView view = toStringView();
+	if (view.data() != NULL)
+		return view.toInt();
+
+	// Same format as StringView::toInt, read across segments
+	PbufReader reader(buf, offset);
+	bool started = false; // Sign or digit found
+	bool negative = false;
+	long value = 0;
+	for (int i = 0; i < len; i++)
+	{
+		char ch = reader.read();
+		if (!started && isspace((uint8_t)ch))
+			continue;
+		if (!started && (ch == '-' || ch == '+'))
+			negative = ch == '-';
+		else if (isdigit((uint8_t)ch))
+			value = value * 10 + (ch - '0');
+		else
+			break;
+		started = true;
+	}
+
+	return negative ? -value : value;
+}
+
+bool PbufSlice::isContiguous() const
+{
+	return buf != NULL && offset + len <= buf->len;
+}
+
+StringView PbufSlice::toStringView() const
+{
+	if (!isContiguous())
+		return StringView(NULL, 0);
+
+	return StringView((const char*)buf->payload + offset, len);
+}
+
+int PbufSlice::copyTo(char* dest, int size) const
+{
+	int count = min(size, len);
+	int copied = 0;
+	int from = offset;
+	for (pbuf* cur = buf; cur != NULL && copied < count; cur = cur->next)
+	{
+		int part = min((int)cur->len - from, count - copied);
+		memcpy(dest + copied, (const char*)cur->payload + from, part);
+		copied += part;
+		from = 0;
+	}
+
+	return copied;
+}
+
+bool PbufSlice::appendTo(String& str) const
+{
+	if (!str.reserve(str.length() + len))
+		return false;
+
+	int remaining = len;
+	int from = offset;
+	for (pbuf* cur = buf; cur != NULL && remaining > 0; cur = cur->next)
+	{
+		int count = min((int)cur->len - from, remaining);
+		str.concat((const char*)cur->payload + from, count);
+		remaining -= count;
+		from = 0;
+	}
+
+	return true;
+}
+
+String PbufSlice::toString() const
+{
+	String str;
+	appendTo(str);
+	return str;
+}
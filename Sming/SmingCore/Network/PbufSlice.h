@@ -0,0 +1,64 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_PBUFSLICE_H_
+#define _SMING_CORE_NETWORK_PBUFSLICE_H_
+
+#include "../../Wiring/WString.h"
+#include "../StringView.h"
+
+struct pbuf;
+
+/**
+ * @brief Range of received bytes in a pbuf chain, it may span several segments
+ *
+ * Allows inspecting received data (compare, search, number parsing) without copying it,
+ * comparison and search work across segment boundaries.
+ * Slice doesn't hold a reference to the pbuf, it's valid only while the chain is.
+ */
+class PbufSlice
+{
+public:
+	PbufSlice() : buf(NULL), offset(0), len(0) {}
+	PbufSlice(pbuf* buf, int startPos = 0, int length = -1); // -1: up to the chain end
+
+	__forceinline int length() const { return len; }
+	__forceinline bool isEmpty() const { return len == 0; }
+	char charAt(int index) const; // 0 outside of slice
+
+	bool equals(const StringView& str) const;
+	bool equalsIgnoreCase(const StringView& str) const;
+	bool startsWith(const StringView& prefix) const;
+	int compareTo(const StringView& str) const;
+	int indexOf(char ch, int fromIndex = 0) const;
+	int indexOf(const StringView& str, int fromIndex = 0) const;
+	int indexOfIgnoreCase(const StringView& str, int fromIndex = 0) const;
+
+	PbufSlice substring(int beginIndex) const { return substring(beginIndex, len); }
+	PbufSlice substring(int beginIndex, int endIndex) const;
+	PbufSlice trim() const; // Without leading and trailing white space
+
+	long toInt() const; // Decimal number with optional sign, 0 if there is none
+
+	// Data in a single segment can be used directly
+	bool isContiguous() const;
+	StringView toStringView() const; // Empty view with NULL data if not contiguous
+
+	int copyTo(char* dest, int size) const; // Returns number of copied bytes, dest isn't null terminated
+	bool appendTo(String& str) const;
+	String toString() const;
+
+private:
+	int find(const StringView& str, int fromIndex, bool ignoreCase) const;
+
+private:
+	pbuf* buf; // Segment with the first byte of slice
+	int offset; // Slice start in buf
+	int len;
+};
+
+#endif /* _SMING_CORE_NETWORK_PBUFSLICE_H_ */
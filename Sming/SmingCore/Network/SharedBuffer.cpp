@@ -0,0 +1,26 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "SharedBuffer.h"
+
+SharedBuffer* SharedBuffer::create(int size)
+{
+	// Data follow the header in the same allocation
+	SharedBuffer* buffer = (SharedBuffer*)malloc(sizeof(SharedBuffer) + size);
+	if (buffer == NULL)
+		return NULL;
+
+	buffer->length = size;
+	buffer->refCount = 1;
+	return buffer;
+}
+
+void SharedBuffer::unref()
+{
+	if (--refCount == 0)
+		free(this);
+}
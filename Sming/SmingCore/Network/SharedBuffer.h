@@ -0,0 +1,37 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_SHAREDBUFFER_H_
+#define _SMING_CORE_NETWORK_SHAREDBUFFER_H_
+
+#include "../Wiring/WiringFrameworkDependencies.h"
+
+/**
+ * @brief Reference counted block of data which can be sent by several connections without copying
+ *
+ * Created with one reference, each user calls ref() and unref() when done, memory is freed with the last reference.
+ */
+class SharedBuffer
+{
+public:
+	static SharedBuffer* create(int size); // NULL if out of memory
+
+	__forceinline uint8_t* data() { return (uint8_t*)(this + 1); }
+	__forceinline int size() { return length; }
+
+	__forceinline void ref() { refCount++; }
+	void unref();
+
+private:
+	SharedBuffer() {}
+
+private:
+	int length;
+	uint16_t refCount;
+};
+
+#endif /* _SMING_CORE_NETWORK_SHAREDBUFFER_H_ */
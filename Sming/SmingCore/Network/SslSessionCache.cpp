@@ -0,0 +1,125 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "SslSessionCache.h"
+
+#ifdef ENABLE_SSL
+
+#include "../Clock.h"
+
+SslSessionCacheClass SslSessionCache;
+
+SslSessionCacheClass::~SslSessionCacheClass()
+{
+	clear();
+}
+
+void SslSessionCacheClass::setSize(int size)
+{
+	this->size = size < 0 ? 0 : size;
+	while ((int)sessions.count() > this->size)
+	{
+		release(sessions[0]); // Oldest
+		sessions.remove(0);
+	}
+}
+
+void SslSessionCacheClass::setLifetime(int seconds)
+{
+	lifetime = seconds;
+	removeExpired();
+}
+
+void SslSessionCacheClass::clear()
+{
+	for (int i = 0; i < sessions.count(); i++)
+		release(sessions[i]);
+	sessions.clear();
+}
+
+SslCachedSession* SslSessionCacheClass::take(const String& hostname, uint16_t port, uint32_t options,
+		bool clientCert, const uint8_t* fingerprint)
+{
+	removeExpired();
+
+	for (int i = 0; i < sessions.count(); i++)
+	{
+		SslCachedSession* session = sessions[i];
+		if (session->port != port || session->options != options || session->clientCert != clientCert
+				|| session->hostname != hostname)
+			continue;
+
+		// Resumed session has no certificate, it must be verified with the same fingerprint before
+		if (session->hasFingerprint != (fingerprint != nullptr)
+				|| (fingerprint && memcmp(session->fingerprint, fingerprint, SSL_SESSION_FINGERPRINT_SIZE) != 0))
+			continue;
+
+		sessions.remove(i);
+		debugf("SSL: resuming session of %s:%d", hostname.c_str(), port);
+		return session;
+	}
+
+	return nullptr;
+}
+
+void SslSessionCacheClass::put(SslCachedSession* session)
+{
+	if (size == 0 || session->sessionIdSize == 0 || isExpired(session))
+	{
+		release(session);
+		return;
+	}
+
+	for (int i = 0; i < sessions.count(); i++)
+	{
+		SslCachedSession* cached = sessions[i];
+		if (cached->port == session->port && cached->options == session->options
+				&& cached->clientCert == session->clientCert && cached->hostname == session->hostname)
+		{
+			release(cached);
+			sessions.remove(i);
+			break;
+		}
+	}
+
+	if ((int)sessions.count() >= size)
+	{
+		release(sessions[0]);
+		sessions.remove(0);
+	}
+
+	sessions.add(session);
+}
+
+void SslSessionCacheClass::release(SslCachedSession* session)
+{
+	if (session == nullptr)
+		return;
+
+	if (session->context)
+		ssl_ctx_free(session->context);
+	delete session;
+}
+
+bool SslSessionCacheClass::isExpired(SslCachedSession* session)
+{
+	return millis() - session->created >= (unsigned long)lifetime * 1000;
+}
+
+void SslSessionCacheClass::removeExpired()
+{
+	for (int i = sessions.count() - 1; i >= 0; i--)
+	{
+		if (isExpired(sessions[i]))
+		{
+			release(sessions[i]);
+			sessions.remove(i);
+		}
+	}
+}
+
+#endif /* ENABLE_SSL */
@@ -0,0 +1,91 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_SSLSESSIONCACHE_H_
+#define _SMING_CORE_NETWORK_SSLSESSIONCACHE_H_
+
+#ifdef ENABLE_SSL
+
+#include "../../axtls-8266/compat/lwipr_compat.h"
+#include "../../Wiring/WString.h"
+#include "../../Wiring/WVector.h"
+
+// Sessions kept for reconnection, each holds its SSL context (~1-2KB of heap)
+#ifndef SSL_SESSION_CACHE_SIZE
+#define SSL_SESSION_CACHE_SIZE 2
+#endif
+
+// Seconds, servers usually forget sessions earlier
+#ifndef SSL_SESSION_CACHE_LIFETIME
+#define SSL_SESSION_CACHE_LIFETIME 3600
+#endif
+
+#define SSL_SESSION_FINGERPRINT_SIZE 20
+
+// Context and session id of a finished TLS connection, with the parameters it was made with
+struct SslCachedSession
+{
+	String hostname; // Or remote IP
+	uint16_t port = 0;
+	uint32_t options = 0;
+	bool clientCert = false;
+	bool hasFingerprint = false;
+	uint8_t fingerprint[SSL_SESSION_FINGERPRINT_SIZE];
+
+	SSLCTX* context = nullptr; // Master secret of the session is stored here
+	uint8_t sessionId[SSL_SESSION_ID_SIZE];
+	uint8_t sessionIdSize = 0;
+	unsigned long created = 0; // millis() of the full handshake
+};
+
+/**
+ * @brief Client TLS sessions for abbreviated handshakes on reconnect
+ *
+ * TcpConnection takes a session of the same host, port, options and fingerprint when it connects
+ * and puts it back when it's closed. axTLS resumes sessions by session id, which saves the
+ * certificate exchange and the RSA operations (several seconds on ESP8266).
+ */
+class SslSessionCacheClass
+{
+public:
+	~SslSessionCacheClass();
+
+	// Maximum of cached sessions, 0 disables the cache
+	void setSize(int size);
+	// Sessions older than lifetime (seconds) aren't offered anymore
+	void setLifetime(int seconds);
+	void clear();
+	__forceinline int getCount() { return sessions.count(); }
+
+	// Removes and returns matching session or nullptr, used by TcpConnection
+	SslCachedSession* take(const String& hostname, uint16_t port, uint32_t options, bool clientCert,
+			const uint8_t* fingerprint);
+	// Takes ownership of the session, replaces previous one of the same host
+	void put(SslCachedSession* session);
+	// Frees session and its context
+	static void release(SslCachedSession* session);
+
+private:
+	bool isExpired(SslCachedSession* session);
+	void removeExpired();
+
+private:
+	Vector<SslCachedSession*> sessions;
+	int size = SSL_SESSION_CACHE_SIZE;
+	int lifetime = SSL_SESSION_CACHE_LIFETIME;
+};
+
+/**	@brief	Global instance of TLS session cache
+ *	@note	Example:
+ *	@code	SslSessionCache.setSize(4);
+ *	@endcode
+ */
+extern SslSessionCacheClass SslSessionCache;
+
+#endif /* ENABLE_SSL */
+
+#endif /* _SMING_CORE_NETWORK_SSLSESSIONCACHE_H_ */
@@ -143,13 +143,7 @@ err_t TcpConnection::onConnected(err_t err)
 void TcpConnection::onError(err_t err)
 {
 #ifdef ENABLE_SSL
-	if(ssl) {
-//		ssl_ctx_free(sslContext);
-		ssl_free(ssl);
-		sslContext=nullptr;
-		ssl=nullptr;
-		sslConnected = false;
-	}
+	freeSsl();
 #endif
 	debugf("TCP connection error: %d", err);
 }
@@ -186,15 +180,14 @@ int TcpConnection::write(const char* data, int len, uint8_t apiflags /* = TCP_WR
    }
    else {
 #endif
-	   u16_t available = getAvailableWriteSize();
-	   if (available < len) {
-		   if (available == 0)
-			   return -1; // No memory
-		   else
-			   len = available;
-	   }
-	   err = tcp_write(tcp, data, len, apiflags);
-
+	   if (!canSend || tcp == NULL)
+		   return -1;
+	   if (len == 0)
+		   return 0;
+
+	   int accepted = transmit.write(tcp, data, len, apiflags);
+	   checkTransmitWatermarks();
+	   return (accepted > 0) ? accepted : -1; // No memory
 #ifdef ENABLE_SSL
    }
 #endif
@@ -265,29 +258,105 @@ int TcpConnection::write(IDataSourceStream* stream)
 	return total;
 }
 
+int TcpConnection::write(SharedBuffer* buffer, int offset, int len, uint8_t apiflags /* = 0*/)
+{
+#ifdef ENABLE_SSL
+	if (ssl)
+		return write((const char*)buffer->data() + offset, len, apiflags | TCP_WRITE_FLAG_COPY); // Encrypted anyway
+#endif
+	if (!canSend || tcp == NULL)
+		return -1;
+
+	int accepted = transmit.write(tcp, buffer, offset, len, apiflags);
+	checkTransmitWatermarks();
+	return (accepted > 0) ? accepted : -1;
+}
+
+int TcpConnection::write(const TcpDataSegment* segments, int count)
+{
+	int total = 0;
+	for (int i = 0; i < count; i++)
+		total += segments[i].length;
+
+#ifdef ENABLE_SSL
+	if (ssl)
+	{
+		for (int i = 0; i < count; i++)
+			if (write(segments[i].data, segments[i].length) < 0)
+				return -1;
+		return total;
+	}
+#endif
+	if (!canSend || tcp == NULL || total > getAvailableWriteSize() + transmit.getFreeSize())
+		return -1;
+
+	int accepted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		uint8_t flags = (i < count - 1) ? TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE : TCP_WRITE_FLAG_COPY;
+		accepted += transmit.write(tcp, segments[i].data, segments[i].length, flags);
+	}
+	checkTransmitWatermarks();
+
+	return accepted;
+}
+
+void TcpConnection::setTransmitQueueSize(int maxSize)
+{
+	transmit.setMaxSize(maxSize);
+}
+
+void TcpConnection::setTransmitWatermarks(int high, int low, TcpTransmitDelegate callback)
+{
+	transmitHighWatermark = high;
+	transmitLowWatermark = low;
+	transmitCallback = callback;
+}
+
+void TcpConnection::checkTransmitWatermarks()
+{
+	if (!transmitCallback)
+		return;
+
+	int queued = transmit.getQueuedSize();
+	if (!transmitFull && queued >= transmitHighWatermark && queued > 0)
+	{
+		transmitFull = true;
+		transmitCallback(*this, true);
+	}
+	else if (transmitFull && queued <= transmitLowWatermark)
+	{
+		transmitFull = false;
+		transmitCallback(*this, false);
+	}
+}
+
 void TcpConnection::close()
 {
 #ifdef ENABLE_SSL
-	if (ssl != nullptr) {
+	if (ssl != nullptr)
 		debugf("SSL: closing ...");
-//		ssl_ctx_free(sslContext);
-		ssl_free(ssl);
-		sslContext=nullptr;
-		ssl=nullptr;
-		sslConnected = false;
-		debugf("done\n");
-	}
+	freeSsl();
 #endif
 
-	if (tcp == NULL) return;
+	if (tcp == NULL)
+	{
+		transmit.clear();
+		return;
+	}
 	debugf("TCP connection closing");
 
 #ifdef ENABLE_SSL
 	axl_free(tcp);
 #endif
 
-	tcp_poll(tcp, staticOnPoll, 1);
-	tcp_arg(tcp, NULL); // reset pointer to close connection on next callback
+	if (!transmit.isCompleted())
+		closeWithPendingData();
+	else
+	{
+		tcp_poll(tcp, staticOnPoll, 1);
+		tcp_arg(tcp, NULL); // reset pointer to close connection on next callback
+	}
 	tcp = NULL;
 
 	hostname = "";
@@ -295,11 +364,132 @@ void TcpConnection::close()
 	checkSelfFree();
 }
 
+// Outgoing data of closed connection, kept until they are sent
+struct TcpClosingTransmit
+{
+	TcpClosingTransmit(TcpTransmitQueue&& queue) : transmit(static_cast<TcpTransmitQueue&&>(queue)) {}
+
+	TcpTransmitQueue transmit;
+	uint16_t polls = 0; // Since the last progress
+};
+
+#ifdef ENABLE_SSL
+void TcpConnection::freeSsl()
+{
+	// Only session of successful (and verified) handshake can be resumed later
+	bool keep = ssl && sslConnected && sslSession;
+	if (keep) {
+		sslSession->sessionIdSize = ssl_get_session_id_size(ssl);
+		memcpy(sslSession->sessionId, ssl_get_session_id(ssl), sslSession->sessionIdSize);
+	}
+
+	if (ssl) {
+		ssl_free(ssl); // Before its context
+		ssl = nullptr;
+	}
+
+	if (keep)
+		SslSessionCache.put(sslSession);
+	else if (sslSession)
+		SslSessionCacheClass::release(sslSession); // Frees sslContext
+	else if (sslContext)
+		ssl_ctx_free(sslContext);
+
+	sslSession = nullptr;
+	sslContext = nullptr;
+	sslConnected = false;
+}
+#endif
+
+#define TCP_CLOSING_MAX_POLLS 20 // Give up on unacknowledged data after ~10 seconds
+
+void TcpConnection::closeWithPendingData()
+{
+	// Connection object can't wait, queued data are sent and referenced buffers released later
+	TcpClosingTransmit* closing = new TcpClosingTransmit(static_cast<TcpTransmitQueue&&>(transmit));
+
+	tcp_arg(tcp, closing);
+	tcp_sent(tcp, staticReleaseOnSent);
+	tcp_recv(tcp, staticReleaseOnReceive);
+	tcp_err(tcp, staticReleaseOnError);
+	tcp_poll(tcp, staticReleaseOnPoll, 1);
+}
+
+err_t TcpConnection::staticReleaseOnSent(void *arg, tcp_pcb *tcp, uint16_t len)
+{
+	TcpClosingTransmit* closing = (TcpClosingTransmit*)arg;
+	if (closing == NULL)
+		return ERR_OK;
+
+	closing->polls = 0;
+	closing->transmit.acknowledge(len);
+	if (closing->transmit.sendQueued(tcp))
+		tcp_output(tcp);
+
+	if (closing->transmit.isCompleted())
+	{
+		delete closing;
+		closeTcpConnection(tcp);
+	}
+
+	return ERR_OK;
+}
+
+err_t TcpConnection::staticReleaseOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err)
+{
+	if (p != NULL)
+	{
+		tcp_recved(tcp, p->tot_len);
+		pbuf_free(p);
+	}
+
+	return ERR_OK;
+}
+
+err_t TcpConnection::staticReleaseOnPoll(void *arg, tcp_pcb *tcp)
+{
+	TcpClosingTransmit* closing = (TcpClosingTransmit*)arg;
+	if (closing == NULL)
+		return ERR_OK;
+
+	if (closing->transmit.sendQueued(tcp))
+		tcp_output(tcp);
+	if (++closing->polls < TCP_CLOSING_MAX_POLLS)
+		return ERR_OK;
+
+	debugf("TCP unsent data dropped");
+	delete closing;
+	tcp_err(tcp, NULL);
+	tcp_abort(tcp);
+	return ERR_ABRT;
+}
+
+void TcpConnection::staticReleaseOnError(void *arg, err_t err)
+{
+	// Connection is already freed
+	delete (TcpClosingTransmit*)arg;
+}
+
+void TcpConnection::pauseReceiving()
+{
+	receivePaused = true;
+}
+
+void TcpConnection::resumeReceiving()
+{
+	receivePaused = false;
+	if (tcp != NULL && receiveHeld > 0)
+		tcp_recved(tcp, receiveHeld);
+	receiveHeld = 0;
+}
+
 void TcpConnection::initialize(tcp_pcb* pcb)
 {
 	tcp = pcb;
 	sleep = 0;
 	canSend = true;
+	receivePaused = false; // Object can be reused for a new connection
+	receiveHeld = 0;
 #ifdef ENABLE_SSL
 	axl_init(10);
 #endif
@@ -393,26 +583,52 @@ err_t TcpConnection::staticOnConnected(void *arg, tcp_pcb *tcp, err_t err)
 			System.setCpuFrequency(eCF_160MHz); // For shorter waiting time, more power consumption.
 #endif
 			debugf("SSL: handshake start (%d ms)", millis());
-			con->sslContext = ssl_ctx_new(SSL_CONNECT_IN_PARTS | sslOptions, 1);
-
-			if (con->clientKeyCert.keyLength && con->clientKeyCert.certificateLength) {
-				// if we have client certificate -> try to use it.
-				if (ssl_obj_memory_load(con->sslContext, SSL_OBJ_RSA_KEY,
-						con->clientKeyCert.key, con->clientKeyCert.keyLength,
-						con->clientKeyCert.keyPassword) != SSL_OK) {
-					debugf("SSL: Unable to load client private key");
-				} else if (ssl_obj_memory_load(con->sslContext, SSL_OBJ_X509_CERT,
-						con->clientKeyCert.certificate,
-						con->clientKeyCert.certificateLength, NULL) != SSL_OK) {
-					debugf("SSL: Unable to load client certificate");
-				}
+			con->freeSsl(); // Previous connection
 
-				if(con->freeClientKeyCert) {
-					con->freeSslClientKeyCert();
+			// Session of the previous connection to the same server is resumed if possible
+			bool clientCert = con->clientKeyCert.keyLength && con->clientKeyCert.certificateLength;
+			String sessionHost = con->hostname.length() ? con->hostname : IPAddress(tcp->remote_ip).toString();
+			con->sslSession = SslSessionCache.take(sessionHost, tcp->remote_port, SSL_CONNECT_IN_PARTS | sslOptions,
+					clientCert, con->sslFingerprint);
+
+			if (con->sslSession) {
+				con->sslContext = con->sslSession->context;
+			}
+			else {
+				con->sslSession = new SslCachedSession();
+				con->sslSession->hostname = sessionHost;
+				con->sslSession->port = tcp->remote_port;
+				con->sslSession->options = SSL_CONNECT_IN_PARTS | sslOptions;
+				con->sslSession->clientCert = clientCert;
+				if (con->sslFingerprint) {
+					con->sslSession->hasFingerprint = true;
+					memcpy(con->sslSession->fingerprint, con->sslFingerprint, SSL_SESSION_FINGERPRINT_SIZE);
+				}
+				con->sslContext = ssl_ctx_new(SSL_CONNECT_IN_PARTS | sslOptions, 1);
+				con->sslSession->context = con->sslContext;
+
+				if (clientCert) {
+					// if we have client certificate -> try to use it.
+					if (ssl_obj_memory_load(con->sslContext, SSL_OBJ_RSA_KEY,
+							con->clientKeyCert.key, con->clientKeyCert.keyLength,
+							con->clientKeyCert.keyPassword) != SSL_OK) {
+						debugf("SSL: Unable to load client private key");
+					} else if (ssl_obj_memory_load(con->sslContext, SSL_OBJ_X509_CERT,
+							con->clientKeyCert.certificate,
+							con->clientKeyCert.certificateLength, NULL) != SSL_OK) {
+						debugf("SSL: Unable to load client certificate");
+					}
 				}
 			}
 
-			con->ssl = ssl_client_new(con->sslContext, clientfd, NULL, 0, con->hostname.c_str());
+			if(clientCert && con->freeClientKeyCert) {
+				con->freeSslClientKeyCert();
+			}
+
+			// Offered session id stays in sslSession to recognize resumption
+			SslCachedSession* session = con->sslSession;
+			con->ssl = ssl_client_new(con->sslContext, clientfd,
+					session->sessionIdSize ? session->sessionId : NULL, session->sessionIdSize, con->hostname.c_str());
 			if(ssl_handshake_status(con->ssl)!=SSL_OK) {
 				debugf("SSL: handshake is in progress...");
 				return SSL_OK;
@@ -472,7 +688,10 @@ err_t TcpConnection::staticOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err
 	//if (tcp != NULL && tcp->state == ESTABLISHED) // If active
 	/* We have taken the data. */
 	if (p != NULL) {
-		tcp_recved(tcp, p->tot_len);
+		if (con->receivePaused)
+			con->receiveHeld += p->tot_len; // Acknowledged in resumeReceiving()
+		else
+			tcp_recved(tcp, p->tot_len);
 	}
 	else {
 		debugf("TcpConnection::staticOnReceive: pbuf is NULL");
@@ -503,13 +722,19 @@ err_t TcpConnection::staticOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err
 
 		if (read_bytes == 0) {
 			if(!con->sslConnected && ssl_handshake_status(con->ssl) == SSL_OK) {
-				con->sslConnected = true;
 				debugf("SSL: Handshake done (%d ms).", millis());
 #ifndef SSL_SLOW_CONNECT
 				debugf("SSL: Switching back to 80 MHz");
 				System.setCpuFrequency(eCF_80MHz); // Preserve some CPU cycles
 #endif
-				if(con->sslFingerprint && ssl_match_fingerprint(con->ssl, con->sslFingerprint) != SSL_OK) {
+				// Server accepted offered session when it returns the same id
+				SslCachedSession* session = con->sslSession;
+				bool resumed = session && session->sessionIdSize
+						&& session->sessionIdSize == ssl_get_session_id_size(con->ssl)
+						&& memcmp(session->sessionId, ssl_get_session_id(con->ssl), session->sessionIdSize) == 0;
+
+				// No certificate is sent for resumed session, it was verified on the full handshake
+				if(!resumed && con->sslFingerprint && ssl_match_fingerprint(con->ssl, con->sslFingerprint) != SSL_OK) {
 					debugf("SSL: Certificate fingerprint does not match!");
 					con->close();
 					closeTcpConnection(tcp);
@@ -517,6 +742,14 @@ err_t TcpConnection::staticOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err
 					return ERR_ABRT;
 				}
 
+				if(resumed) {
+					debugf("SSL: Session resumed");
+				}
+				else if(session) {
+					session->created = millis();
+				}
+				con->sslConnected = true;
+
 				err_t res = con->onConnected(err);
 				con->checkSelfFree();
 
@@ -542,7 +775,8 @@ err_t TcpConnection::staticOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err
 	else
 	{
 		con->close();
-		closeTcpConnection(tcp);
+		if (tcp->callback_arg == NULL) // Not waiting for referenced data to be sent
+			closeTcpConnection(tcp);
 	}
 
 	con->checkSelfFree();
@@ -559,6 +793,11 @@ err_t TcpConnection::staticOnSent(void *arg, tcp_pcb *tcp, uint16_t len)
 	else
 		con->sleep = 0;
 
+	con->transmit.acknowledge(len);
+	if (con->transmit.sendQueued(tcp))
+		con->flush();
+	con->checkTransmitWatermarks();
+
 	err_t res = con->onSent(len);
 	con->checkSelfFree();
 	//debugf("<staticOnSent");
@@ -579,6 +818,11 @@ err_t TcpConnection::staticOnPoll(void *arg, tcp_pcb *tcp)
 	//	return ERR_OK;
 
 	con->sleep++;
+	if (con->tcp != NULL && con->transmit.sendQueued(con->tcp))
+	{
+		con->flush();
+		con->checkTransmitWatermarks();
+	}
 	err_t res = con->onPoll();
 	con->checkSelfFree();
 	//debugf("<staticOnPoll");
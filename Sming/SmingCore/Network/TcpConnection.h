@@ -10,10 +10,13 @@
 
 #ifdef ENABLE_SSL
 #include "../../axtls-8266/compat/lwipr_compat.h"
+#include "SslSessionCache.h"
 #endif
 
 #include "../Wiring/WiringFrameworkDependencies.h"
 #include "IPAddress.h"
+#include "TcpTransmitQueue.h"
+#include "../Delegate.h"
 
 
 #define NETWORK_DEBUG
@@ -37,6 +40,13 @@ class String;
 class IDataSourceStream;
 class IPAddress;
 
+// Part of data for scatter/gather write
+struct TcpDataSegment
+{
+	const char* data;
+	int length;
+};
+
 typedef struct {
 	uint8_t *key = NULL;
 	int keyLength = 0;
@@ -45,6 +55,11 @@ typedef struct {
 	int certificateLength = 0;
 } SSLKeyCertPair;
 
+class TcpConnection;
+
+// Transmit queue reached high watermark (full = true) or dropped under low watermark again
+typedef Delegate<void(TcpConnection& connection, bool full)> TcpTransmitDelegate;
+
 class TcpConnection
 {
 public:
@@ -60,13 +75,31 @@ public:
 	// return -1 on error
 	int writeString(const char* data, uint8_t apiflags = TCP_WRITE_FLAG_COPY);
 	int writeString(const String data, uint8_t apiflags = TCP_WRITE_FLAG_COPY);
-	// return -1 on error
+	// Data which don't fit in TCP send buffer are queued, returns accepted length or -1 if nothing was accepted
 	virtual int write(const char* data, int len, uint8_t apiflags = TCP_WRITE_FLAG_COPY); // flags: TCP_WRITE_FLAG_COPY, TCP_WRITE_FLAG_MORE
 	int write(IDataSourceStream* stream);
-	__forceinline uint16_t getAvailableWriteSize() { return (canSend && tcp) ? tcp_sndbuf(tcp) : 0; }
+	// Data are sent without copying, buffer is referenced until the remote side acknowledges them
+	int write(SharedBuffer* buffer, int offset, int len, uint8_t apiflags = 0);
+	// Scatter/gather write, all segments are accepted or none (returns -1)
+	int write(const TcpDataSegment* segments, int count);
+	// Space for immediate sending, nothing while transmit queue isn't empty
+	__forceinline uint16_t getAvailableWriteSize() { return (canSend && tcp && transmit.isEmpty()) ? tcp_sndbuf(tcp) : 0; }
 	void flush();
 
+	/// Transmit queue
+	void setTransmitQueueSize(int maxSize);
+	// Don't close connection from the callback
+	void setTransmitWatermarks(int high, int low, TcpTransmitDelegate callback);
+	__forceinline int getTransmitQueueLength() { return transmit.getQueuedSize(); }
+
 	void setTimeOut(uint16_t waitTimeOut);
+
+	// Flow control: while receiving is paused, incoming data is not acknowledged
+	// and the remote side stops sending once the TCP window is exhausted
+	void pauseReceiving();
+	void resumeReceiving();
+	__forceinline bool isReceivingPaused() { return receivePaused; }
+
 	IPAddress getRemoteIp()  { return (tcp == NULL) ? INADDR_NONE : IPAddress(tcp->remote_ip);};
 	uint16_t getRemotePort() { return (tcp == NULL) ? 0 : tcp->remote_port; };
 
@@ -126,6 +159,16 @@ protected:
 
 private:
 	inline void checkSelfFree() { if (tcp == NULL && autoSelfDestruct) delete this; }
+#ifdef ENABLE_SSL
+	void freeSsl();
+#endif
+
+	void checkTransmitWatermarks();
+	void closeWithPendingData();
+	static err_t staticReleaseOnSent(void *arg, tcp_pcb *tcp, uint16_t len);
+	static err_t staticReleaseOnReceive(void *arg, tcp_pcb *tcp, pbuf *p, err_t err);
+	static err_t staticReleaseOnPoll(void *arg, tcp_pcb *tcp);
+	static void staticReleaseOnError(void *arg, err_t err);
 
 protected:
 	tcp_pcb *tcp;
@@ -133,9 +176,17 @@ protected:
 	uint16_t timeOut;
 	bool canSend;
 	bool autoSelfDestruct;
+	bool receivePaused = false;
+	uint16_t receiveHeld = 0; // Received but not yet acknowledged bytes
+	TcpTransmitQueue transmit; // Not used with SSL
+	TcpTransmitDelegate transmitCallback;
+	int transmitHighWatermark = 0;
+	int transmitLowWatermark = 0;
+	bool transmitFull = false;
 #ifdef ENABLE_SSL
 	SSL *ssl = nullptr;
 	SSLCTX *sslContext = nullptr;
+	SslCachedSession *sslSession = nullptr; // Returned to SslSessionCache on close
 #endif
 	boolean useSsl = false;
 	uint8_t *sslFingerprint=null;
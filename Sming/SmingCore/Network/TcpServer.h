@@ -24,6 +24,7 @@ public:
 public:
 	virtual bool listen(int port);
 	void setTimeOut(uint16_t waitTimeOut);
+	__forceinline uint16_t getTimeOut() { return timeOut; }
 
 protected:
 	// Overload this method in your derived class!
@@ -0,0 +1,151 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "TcpTransmitQueue.h"
+
+TcpTransmitQueue::TcpTransmitQueue(TcpTransmitQueue&& other)
+	: queue(static_cast<Vector<TcpQueuedData>&&>(other.queue)),
+	  references(static_cast<Vector<TcpBufferReference>&&>(other.references))
+{
+	written = other.written;
+	acknowledged = other.acknowledged;
+	queuedSize = other.queuedSize;
+	maxSize = other.maxSize;
+	other.queuedSize = 0;
+}
+
+TcpTransmitQueue::~TcpTransmitQueue()
+{
+	clear();
+}
+
+void TcpTransmitQueue::clear()
+{
+	for (unsigned i = 0; i < queue.count(); i++)
+		queue[i].buffer->unref();
+	for (unsigned i = 0; i < references.count(); i++)
+		references[i].buffer->unref();
+	queue.clear();
+	references.clear();
+	queuedSize = 0;
+}
+
+int TcpTransmitQueue::write(tcp_pcb* tcp, const char* data, int len, uint8_t apiflags)
+{
+	int done = 0;
+	if (isEmpty())
+		done = writeDirect(tcp, data, len, apiflags | TCP_WRITE_FLAG_COPY);
+
+	int rest = min(len - done, getFreeSize());
+	if (rest > 0)
+	{
+		SharedBuffer* buffer = SharedBuffer::create(rest);
+		if (buffer != NULL)
+		{
+			memcpy(buffer->data(), data + done, rest);
+			enqueue(buffer, 0, rest);
+			buffer->unref(); // Queue has its own reference
+			done += rest;
+		}
+	}
+
+	return done;
+}
+
+int TcpTransmitQueue::write(tcp_pcb* tcp, SharedBuffer* buffer, int offset, int len, uint8_t apiflags)
+{
+	int done = 0;
+	if (isEmpty())
+	{
+		done = writeDirect(tcp, (const char*)buffer->data() + offset, len, apiflags & ~TCP_WRITE_FLAG_COPY);
+		if (done > 0)
+			reference(buffer);
+	}
+
+	int rest = min(len - done, getFreeSize());
+	if (rest > 0)
+	{
+		enqueue(buffer, offset + done, rest);
+		done += rest;
+	}
+
+	return done;
+}
+
+bool TcpTransmitQueue::sendQueued(tcp_pcb* tcp)
+{
+	bool sent = false;
+	while (queue.count() > 0)
+	{
+		TcpQueuedData& item = queue[0];
+		int res = writeDirect(tcp, (const char*)item.buffer->data() + item.offset, item.length, 0);
+		if (res == 0)
+			break; // No space yet
+
+		reference(item.buffer);
+		sent = true;
+		item.offset += res;
+		item.length -= res;
+		queuedSize -= res;
+		if (item.length > 0)
+			break;
+
+		item.buffer->unref();
+		queue.remove(0);
+	}
+
+	return sent;
+}
+
+void TcpTransmitQueue::acknowledge(uint16_t len)
+{
+	acknowledged += len;
+	while (references.count() > 0 && (int32_t)(acknowledged - references[0].end) >= 0)
+	{
+		references[0].buffer->unref();
+		references.remove(0);
+	}
+}
+
+int TcpTransmitQueue::writeDirect(tcp_pcb* tcp, const char* data, int len, uint8_t apiflags)
+{
+	int available = tcp_sndbuf(tcp);
+	if (len > available)
+		len = available;
+	if (len <= 0)
+		return 0;
+
+	// Can fail with ERR_MEM when too many segments are queued
+	if (tcp_write(tcp, data, len, apiflags) != ERR_OK)
+		return 0;
+
+	written += len;
+	return len;
+}
+
+void TcpTransmitQueue::reference(SharedBuffer* buffer)
+{
+	// Continuous parts of the same buffer need one reference
+	int last = references.count() - 1;
+	if (last >= 0 && references[last].buffer == buffer)
+	{
+		references[last].end = written;
+		return;
+	}
+
+	buffer->ref();
+	TcpBufferReference item = { buffer, written };
+	references.add(item);
+}
+
+void TcpTransmitQueue::enqueue(SharedBuffer* buffer, int offset, int len)
+{
+	buffer->ref();
+	TcpQueuedData item = { buffer, offset, len };
+	queue.add(item);
+	queuedSize += len;
+}
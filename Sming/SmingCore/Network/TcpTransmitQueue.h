@@ -0,0 +1,79 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_TCPTRANSMITQUEUE_H_
+#define _SMING_CORE_NETWORK_TCPTRANSMITQUEUE_H_
+
+#include "../Wiring/WiringFrameworkDependencies.h"
+#include "../../Wiring/WVector.h"
+#include "SharedBuffer.h"
+
+// Default limit of data waiting for space in TCP send buffer
+#ifndef NETWORK_TRANSMIT_QUEUE_SIZE
+#define NETWORK_TRANSMIT_QUEUE_SIZE 2048
+#endif
+
+// Shared buffer data written to TCP without copying, referenced until acknowledged
+struct TcpBufferReference
+{
+	SharedBuffer* buffer;
+	uint32_t end; // Position after its last byte in the sent data
+};
+
+struct TcpQueuedData
+{
+	SharedBuffer* buffer;
+	int offset;
+	int length;
+};
+
+/**
+ * @brief Outgoing data of TCP connection which aren't acknowledged yet
+ *
+ * Data which don't fit in TCP send buffer are queued (up to maximum size) and written when space is freed.
+ * Queued data are kept in shared buffers, so they are copied only once.
+ */
+class TcpTransmitQueue
+{
+public:
+	TcpTransmitQueue() {}
+	TcpTransmitQueue(TcpTransmitQueue&& other);
+	~TcpTransmitQueue();
+
+	// Return number of accepted (written or queued) bytes
+	int write(tcp_pcb* tcp, const char* data, int len, uint8_t apiflags);
+	int write(tcp_pcb* tcp, SharedBuffer* buffer, int offset, int len, uint8_t apiflags);
+
+	bool sendQueued(tcp_pcb* tcp); // Returns true if some data were written
+	void acknowledge(uint16_t len);
+	void clear();
+
+	void setMaxSize(int size) { maxSize = size; }
+	__forceinline int getQueuedSize() { return queuedSize; }
+	__forceinline int getFreeSize() { return (maxSize > queuedSize) ? maxSize - queuedSize : 0; }
+	__forceinline bool isEmpty() { return queue.count() == 0; }
+	__forceinline bool isCompleted() { return queue.count() == 0 && references.count() == 0; }
+
+private:
+	int writeDirect(tcp_pcb* tcp, const char* data, int len, uint8_t apiflags);
+	void reference(SharedBuffer* buffer);
+	void enqueue(SharedBuffer* buffer, int offset, int len);
+
+	// Only moving is allowed
+	TcpTransmitQueue(const TcpTransmitQueue& other);
+	TcpTransmitQueue& operator=(const TcpTransmitQueue& other);
+
+private:
+	Vector<TcpQueuedData> queue;
+	Vector<TcpBufferReference> references;
+	uint32_t written = 0;
+	uint32_t acknowledged = 0;
+	int queuedSize = 0;
+	int maxSize = NETWORK_TRANSMIT_QUEUE_SIZE;
+};
+
+#endif /* _SMING_CORE_NETWORK_TCPTRANSMITQUEUE_H_ */
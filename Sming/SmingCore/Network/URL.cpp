@@ -67,7 +67,7 @@ URL::URL(String urlString)
 		portStart++;
 		Port = urlString.substring(portStart, portEnd).toInt();
 	}
-	else if(Protocol == HTTPS_URL_PROTOCOL) {
+	else if(Protocol == HTTPS_URL_PROTOCOL || Protocol == WEBSOCKET_SECURE_URL_PROTOCOL) {
 		Port = 443;
 	}
 	else {
@@ -12,6 +12,8 @@
 
 #define DEFAULT_URL_PROTOCOL "http"
 #define HTTPS_URL_PROTOCOL "https"
+#define WEBSOCKET_URL_PROTOCOL "ws"
+#define WEBSOCKET_SECURE_URL_PROTOCOL "wss"
 
 class URL
 {
@@ -80,11 +80,14 @@ namespace HttpStatusCode
 	static const char* OK = "200 OK";
 	static const char* SwitchingProtocols = "101 Switching Protocols";
 	static const char* Found = "302 Found";
+	static const char* NotModified = "304 Not Modified";
 
 	static const char* BadRequest = "400 Bad Request";
 	static const char* NotFound = "404 Not Found";
 	static const char* Forbidden = "403 Forbidden";
 	static const char* Unauthorized = "401 Unauthorized";
+	static const char* MethodNotAllowed = "405 Method Not Allowed";
+	static const char* LengthRequired = "411 Length Required";
 
 	static const char* NotImplemented = "501 Not Implemented";
 };
@@ -6,13 +6,16 @@
  ****/
 
 #include "WebSocket.h"
+#include "HttpServer.h"
 #include "../../Services/WebHelpers/aw-sha1.h"
 #include "../../Services/WebHelpers/base64.h"
+#include "../../Services/WebHelpers/deflate.h"
 #include "../../Services/CommandProcessing/CommandExecutor.h"
 
-WebSocket::WebSocket(HttpServerConnection* conn)
+WebSocket::WebSocket(HttpServerConnection* conn, HttpServer* server) : WebSocketFrameParser(true)
 {
 	connection = conn;
+	this->server = server;
 }
 
 WebSocket::~WebSocket()
@@ -21,16 +24,18 @@ WebSocket::~WebSocket()
 	{
 		delete commandExecutor;
 	}
+	for (unsigned i = 0; i < sendQueue.count(); i++)
+		sendQueue[i]->unref();
 }
 
 bool WebSocket::initialize(HttpRequest& request, HttpResponse& response)
 {
-	String version = request.getHeader("Sec-WebSocket-Version");
+	String version = request.getHeader(F("sec-websocket-version"));
 	version.trim();
 	if (version.toInt() != 13) // 1.3
 		return false;
 
-	String hash = request.getHeader("Sec-WebSocket-Key");
+	String hash = request.getHeader(F("sec-websocket-key"));
 	hash.trim();
 	hash = hash + secret;
 	unsigned char data[SHA1_SIZE];
@@ -38,20 +43,223 @@ bool WebSocket::initialize(HttpRequest& request, HttpResponse& response)
 	sha1(data, hash.c_str(), hash.length());
 	base64_encode(SHA1_SIZE, data, SHA1_SIZE * 4, secure);
 	response.switchingProtocols();
-	response.setHeader("Connection", "Upgrade");
-	response.setHeader("Upgrade", "websocket");
-	response.setHeader("Sec-WebSocket-Accept", secure);
+	response.setHeader(F("Connection"), "Upgrade");
+	response.setHeader(F("Upgrade"), "websocket");
+	response.setHeader(F("Sec-WebSocket-Accept"), secure);
+
+	if (server->wsDeflateBits != 0)
+	{
+		// First acceptable offer wins
+		String offers = request.getHeader(F("sec-websocket-extensions"));
+		int pos = 0;
+		while (pos < (int)offers.length() && deflateBits == 0)
+		{
+			int end = offers.indexOf(',', pos);
+			if (end < 0)
+				end = offers.length();
+			deflateBits = acceptDeflateOffer(offers.substring(pos, end), server->wsDeflateBits);
+			pos = end + 1;
+		}
+	}
+
+	if (deflateBits != 0)
+	{
+		// Every message is compressed on its own, no history is kept
+		response.setHeader(F("Sec-WebSocket-Extensions"),
+				String(F("permessage-deflate; server_no_context_takeover; client_no_context_takeover; server_max_window_bits="))
+				+ deflateBits);
+		setExtensionBits(WS_FRAME_RSV1);
+		debugf("WS permessage-deflate, window bits %d", deflateBits);
+	}
+
 	return true;
 }
 
+uint8_t WebSocket::acceptDeflateOffer(const String& offer, uint8_t maxBits)
+{
+	// permessage-deflate; param; param=value
+	int pos = offer.indexOf(';');
+	String name = offer.substring(0, (pos < 0) ? offer.length() : pos);
+	name.trim();
+	if (!name.equalsIgnoreCase(F("permessage-deflate")))
+		return 0;
+
+	uint8_t bits = maxBits;
+	uint8_t found = 0; // Each parameter is allowed once
+	while (pos >= 0)
+	{
+		int end = offer.indexOf(';', pos + 1);
+		String param = offer.substring(pos + 1, (end < 0) ? offer.length() : end);
+		pos = end;
+
+		String value;
+		int eq = param.indexOf('=');
+		if (eq >= 0)
+		{
+			value = param.substring(eq + 1);
+			value.trim();
+			if (value.length() >= 2 && value[0] == '"' && value[value.length() - 1] == '"')
+				value = value.substring(1, value.length() - 1);
+			param = param.substring(0, eq);
+		}
+		param.trim();
+
+		int windowBits = value.toInt();
+		bool validBits = windowBits >= 8 && windowBits <= 15;
+		uint8_t flag;
+		if (param == "server_no_context_takeover" && eq < 0)
+			flag = 0x01;
+		else if (param == "client_no_context_takeover" && eq < 0)
+			flag = 0x02;
+		else if (param == "server_max_window_bits" && validBits)
+		{
+			flag = 0x04;
+			if (windowBits < bits)
+				bits = windowBits;
+		}
+		else if (param == "client_max_window_bits" && (eq < 0 || validBits))
+			flag = 0x08; // Whole messages are inflated, any window is fine
+		else
+			return 0; // Unknown parameter, decline this offer
+
+		if (found & flag)
+			return 0;
+		found |= flag;
+	}
+
+	return bits;
+}
+
 void WebSocket::send(const char* message, int length, wsFrameType type)
 {
-	uint8_t frameHeader[16] = {0};
-	size_t headSize = sizeof(frameHeader);
-	wsMakeFrame(nullptr, length, frameHeader, &headSize, type);
-	connection->write((char*)frameHeader, headSize, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE);
-	connection->write(message, length, TCP_WRITE_FLAG_COPY);
-	connection->flush();
+	SharedBuffer* frame = makeFrame(message, length, type, deflateBits);
+	if (frame == NULL)
+	{
+		debugf("WS no memory for frame");
+		return;
+	}
+
+	queueFrame(frame);
+	frame->unref();
+}
+
+SharedBuffer* WebSocket::makeFrame(const char* data, int length, wsFrameType type, uint8_t deflateBits)
+{
+	if (deflateBits != 0 && (type & 0x08) == 0 && length >= WEBSOCKET_DEFLATE_MIN_SIZE)
+	{
+		// Compressed data must be shorter, otherwise message goes as is
+		uint8_t* packed = (uint8_t*)malloc(length);
+		if (packed != NULL)
+		{
+			int packedLength = raw_deflate((const uint8_t*)data, length, packed, length, deflateBits, 0);
+			SharedBuffer* frame = NULL;
+			if (packedLength > 0)
+				frame = buildFrame(packed, packedLength, 0x80 | WS_FRAME_RSV1 | type);
+			free(packed);
+			if (frame != NULL)
+				return frame;
+		}
+	}
+
+	return buildFrame((const uint8_t*)data, length, 0x80 | type);
+}
+
+SharedBuffer* WebSocket::buildFrame(const uint8_t* payload, int length, uint8_t firstByte)
+{
+	// Server frames aren't masked
+	uint8_t header[10];
+	int headerLength = 2;
+	header[0] = firstByte;
+	if (length <= 125)
+		header[1] = length;
+	else if (length <= 0xFFFF)
+	{
+		header[1] = 126;
+		header[2] = length >> 8;
+		header[3] = length;
+		headerLength = 4;
+	}
+	else
+	{
+		header[1] = 127;
+		memset(&header[2], 0, 4);
+		header[6] = length >> 24;
+		header[7] = length >> 16;
+		header[8] = length >> 8;
+		header[9] = length;
+		headerLength = 10;
+	}
+
+	SharedBuffer* frame = SharedBuffer::create(headerLength + length);
+	if (frame == NULL)
+		return NULL;
+
+	memcpy(frame->data(), header, headerLength);
+	memcpy(frame->data() + headerLength, payload, length);
+	return frame;
+}
+
+bool WebSocket::queueFrame(SharedBuffer* frame)
+{
+	bool control = (frame->data()[0] & 0x08) != 0;
+	if (closing)
+		return false; // Nothing can follow close frame
+
+	if (!control && sendQueue.count() >= WEBSOCKET_SEND_QUEUE_SIZE)
+	{
+		if (server->wsQueuePolicy == eWSQP_Close)
+		{
+			debugf("WS client is too slow, closing");
+			close(); // Socket is removed
+			return false;
+		}
+
+		// Frame being written and control frames stay
+		int drop = -1;
+		if (server->wsQueuePolicy == eWSQP_DropOldest)
+			for (unsigned i = (sendQueuePos > 0) ? 1 : 0; i < sendQueue.count() && drop == -1; i++)
+				if ((sendQueue[i]->data()[0] & 0x08) == 0)
+					drop = i;
+
+		if (drop == -1)
+		{
+			debugf("WS send queue full, frame dropped");
+			return false;
+		}
+
+		debugf("WS send queue full, oldest frame dropped");
+		sendQueue[drop]->unref();
+		sendQueue.remove(drop);
+	}
+
+	frame->ref();
+	sendQueue.add(frame);
+	sendQueued();
+	return true;
+}
+
+void WebSocket::sendQueued()
+{
+	bool written = false;
+	while (sendQueue.count() > 0)
+	{
+		SharedBuffer* frame = sendQueue[0];
+		int res = connection->write(frame, sendQueuePos, frame->size() - sendQueuePos, TCP_WRITE_FLAG_MORE);
+		if (res <= 0)
+			break; // Will continue when some data are sent
+
+		written = true;
+		sendQueuePos += res;
+		if (sendQueuePos < frame->size())
+			break;
+
+		frame->unref();
+		sendQueue.remove(0);
+		sendQueuePos = 0;
+	}
+
+	if (written)
+		connection->flush();
 }
 
 void WebSocket::sendString(const String& message)
@@ -74,5 +282,126 @@ void WebSocket::enableCommand()
 
 void WebSocket::close()
 {
-	connection->close();
+	sendClose(WS_CLOSE_NORMAL);
+	if (!processing && !removed)
+		connection->close(); // Otherwise connection is closed when received data are processed, or already is
+}
+
+void WebSocket::sendClose(uint16_t code)
+{
+	if (closing)
+		return;
+
+	uint8_t status[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+	send((char*)status, sizeof(status), WS_CLOSING_FRAME);
+	closing = true;
+}
+
+bool WebSocket::processFrames(pbuf* buf)
+{
+	processing = true;
+	if (!parse(buf) && getParserState() == eWSPS_Failed)
+		sendClose(getErrorCode());
+	processing = false;
+
+	return !closing;
+}
+
+bool WebSocket::onMessageData(wsFrameType type, uint8_t* data, size_t size, bool messageEnd)
+{
+	bool compressed = (getMessageExtensionBits() & WS_FRAME_RSV1) != 0;
+	if (type == WS_BINARY_FRAME && server->wsBinaryStream && !compressed)
+	{
+		// Large binary data are never buffered
+		server->wsBinaryStream(*this, data, size, messageEnd);
+		return !closing;
+	}
+
+	bool handled = (type == WS_TEXT_FRAME) ? (server->wsMessage || commandExecutor)
+			: (server->wsBinary || server->wsBinaryStream);
+	if (!handled)
+		return true; // Nobody is interested, drop it
+
+	if (messageEnd && message.length() == 0)
+	{
+		// Whole message is in one segment
+		if (compressed)
+			return inflateMessage(type, data, size);
+		deliverMessage(type, data, size);
+		return !closing;
+	}
+
+	if (message.length() + size > WEBSOCKET_MAX_MESSAGE_SIZE || !message.concat((const char*)data, size))
+	{
+		debugf("WS message is too big");
+		message = String();
+		sendClose(WS_CLOSE_TOO_BIG);
+		return false;
+	}
+
+	if (messageEnd)
+	{
+		String completed = static_cast<String&&>(message);
+		message = String();
+		if (compressed)
+			return inflateMessage(type, (const uint8_t*)completed.c_str(), completed.length());
+		deliverMessage(type, (uint8_t*)&completed[0], completed.length());
+	}
+
+	return !closing;
+}
+
+bool WebSocket::inflateMessage(wsFrameType type, const uint8_t* data, size_t size)
+{
+	uint8_t* inflated;
+	int res = raw_inflate(data, size, &inflated, WEBSOCKET_MAX_MESSAGE_SIZE);
+	if (res < 0)
+	{
+		debugf("WS inflate failed: %d", res);
+		sendClose((res == -1) ? WS_CLOSE_INVALID_DATA : WS_CLOSE_TOO_BIG);
+		return false;
+	}
+
+	deliverMessage(type, inflated, res);
+	free(inflated);
+	return !closing;
+}
+
+void WebSocket::deliverMessage(wsFrameType type, uint8_t* data, size_t size)
+{
+	if (type == WS_BINARY_FRAME)
+	{
+		// Stream handler gets only compressed messages here, in one part
+		if (server->wsBinaryStream)
+			server->wsBinaryStream(*this, data, size, true);
+		else
+			server->wsBinary(*this, data, size);
+		return;
+	}
+
+	String msg((const char*)data, size);
+	debugf("WS: %s", msg.c_str());
+	if (server->wsMessage)
+		server->wsMessage(*this, msg);
+	if (commandExecutor)
+		commandExecutor->executorReceive(msg + "\r");
+}
+
+bool WebSocket::onControlFrame(wsFrameType type, const uint8_t* data, size_t size)
+{
+	if (type == WS_PING_FRAME)
+	{
+		if (!closing)
+			send((const char*)data, size, WS_PONG_FRAME);
+	}
+	else if (type == WS_CLOSING_FRAME)
+	{
+		// Answer with the same status and close connection
+		debugf("WS close frame received");
+		uint16_t code = (size >= 2) ? (data[0] << 8) | data[1] : WS_CLOSE_NORMAL;
+		sendClose(code);
+		return false;
+	}
+
+	return true;
 }
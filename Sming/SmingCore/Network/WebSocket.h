@@ -10,19 +10,38 @@
 
 #include "TcpServer.h"
 #include "HttpServerConnection.h"
+#include "WebSocketFrameParser.h"
 #include "../../Wiring/WHashMap.h"
 #include "../../Wiring/WVector.h"
 #include "../Delegate.h"
 #include "../../Services/cWebsocket/websocket.h"
 
+// Frames waiting for space in TCP send buffer, more are handled by WebSocketQueuePolicy
+#ifndef WEBSOCKET_SEND_QUEUE_SIZE
+#define WEBSOCKET_SEND_QUEUE_SIZE 8
+#endif
+
+// Shorter messages aren't compressed with permessage-deflate
+#ifndef WEBSOCKET_DEFLATE_MIN_SIZE
+#define WEBSOCKET_DEFLATE_MIN_SIZE 64
+#endif
+
+// What to do with a new frame for client which doesn't read fast enough
+enum WebSocketQueuePolicy
+{
+	eWSQP_DropOldest = 0, // Client misses older frames (right for live data)
+	eWSQP_DropNewest,
+	eWSQP_Close
+};
+
 class HttpServer;
 class CommandExecutor;
 
-class WebSocket
+class WebSocket : protected WebSocketFrameParser
 {
 	friend class HttpServer;
 public:
-	WebSocket(HttpServerConnection* conn);
+	WebSocket(HttpServerConnection* conn, HttpServer* server);
 	~WebSocket();
 
 	virtual void send(const char* message, int length, wsFrameType type = WS_TEXT_FRAME);
@@ -31,13 +50,49 @@ public:
 	void enableCommand();
 	void close();
 
+	__forceinline int getSendQueueLength() { return sendQueue.count(); }
+	// Window bits of permessage-deflate extension, 0 if it wasn't negotiated
+	__forceinline uint8_t getDeflateWindowBits() { return deflateBits; }
+
+	// Frame with header and payload, shared by all sockets it is sent to.
+	// Data messages are compressed when deflateBits is set, unless it doesn't make them shorter
+	static SharedBuffer* makeFrame(const char* data, int length, wsFrameType type, uint8_t deflateBits = 0);
+
 protected:
 	bool initialize(HttpRequest &request, HttpResponse &response);
 	bool is(HttpServerConnection* conn) { return connection == conn; };
+	// Returns false when the connection must be closed
+	bool processFrames(pbuf* buf);
+	// Frame is referenced until it is sent
+	bool queueFrame(SharedBuffer* frame);
+	void sendQueued();
+
+	virtual bool onMessageData(wsFrameType type, uint8_t* data, size_t size, bool messageEnd);
+	virtual bool onControlFrame(wsFrameType type, const uint8_t* data, size_t size);
+
+private:
+	void sendClose(uint16_t code);
+	void deliverMessage(wsFrameType type, uint8_t* data, size_t size);
+	bool inflateMessage(wsFrameType type, const uint8_t* data, size_t size);
+	static SharedBuffer* buildFrame(const uint8_t* payload, int length, uint8_t firstByte);
+	// Window bits for sent messages or 0 if offer can't be accepted
+	static uint8_t acceptDeflateOffer(const String& offer, uint8_t maxBits);
 
 private:
 	HttpServerConnection* connection;
+	HttpServer* server;
 	CommandExecutor* commandExecutor = nullptr;
+	String message; // Fragmented message or message split over several segments
+	bool processing = false; // Frames are being parsed, closing must wait
+	bool closing = false; // Close frame was sent
+	bool removed = false; // Connection is closed, server deletes the socket later
+	uint8_t deflateBits = 0; // Negotiated permessage-deflate window for sent messages
+	Vector<SharedBuffer*, WEBSOCKET_SEND_QUEUE_SIZE> sendQueue;
+	int sendQueuePos = 0; // Already written part of the first frame
+
+	// Command executor is owned
+	WebSocket(const WebSocket& other);
+	WebSocket& operator=(const WebSocket& other);
 };
 
 #endif /* SMINGCORE_NETWORK_WEBSOCKET_H_ */
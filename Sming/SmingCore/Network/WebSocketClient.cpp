@@ -0,0 +1,408 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "WebSocketClient.h"
+#include "URL.h"
+#include "PbufSlice.h"
+#include "../../Services/WebHelpers/aw-sha1.h"
+#include "../../Services/WebHelpers/base64.h"
+#include "espinc/peri.h"
+
+WebSocketClient::WebSocketClient() : TcpClient(false), WebSocketFrameParser(false)
+{
+}
+
+WebSocketClient::~WebSocketClient()
+{
+	pingTimer.stop();
+	reconnectTimer.stop();
+}
+
+bool WebSocketClient::connect(String url, uint32_t sslOptions /* = 0 */)
+{
+	URL uri(url);
+	if (uri.Protocol != WEBSOCKET_URL_PROTOCOL && uri.Protocol != WEBSOCKET_SECURE_URL_PROTOCOL)
+	{
+		debugf("WS client: unsupported URL %s", url.c_str());
+		return false;
+	}
+
+	if (getConnectionState() != eTCS_Ready)
+	{
+		stopped = true; // No reconnect from closing
+		TcpClient::close();
+		debugf("WS client closed previous connection");
+	}
+
+	host = uri.Host;
+	port = uri.Port;
+	path = uri.getPathWithQuery();
+	secure = uri.Protocol == WEBSOCKET_SECURE_URL_PROTOCOL;
+	this->sslOptions = sslOptions;
+	stopped = false;
+
+	start();
+	return state == eWSCS_Connecting;
+}
+
+void WebSocketClient::start()
+{
+	reconnectTimer.stop();
+	WebSocketFrameParser::reset();
+	response = String();
+	message = String();
+
+	// Random key, server proves the handshake with its hash
+	uint8_t nonce[16];
+	for (int i = 0; i < (int)sizeof(nonce); i += 4)
+	{
+		uint32_t value = RANDOM_REG32;
+		memcpy(&nonce[i], &value, 4);
+	}
+	char encoded[25];
+	base64_encode(sizeof(nonce), nonce, sizeof(encoded), encoded);
+	key = encoded;
+
+	state = eWSCS_Connecting;
+	if (!TcpClient::connect(host, port, secure, sslOptions))
+	{
+		debugf("WS client: can't connect to %s", host.c_str());
+		TcpClient::close(); // Reconnect is scheduled
+	}
+}
+
+void WebSocketClient::disconnect()
+{
+	stopped = true;
+	reconnectTimer.stop();
+	if (state == eWSCS_Open)
+		sendClose(WS_CLOSE_NORMAL);
+	else if (state != eWSCS_Ready)
+		TcpClient::close();
+}
+
+err_t WebSocketClient::onConnected(err_t err)
+{
+	if (err == ERR_OK)
+	{
+		String request = "GET " + path + " HTTP/1.1\r\n";
+		request += "Host: " + host + ":" + String(port) + "\r\n";
+		request += "Upgrade: websocket\r\n";
+		request += "Connection: Upgrade\r\n";
+		request += "Sec-WebSocket-Key: " + key + "\r\n";
+		request += "Sec-WebSocket-Version: 13\r\n\r\n";
+		TcpClient::sendString(request);
+	}
+
+	// Request is pushed by ready to send callback
+	return TcpClient::onConnected(err);
+}
+
+err_t WebSocketClient::onReceive(pbuf *buf)
+{
+	if (buf == NULL)
+	{
+		// Disconnected, close it
+		TcpClient::onReceive(buf);
+		return ERR_OK;
+	}
+
+	pingSent = false; // Connection is alive
+
+	if (state == eWSCS_Connecting)
+	{
+		if (!processHandshake(buf))
+		{
+			TcpClient::close();
+			return ERR_OK;
+		}
+	}
+	else if (!parse(buf) && getParserState() == eWSPS_Failed)
+		sendClose(getErrorCode()); // Connection is closed when close frame is sent
+
+	if (state == eWSCS_Ready)
+		return ERR_OK; // Closed by callback
+
+	// Fire ReadyToSend callback
+	TcpConnection::onReceive(buf);
+	return ERR_OK;
+}
+
+bool WebSocketClient::processHandshake(pbuf* buf)
+{
+	int searchFrom = max((int)response.length() - 3, 0);
+	PbufSlice(buf).appendTo(response);
+
+	int end = response.indexOf("\r\n\r\n", searchFrom);
+	if (end < 0)
+	{
+		if (response.length() <= WEBSOCKET_CLIENT_MAX_HEADER_SIZE)
+			return true; // Wait for the rest
+		debugf("WS client: handshake response is too long");
+		return false;
+	}
+
+	// Frames can follow the header right away
+	String received = static_cast<String&&>(response);
+	response = String();
+	end += 4;
+
+	if (!checkHandshake(received.substring(0, end)))
+		return false;
+
+	state = eWSCS_Open;
+	setTimeOut(USHRT_MAX); // Pings check the connection
+	if (pingInterval > 0)
+		pingTimer.initializeMs(pingInterval * 1000, TimerDelegate(&WebSocketClient::onPingTimer, this)).start();
+	debugf("WS client connected to %s", host.c_str());
+	if (wsConnect)
+		wsConnect(*this);
+
+	if (state == eWSCS_Open && end < (int)received.length()
+			&& !parse((uint8_t*)&received[end], received.length() - end) && getParserState() == eWSPS_Failed)
+		sendClose(getErrorCode());
+	return true;
+}
+
+bool WebSocketClient::checkHandshake(const String& header)
+{
+	if (!header.startsWith("HTTP/1.1 101"))
+	{
+		debugf("WS client: upgrade refused: %s", header.substring(0, header.indexOf('\r')).c_str());
+		return false;
+	}
+
+	// Header names are case insensitive
+	String names = header;
+	names.toLowerCase();
+	int pos = names.indexOf("\r\nsec-websocket-accept:");
+	if (pos < 0)
+		return false;
+	pos += 23;
+	String accept = header.substring(pos, header.indexOf('\r', pos));
+	accept.trim();
+
+	String hash = key + secret;
+	unsigned char data[SHA1_SIZE];
+	char expected[SHA1_SIZE * 4];
+	sha1(data, hash.c_str(), hash.length());
+	base64_encode(SHA1_SIZE, data, SHA1_SIZE * 4, expected);
+
+	if (accept != expected)
+	{
+		debugf("WS client: wrong Sec-WebSocket-Accept");
+		return false;
+	}
+
+	return true;
+}
+
+bool WebSocketClient::send(const char* message, int length, wsFrameType type)
+{
+	if (state != eWSCS_Open)
+		return false;
+
+	return sendFrame(type, (const uint8_t*)message, length);
+}
+
+bool WebSocketClient::sendString(const String& message)
+{
+	return send(message.c_str(), message.length());
+}
+
+bool WebSocketClient::sendBinary(const uint8_t* data, int size)
+{
+	return send((const char*)data, size, WS_BINARY_FRAME);
+}
+
+bool WebSocketClient::sendPing()
+{
+	return send(NULL, 0, WS_PING_FRAME);
+}
+
+bool WebSocketClient::sendFrame(wsFrameType type, const uint8_t* data, int length, bool closeAfterSent)
+{
+	// Client frames are always masked
+	uint8_t header[14];
+	int headerLength = 2;
+	header[0] = 0x80 | type;
+	if (length <= 125)
+		header[1] = 0x80 | length;
+	else if (length <= 0xFFFF)
+	{
+		header[1] = 0x80 | 126;
+		header[2] = length >> 8;
+		header[3] = length;
+		headerLength = 4;
+	}
+	else
+	{
+		header[1] = 0x80 | 127;
+		memset(&header[2], 0, 4);
+		header[6] = length >> 24;
+		header[7] = length >> 16;
+		header[8] = length >> 8;
+		header[9] = length;
+		headerLength = 10;
+	}
+
+	uint32_t maskKey = RANDOM_REG32;
+	uint8_t* mask = &header[headerLength];
+	memcpy(mask, &maskKey, 4);
+	headerLength += 4;
+
+	if (!TcpClient::send((const char*)header, headerLength, closeAfterSent && length == 0))
+		return false;
+
+	// Masked in small parts, nothing is allocated for the whole frame
+	uint8_t chunk[128];
+	for (int pos = 0; pos < length; pos += sizeof(chunk))
+	{
+		int count = min(length - pos, (int)sizeof(chunk));
+		for (int i = 0; i < count; i++)
+			chunk[i] = data[pos + i] ^ mask[(pos + i) & 3];
+		if (!TcpClient::send((const char*)chunk, count, closeAfterSent && pos + count == length))
+			return false;
+	}
+
+	if (getAvailableWriteSize() > 0)
+		pushAsyncPart(); // Don't wait for poll
+	return true;
+}
+
+void WebSocketClient::sendClose(uint16_t code)
+{
+	if (state != eWSCS_Open)
+		return;
+
+	uint8_t status[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+	state = eWSCS_Closing;
+	pingTimer.stop();
+	sendFrame(WS_CLOSING_FRAME, status, sizeof(status), true);
+}
+
+void WebSocketClient::onPingTimer()
+{
+	if (state != eWSCS_Open)
+		return;
+
+	if (pingSent)
+	{
+		debugf("WS client: no answer to ping, closing");
+		TcpClient::close();
+		return;
+	}
+
+	sendPing();
+	pingSent = true;
+}
+
+void WebSocketClient::onFinished(TcpClientState finishState)
+{
+	bool wasOpen = state == eWSCS_Open || state == eWSCS_Closing;
+	state = eWSCS_Ready;
+	pingTimer.stop();
+	pingSent = false;
+	message = String();
+	response = String();
+
+	TcpClient::onFinished(finishState);
+
+	if (wasOpen && wsDisconnect)
+		wsDisconnect(*this);
+
+	if (!stopped && reconnectInterval > 0)
+	{
+		debugf("WS client reconnects in %d s", reconnectInterval);
+		reconnectTimer.initializeMs(reconnectInterval * 1000, TimerDelegate(&WebSocketClient::start, this)).startOnce();
+	}
+}
+
+bool WebSocketClient::onMessageData(wsFrameType type, uint8_t* data, size_t size, bool messageEnd)
+{
+	if ((type == WS_TEXT_FRAME && !wsMessage) || (type == WS_BINARY_FRAME && !wsBinary))
+		return true; // Nobody is interested, drop it
+
+	if (!messageEnd || message.length() > 0)
+	{
+		if (message.length() + size > WEBSOCKET_MAX_MESSAGE_SIZE || !message.concat((const char*)data, size))
+		{
+			debugf("WS client: message is too big");
+			message = String();
+			sendClose(WS_CLOSE_TOO_BIG);
+			return false;
+		}
+		if (!messageEnd)
+			return true;
+	}
+
+	String completed = static_cast<String&&>(message);
+	message = String();
+	if (completed.length() > 0)
+	{
+		data = (uint8_t*)&completed[0];
+		size = completed.length();
+	}
+
+	if (type == WS_TEXT_FRAME)
+		wsMessage(*this, String((const char*)data, size));
+	else
+		wsBinary(*this, data, size);
+
+	return state == eWSCS_Open;
+}
+
+bool WebSocketClient::onControlFrame(wsFrameType type, const uint8_t* data, size_t size)
+{
+	if (type == WS_PING_FRAME)
+		sendFrame(WS_PONG_FRAME, data, size);
+	else if (type == WS_CLOSING_FRAME)
+	{
+		debugf("WS client: close frame received");
+		if (state == eWSCS_Open)
+		{
+			// Answer with the same status, connection is closed when it is sent
+			uint16_t code = (size >= 2) ? (data[0] << 8) | data[1] : WS_CLOSE_NORMAL;
+			sendClose(code);
+		}
+		else
+			TcpClient::close(); // Our close frame was answered
+		return false;
+	}
+
+	return true;
+}
+
+void WebSocketClient::setConnectionHandler(WebSocketClientDelegate handler)
+{
+	wsConnect = handler;
+}
+
+void WebSocketClient::setMessageHandler(WebSocketClientMessageDelegate handler)
+{
+	wsMessage = handler;
+}
+
+void WebSocketClient::setBinaryHandler(WebSocketClientBinaryDelegate handler)
+{
+	wsBinary = handler;
+}
+
+void WebSocketClient::setDisconnectionHandler(WebSocketClientDelegate handler)
+{
+	wsDisconnect = handler;
+}
+
+void WebSocketClient::setPingInterval(int seconds)
+{
+	pingInterval = seconds;
+}
+
+void WebSocketClient::setReconnectInterval(int seconds)
+{
+	reconnectInterval = seconds;
+}
@@ -0,0 +1,117 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_WEBSOCKETCLIENT_H_
+#define _SMING_CORE_NETWORK_WEBSOCKETCLIENT_H_
+
+#include "TcpClient.h"
+#include "WebSocketFrameParser.h"
+#include "../Timer.h"
+#include "../Delegate.h"
+#include "../../Wiring/WString.h"
+
+// Handshake response longer than this is refused
+#define WEBSOCKET_CLIENT_MAX_HEADER_SIZE 1024
+
+class WebSocketClient;
+
+typedef Delegate<void(WebSocketClient&)> WebSocketClientDelegate;
+typedef Delegate<void(WebSocketClient&, const String&)> WebSocketClientMessageDelegate;
+typedef Delegate<void(WebSocketClient&, uint8_t* data, size_t size)> WebSocketClientBinaryDelegate;
+
+enum WebSocketClientState
+{
+	eWSCS_Ready = 0,
+	eWSCS_Connecting, // TCP connection and handshake
+	eWSCS_Open,
+	eWSCS_Closing // Close frame was sent
+};
+
+/**
+ * @brief WebSocket client (RFC 6455) for ws:// and wss:// URLs
+ *
+ * Sent frames are masked, received frames are decoded by WebSocketFrameParser.
+ * Connection can be restored automatically and checked with pings when there is no traffic.
+ */
+class WebSocketClient : protected TcpClient, protected WebSocketFrameParser
+{
+public:
+	WebSocketClient();
+	virtual ~WebSocketClient();
+
+	// Start connection, sslOptions are used for wss:// URLs
+	bool connect(String url, uint32_t sslOptions = 0);
+	// Send close frame and stop reconnecting
+	void disconnect();
+
+	bool send(const char* message, int length, wsFrameType type = WS_TEXT_FRAME);
+	bool sendString(const String& message);
+	bool sendBinary(const uint8_t* data, int size);
+	bool sendPing();
+
+	void setConnectionHandler(WebSocketClientDelegate handler);
+	void setMessageHandler(WebSocketClientMessageDelegate handler);
+	void setBinaryHandler(WebSocketClientBinaryDelegate handler);
+	void setDisconnectionHandler(WebSocketClientDelegate handler);
+
+	// Ping is sent in this interval, connection is closed if nothing was received until the next one, 0 disables
+	void setPingInterval(int seconds);
+	// Delay before connecting again after connection was lost or failed, 0 disables
+	void setReconnectInterval(int seconds);
+
+	__forceinline WebSocketClientState getState() { return state; }
+	__forceinline bool isOpen() { return state == eWSCS_Open; }
+
+	using TcpClient::addSslOptions;
+	using TcpClient::setSslFingerprint;
+	using TcpClient::setSslClientKeyCert;
+	using TcpClient::freeSslClientKeyCert;
+#ifdef ENABLE_SSL
+	using TcpClient::getSsl;
+#endif
+
+protected:
+	virtual err_t onConnected(err_t err);
+	virtual err_t onReceive(pbuf *buf);
+	virtual void onFinished(TcpClientState finishState);
+
+	virtual bool onMessageData(wsFrameType type, uint8_t* data, size_t size, bool messageEnd);
+	virtual bool onControlFrame(wsFrameType type, const uint8_t* data, size_t size);
+
+private:
+	void start();
+	bool processHandshake(pbuf* buf);
+	bool checkHandshake(const String& header);
+	bool sendFrame(wsFrameType type, const uint8_t* data, int length, bool closeAfterSent = false);
+	void sendClose(uint16_t code);
+	void onPingTimer();
+
+private:
+	WebSocketClientState state = eWSCS_Ready;
+	String host;
+	int port = 0;
+	String path;
+	bool secure = false;
+	uint32_t sslOptions = 0;
+	String key; // Sec-WebSocket-Key of current handshake
+	String response; // Handshake response until the header is complete
+	String message; // Fragmented message or message split over several segments
+
+	WebSocketClientDelegate wsConnect;
+	WebSocketClientMessageDelegate wsMessage;
+	WebSocketClientBinaryDelegate wsBinary;
+	WebSocketClientDelegate wsDisconnect;
+
+	int pingInterval = 30;
+	int reconnectInterval = 10;
+	bool pingSent = false; // Nothing was received since the last ping
+	bool stopped = true; // Disconnected by user, don't reconnect
+	Timer pingTimer;
+	Timer reconnectTimer;
+};
+
+#endif /* _SMING_CORE_NETWORK_WEBSOCKETCLIENT_H_ */
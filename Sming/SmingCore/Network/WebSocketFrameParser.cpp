@@ -0,0 +1,192 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "WebSocketFrameParser.h"
+#include "lwip/pbuf.h"
+
+WebSocketFrameParser::WebSocketFrameParser(bool maskRequired) : maskRequired(maskRequired)
+{
+	reset();
+}
+
+void WebSocketFrameParser::reset()
+{
+	parserState = eWSPS_Header;
+	headerLength = 0;
+	headerRequired = 2;
+	opcode = 0;
+	messageType = 0;
+	messageBits = 0;
+	finalFrame = false;
+	masked = false;
+	payloadLength = 0;
+	payloadPos = 0;
+	errorCode = 0;
+}
+
+bool WebSocketFrameParser::parse(pbuf* buf)
+{
+	for (pbuf* cur = buf; cur != NULL; cur = cur->next)
+		if (!parse((uint8_t*)cur->payload, cur->len))
+			return false;
+
+	return true;
+}
+
+bool WebSocketFrameParser::parse(uint8_t* data, int length)
+{
+	if (parserState == eWSPS_Stopped)
+		parserState = (payloadPos < payloadLength) ? eWSPS_Payload : eWSPS_Header;
+
+	while (length > 0)
+	{
+		int consumed = parseBlock(data, length);
+		if (parserState == eWSPS_Stopped || parserState == eWSPS_Failed)
+			return false;
+		data += consumed;
+		length -= consumed;
+	}
+
+	return true;
+}
+
+int WebSocketFrameParser::parseBlock(uint8_t* data, int length)
+{
+	if (parserState == eWSPS_Header)
+	{
+		int pos = 0;
+		while (pos < length && headerLength < headerRequired)
+		{
+			header[headerLength++] = data[pos++];
+			if (headerLength == 2)
+			{
+				// Now we know the real header size
+				uint8_t len7 = header[1] & 0x7F;
+				headerRequired = 2 + (len7 == 126 ? 2 : (len7 == 127 ? 8 : 0)) + ((header[1] & 0x80) ? 4 : 0);
+			}
+		}
+
+		if (headerLength == headerRequired && beginFrame() && payloadLength == 0)
+			processPayload(NULL, 0); // Empty frame is completed right away
+
+		return pos;
+	}
+
+	int count = min((uint32_t)length, payloadLength - payloadPos);
+	if (masked)
+	{
+		for (int i = 0; i < count; i++)
+			data[i] ^= mask[(payloadPos + i) & 3];
+	}
+	processPayload(data, count);
+	return count;
+}
+
+bool WebSocketFrameParser::beginFrame()
+{
+	finalFrame = (header[0] & 0x80) != 0;
+	opcode = header[0] & 0x0F;
+	masked = (header[1] & 0x80) != 0;
+	uint8_t rsv = header[0] & WS_FRAME_RSV_MASK;
+
+	if ((rsv & ~extensionBits) != 0)
+		return fail(WS_CLOSE_PROTOCOL_ERROR); // Not negotiated
+	if (maskRequired && !masked)
+		return fail(WS_CLOSE_PROTOCOL_ERROR);
+
+	int pos = 2;
+	uint8_t len7 = header[1] & 0x7F;
+	if (len7 == 126)
+	{
+		payloadLength = (header[2] << 8) | header[3];
+		pos += 2;
+	}
+	else if (len7 == 127)
+	{
+		// Frames up to 4GB only
+		if (header[2] | header[3] | header[4] | header[5])
+			return fail(WS_CLOSE_TOO_BIG);
+		payloadLength = ((uint32_t)header[6] << 24) | ((uint32_t)header[7] << 16) | (header[8] << 8) | header[9];
+		pos += 8;
+	}
+	else
+		payloadLength = len7;
+
+	if (masked)
+		memcpy(mask, &header[pos], sizeof(mask));
+
+	switch (opcode)
+	{
+	case WS_CONTINUATION_FRAME:
+		// Extension bits belong to the first frame only
+		if (messageType == 0 || rsv != 0)
+			return fail(WS_CLOSE_PROTOCOL_ERROR);
+		break;
+	case WS_TEXT_FRAME:
+	case WS_BINARY_FRAME:
+		if (messageType != 0)
+			return fail(WS_CLOSE_PROTOCOL_ERROR); // Previous message wasn't finished
+		messageType = opcode;
+		messageBits = rsv;
+		break;
+	case WS_CLOSING_FRAME:
+	case WS_PING_FRAME:
+	case WS_PONG_FRAME:
+		// Can come between fragments, never fragmented itself
+		if (!finalFrame || rsv != 0 || payloadLength > WS_MAX_CONTROL_PAYLOAD)
+			return fail(WS_CLOSE_PROTOCOL_ERROR);
+		break;
+	default:
+		return fail(WS_CLOSE_PROTOCOL_ERROR);
+	}
+
+	parserState = eWSPS_Payload;
+	payloadPos = 0;
+	return true;
+}
+
+bool WebSocketFrameParser::processPayload(uint8_t* data, int length)
+{
+	uint32_t offset = payloadPos;
+	payloadPos += length;
+	bool frameEnd = payloadPos == payloadLength;
+	if (frameEnd)
+	{
+		// Ready for the next frame before callback
+		parserState = eWSPS_Header;
+		headerLength = 0;
+		headerRequired = 2;
+	}
+
+	bool res;
+	if (opcode & 0x08)
+	{
+		if (length > 0)
+			memcpy(controlData + offset, data, length);
+		res = !frameEnd || onControlFrame((wsFrameType)opcode, controlData, payloadLength);
+	}
+	else
+	{
+		bool messageEnd = frameEnd && finalFrame;
+		wsFrameType type = (wsFrameType)messageType;
+		if (messageEnd)
+			messageType = 0;
+		res = (length == 0 && !messageEnd) || onMessageData(type, data, length, messageEnd);
+	}
+
+	if (!res && parserState != eWSPS_Failed)
+		parserState = eWSPS_Stopped;
+	return res;
+}
+
+bool WebSocketFrameParser::fail(uint16_t code)
+{
+	debugf("WS frame error: %d", code);
+	parserState = eWSPS_Failed;
+	errorCode = code;
+	return false;
+}
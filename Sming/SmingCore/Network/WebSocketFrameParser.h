@@ -0,0 +1,102 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_WEBSOCKETFRAMEPARSER_H_
+#define _SMING_CORE_NETWORK_WEBSOCKETFRAMEPARSER_H_
+
+#include "../Wiring/WiringFrameworkDependencies.h"
+#include "../../Services/cWebsocket/websocket.h"
+
+struct pbuf;
+
+// Close status codes (RFC 6455, 7.4.1)
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_INVALID_DATA 1007
+#define WS_CLOSE_TOO_BIG 1009
+
+// Longest text or binary message which is assembled for message handlers
+#ifndef WEBSOCKET_MAX_MESSAGE_SIZE
+#define WEBSOCKET_MAX_MESSAGE_SIZE 4096
+#endif
+
+#define WS_CONTINUATION_FRAME 0x00
+#define WS_MAX_CONTROL_PAYLOAD 125
+
+// Reserved header bits, RSV1 marks compressed message (RFC 7692)
+#define WS_FRAME_RSV1 0x40
+#define WS_FRAME_RSV_MASK 0x70
+
+enum WebSocketParserState
+{
+	eWSPS_Header = 0,
+	eWSPS_Payload,
+	eWSPS_Stopped,
+	eWSPS_Failed
+};
+
+/**
+ * @brief Incremental WebSocket frame decoder
+ *
+ * Frames can be split over any number of pbufs and TCP segments, header bytes are collected
+ * until complete and payload is unmasked in place and reported in chunks as it arrives.
+ * Fragmented messages are reported with the type of their first frame,
+ * control frames (up to 125 bytes) are collected and reported when complete.
+ */
+class WebSocketFrameParser
+{
+public:
+	WebSocketFrameParser(bool maskRequired);
+	virtual ~WebSocketFrameParser() {}
+
+	/**
+	 * @brief Parse received data, payload is unmasked inside buf
+	 * @return false if parsing was stopped by callback or failed, see getParserState() and getErrorCode()
+	 */
+	bool parse(pbuf* buf);
+	bool parse(uint8_t* data, int length);
+	void reset();
+	// RSV bits allowed in the first frame of data message, set by negotiated extensions
+	__forceinline void setExtensionBits(uint8_t bits) { extensionBits = bits & WS_FRAME_RSV_MASK; }
+
+	__forceinline WebSocketParserState getParserState() { return parserState; }
+	__forceinline uint16_t getErrorCode() { return errorCode; } // Close status for failed parsing
+	// RSV bits of the message being reported to onMessageData()
+	__forceinline uint8_t getMessageExtensionBits() { return messageBits; }
+
+protected:
+	// Next payload chunk of text or binary message, return false to stop parsing
+	virtual bool onMessageData(wsFrameType type, uint8_t* data, size_t size, bool messageEnd) = 0;
+	// Complete ping, pong or close frame, return false to stop parsing
+	virtual bool onControlFrame(wsFrameType type, const uint8_t* data, size_t size) = 0;
+
+private:
+	int parseBlock(uint8_t* data, int length);
+	bool beginFrame();
+	bool processPayload(uint8_t* data, int length);
+	bool fail(uint16_t code);
+
+private:
+	WebSocketParserState parserState;
+	bool maskRequired;
+	uint8_t header[14];
+	uint8_t headerLength;
+	uint8_t headerRequired;
+	uint8_t opcode; // Current frame
+	uint8_t messageType; // Text or binary message in progress, 0 if none
+	uint8_t messageBits; // RSV bits from the first frame of message
+	uint8_t extensionBits = 0;
+	bool finalFrame;
+	bool masked;
+	uint8_t mask[4];
+	uint32_t payloadLength;
+	uint32_t payloadPos;
+	uint8_t controlData[WS_MAX_CONTROL_PAYLOAD];
+	uint16_t errorCode;
+};
+
+#endif /* _SMING_CORE_NETWORK_WEBSOCKETFRAMEPARSER_H_ */
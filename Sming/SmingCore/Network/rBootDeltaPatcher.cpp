@@ -0,0 +1,434 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "rBootDeltaPatcher.h"
+#include "../../system/flashmem.h"
+
+// Source is read by small pieces to stack
+#define RBOOT_DELTA_READ_SIZE 64
+
+static const uint32_t crcTable[16] =
+{
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = crcTable[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+		crc = crcTable[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+	}
+	return ~crc;
+}
+
+static uint32_t readUint32(const uint8_t* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+rBootDeltaPatcher::~rBootDeltaPatcher()
+{
+	free(pending);
+}
+
+bool rBootDeltaPatcher::begin(uint32_t sourceAddress, uint32_t targetAddress)
+{
+	timer.stop();
+	this->sourceAddress = sourceAddress;
+	this->targetAddress = targetAddress;
+	headerLength = 0;
+	sourcePos = 0;
+	written = 0;
+	crc = 0;
+	bufferLength = 0;
+	pendingLength = 0;
+
+	// Sizes are known from the header, this is the running rom for example
+	if ((sourceAddress & ~(SECTOR_SIZE - 1)) == (targetAddress & ~(SECTOR_SIZE - 1)))
+	{
+		debugf("Delta patch: target overwrites the source");
+		state = eRDS_Failed;
+		return false;
+	}
+
+	writeStatus = rboot_write_init(targetAddress);
+	state = eRDS_Header;
+	return true;
+}
+
+bool rBootDeltaPatcher::write(const uint8_t* data, size_t size)
+{
+	if (state == eRDS_Failed)
+		return false;
+
+	if (!isBusy())
+	{
+		size_t used = parse(data, size);
+		data += used;
+		size -= used;
+	}
+
+	if (size > 0 && !keep(data, size))
+		return false;
+
+	if (isBusy())
+		process();
+
+	return state != eRDS_Failed;
+}
+
+bool rBootDeltaPatcher::keep(const uint8_t* data, size_t size)
+{
+	if (pendingLength + size > pendingCapacity)
+	{
+		// Bounded by TCP window when receiving is paused
+		uint8_t* buf = (uint8_t*)realloc(pending, pendingLength + size);
+		if (buf == NULL)
+		{
+			debugf("Delta patch: out of memory");
+			state = eRDS_Failed;
+			return false;
+		}
+		pending = buf;
+		pendingCapacity = pendingLength + size;
+	}
+
+	memcpy(pending + pendingLength, data, size);
+	pendingLength += size;
+	return true;
+}
+
+void rBootDeltaPatcher::process()
+{
+	size_t budget = RBOOT_DELTA_STEP_SIZE;
+	while (state != eRDS_Failed && budget > 0)
+	{
+		if (state == eRDS_Verify || state == eRDS_Copy)
+			budget -= step(budget);
+		else if (pendingLength > 0)
+		{
+			size_t used = parse(pending, pendingLength);
+			pendingLength -= used;
+			memmove(pending, pending + used, pendingLength);
+		}
+		else
+			break;
+	}
+
+	if (isBusy())
+		timer.initializeMs(1, TimerDelegate(&rBootDeltaPatcher::onTimer, this)).startOnce();
+}
+
+void rBootDeltaPatcher::onTimer()
+{
+	process();
+	if (!isBusy() && readyHandler)
+		readyHandler();
+}
+
+size_t rBootDeltaPatcher::parse(const uint8_t* data, size_t size)
+{
+	// Stops when source work is needed, rest is parsed after it
+	size_t pos = 0;
+	while (pos < size && state != eRDS_Failed && state != eRDS_Verify && state != eRDS_Copy)
+	{
+		switch (state)
+		{
+		case eRDS_Header:
+		{
+			size_t count = RBOOT_DELTA_HEADER_SIZE - headerLength;
+			if (count > size - pos)
+				count = size - pos;
+			memcpy(header + headerLength, data + pos, count);
+			headerLength += count;
+			pos += count;
+			if (headerLength == RBOOT_DELTA_HEADER_SIZE && !processHeader())
+				state = eRDS_Failed;
+			break;
+		}
+
+		case eRDS_Command:
+			command = data[pos++];
+			if (command < RBOOT_DELTA_COPY || command > RBOOT_DELTA_SEEK)
+			{
+				debugf("Delta patch: invalid command %d", command);
+				state = eRDS_Failed;
+				break;
+			}
+			number = 0;
+			numberShift = 0;
+			state = eRDS_Number;
+			break;
+
+		case eRDS_Number:
+		{
+			uint8_t value = data[pos++];
+			if (numberShift > 28)
+			{
+				state = eRDS_Failed;
+				break;
+			}
+			number |= (uint32_t)(value & 0x7F) << numberShift;
+			numberShift += 7;
+			if ((value & 0x80) == 0 && !processCommand())
+				state = eRDS_Failed;
+			break;
+		}
+
+		case eRDS_Data:
+		{
+			size_t count = size - pos;
+			if (count > remaining)
+				count = remaining;
+			if (command == RBOOT_DELTA_ADD)
+			{
+				uint8_t source[RBOOT_DELTA_READ_SIZE];
+				for (size_t done = 0; done < count; )
+				{
+					size_t part = count - done;
+					if (part > RBOOT_DELTA_READ_SIZE)
+						part = RBOOT_DELTA_READ_SIZE;
+					if (!readSource(sourcePos, source, part))
+						break;
+					for (size_t i = 0; i < part; i++)
+						source[i] += data[pos + done + i];
+					if (!output(source, part))
+						break;
+					sourcePos += part;
+					done += part;
+				}
+			}
+			else
+				output(data + pos, count);
+
+			if (state == eRDS_Failed)
+				break;
+
+			pos += count;
+			remaining -= count;
+			if (remaining == 0)
+				state = (written < targetSize) ? eRDS_Command : eRDS_Done;
+			break;
+		}
+
+		default:
+			debugf("Delta patch: unexpected data");
+			state = eRDS_Failed;
+			break;
+		}
+	}
+
+	return pos;
+}
+
+bool rBootDeltaPatcher::end()
+{
+	timer.stop();
+	if (state != eRDS_Done || pendingLength > 0)
+	{
+		debugf("Delta patch is incomplete");
+		return false;
+	}
+
+	if (!flush())
+		return false;
+
+	if (crc != targetCrc)
+	{
+		debugf("Delta patch: target CRC mismatch");
+		state = eRDS_Failed;
+		return false;
+	}
+
+	return rboot_write_end(&writeStatus);
+}
+
+bool rBootDeltaPatcher::processHeader()
+{
+	if (readUint32(header) != RBOOT_DELTA_MAGIC)
+	{
+		debugf("Delta patch: invalid header");
+		return false;
+	}
+
+	sourceSize = readUint32(header + 4);
+	sourceCrc = readUint32(header + 8);
+	targetSize = readUint32(header + 12);
+	targetCrc = readUint32(header + 16);
+	debugf("Delta patch: %d -> %d bytes", sourceSize, targetSize);
+
+	// Writing erases whole sectors from the target address
+	uint32_t targetStart = targetAddress & ~(SECTOR_SIZE - 1);
+	if (sourceAddress < targetAddress + targetSize && targetStart < sourceAddress + sourceSize)
+	{
+		debugf("Delta patch: target overlaps the source");
+		return false;
+	}
+
+	// Patch must be made from exactly this image, see step()
+	checked = 0;
+	check = 0;
+	state = eRDS_Verify;
+	return true;
+}
+
+bool rBootDeltaPatcher::processCommand()
+{
+	switch (command)
+	{
+	case RBOOT_DELTA_COPY:
+		if (number > sourceSize - sourcePos)
+		{
+			debugf("Delta patch: copy out of source");
+			return false;
+		}
+		if (number > 0)
+		{
+			remaining = number;
+			state = eRDS_Copy; // See step()
+			return true;
+		}
+		break;
+
+	case RBOOT_DELTA_SEEK:
+	{
+		int32_t offset = (int32_t)(number >> 1) ^ -(int32_t)(number & 1);
+		int64_t pos = (int64_t)sourcePos + offset;
+		if (pos < 0 || pos > sourceSize)
+		{
+			debugf("Delta patch: seek out of source");
+			return false;
+		}
+		sourcePos = pos;
+		break;
+	}
+
+	default: // ADD or INSERT, data follows
+		if (command == RBOOT_DELTA_ADD && number > sourceSize - sourcePos)
+		{
+			debugf("Delta patch: add out of source");
+			return false;
+		}
+		if (number > 0)
+		{
+			remaining = number;
+			state = eRDS_Data;
+			return true;
+		}
+		break;
+	}
+
+	state = (written < targetSize) ? eRDS_Command : eRDS_Done;
+	return true;
+}
+
+size_t rBootDeltaPatcher::step(size_t budget)
+{
+	// Source CRC check or COPY, returns number of processed source bytes
+	uint32_t length = (state == eRDS_Verify) ? sourceSize - checked : remaining;
+	if (length > budget)
+		length = budget;
+
+	uint8_t source[RBOOT_DELTA_READ_SIZE];
+	for (uint32_t done = 0; done < length; )
+	{
+		size_t count = length - done;
+		if (count > RBOOT_DELTA_READ_SIZE)
+			count = RBOOT_DELTA_READ_SIZE;
+
+		if (state == eRDS_Verify)
+		{
+			if (!readSource(checked, source, count))
+				return length;
+			check = deltaCrc32(check, source, count);
+			checked += count;
+		}
+		else
+		{
+			if (!readSource(sourcePos, source, count) || !output(source, count))
+				return length;
+			sourcePos += count;
+			remaining -= count;
+		}
+		done += count;
+	}
+
+	if (state == eRDS_Verify && checked == sourceSize)
+	{
+		if (check != sourceCrc)
+		{
+			debugf("Delta patch doesn't match the source image");
+			state = eRDS_Failed;
+		}
+		else
+			state = (targetSize > 0) ? eRDS_Command : eRDS_Done;
+	}
+	else if (state == eRDS_Copy && remaining == 0)
+		state = (written < targetSize) ? eRDS_Command : eRDS_Done;
+
+	// Nothing to do for empty source, budget must still decrease
+	return (length > 0) ? length : 1;
+}
+
+bool rBootDeltaPatcher::readSource(uint32_t pos, uint8_t* dst, size_t size)
+{
+	if (flashmem_read(dst, sourceAddress + pos, size) != size)
+	{
+		debugf("Delta patch: can't read 0x%X", sourceAddress + pos);
+		state = eRDS_Failed;
+		return false;
+	}
+
+	return true;
+}
+
+bool rBootDeltaPatcher::output(const uint8_t* data, size_t size)
+{
+	if (size > targetSize - written)
+	{
+		debugf("Delta patch: target is too long");
+		state = eRDS_Failed;
+		return false;
+	}
+
+	crc = deltaCrc32(crc, data, size);
+	written += size;
+
+	while (size > 0)
+	{
+		size_t count = RBOOT_DELTA_BUFFER_SIZE - bufferLength;
+		if (count > size)
+			count = size;
+		memcpy(buffer + bufferLength, data, count);
+		bufferLength += count;
+		data += count;
+		size -= count;
+		if (bufferLength == RBOOT_DELTA_BUFFER_SIZE && !flush())
+			return false;
+	}
+
+	return true;
+}
+
+bool rBootDeltaPatcher::flush()
+{
+	if (bufferLength == 0)
+		return true;
+
+	if (!rboot_write_flash(&writeStatus, buffer, bufferLength))
+	{
+		debugf("Delta patch: flash write failed");
+		state = eRDS_Failed;
+		return false;
+	}
+
+	bufferLength = 0;
+	return true;
+}
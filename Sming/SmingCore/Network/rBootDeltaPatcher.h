@@ -0,0 +1,129 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_RBOOTDELTAPATCHER_H_
+#define _SMING_CORE_NETWORK_RBOOTDELTAPATCHER_H_
+
+#include <user_config.h>
+#include <rboot-api.h>
+#include "../Timer.h"
+
+/*
+ * Patch format, created by deltaimg tool from two rom images:
+ * header: magic, source size, source CRC32, target size, target CRC32 (32 bit little endian)
+ * then commands until the whole target is produced, lengths are unsigned LEB128
+ */
+#define RBOOT_DELTA_MAGIC 0x31544c44 // "DLT1"
+#define RBOOT_DELTA_HEADER_SIZE 20
+#define RBOOT_DELTA_COPY 1 // length: source bytes are copied
+#define RBOOT_DELTA_ADD 2 // length, bytes: added to source bytes (modulo 256)
+#define RBOOT_DELTA_INSERT 3 // length, bytes: new bytes
+#define RBOOT_DELTA_SEEK 4 // offset (zigzag encoded): source position is moved
+
+// Target data written to flash at once
+#define RBOOT_DELTA_BUFFER_SIZE 256
+// Source bytes read (CRC check or COPY) in one step, longer work continues from timer
+#define RBOOT_DELTA_STEP_SIZE 4096
+
+enum rBootDeltaState
+{
+	eRDS_Header = 0,
+	eRDS_Verify, // CRC of source image
+	eRDS_Command,
+	eRDS_Number,
+	eRDS_Data, // Of ADD or INSERT
+	eRDS_Copy,
+	eRDS_Done,
+	eRDS_Failed
+};
+
+/**
+ * @brief Applies delta patch as it arrives, target image is reconstructed from the source
+ * (usually the running rom) and written to another rom slot
+ *
+ * Patch is checked against CRC32 of the source before anything is written and the result
+ * against CRC32 of the target at the end. RAM use doesn't depend on image size.
+ * Source CRC check and COPY commands are done in steps of RBOOT_DELTA_STEP_SIZE bytes,
+ * patch data received meanwhile are kept until the work is done (pause the connection while isBusy()).
+ */
+class rBootDeltaPatcher
+{
+public:
+	rBootDeltaPatcher() {}
+	~rBootDeltaPatcher();
+
+	// Addresses of the source image and of the slot for the target image, they must differ
+	bool begin(uint32_t sourceAddress, uint32_t targetAddress);
+	bool write(const uint8_t* data, size_t size);
+	// Returns true if the target image is complete and valid, call it when the patcher isn't busy
+	bool end();
+
+	// Work from previous write() continues, received data are kept
+	__forceinline bool isBusy()
+	{
+		return state != eRDS_Failed && (pendingLength > 0 || state == eRDS_Verify || state == eRDS_Copy);
+	}
+	// Called when work started by write() is finished or has failed
+	void setReadyHandler(TimerDelegate handler) { readyHandler = handler; }
+
+	__forceinline uint32_t getTargetSize() { return targetSize; }
+	__forceinline size_t getWrittenSize() { return written; }
+
+private:
+	size_t parse(const uint8_t* data, size_t size);
+	void process();
+	void onTimer();
+	bool keep(const uint8_t* data, size_t size);
+	size_t step(size_t budget);
+	bool processHeader();
+	bool processCommand();
+	bool readSource(uint32_t pos, uint8_t* dst, size_t size);
+	bool output(const uint8_t* data, size_t size);
+	bool flush();
+
+private:
+	rBootDeltaState state = eRDS_Failed;
+	uint32_t sourceAddress = 0;
+	uint32_t targetAddress = 0;
+	rboot_write_status writeStatus;
+
+	uint32_t sourceSize = 0;
+	uint32_t sourceCrc = 0;
+	uint32_t targetSize = 0;
+	uint32_t targetCrc = 0;
+
+	uint8_t header[RBOOT_DELTA_HEADER_SIZE];
+	uint8_t headerLength = 0;
+
+	uint8_t command = 0;
+	uint32_t number = 0; // Being decoded
+	uint8_t numberShift = 0;
+	uint32_t remaining = 0; // Data bytes of current command
+
+	uint32_t sourcePos = 0;
+	uint32_t checked = 0; // Verified part of source
+	uint32_t check = 0; // Its CRC
+	size_t written = 0; // Target bytes produced
+	uint32_t crc = 0;
+
+	uint8_t buffer[RBOOT_DELTA_BUFFER_SIZE]; // Not written yet
+	size_t bufferLength = 0;
+
+	uint8_t* pending = NULL; // Patch data received while working
+	size_t pendingLength = 0;
+	size_t pendingCapacity = 0;
+	Timer timer;
+	TimerDelegate readyHandler;
+
+	rBootDeltaPatcher(const rBootDeltaPatcher&);
+	rBootDeltaPatcher& operator=(const rBootDeltaPatcher&);
+};
+
+// Standard CRC-32 (IEEE 802.3), crc is result of previous call or 0
+uint32_t deltaCrc32(uint32_t crc, const uint8_t* data, size_t size);
+
+#endif /* _SMING_CORE_NETWORK_RBOOTDELTAPATCHER_H_ */
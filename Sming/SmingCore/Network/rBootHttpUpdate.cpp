@@ -17,6 +17,7 @@ rBootHttpUpdate::rBootHttpUpdate() {
 }
 
 rBootHttpUpdate::~rBootHttpUpdate() {
+	delete patcher;
 }
 
 void rBootHttpUpdate::addItem(int offset, String firmwareFileUrl) {
@@ -24,11 +25,42 @@ void rBootHttpUpdate::addItem(int offset, String firmwareFileUrl) {
 	add.targetOffset = offset;
 	add.url = firmwareFileUrl;
 	add.size = 0;
+	add.patch = false;
+	add.sourceOffset = 0;
+	add.totalSize = 0;
+	items.add(add);
+}
+
+void rBootHttpUpdate::addPatchItem(int offset, String patchFileUrl) {
+	rboot_config config = rboot_get_config();
+	addPatchItem(offset, patchFileUrl, config.roms[rboot_get_current_rom()]);
+}
+
+void rBootHttpUpdate::addPatchItem(int offset, String patchFileUrl, uint32_t sourceOffset) {
+	rBootHttpUpdateItem add;
+	add.targetOffset = offset;
+	add.url = patchFileUrl;
+	add.size = 0;
+	add.patch = true;
+	add.sourceOffset = sourceOffset;
+	add.totalSize = 0;
 	items.add(add);
 }
 
 void rBootHttpUpdate::start() {
-	timer.initializeMs(500, TimerDelegate(&rBootHttpUpdate::onTimer, this)).start();
+	timer.stop();
+	for (int i = 0; i < items.count(); i++) {
+		items[i].size = 0;
+		items[i].validator = "";
+		items[i].totalSize = 0;
+	}
+	currentItem = 0;
+	retries = 0;
+	if (items.count() == 0) {
+		applyUpdate();
+		return;
+	}
+	startItem();
 }
 
 void rBootHttpUpdate::switchToRom(uint8 romSlot) {
@@ -45,62 +77,191 @@ void rBootHttpUpdate::setDelegate(otaUpdateDelegate reqUpdateDelegate) {
 
 void rBootHttpUpdate::updateFailed() {
 	timer.stop();
+	delete patcher;
+	patcher = NULL;
+	completionPending = false;
+	resumeReceiving();
 	debugf("\r\nFirmware download failed..");
 	if (updateDelegate) updateDelegate(*this, false);
 	items.clear();
 }
 
-void rBootHttpUpdate::onItemDownloadCompleted(HttpClient& client, bool successful) {
-	if(successful) {
-		rboot_write_end(&rBootWriteStatus);
+void rBootHttpUpdate::startItem() {
+	rBootHttpUpdateItem &it = items[currentItem];
+	attemptStart = it.size;
+	accepting = false;
+	restartItem = false;
+	completionPending = false;
+
+	if (it.size == 0) {
+		debugf("Download file:\r\n    (%d) %s -> %X", currentItem, it.url.c_str(), it.targetOffset);
+		if (!beginWrite()) {
+			updateFailed();
+			return;
+		}
+		removeRequestHeader("Range");
+		removeRequestHeader("If-Range");
+	} else {
+		debugf("Resume download:\r\n    (%d) %s -> %X from %d", currentItem, it.url.c_str(), it.targetOffset, it.size);
+		setRequestHeader("Range", "bytes=" + String(it.size) + "-");
+		// Server sends the whole file (200) if it has changed
+		if (it.validator.length() > 0) {
+			setRequestHeader("If-Range", it.validator);
+		} else {
+			removeRequestHeader("If-Range");
+		}
+	}
+
+	if (!startDownload(URL(it.url), eHCM_UserDefined, HttpClientCompletedDelegate(&rBootHttpUpdate::onItemDownloadCompleted, this))) {
+		updateFailed();
 	}
 }
 
-void rBootHttpUpdate::onTimer() {
-	
-	if (TcpClient::isProcessing()) return; // Will wait
-	
-	if (TcpClient::getConnectionState() == eTCS_Successful) {
-		
-		if (!isSuccessful()) {
+void rBootHttpUpdate::onResponseHeadersComplete() {
+	HttpClient::onResponseHeadersComplete();
+
+	rBootHttpUpdateItem &it = items[currentItem];
+	int code = getResponseCode();
+	if (code == 206 && it.size > 0) {
+		// Content-Range: bytes 1024-409599/409600
+		String range = getResponseHeader("Content-Range");
+		int first = range.substring(range.indexOf(' ') + 1).toInt();
+		int total = range.substring(range.indexOf('/') + 1).toInt();
+		// Changed file is sent whole when If-Range was used, size is the only check without validator
+		if (first != it.size || (it.totalSize > 0 && total != it.totalSize)) {
+			debugf("Unexpected Content-Range: %s, download starts again", range.c_str());
+			restartItem = true;
+			writeError = true; // Response is aborted
+			return;
+		}
+		accepting = true;
+	} else if (code == 200) {
+		if (it.size > 0) {
+			debugf("Range isn't supported or file has changed, download starts again");
+			if (!beginWrite()) {
+				writeError = true;
+				return;
+			}
+		}
+		it.validator = getValidator();
+		it.totalSize = max(getContentLength(), 0);
+		accepting = true;
+	}
+}
+
+String rBootHttpUpdate::getValidator() {
+	// Weak ETag can't be used with If-Range
+	String etag = getResponseHeader("ETag", getResponseHeader("Etag"));
+	if (etag.length() > 0 && !etag.startsWith("W/")) {
+		return etag;
+	}
+	return getResponseHeader("Last-Modified");
+}
+
+bool rBootHttpUpdate::beginWrite() {
+	rBootHttpUpdateItem &it = items[currentItem];
+	it.size = 0;
+	attemptStart = 0;
+	if (it.patch) {
+		if (patcher == NULL) {
+			patcher = new rBootDeltaPatcher();
+			patcher->setReadyHandler(TimerDelegate(&rBootHttpUpdate::onPatcherReady, this));
+		}
+		return patcher->begin(it.sourceOffset, it.targetOffset);
+	}
+
+	rBootWriteStatus = rboot_write_init(it.targetOffset);
+	return true;
+}
+
+void rBootHttpUpdate::onItemDownloadCompleted(HttpClient& client, bool successful) {
+	rBootHttpUpdateItem &it = items[currentItem];
+
+	if (successful && accepting && it.patch && patcher->isBusy()) {
+		completionPending = true; // Finished by onPatcherReady
+		return;
+	}
+
+	if (successful && accepting) {
+		bool written = it.patch ? patcher->end() : rboot_write_end(&rBootWriteStatus);
+		delete patcher;
+		patcher = NULL;
+		if (!written) {
 			updateFailed();
 			return;
 		}
-		
+
+		retries = 0;
 		currentItem++;
 		if (currentItem >= items.count()) {
 			debugf("\r\nFirmware download finished!");
 			for (int i = 0; i < items.count(); i++) {
 				debugf(" - item: %d, addr: %X, len: %d bytes", i, items[i].targetOffset, items[i].size);
 			}
-			
 			applyUpdate();
 			return;
 		}
-		
-	} else if (TcpClient::getConnectionState() == eTCS_Failed) {
-		updateFailed();
+
+		startItem();
 		return;
 	}
-	
-	rBootHttpUpdateItem &it = items[currentItem];
-	debugf("Download file:\r\n    (%d) %s -> %X", currentItem, it.url.c_str(), it.targetOffset);
-	rBootWriteStatus = rboot_write_init(items[currentItem].targetOffset);
-	startDownload(URL(it.url), eHCM_UserDefined, HttpClientCompletedDelegate(&rBootHttpUpdate::onItemDownloadCompleted, this));
-}
-
-void rBootHttpUpdate::writeRawData(pbuf* buf, int startPos) {
-	pbuf *cur = buf;
-	while (cur != NULL && cur->len > 0 && !writeError) {
-		uint8* ptr = (uint8*) cur->payload + startPos;
-		int len = cur->len - startPos;
-		writeError = !rboot_write_flash(&rBootWriteStatus, ptr, len);
-		if (writeError) {
-			debugf("Write Error!");
+
+	if (restartItem) {
+		if (!beginWrite() || ++retries >= RBOOT_HTTP_RETRY_COUNT) {
+			updateFailed();
+		} else {
+			startItem();
 		}
-		items[currentItem].size += len;
-		cur = cur->next;
-		startPos = 0;
+		return;
+	}
+
+	// Only interrupted transfer is resumed, HTTP and flash errors are final
+	if (getResponseCode() != 0 || writeError) {
+		updateFailed();
+		return;
+	}
+
+	if (!it.patch) {
+		// Unaligned tail wasn't written yet, it is requested again
+		it.size = rBootWriteStatus.start_addr - it.targetOffset;
+		rBootWriteStatus.extra_count = 0;
+	}
+	// Patcher keeps its state, it continues with the next patch byte
+
+	if (it.size > attemptStart) {
+		retries = 0;
+	} else if (++retries >= RBOOT_HTTP_RETRY_COUNT) {
+		updateFailed();
+		return;
+	}
+
+	debugf("Download interrupted at %d bytes, resuming", it.size);
+	timer.initializeMs(RBOOT_HTTP_RETRY_DELAY, TimerDelegate(&rBootHttpUpdate::startItem, this)).startOnce();
+}
+
+void rBootHttpUpdate::writeRawData(uint8_t* data, size_t size) {
+	if (!accepting) {
+		return; // Error response
+	}
+
+	bool written = items[currentItem].patch ? patcher->write(data, size) : rboot_write_flash(&rBootWriteStatus, data, size);
+	if (!written) {
+		debugf("Write Error!");
+		writeError = true;
+		return;
+	}
+	items[currentItem].size += size;
+
+	if (patcher != NULL && patcher->isBusy()) {
+		pauseReceiving(); // Long copy or source check, resumed by onPatcherReady
+	}
+}
+
+void rBootHttpUpdate::onPatcherReady() {
+	resumeReceiving();
+	if (completionPending) {
+		completionPending = false;
+		onItemDownloadCompleted(*this, true);
 	}
 }
 
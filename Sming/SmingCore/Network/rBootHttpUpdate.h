@@ -9,11 +9,16 @@
 #define SMINGCORE_NETWORK_RBOOTHTTPUPDATE_H_
 
 #include "HttpClient.h"
+#include "rBootDeltaPatcher.h"
 #include <Timer.h>
 
 #include <rboot-api.h>
 
 #define NO_ROM_SWITCH 0xff
+// Attempts to resume interrupted item download without getting further
+#define RBOOT_HTTP_RETRY_COUNT 5
+// Milliseconds before interrupted download is resumed
+#define RBOOT_HTTP_RETRY_DELAY 2000
 
 class rBootHttpUpdate;
 
@@ -23,7 +28,11 @@ typedef Delegate<void(rBootHttpUpdate& client, bool result)> otaUpdateDelegate;
 struct rBootHttpUpdateItem {
 	String url;
 	uint32_t targetOffset;
-	int size;
+	int size; // Bytes received, download is resumed from here
+	bool patch; // Delta patch, see rBootDeltaPatcher
+	uint32_t sourceOffset; // Image the patch is applied to
+	String validator; // ETag or Last-Modified of the first response, resumed part must be of the same file
+	int totalSize; // Content-Length of the first response, 0 if unknown
 };
 
 class rBootHttpUpdate: private HttpClient {
@@ -32,6 +41,9 @@ public:
 	rBootHttpUpdate();
 	virtual ~rBootHttpUpdate();
 	void addItem(int offset, String firmwareFileUrl);
+	// Image for offset is reconstructed from the running rom, or from image at sourceOffset, and the patch
+	void addPatchItem(int offset, String patchFileUrl);
+	void addPatchItem(int offset, String patchFileUrl, uint32_t sourceOffset);
 	void start();
 	void switchToRom(uint8 romSlot);
 	void setCallback(otaUpdateDelegate reqUpdateDelegate);
@@ -40,6 +52,7 @@ public:
 	// Expose request and response header information
 	using HttpClient::setRequestHeader;
 	using HttpClient::hasRequestHeader;
+	using HttpClient::removeRequestHeader;
 	using HttpClient::getResponseHeader;
 
 	// Allow reading items
@@ -54,17 +67,27 @@ public:
 #endif
 
 protected:
-	void onTimer();
-	virtual void writeRawData(pbuf* buf, int startPos);
+	void startItem();
+	bool beginWrite();
+	String getValidator();
+	virtual void onResponseHeadersComplete();
+	virtual void writeRawData(uint8_t* data, size_t size);
 	void applyUpdate();
 	void updateFailed();
 	void onItemDownloadCompleted(HttpClient& client, bool successful);
+	void onPatcherReady();
 
 protected:
 	Vector<rBootHttpUpdateItem> items;
-	Timer timer;
+	Timer timer; // Delay before resuming
 	int currentItem;
 	rboot_write_status rBootWriteStatus;
+	int attemptStart = 0; // Item size when the current attempt started
+	uint8_t retries = 0;
+	bool accepting = false; // Body of current response belongs to the image
+	bool restartItem = false; // File has changed since the download started
+	bool completionPending = false; // Whole patch was received, patcher is still working
+	rBootDeltaPatcher* patcher = NULL; // For patch item
 	uint8 romSlot;
 	otaUpdateDelegate updateDelegate;
 };
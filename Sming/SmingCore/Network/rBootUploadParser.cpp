@@ -0,0 +1,61 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "rBootUploadParser.h"
+#include "HttpRequest.h"
+#include "../Clock.h"
+
+rBootUploadParser::rBootUploadParser(uint32_t targetOffset)
+	: targetOffset(targetOffset)
+{
+}
+
+void rBootUploadParser::setTargetOffset(uint32_t targetOffset)
+{
+	this->targetOffset = targetOffset;
+}
+
+bool rBootUploadParser::parse(HttpRequest& request, const char* at, int length)
+{
+	if (length == PARSE_DATASTART)
+	{
+		if (activeRequest != NULL)
+		{
+			debugf("rBoot upload is already in progress");
+			return false;
+		}
+		debugf("rBoot upload to 0x%X, %d bytes", targetOffset, request.getContentLength());
+		writeStatus = rboot_write_init(targetOffset);
+		activeRequest = &request;
+		return true;
+	}
+
+	if (activeRequest != &request)
+		return false;
+
+	if (length == PARSE_DATAEND)
+	{
+		throttle.cancel();
+		activeRequest = NULL;
+		return rboot_write_end(&writeStatus);
+	}
+	else if (length == PARSE_DATAABORT)
+	{
+		debugf("rBoot upload aborted");
+		throttle.cancel();
+		activeRequest = NULL;
+		return true;
+	}
+
+	// Sector erase takes tens of ms, the stack gets its time before the next chunk
+	uint32_t startTime = micros();
+	if (!rboot_write_flash(&writeStatus, (uint8*)at, length))
+		return false;
+
+	throttle.writeDone(request, startTime);
+	return true;
+}
@@ -0,0 +1,35 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_NETWORK_RBOOTUPLOADPARSER_H_
+#define _SMING_CORE_NETWORK_RBOOTUPLOADPARSER_H_
+
+#include "HttpBodyParser.h"
+
+#include <rboot-api.h>
+
+/**
+ * @brief Writes uploaded firmware directly to the rBoot rom slot, only one upload at a time
+ * Usage: server.addPath("/ota", onUploaded, HttpBodyParserDelegate(&rBootUploadParser::parse, &otaUploader));
+ * Path callback is called only when the whole image was written, switch rom there.
+ */
+class rBootUploadParser
+{
+public:
+	rBootUploadParser(uint32_t targetOffset);
+
+	void setTargetOffset(uint32_t targetOffset);
+	bool parse(HttpRequest& request, const char* at, int length);
+
+private:
+	uint32_t targetOffset;
+	rboot_write_status writeStatus;
+	HttpRequest* activeRequest = NULL;
+	HttpBodyThrottle throttle;
+};
+
+#endif /* _SMING_CORE_NETWORK_RBOOTUPLOADPARSER_H_ */
@@ -13,6 +13,7 @@
 #include "../Wiring/WiringFrameworkIncludes.h"
 
 #include "Delegate.h"
+#include "StringView.h"
 #include "Boards.h"
 #include "Clock.h"
 #include "SystemClock.h"
@@ -37,18 +38,26 @@
 
 #include "Network/DNSServer.h"
 #include "Network/HttpClient.h"
+#include "Network/HttpClientSink.h"
 #include "Network/MqttClient.h"
+#include "Network/MqttSnClient.h"
 #include "Network/NtpClient.h"
+#include "Network/WebSocketClient.h"
 #include "Network/HttpServer.h"
 #include "Network/HttpRequest.h"
 #include "Network/HttpResponse.h"
+#include "Network/HttpBodyParser.h"
 #include "Network/FTPServer.h"
 #include "Network/NetUtils.h"
+#include "Network/PbufSlice.h"
 #include "Network/TcpClient.h"
 #include "Network/TcpConnection.h"
+#include "Network/SslSessionCache.h"
 #include "Network/UdpConnection.h"
 #include "Network/HttpFirmwareUpdate.h"
 #include "Network/rBootHttpUpdate.h"
+#include "Network/rBootUploadParser.h"
+#include "Network/rBootDeltaPatcher.h"
 #include "Network/URL.h"
 
 #include "../Services/ArduinoJson/include/ArduinoJson.h"
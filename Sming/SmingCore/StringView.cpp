@@ -0,0 +1,102 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#include "StringView.h"
+
+bool StringView::equals(const StringView& other) const
+{
+	return len == other.len && (len == 0 || memcmp(ptr, other.ptr, len) == 0);
+}
+
+bool StringView::equalsIgnoreCase(const StringView& other) const
+{
+	if (len != other.len) return false;
+
+	for (int i = 0; i < len; i++)
+		if (tolower((uint8_t)ptr[i]) != tolower((uint8_t)other.ptr[i]))
+			return false;
+
+	return true;
+}
+
+bool StringView::startsWith(const StringView& prefix) const
+{
+	return prefix.len <= len && (prefix.len == 0 || memcmp(ptr, prefix.ptr, prefix.len) == 0);
+}
+
+int StringView::compareTo(const StringView& other) const
+{
+	int count = min(len, other.len);
+	int res = (count > 0) ? memcmp(ptr, other.ptr, count) : 0;
+	if (res != 0) return res;
+
+	return len - other.len;
+}
+
+int StringView::indexOf(char ch, int fromIndex) const
+{
+	if (fromIndex < 0) fromIndex = 0;
+	if (fromIndex >= len) return -1;
+
+	const char* found = (const char*)memchr(ptr + fromIndex, ch, len - fromIndex);
+	return (found != NULL) ? found - ptr : -1;
+}
+
+int StringView::indexOf(const StringView& str, int fromIndex) const
+{
+	if (fromIndex < 0) fromIndex = 0;
+	if (str.len == 0) return (fromIndex <= len) ? fromIndex : -1;
+
+	for (int pos = indexOf(str.ptr[0], fromIndex); pos >= 0 && pos + str.len <= len; pos = indexOf(str.ptr[0], pos + 1))
+		if (memcmp(ptr + pos, str.ptr, str.len) == 0)
+			return pos;
+
+	return -1;
+}
+
+StringView StringView::substring(int beginIndex, int endIndex) const
+{
+	if (beginIndex < 0) beginIndex = 0;
+	if (endIndex > len) endIndex = len;
+	if (beginIndex >= endIndex) return StringView(ptr, 0);
+
+	return StringView(ptr + beginIndex, endIndex - beginIndex);
+}
+
+StringView StringView::trim() const
+{
+	int begin = 0;
+	int end = len;
+	while (begin < end && isspace((uint8_t)ptr[begin]))
+		begin++;
+	while (end > begin && isspace((uint8_t)ptr[end - 1]))
+		end--;
+
+	return StringView(ptr + begin, end - begin);
+}
+
+long StringView::toInt() const
+{
+	int pos = 0;
+	while (pos < len && isspace((uint8_t)ptr[pos]))
+		pos++;
+
+	bool negative = false;
+	if (pos < len && (ptr[pos] == '-' || ptr[pos] == '+'))
+		negative = ptr[pos++] == '-';
+
+	long value = 0;
+	for (; pos < len && isdigit((uint8_t)ptr[pos]); pos++)
+		value = value * 10 + (ptr[pos] - '0');
+
+	return negative ? -value : value;
+}
+
+String StringView::toString() const
+{
+	return (ptr != NULL) ? String(ptr, len) : String();
+}
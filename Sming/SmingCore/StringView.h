@@ -0,0 +1,54 @@
+/****
+ * Sming Framework Project - Open Source framework for high efficiency native ESP8266 development.
+ * Created 2015 by Skurydin Alexey
+ * http://github.com/anakod/Sming
+ * All files of the Sming Core are provided under the LGPL v3 license.
+ ****/
+
+#ifndef _SMING_CORE_STRINGVIEW_H_
+#define _SMING_CORE_STRINGVIEW_H_
+
+#include "../Wiring/WString.h"
+
+/**
+ * @brief Non-owning reference to a sequence of characters, not necessarily null terminated
+ *
+ * Used to inspect received data without copying it into Strings.
+ * Referenced data must stay valid while the view is used.
+ */
+class StringView
+{
+public:
+	StringView() : ptr(NULL), len(0) {}
+	StringView(const char* cstr) : ptr(cstr), len(cstr ? strlen(cstr) : 0) {}
+	StringView(const char* data, int length) : ptr(data), len(length) {}
+	StringView(const String& str) : ptr(str.c_str()), len(str.length()) {}
+
+	__forceinline const char* data() const { return ptr; }
+	__forceinline int length() const { return len; }
+	__forceinline bool isEmpty() const { return len == 0; }
+	__forceinline char operator[](int index) const { return ptr[index]; }
+
+	bool equals(const StringView& other) const;
+	bool equalsIgnoreCase(const StringView& other) const;
+	bool startsWith(const StringView& prefix) const;
+	int compareTo(const StringView& other) const;
+	int indexOf(char ch, int fromIndex = 0) const;
+	int indexOf(const StringView& str, int fromIndex = 0) const;
+
+	StringView substring(int beginIndex) const { return substring(beginIndex, len); }
+	StringView substring(int beginIndex, int endIndex) const;
+	StringView trim() const; // Without leading and trailing white space
+
+	long toInt() const; // Decimal number with optional sign, 0 if there is none
+	String toString() const;
+
+	bool operator==(const StringView& other) const { return equals(other); }
+	bool operator!=(const StringView& other) const { return !equals(other); }
+
+private:
+	const char* ptr;
+	int len;
+};
+
+#endif /* _SMING_CORE_STRINGVIEW_H_ */
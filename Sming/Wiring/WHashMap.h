@@ -8,6 +8,11 @@
 || @description
 || | Implementation of a HashMap data structure.
 || |
+|| | Keys and values share one heap block in insertion order, so keyAt() and valueAt()
+|| | keep working by index. Only present items are constructed, the spare capacity
+|| | is raw memory. Lookups go through an open addressing index (linear probing,
+|| | power of two size) when a hasher exists for the key type.
+|| |
 || | Wiring Cross-platform Library
 || #
 ||
@@ -19,8 +24,73 @@
 #define HASHMAP_H
 
 #include "Countable.h"
+#include <stdlib.h>
+
+class String;
+
+/*
+|| @description
+|| | Key hasher, specialize it for own key types.
+|| | Without specialization keys are searched linearly.
+|| #
+*/
+template<typename K>
+struct HashMapHash
+{
+  enum { enabled = 0 };
+  static uint32_t hash(const K& key) { return 0; }
+};
+
+#define HASHMAP_INTEGRAL_HASH(type) \
+  template<> struct HashMapHash<type> \
+  { \
+    enum { enabled = 1 }; \
+    static uint32_t hash(type key) \
+    { \
+      uint32_t h = (uint32_t)key * 2654435761U; \
+      return h ^ (h >> 16); \
+    } \
+  };
+
+HASHMAP_INTEGRAL_HASH(char)
+HASHMAP_INTEGRAL_HASH(signed char)
+HASHMAP_INTEGRAL_HASH(unsigned char)
+HASHMAP_INTEGRAL_HASH(short)
+HASHMAP_INTEGRAL_HASH(unsigned short)
+HASHMAP_INTEGRAL_HASH(int)
+HASHMAP_INTEGRAL_HASH(unsigned int)
+HASHMAP_INTEGRAL_HASH(long)
+HASHMAP_INTEGRAL_HASH(unsigned long)
+
+template<typename T>
+struct HashMapHash<T*>
+{
+  enum { enabled = 1 };
+  static uint32_t hash(T* key)
+  {
+    uint32_t h = ((uint32_t)(size_t)key >> 2) * 2654435761U;
+    return h ^ (h >> 16);
+  }
+};
+
+// FNV-1a over string content, see WString.cpp
+template<>
+struct HashMapHash<String>
+{
+  enum { enabled = 1 };
+  static uint32_t hash(const String& key);
+};
+
+#define HASHMAP_MIN_CAPACITY 4
+// Index holds int16_t positions and has twice the capacity of slots
+#define HASHMAP_MAX_CAPACITY 0x4000
 
-template<typename K, typename V>
+// Placement new for map storage, a tag keeps it apart from <new>
+struct HashMapPlacement {};
+inline void* operator new(size_t, void* ptr, HashMapPlacement) { return ptr; }
+inline void operator delete(void*, void*, HashMapPlacement) {}
+
+template<typename K, typename V, typename H = HashMapHash<K> >
 class HashMap
 {
   public:
@@ -32,6 +102,7 @@ class HashMap
     || #
     ||
     || @parameter compare optional function for comparing a key against another (for complex types)
+    ||            Keys are searched linearly when comparator is used.
     */
     HashMap(comparator compare = 0)
     {
@@ -40,11 +111,37 @@ class HashMap
       size = 0;
       keys = NULL;
       values = NULL;
+      slots = NULL;
+      slotMask = 0;
+    }
+
+    /*
+    || @constructor
+    || | Take over content of another HashMap
+    || #
+    */
+    HashMap(HashMap<K, V, H>&& that)
+    {
+      cb_comparator = that.cb_comparator;
+      currentIndex = that.currentIndex;
+      size = that.size;
+      keys = that.keys;
+      values = that.values;
+      slots = that.slots;
+      slotMask = that.slotMask;
+      nil = that.nil;
+
+      that.currentIndex = 0;
+      that.size = 0;
+      that.keys = NULL;
+      that.values = NULL;
+      that.slots = NULL;
+      that.slotMask = 0;
     }
 
     ~HashMap()
     {
-    	clear();
+      clear();
     }
 
     /*
@@ -68,9 +165,9 @@ class HashMap
     ||
     || @return The key at index idx
     */
-    K keyAt(unsigned int idx) const
+    const K& keyAt(unsigned int idx) const
     {
-      return *keys[idx];
+      return keys[idx];
     }
 
     /*
@@ -82,25 +179,28 @@ class HashMap
     ||
     || @return The value at index idx
     */
-    V valueAt(unsigned int idx) const
+    const V& valueAt(unsigned int idx) const
     {
-      return *values[idx];
+      return values[idx];
     }
 
     /*
     || @description
-    || | An indexer for accessing and assigning a value to a key
-    || | If a key is used that exists, it returns the value for that key
-    || | If there exists no value for that key, the key is added
+    || | Get the value for a key without adding it
     || #
     ||
     || @parameter key the key to get the value for
     ||
-    || @return The const value for key
+    || @return The const value for key, or null value if key does not exist
     */
-    const V& operator[](const K key) const
+    const V& operator[](const K& key) const
     {
-      return operator[](key);
+      int index = indexOf(key);
+      if (index == -1)
+      {
+        return nil;
+      }
+      return values[index];
     }
 
     /*
@@ -114,49 +214,76 @@ class HashMap
     ||
     || @return The value for key
     */
-    V& operator[](const K key)
+    V& operator[](const K& key)
     {
-      if (contains(key))
+      int index = indexOf(key);
+      if (index != -1)
       {
-        return *values[indexOf(key)];
+        return values[index];
       }
-      if (currentIndex >= size)
+      if (!reserveNext())
       {
-    	  allocate(currentIndex + 1);
+        return nil;
       }
-      *keys[currentIndex] = key;
-      *values[currentIndex] = nil;
-      currentIndex++;
-      return *values[currentIndex - 1];
+      new (&keys[currentIndex], HashMapPlacement()) K(key);
+      return addLast();
     }
 
-    void allocate(int newSize)
+    V& operator[](K&& key)
     {
-    	if (newSize <= size) return;
-
-    	K** nkeys = new K*[newSize];
-    	V** nvalues = new V*[newSize];
-
-    	if (keys != NULL)
-    	{
-			for (int i = 0; i < size; i++)
-			{
-				nkeys[i] = keys[i];
-				nvalues[i] = values[i];
-			}
-
-			delete[] keys;
-			delete[] values;
-    	}
-		for (int i = size; i < newSize; i++)
-		{
-			nkeys[i] = new K();
-			nvalues[i] = new V();
-		}
-
-    	keys = nkeys;
-    	values = nvalues;
-    	size = newSize;
+      int index = indexOf(key);
+      if (index != -1)
+      {
+        return values[index];
+      }
+      if (!reserveNext())
+      {
+        return nil;
+      }
+      new (&keys[currentIndex], HashMapPlacement()) K(static_cast<K&&>(key));
+      return addLast();
+    }
+
+    /*
+    || @description
+    || | Reserve space for newSize items, existing items are moved
+    || #
+    ||
+    || @return false if out of memory or over HASHMAP_MAX_CAPACITY
+    */
+    bool allocate(int newSize)
+    {
+      if (newSize <= size) return true;
+      if (newSize > HASHMAP_MAX_CAPACITY) return false;
+
+      // Values follow the keys in the same block
+      size_t valuesOffset = valuesStart(newSize);
+      char* block = (char*)malloc(valuesOffset + sizeof(V) * newSize);
+      if (block == NULL)
+      {
+        return false;
+      }
+
+      K* nkeys = (K*)block;
+      V* nvalues = (V*)(block + valuesOffset);
+      for (int i = 0; i < currentIndex; i++)
+      {
+        new (&nkeys[i], HashMapPlacement()) K(static_cast<K&&>(keys[i]));
+        new (&nvalues[i], HashMapPlacement()) V(static_cast<V&&>(values[i]));
+        keys[i].~K();
+        values[i].~V();
+      }
+      free(keys);
+
+      keys = nkeys;
+      values = nvalues;
+      size = newSize;
+
+      if (useIndex())
+      {
+        rebuildIndex();
+      }
+      return true;
     }
 
     /*
@@ -168,20 +295,32 @@ class HashMap
     ||
     || @return The index of the key, or -1 if key does not exist
     */
-    unsigned int indexOf(K key) const
+    unsigned int indexOf(const K& key) const
     {
+      if (slots != NULL)
+      {
+        for (uint16_t pos = H::hash(key) & slotMask; slots[pos] != -1; pos = (pos + 1) & slotMask)
+        {
+          if (keys[slots[pos]] == key)
+          {
+            return slots[pos];
+          }
+        }
+        return -1;
+      }
+
       for (int i = 0; i < currentIndex; i++)
       {
         if (cb_comparator)
         {
-          if (cb_comparator(key, *keys[i]))
+          if (cb_comparator(key, keys[i]))
           {
             return i;
           }
         }
         else
         {
-          if (key == *keys[i])
+          if (key == keys[i])
           {
             return i;
           }
@@ -199,73 +338,67 @@ class HashMap
     ||
     || @return true if it is contained in this HashMap
     */
-    bool contains(K key) const
+    bool contains(const K& key) const
     {
-      for (int i = 0; i < currentIndex; i++)
-      {
-        if (cb_comparator)
-        {
-          if (cb_comparator(key, *keys[i]))
-          {
-            return true;
-          }
-        }
-        else
-        {
-          if (key == *keys[i])
-          {
-            return true;
-          }
-        }
-      }
-      return false;
+      return (int)indexOf(key) != -1;
     }
 
     /*
     || @description
-    || | Check if a key is contained within this HashMap
+    || | Remove a key with its value, order of other items is kept
+    || | Items after it are moved and the index is rebuilt, O(n): it costs a few lookups
+    || | and maps are read much more often (see test/HashMapBench.cpp)
     || #
     ||
     || @parameter key the key to remove from this HashMap
     */
-    void remove(K key)
+    void remove(const K& key)
     {
       int index = indexOf(key);
-      if (contains(key))
+      if (index == -1)
       {
-        for (int i = index; i < size - 1; i++)
-        {
-          *keys[i] = *keys[i + 1];
-          *values[i] = *values[i + 1];
-        }
-        currentIndex--;
+        return;
+      }
+
+      for (int i = index; i < currentIndex - 1; i++)
+      {
+        keys[i] = static_cast<K&&>(keys[i + 1]);
+        values[i] = static_cast<V&&>(values[i + 1]);
+      }
+      currentIndex--;
+      keys[currentIndex].~K();
+      values[currentIndex].~V();
+
+      if (slots != NULL)
+      {
+        rebuildIndex();
       }
     }
 
     void clear()
     {
-    	if (keys != NULL)
-    	{
-    		for (int i = 0; i < size; i++)
-			{
-				delete keys[i];
-				delete values[i];
-			}
-			delete[] keys;
-			delete[] values;
-			keys = NULL;
-			values = NULL;
-    	}
-    	currentIndex = 0;
-    	size = 0;
+      for (int i = 0; i < currentIndex; i++)
+      {
+        keys[i].~K();
+        values[i].~V();
+      }
+      free(keys); // Values are in the same block
+      delete[] slots;
+      keys = NULL;
+      values = NULL;
+      slots = NULL;
+      slotMask = 0;
+      currentIndex = 0;
+      size = 0;
     }
 
-    void setMultiple(const HashMap<K, V>& map)
+    void setMultiple(const HashMap<K, V, H>& map)
     {
-    	for (int i = 0; i < map.count(); i++)
-    	{
-    		(*this)[map.keyAt(i)] = map.valueAt(i);
-    	}
+      allocate(currentIndex + map.count());
+      for (unsigned int i = 0; i < map.count(); i++)
+      {
+        (*this)[map.keyAt(i)] = map.valueAt(i);
+      }
     }
 
     void setNullValue(V nullv)
@@ -274,15 +407,92 @@ class HashMap
     }
 
   protected:
-    K **keys;
-    V **values;
+    bool useIndex() const
+    {
+      return H::enabled && cb_comparator == NULL;
+    }
+
+    bool reserveNext()
+    {
+      if (currentIndex < size) return true;
+      if (size == HASHMAP_MAX_CAPACITY) return false;
+
+      // Grow geometrically
+      int newSize = (size < HASHMAP_MIN_CAPACITY) ? HASHMAP_MIN_CAPACITY : size * 2;
+      return allocate(newSize < HASHMAP_MAX_CAPACITY ? newSize : HASHMAP_MAX_CAPACITY);
+    }
+
+    static size_t valuesStart(int capacity)
+    {
+      size_t align = alignof(V);
+      return (sizeof(K) * capacity + align - 1) / align * align;
+    }
+
+    // Key is already constructed at currentIndex
+    V& addLast()
+    {
+      new (&values[currentIndex], HashMapPlacement()) V(nil);
+      if (slots != NULL)
+      {
+        insertSlot(currentIndex);
+      }
+      return values[currentIndex++];
+    }
+
+    void insertSlot(int16_t index)
+    {
+      uint16_t pos = H::hash(keys[index]) & slotMask;
+      while (slots[pos] != -1)
+      {
+        pos = (pos + 1) & slotMask;
+      }
+      slots[pos] = index;
+    }
+
+    // Index size is kept at least twice the capacity, so probe sequences stay short
+    void rebuildIndex()
+    {
+      unsigned int slotCount = HASHMAP_MIN_CAPACITY * 2;
+      while (slotCount < (unsigned int)size * 2)
+      {
+        slotCount <<= 1;
+      }
+
+      if (slots == NULL || slotCount != (unsigned int)slotMask + 1)
+      {
+        int16_t* nslots = new int16_t[slotCount];
+        if (nslots == NULL)
+        {
+          // Keep working with linear search
+          delete[] slots;
+          slots = NULL;
+          slotMask = 0;
+          return;
+        }
+        delete[] slots;
+        slots = nslots;
+        slotMask = slotCount - 1;
+      }
+
+      memset(slots, 0xFF, (slotMask + 1) * sizeof(int16_t));
+      for (int i = 0; i < currentIndex; i++)
+      {
+        insertSlot(i);
+      }
+    }
+
+  protected:
+    K *keys;
+    V *values;
+    int16_t *slots; // Open addressing index into keys, -1 for empty slot
     V nil;
-    int16_t currentIndex;
-    int16_t size;
+    uint16_t currentIndex;
+    uint16_t size; // Capacity, up to HASHMAP_MAX_CAPACITY
+    uint16_t slotMask;
     comparator cb_comparator;
 
   private:
-    HashMap(const HashMap<K, V>& that);
+    HashMap(const HashMap<K, V, H>& that);
 };
 
 #endif
@@ -41,6 +41,12 @@ String::String(const String &value)
   *this = value;
 }
 
+String::String(const __FlashStringHelper *pstr)
+{
+  init();
+  *this = pstr;
+}
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 String::String(String &&rval)
 {
@@ -119,7 +125,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	if (isHeap()) free(buffer);
 }
 
 void String::setString(const char *cstr, int length /* = -1 */)
@@ -146,14 +152,14 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-  if (buffer) free(buffer);
+  if (isHeap()) free(buffer);
   buffer = NULL;
   capacity = len = 0;
 }
 
 unsigned char String::reserve(unsigned int size)
 {
-  if (buffer && capacity >= size) return 1;
+  if (buffer && capacity != 0 && capacity >= size) return 1;
   if (changeBuffer(size))
   {
     if (len == 0) buffer[0] = 0;
@@ -164,14 +170,53 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-  char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
-  if (newbuffer)
+  char *newbuffer;
+  if (maxStrLen <= STRING_SSO_CAPACITY)
+  {
+    if (buffer == sso) return 1;
+    newbuffer = sso;
+    maxStrLen = STRING_SSO_CAPACITY;
+  }
+  else if (isHeap())
   {
+    newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+    if (!newbuffer) return 0;
     buffer = newbuffer;
     capacity = maxStrLen;
     return 1;
   }
-  return 0;
+  else
+  {
+    newbuffer = (char *)malloc(maxStrLen + 1);
+    if (!newbuffer) return 0;
+  }
+
+  // Content moves from inline, external or heap buffer
+  if (buffer)
+  {
+    if (len > maxStrLen) len = maxStrLen;
+    memmove(newbuffer, buffer, len);
+    newbuffer[len] = 0;
+    if (isHeap()) free(buffer);
+  }
+  buffer = newbuffer;
+  capacity = maxStrLen;
+  return 1;
+}
+
+// External constant is copied before modification
+unsigned char String::makeWritable(void)
+{
+  if (!isExternal()) return 1;
+  return changeBuffer(len);
+}
+
+void String::setExternal(const char *cstr, unsigned int length)
+{
+  if (isHeap()) free(buffer);
+  buffer = (char *)cstr;
+  capacity = 0;
+  len = length;
 }
 
 /*********************************************/
@@ -194,11 +239,18 @@ String & String::copy(const char *cstr, unsigned int length)
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 void String::move(String &rhs)
 {
-  if (buffer)
-	  free(buffer);
-  buffer = rhs.buffer;
-  capacity = rhs.capacity;
-  len = rhs.len;
+  if (rhs.buffer == rhs.sso)
+  {
+    // Inline content can't be taken over
+    copy(rhs.buffer, rhs.len);
+  }
+  else
+  {
+    if (isHeap()) free(buffer);
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+  }
   rhs.buffer = NULL;
   rhs.capacity = 0;
   rhs.len = 0;
@@ -209,7 +261,8 @@ String & String::operator = (const String &rhs)
 {
   if (this == &rhs) return *this;
 
-  if (rhs.buffer) copy(rhs.buffer, rhs.len);
+  if (rhs.isExternal()) setExternal(rhs.buffer, rhs.len);
+  else if (rhs.buffer) copy(rhs.buffer, rhs.len);
   else invalidate();
 
   return *this;
@@ -237,6 +290,14 @@ String & String::operator = (const char *cstr)
   return *this;
 }
 
+String & String::operator = (const __FlashStringHelper *pstr)
+{
+  if (pstr) setExternal((const char *)pstr, strlen((const char *)pstr));
+  else invalidate();
+
+  return *this;
+}
+
 /*********************************************/
 /*  concat                                   */
 /*********************************************/
@@ -252,7 +313,8 @@ unsigned char String::concat(const char *cstr, unsigned int length)
   if (!cstr) return 0;
   if (length == 0) return 1;
   if (!reserve(newlen)) return 0;
-  strcpy(buffer + len, cstr);
+  memcpy(buffer + len, cstr, length);
+  buffer[newlen] = '\0';
   len = newlen;
   return 1;
 }
@@ -484,13 +546,13 @@ char String::charAt(unsigned int loc) const
 
 void String::setCharAt(unsigned int loc, char c)
 {
-  if (loc < len) buffer[loc] = c;
+  if (loc < len && makeWritable()) buffer[loc] = c;
 }
 
 char & String::operator[](unsigned int index)
 {
   static char dummy_writable_char;
-  if (index >= len || !buffer)
+  if (index >= len || !buffer || !makeWritable())
   {
     dummy_writable_char = 0;
     return dummy_writable_char;
@@ -556,12 +618,11 @@ int String::lastIndexOf(char theChar) const
 int String::lastIndexOf(char ch, int fromIndex) const
 {
   if (fromIndex >= len || fromIndex < 0) return -1;
-  char tempchar = buffer[fromIndex + 1];
-  buffer[fromIndex + 1] = '\0';
-  char* temp = strrchr(buffer, ch);
-  buffer[fromIndex + 1] = tempchar;
-  if (temp == NULL) return -1;
-  return temp - buffer;
+  for (int i = fromIndex; i >= 0; i--)
+  {
+    if (buffer[i] == ch) return i;
+  }
+  return -1;
 }
 
 int String::lastIndexOf(const String &s2) const
@@ -594,10 +655,7 @@ String String::substring(unsigned int left, unsigned int right) const
   String out;
   if (left > len) return out;
   if (right > len) right = len;
-  char temp = buffer[right];  // save the replaced character
-  buffer[right] = '\0';
-  out = buffer + left;  // pointer arithmetic
-  buffer[right] = temp;  //restore character
+  out.copy(buffer + left, right - left);
   return out;
 }
 
@@ -607,7 +665,7 @@ String String::substring(unsigned int left, unsigned int right) const
 
 void String::replace(char find, char replace)
 {
-  if (!buffer) return;
+  if (!buffer || !makeWritable()) return;
   for (char *p = buffer; *p; p++)
   {
     if (*p == find) *p = replace;
@@ -616,7 +674,7 @@ void String::replace(char find, char replace)
 
 void String::replace(const String& find, const String& replace)
 {
-  if (len == 0 || find.len == 0) return;
+  if (len == 0 || find.len == 0 || !makeWritable()) return;
   int diff = replace.len - find.len;
   char *readFrom = buffer;
   char *foundAt;
@@ -676,18 +734,25 @@ void String::remove(unsigned int index, unsigned int count){
 	if (index >= len) { return; }
 	if (count <= 0) { return; }
 	if (index + count > len) { count = len - index; }
+	if (!makeWritable()) { return; }
 	char *writeTo = buffer + index;
 	len = len - count;
-	strncpy(writeTo, buffer + index + count,len - index);
+	memmove(writeTo, buffer + index + count, len - index);
 	buffer[len] = 0;
 }
 
+// External constant is copied only when some character changes
 void String::toLowerCase(void)
 {
   if (!buffer) return;
   for (char *p = buffer; *p; p++)
   {
-    *p = tolower(*p);
+    char c = tolower(*p);
+    if (c == *p) continue;
+    unsigned int pos = p - buffer;
+    if (!makeWritable()) return;
+    p = buffer + pos;
+    *p = c;
   }
 }
 
@@ -696,19 +761,24 @@ void String::toUpperCase(void)
   if (!buffer) return;
   for (char *p = buffer; *p; p++)
   {
-    *p = toupper(*p);
+    char c = toupper(*p);
+    if (c == *p) continue;
+    unsigned int pos = p - buffer;
+    if (!makeWritable()) return;
+    p = buffer + pos;
+    *p = c;
   }
 }
 
 void String::trim(void)
 {
-  if (!buffer || len == 0) return;
+  if (!buffer || len == 0 || !makeWritable()) return;
   char *begin = buffer;
   while (isspace(*begin)) begin++;
   char *end = buffer + len - 1;
   while (isspace(*end) && end >= begin) end--;
   len = end + 1 - begin;
-  if (begin > buffer) memcpy(buffer, begin, len);
+  if (begin > buffer) memmove(buffer, begin, len);
   buffer[len] = 0;
 }
 
@@ -733,3 +803,19 @@ float String::toFloat(void) const
   p.print(buffer);
 }*/
 
+
+/*********************************************/
+/*  Hashing                                  */
+/*********************************************/
+
+uint32_t HashMapHash<String>::hash(const String& key)
+{
+  uint32_t h = 2166136261U;
+  const char* p = key.c_str();
+  for (unsigned int i = 0; i < key.length(); i++)
+  {
+    h ^= (uint8_t)p[i];
+    h *= 16777619U;
+  }
+  return h;
+}
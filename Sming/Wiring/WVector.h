@@ -8,6 +8,14 @@
 || @description
 || | Vector data structure.
 || |
+|| | Elements are stored contiguously in a single allocation which grows
+|| | geometrically, elements are moved (not copied) when storage is reallocated.
+|| | Optional InlineCapacity elements are kept inside the Vector itself,
+|| | so small vectors need no heap at all.
+|| | References to elements are invalidated when the Vector grows or elements are removed.
+|| | Insert and remove move every following element, queues of large elements
+|| | should hold pointers (see test/VectorBench.cpp).
+|| |
 || | Wiring Common API
 || #
 ||
@@ -22,15 +30,44 @@
 #include "WiringFrameworkDependencies.h"
 #include <stdlib.h>
 
+// Placement new for vector storage, a tag keeps it apart from <new>
+struct VectorPlacement {};
+inline void* operator new(size_t, void* ptr, VectorPlacement) { return ptr; }
+inline void operator delete(void*, void*, VectorPlacement) {}
+
+// Space for InlineCapacity elements inside the Vector
+template <typename Element, unsigned int InlineCapacity>
+struct VectorInlineStorage
+{
+  Element* data()
+  {
+    return (Element*)buffer;
+  }
+
+  alignas(Element) uint8_t buffer[InlineCapacity * sizeof(Element)];
+};
+
+// No inline storage, Element may be an incomplete type here
 template <typename Element>
+struct VectorInlineStorage<Element, 0>
+{
+  Element* data()
+  {
+    return nullptr;
+  }
+};
+
+template <typename Element, unsigned int InlineCapacity = 0>
 class Vector : public Countable<Element>
 {
   public:
 	typedef int (*Comparer)(const Element& lhs, const Element& rhs);
 
     // constructors
+    // initialCapacity is allocated with the first added element, capacityIncrement is the minimal growth step
 	Vector(unsigned int initialCapacity = 10, unsigned int capacityIncrement = 10);
 	Vector(const Vector& rhv);
+	Vector(Vector&& rhv);
 	virtual ~Vector();
 
     // methods
@@ -53,7 +90,9 @@ class Vector : public Countable<Element>
       return true;
     }
      void addElement(const Element& obj);
-     void addElement(Element* objp);
+     void addElement(Element&& obj);
+     // Vector can't take ownership of a heap element anymore, elements are stored by value
+     void addElement(Element* objp) = delete;
      inline void clear()
     {
       removeAllElements();
@@ -61,6 +100,7 @@ class Vector : public Countable<Element>
      void ensureCapacity(unsigned int minCapacity);
      void removeAllElements();
      boolean removeElement(const Element& obj);
+     // Only shrinks count(), larger size just reserves capacity
      void setSize(unsigned int newSize);
      void trimToSize();
      const Element& elementAt(unsigned int index) const;
@@ -76,27 +116,19 @@ class Vector : public Countable<Element>
      const Element& operator[](unsigned int index) const;
      Element& operator[](unsigned int index);
 
-     const Vector<Element>& operator=(const Vector<Element>& rhv)
+     const Vector<Element, InlineCapacity>& operator=(const Vector<Element, InlineCapacity>& rhv)
      {
     	 if (this != &rhv)
     		 copyFrom(rhv);
     	 return *this;
      }
-     const Vector<Element>& operator=(const Vector<Element>&& other) // move assignment
+     const Vector<Element, InlineCapacity>& operator=(Vector<Element, InlineCapacity>&& other) // move assignment
      {
-         if (_data != nullptr)
+         if (this != &other)
          {
-           removeAllElements();
-           delete[] _data;        // delete this storage
+           release();
+           moveFrom(other);
          }
-         _data = other._data;  // move
-         _size = other._size;
-         _capacity = other._capacity;
-         _increment = other._increment;
-         other._data = nullptr; // leave moved-from in valid state
-         other._size = 0;
-         other._capacity = 0;
-         other._increment = 0;
          return *this;
      }
 
@@ -104,149 +136,180 @@ class Vector : public Countable<Element>
 
   protected:
      void copyFrom(const Vector& rhv);
+     void moveFrom(Vector& rhv);
+     void release();
+     void grow(unsigned int minCapacity);
+
+     Element* inlineData()
+     {
+       return _inline.data();
+     }
+
+     bool isInline()
+     {
+       return _data == _inline.data();
+     }
 
   protected:
     unsigned int _size = 0;
     unsigned int _capacity = 0;
+    unsigned int _initial;
     unsigned int _increment;
-    Element** _data = nullptr;
+    Element* _data = nullptr;
+    VectorInlineStorage<Element, InlineCapacity> _inline;
 };
 
-template <class Element>
-Vector<Element>::Vector(unsigned int initialCapacity, unsigned int capacityIncrement)
+template <class Element, unsigned int InlineCapacity>
+Vector<Element, InlineCapacity>::Vector(unsigned int initialCapacity, unsigned int capacityIncrement)
 {
   _size = 0;
-  _capacity = initialCapacity;
-  _data = new Element*[ _capacity ];
+  _capacity = InlineCapacity;
+  _data = inlineData();
+  _initial = initialCapacity;
   _increment = capacityIncrement;
-  if (_data == NULL) _capacity = _increment = 0;
 };
 
-template <class Element>
-Vector<Element>::Vector(const Vector<Element>& rhv)
+template <class Element, unsigned int InlineCapacity>
+Vector<Element, InlineCapacity>::Vector(const Vector<Element, InlineCapacity>& rhv)
+{
+  _capacity = InlineCapacity;
+  _data = inlineData();
+  copyFrom(rhv);
+};
+
+template <class Element, unsigned int InlineCapacity>
+Vector<Element, InlineCapacity>::Vector(Vector<Element, InlineCapacity>&& rhv)
 {
-	copyFrom(rhv);
+  moveFrom(rhv);
 };
 
-template <class Element>
-void Vector<Element>::copyFrom(const Vector<Element>& rhv)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::copyFrom(const Vector<Element, InlineCapacity>& rhv)
 {
-	if (_data != nullptr)
-	{
-	  removeAllElements();
-	  delete[] _data;
-	}
+  removeAllElements();
+  _initial = rhv._initial;
+  _increment = rhv._increment;
+  ensureCapacity(rhv._size);
+  if (_capacity < rhv._size) return;
+
+  for (unsigned int i = 0; i < rhv._size; i++)
+    new (&_data[i], VectorPlacement()) Element(rhv._data[i]);
   _size = rhv._size;
-  _capacity = rhv._capacity;
-  _data = new Element*[ _capacity ];
+};
+
+// Expects released (or not initialized) storage
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::moveFrom(Vector<Element, InlineCapacity>& rhv)
+{
+  _initial = rhv._initial;
   _increment = rhv._increment;
-  if (_data == NULL)
+  if (rhv.isInline())
   {
-    _size = _capacity = _increment = 0;
+    _data = inlineData();
+    _capacity = InlineCapacity;
+    for (unsigned int i = 0; i < rhv._size; i++)
+    {
+      new (&_data[i], VectorPlacement()) Element(static_cast<Element&&>(rhv._data[i]));
+      rhv._data[i].~Element();
+    }
   }
-
-  for (unsigned int i = 0; i < _size; i++)
+  else
   {
-    _data[i] = new Element(*(rhv._data[i]));
+    // Take over heap storage
+    _data = rhv._data;
+    _capacity = rhv._capacity;
   }
+  _size = rhv._size;
+
+  rhv._data = rhv.inlineData(); // leave moved-from in valid state
+  rhv._size = 0;
+  rhv._capacity = InlineCapacity;
 };
 
-template <class Element>
-Vector<Element>::~Vector()
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::release()
 {
   removeAllElements();
-  delete [] _data;
+  if (!isInline())
+    free(_data);
+  _data = inlineData();
+  _capacity = InlineCapacity;
 };
 
-template <class Element>
-unsigned int Vector<Element>::capacity() const
+template <class Element, unsigned int InlineCapacity>
+Vector<Element, InlineCapacity>::~Vector()
 {
-  return _capacity;
+  release();
 };
 
-template <class Element>
-boolean Vector<Element>::contains(const Element &elem) const
+template <class Element, unsigned int InlineCapacity>
+unsigned int Vector<Element, InlineCapacity>::capacity() const
 {
-  for (unsigned int i = 0; i < _size; i++)
-  {
-    if (*_data[i] == elem)
-      return true;
-  }
+  return _capacity;
+};
 
-  return false;
+template <class Element, unsigned int InlineCapacity>
+boolean Vector<Element, InlineCapacity>::contains(const Element &elem) const
+{
+  return indexOf(elem) >= 0;
 };
 
-template <class Element>
-void Vector<Element>::copyInto(Element* array) const
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::copyInto(Element* array) const
 {
   if (array != NULL)
     for (unsigned int i = 0; i < _size; i++)
-      array[i] = *_data[i];
+      array[i] = _data[i];
 };
 
 
-template <class Element>
-const Element & Vector<Element>::elementAt(unsigned int index) const
+template <class Element, unsigned int InlineCapacity>
+const Element & Vector<Element, InlineCapacity>::elementAt(unsigned int index) const
 {
-  //static Element dummy_writable_element;
-  if (index >= _size || !_data)
-  {
-    //dummy_writable_element = 0;
-    //return dummy_writable_element;
+  if (index >= _size)
 	  abort();
-  }
-  // add check for valid index
-  return *_data[index];
+
+  return _data[index];
 };
 
-template <class Element>
-const Element & Vector<Element>::firstElement() const
+template <class Element, unsigned int InlineCapacity>
+const Element & Vector<Element, InlineCapacity>::firstElement() const
 {
-  //static Element dummy_writable_element;
-  if (_size == 0 || !_data)
-  {
-    //dummy_writable_element = 0;
-    //return dummy_writable_element;
+  if (_size == 0)
 	  abort();
-  }
 
-  return *_data[ 0 ];
+  return _data[ 0 ];
 };
 
-template <class Element>
-int Vector<Element>::indexOf(const Element &elem) const
+template <class Element, unsigned int InlineCapacity>
+int Vector<Element, InlineCapacity>::indexOf(const Element &elem) const
 {
   for (unsigned int i = 0; i < _size; i++)
   {
-    if (*_data[ i ] == elem)
+    if (_data[ i ] == elem)
       return i;
   }
 
   return -1;
 };
 
-template <class Element>
-boolean Vector<Element>::isEmpty() const
+template <class Element, unsigned int InlineCapacity>
+boolean Vector<Element, InlineCapacity>::isEmpty() const
 {
   return _size == 0;
 };
 
-template <class Element>
-const Element & Vector<Element>::lastElement() const
+template <class Element, unsigned int InlineCapacity>
+const Element & Vector<Element, InlineCapacity>::lastElement() const
 {
-  //static Element dummy_writable_element;
-  if (_size == 0 || !_data)
-  {
-    //dummy_writable_element = 0;
-    //return dummy_writable_element;
+  if (_size == 0)
 	  abort();
-  }
 
-  return *_data[ _size - 1 ];
+  return _data[ _size - 1 ];
 };
 
-template <class Element>
-int Vector<Element>::lastIndexOf(const Element &elem) const
+template <class Element, unsigned int InlineCapacity>
+int Vector<Element, InlineCapacity>::lastIndexOf(const Element &elem) const
 {
   //  check for empty vector
   if (_size == 0)
@@ -257,7 +320,7 @@ int Vector<Element>::lastIndexOf(const Element &elem) const
   do
   {
     i -= 1;
-    if (*_data[i] == elem)
+    if (_data[i] == elem)
       return i;
 
   }
@@ -266,51 +329,70 @@ int Vector<Element>::lastIndexOf(const Element &elem) const
   return -1;
 };
 
-template <class Element>
-unsigned int Vector<Element>::size() const
+template <class Element, unsigned int InlineCapacity>
+unsigned int Vector<Element, InlineCapacity>::size() const
 {
   return _size;
 };
 
-template <class Element>
-void Vector<Element>::addElement(const Element &obj)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::addElement(const Element &obj)
 {
   if (_size == _capacity)
-    ensureCapacity(_capacity + _increment);
-  if (_size < _capacity)
-    _data[ _size++ ] = new Element(obj);
+  {
+    // obj may live in this vector, keep it while storage is reallocated
+    Element tmp(obj);
+    addElement(static_cast<Element&&>(tmp));
+    return;
+  }
+  new (&_data[ _size++ ], VectorPlacement()) Element(obj);
 };
 
-template <class Element>
-void Vector<Element>::addElement(Element* objp)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::addElement(Element&& obj)
 {
   if (_size == _capacity)
-    ensureCapacity(_capacity + _increment);
+    grow(_size + 1);
   if (_size < _capacity)
-    _data[ _size++ ] = objp;
+    new (&_data[ _size++ ], VectorPlacement()) Element(static_cast<Element&&>(obj));
 };
 
-template <class Element>
-void Vector<Element>::ensureCapacity(unsigned int minCapacity)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::grow(unsigned int minCapacity)
+{
+  // Geometric growth keeps number of reallocations (and heap fragments) logarithmic
+  unsigned int newCapacity = _capacity * 2;
+  if (newCapacity < _capacity + _increment)
+    newCapacity = _capacity + _increment;
+  if (newCapacity < _initial)
+    newCapacity = _initial;
+  if (newCapacity < minCapacity)
+    newCapacity = minCapacity;
+  ensureCapacity(newCapacity);
+};
+
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::ensureCapacity(unsigned int minCapacity)
 {
   if (minCapacity > _capacity)
   {
-    unsigned int i;
-    //_capacity = minCapacity;
-    Element** temp = new Element*[ minCapacity ];
-    // copy all elements
-    if (temp != NULL)
+    Element* temp = (Element*)malloc(sizeof(Element) * minCapacity);
+    if (temp == NULL) return;
+
+    for (unsigned int i = 0; i < _size; i++)
     {
-      _capacity = minCapacity;
-      memcpy(temp, _data, sizeof(Element*) * _size);
-      delete [] _data;
-      _data = temp;
+      new (&temp[i], VectorPlacement()) Element(static_cast<Element&&>(_data[i]));
+      _data[i].~Element();
     }
+    if (!isInline())
+      free(_data);
+    _data = temp;
+    _capacity = minCapacity;
   }
 };
 
-template <class Element>
-void Vector<Element>::insertElementAt(const Element &obj, unsigned int index)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::insertElementAt(const Element &obj, unsigned int index)
 {
   if (index == _size)
     addElement(obj);
@@ -318,149 +400,141 @@ void Vector<Element>::insertElementAt(const Element &obj, unsigned int index)
   {
     //  need to verify index, right now you must know what you're doing
     if (index > _size) return;
+
+    Element tmp(obj); // obj may live in this vector
     if (_size == _capacity)
-      ensureCapacity(_capacity + _increment);
+      grow(_size + 1);
     if (_size < _capacity)
     {
-      Element* newItem = new Element(obj);  //  pointer to new item
-      Element* tmp;  // temp to hold item to be moved over
-
-      for (unsigned int i = index; i <= _size; i++)
-      {
-        tmp = _data[i];
-        _data[i] = newItem;
-
-        if (i != _size)
-          newItem = tmp;
-        else
-          break;
-      }
+      // Shift tail up by one
+      new (&_data[_size], VectorPlacement()) Element(static_cast<Element&&>(_data[_size - 1]));
+      for (unsigned int i = _size - 1; i > index; i--)
+        _data[i] = static_cast<Element&&>(_data[i - 1]);
+      _data[index] = static_cast<Element&&>(tmp);
       _size++;
     }
   }
-  //_size++;
 };
 
-template <class Element>
-const void Vector<Element>::remove(unsigned int index)
+template <class Element, unsigned int InlineCapacity>
+const void Vector<Element, InlineCapacity>::remove(unsigned int index)
 {
-  //const Element* retval = &get(index);
   removeElementAt(index);
-  //return (Element)*retval;
 };
 
-template <class Element>
-void Vector<Element>::removeAllElements()
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::removeAllElements()
 {
-  // avoid memory leak
   for (unsigned int i = 0; i < _size; i++)
-    delete _data[i];
+    _data[i].~Element();
 
   _size = 0;
 };
 
-template <class Element>
-boolean Vector<Element>::removeElement(const Element &obj)
+template <class Element, unsigned int InlineCapacity>
+boolean Vector<Element, InlineCapacity>::removeElement(const Element &obj)
 {
-  for (unsigned int i = 0; i < _size; i++)
-  {
-    if (*_data[i] == obj)
-    {
-      removeElementAt(i);
-      return true;
-    }
-  }
-  return false;
+  int index = indexOf(obj);
+  if (index < 0)
+    return false;
+
+  removeElementAt(index);
+  return true;
 };
 
-template <class Element>
-void Vector<Element>::removeElementAt(unsigned int index)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::removeElementAt(unsigned int index)
 {
   // check for valid index
   if (index >= _size) return;
 
-  delete _data[ index ];
-
-  unsigned int i;
-  for (i = index + 1; i < _size; i++)
-    _data[ i - 1 ] = _data[ i ];
+  for (unsigned int i = index + 1; i < _size; i++)
+    _data[ i - 1 ] = static_cast<Element&&>(_data[ i ]);
 
-  _data[i];
   _size--;
+  _data[ _size ].~Element();
 };
 
-template <class Element>
-void Vector<Element>::setElementAt(const Element &obj, unsigned int index)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::setElementAt(const Element &obj, unsigned int index)
 {
   // check for valid index
   if (index >= _size) return;
-  *_data[ index ] = obj;
+  _data[ index ] = obj;
 };
 
-template <class Element>
-void Vector<Element>::setSize(unsigned int newSize)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::setSize(unsigned int newSize)
 {
   if (newSize > _capacity)
     ensureCapacity(newSize);
   else if (newSize < _size)
   {
     for (unsigned int i = newSize; i < _size; i++)
-      delete _data[i];
+      _data[i].~Element();
 
     _size = newSize;
   }
 };
 
-template <class Element>
-void Vector<Element>::trimToSize()
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::trimToSize()
 {
-  if (_size != _capacity)
+  if (_size == _capacity || isInline()) return;
+
+  Element* temp;
+  unsigned int newCapacity;
+  if (_size <= InlineCapacity)
   {
-    Element** temp = new Element*[ _size ];
+    temp = inlineData();
+    newCapacity = InlineCapacity;
+  }
+  else
+  {
+    temp = (Element*)malloc(sizeof(Element) * _size);
     if (temp == NULL) return;
+    newCapacity = _size;
+  }
 
-    for (unsigned int i = 0; i < _size; i++)
-      temp[i] = _data[i];
-
-    delete [] _data;
-
-    _data = temp;
-    _capacity = _size;
+  for (unsigned int i = 0; i < _size; i++)
+  {
+    new (&temp[i], VectorPlacement()) Element(static_cast<Element&&>(_data[i]));
+    _data[i].~Element();
   }
+  free(_data);
+
+  _data = temp;
+  _capacity = newCapacity;
 };
 
-template <class Element>
-const Element & Vector<Element>::operator[](unsigned int index) const
+template <class Element, unsigned int InlineCapacity>
+const Element & Vector<Element, InlineCapacity>::operator[](unsigned int index) const
 {
   return elementAt(index);
 };
 
-template <class Element>
-Element & Vector<Element>::operator[](unsigned int index)
+template <class Element, unsigned int InlineCapacity>
+Element & Vector<Element, InlineCapacity>::operator[](unsigned int index)
 {
   // check for valid index
-  //static Element dummy_writable_element;
-  if (index >= _size || !_data)
-  {
-	//dummy_writable_element = 0;
-    //return dummy_writable_element;
+  if (index >= _size)
 	  abort();
-  }
-  return *_data[ index ];
+
+  return _data[ index ];
 };
 
-template <class Element>
-void Vector<Element>::sort(Comparer compareFunction)
+template <class Element, unsigned int InlineCapacity>
+void Vector<Element, InlineCapacity>::sort(Comparer compareFunction)
 {
    int i, j;
-   for(j = 1; j < _size; j++)   // Start with 1 (not 0)
+   for(j = 1; j < (int)_size; j++)   // Start with 1 (not 0)
    {
-    	Element* key = _data[j];
-		for(i = j - 1; (i >= 0) && compareFunction(*_data[i], *key) > 0; i--)   // Smaller values move up
+		Element key(static_cast<Element&&>(_data[j]));
+		for(i = j - 1; (i >= 0) && compareFunction(_data[i], key) > 0; i--)   // Smaller values move up
 		{
-			_data[i+1] = _data[i];
+			_data[i+1] = static_cast<Element&&>(_data[i]);
 		}
-		_data[i+1] = key;    //Put key into its proper location
+		_data[i+1] = static_cast<Element&&>(key);    //Put key into its proper location
     }
 }
 
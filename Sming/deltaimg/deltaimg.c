@@ -0,0 +1,405 @@
+/*
+ * deltaimg - creates delta patch between two rom images for rBootHttpUpdate::addPatchItem
+ *
+ * Usage:
+ *   deltaimg <source rom> <target rom> <patch>        create patch
+ *   deltaimg -a <source rom> <patch> <target rom>     apply patch (for checking)
+ *
+ * Format is read by SmingCore/Network/rBootDeltaPatcher, constants must match it.
+ * Matches are searched with hash chains: unchanged code becomes COPY, code moved
+ * elsewhere SEEK + COPY and code with changed addresses ADD of mostly zero bytes,
+ * runs of zeros are turned into COPY again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define DELTA_MAGIC 0x31544c44 // "DLT1"
+#define DELTA_COPY 1
+#define DELTA_ADD 2
+#define DELTA_INSERT 3
+#define DELTA_SEEK 4
+
+#define HASH_BITS 18
+#define HASH_KEY 4 // Bytes hashed
+#define MAX_CHAIN 128 // Candidates checked at each position
+#define MIN_MATCH 12 // Shorter match isn't worth SEEK
+#define MIN_ZERO_RUN 8 // In ADD data, replaced by COPY
+#define MAX_MATCH 0x10000
+#define SIMILAR_WINDOW 16 // Bytes compared to decide between ADD and INSERT
+#define SIMILAR_MIN 8
+
+typedef struct {
+	uint8_t* data;
+	size_t size;
+} buffer_t;
+
+static const uint8_t* src;
+static size_t ssize;
+static const uint8_t* tgt;
+static size_t tsize;
+
+static buffer_t out;
+static int pending = 0; // Command being collected
+static buffer_t pendingData;
+static size_t pendingLength = 0;
+
+static void append(buffer_t* buf, const void* data, size_t size) {
+	buf->data = realloc(buf->data, buf->size + size);
+	if (buf->data == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+}
+
+static void appendByte(buffer_t* buf, uint8_t value) {
+	append(buf, &value, 1);
+}
+
+static void appendNumber(buffer_t* buf, uint32_t value) {
+	do {
+		uint8_t b = value & 0x7F;
+		value >>= 7;
+		appendByte(buf, value ? (b | 0x80) : b);
+	} while (value);
+}
+
+static void appendUint32(buffer_t* buf, uint32_t value) {
+	uint8_t b[4] = { value, value >> 8, value >> 16, value >> 24 };
+	append(buf, b, 4);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+	uint32_t crc = 0xFFFFFFFF;
+	size_t i;
+	int k;
+	for (i = 0; i < size; i++) {
+		crc ^= data[i];
+		for (k = 0; k < 8; k++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+	return ~crc;
+}
+
+static void writeCommand(int command, uint32_t length, const uint8_t* data) {
+	appendByte(&out, command);
+	appendNumber(&out, length);
+	if (data != NULL) {
+		append(&out, data, length);
+	}
+}
+
+static void flushPending(void) {
+	size_t i, start, zeros;
+
+	if (pending == DELTA_COPY) {
+		writeCommand(DELTA_COPY, pendingLength, NULL);
+	} else if (pending == DELTA_INSERT) {
+		writeCommand(DELTA_INSERT, pendingData.size, pendingData.data);
+	} else if (pending == DELTA_ADD) {
+		// Unchanged bytes between changed ones are copied
+		start = 0;
+		i = 0;
+		while (i < pendingData.size) {
+			if (pendingData.data[i] != 0) {
+				i++;
+				continue;
+			}
+			zeros = 0;
+			while (i + zeros < pendingData.size && pendingData.data[i + zeros] == 0) {
+				zeros++;
+			}
+			if (zeros >= MIN_ZERO_RUN) {
+				if (i > start) {
+					writeCommand(DELTA_ADD, i - start, pendingData.data + start);
+				}
+				writeCommand(DELTA_COPY, zeros, NULL);
+				start = i + zeros;
+			}
+			i += zeros;
+		}
+		if (i > start) {
+			writeCommand(DELTA_ADD, i - start, pendingData.data + start);
+		}
+	}
+
+	pending = 0;
+	pendingLength = 0;
+	pendingData.size = 0;
+}
+
+static void emitCopy(size_t length) {
+	if (pending != DELTA_COPY) {
+		flushPending();
+		pending = DELTA_COPY;
+	}
+	pendingLength += length;
+}
+
+static void emitData(int command, uint8_t value) {
+	if (pending != command) {
+		flushPending();
+		pending = command;
+	}
+	appendByte(&pendingData, value);
+}
+
+static void emitSeek(long offset) {
+	flushPending();
+	if (offset != 0) {
+		appendByte(&out, DELTA_SEEK);
+		appendNumber(&out, offset < 0 ? ((uint32_t)(-offset) << 1) - 1 : (uint32_t)offset << 1);
+	}
+}
+
+static uint32_t hashAt(const uint8_t* p) {
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static size_t matchLength(size_t spos, size_t tpos) {
+	size_t n = 0;
+	while (spos + n < ssize && tpos + n < tsize && n < MAX_MATCH && src[spos + n] == tgt[tpos + n]) {
+		n++;
+	}
+	return n;
+}
+
+static int isSimilar(size_t spos, size_t tpos) {
+	int same = 0, i;
+	for (i = 0; i < SIMILAR_WINDOW && spos + i < ssize && tpos + i < tsize; i++) {
+		same += (src[spos + i] == tgt[tpos + i]);
+	}
+	return same >= SIMILAR_MIN;
+}
+
+static void createPatch(void) {
+	int32_t* head = malloc(sizeof(int32_t) << HASH_BITS);
+	int32_t* prev = malloc(sizeof(int32_t) * (ssize + 1));
+	size_t spos = 0, tpos = 0, i;
+
+	if (head == NULL || prev == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memset(head, 0xFF, sizeof(int32_t) << HASH_BITS);
+	for (i = 0; i + HASH_KEY <= ssize; i++) {
+		uint32_t h = hashAt(src + i);
+		prev[i] = head[h];
+		head[h] = i;
+	}
+
+	appendUint32(&out, DELTA_MAGIC);
+	appendUint32(&out, ssize);
+	appendUint32(&out, crc32(src, ssize));
+	appendUint32(&out, tsize);
+	appendUint32(&out, crc32(tgt, tsize));
+
+	while (tpos < tsize) {
+		size_t cont = matchLength(spos, tpos);
+		size_t bestLength = 0, bestPos = 0;
+
+		if (cont < MAX_MATCH && tpos + HASH_KEY <= tsize) {
+			int32_t p = head[hashAt(tgt + tpos)];
+			int chain = 0;
+			for (; p >= 0 && chain < MAX_CHAIN; p = prev[p], chain++) {
+				size_t len = matchLength(p, tpos);
+				if (len > bestLength) {
+					bestLength = len;
+					bestPos = p;
+				}
+			}
+		}
+
+		if (bestLength >= MIN_MATCH && bestLength > cont + MIN_MATCH / 2) {
+			emitSeek((long)bestPos - (long)spos);
+			emitCopy(bestLength);
+			tpos += bestLength;
+			spos = bestPos + bestLength;
+		} else if (cont > 0) {
+			emitCopy(cont);
+			tpos += cont;
+			spos += cont;
+		} else if (spos < ssize && isSimilar(spos, tpos)) {
+			emitData(DELTA_ADD, tgt[tpos] - src[spos]);
+			tpos++;
+			spos++;
+		} else {
+			emitData(DELTA_INSERT, tgt[tpos]);
+			tpos++;
+		}
+	}
+	flushPending();
+
+	free(head);
+	free(prev);
+}
+
+static uint32_t readUint32(const uint8_t* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int readNumber(const uint8_t* patch, size_t size, size_t* pos, uint32_t* value) {
+	int shift = 0;
+	*value = 0;
+	while (*pos < size && shift <= 28) {
+		uint8_t b = patch[(*pos)++];
+		*value |= (uint32_t)(b & 0x7F) << shift;
+		shift += 7;
+		if ((b & 0x80) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Same checks as on the device, result is in out
+static int applyPatch(const uint8_t* patch, size_t size) {
+	size_t pos = 20, spos = 0, tlen, i;
+	uint32_t length;
+	int command;
+
+	out.size = 0;
+	if (size < 20 || readUint32(patch) != DELTA_MAGIC) {
+		fprintf(stderr, "Invalid patch header\n");
+		return 0;
+	}
+	if (readUint32(patch + 4) != ssize || readUint32(patch + 8) != crc32(src, ssize)) {
+		fprintf(stderr, "Patch doesn't match the source image\n");
+		return 0;
+	}
+	tlen = readUint32(patch + 12);
+
+	while (out.size < tlen) {
+		if (pos >= size) {
+			fprintf(stderr, "Patch is incomplete\n");
+			return 0;
+		}
+		command = patch[pos++];
+		if (!readNumber(patch, size, &pos, &length)) {
+			fprintf(stderr, "Invalid number at %zu\n", pos);
+			return 0;
+		}
+		switch (command) {
+		case DELTA_COPY:
+			if (length > ssize - spos) {
+				fprintf(stderr, "Copy out of source\n");
+				return 0;
+			}
+			append(&out, src + spos, length);
+			spos += length;
+			break;
+		case DELTA_ADD:
+			if (length > ssize - spos || length > size - pos) {
+				fprintf(stderr, "Add out of source\n");
+				return 0;
+			}
+			for (i = 0; i < length; i++) {
+				appendByte(&out, src[spos + i] + patch[pos + i]);
+			}
+			spos += length;
+			pos += length;
+			break;
+		case DELTA_INSERT:
+			if (length > size - pos) {
+				fprintf(stderr, "Patch is incomplete\n");
+				return 0;
+			}
+			append(&out, patch + pos, length);
+			pos += length;
+			break;
+		case DELTA_SEEK: {
+			long offset = (length & 1) ? -(long)(length >> 1) - 1 : (long)(length >> 1);
+			if ((long)spos + offset < 0 || (long)spos + offset > (long)ssize) {
+				fprintf(stderr, "Seek out of source\n");
+				return 0;
+			}
+			spos += offset;
+			break;
+		}
+		default:
+			fprintf(stderr, "Invalid command %d at %zu\n", command, pos - 1);
+			return 0;
+		}
+	}
+
+	if (out.size != tlen || pos != size || crc32(out.data, out.size) != readUint32(patch + 16)) {
+		fprintf(stderr, "Patch result doesn't match\n");
+		return 0;
+	}
+	return 1;
+}
+
+static buffer_t readFile(const char* name) {
+	buffer_t buf = { NULL, 0 };
+	uint8_t block[4096];
+	size_t n;
+	FILE* f = fopen(name, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "Unable to open %s\n", name);
+		exit(1);
+	}
+	while ((n = fread(block, 1, sizeof(block), f)) > 0) {
+		append(&buf, block, n);
+	}
+	fclose(f);
+	return buf;
+}
+
+static void writeFile(const char* name, const buffer_t* buf) {
+	FILE* f = fopen(name, "wb");
+	if (f == NULL || fwrite(buf->data, 1, buf->size, f) != buf->size) {
+		fprintf(stderr, "Unable to write %s\n", name);
+		exit(1);
+	}
+	fclose(f);
+}
+
+int main(int argc, char* argv[]) {
+	buffer_t source, target, patch;
+
+	if (argc == 5 && strcmp(argv[1], "-a") == 0) {
+		source = readFile(argv[2]);
+		patch = readFile(argv[3]);
+		src = source.data;
+		ssize = source.size;
+		if (!applyPatch(patch.data, patch.size)) {
+			return 1;
+		}
+		writeFile(argv[4], &out);
+		return 0;
+	}
+
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <source rom> <target rom> <patch>\n", argv[0]);
+		fprintf(stderr, "       %s -a <source rom> <patch> <target rom>\n", argv[0]);
+		return 1;
+	}
+
+	source = readFile(argv[1]);
+	target = readFile(argv[2]);
+	src = source.data;
+	ssize = source.size;
+	tgt = target.data;
+	tsize = target.size;
+
+	createPatch();
+	patch = out;
+	out.data = NULL;
+	out.size = 0;
+
+	// Patch is checked before anybody tries to flash it
+	if (!applyPatch(patch.data, patch.size) || out.size != tsize || memcmp(out.data, tgt, tsize) != 0) {
+		fprintf(stderr, "Created patch is invalid\n");
+		return 1;
+	}
+
+	writeFile(argv[3], &patch);
+	printf("%s: %zu bytes, %zu%% of %s\n", argv[3], patch.size, tsize ? patch.size * 100 / tsize : 0, argv[2]);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Raw DEFLATE decoder against zlib output, encoder by round trip
+ */
+
+#include "host/test.h"
+#include "../Services/WebHelpers/deflate.h"
+
+// RFC 7692 7.2.3.1, sync flush tail 00 00 ff ff removed
+static const uint8_t helloBlock[] = {0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00};
+
+// Made by zlib with raw deflate, level 9 and level 0
+static const char dynamicText[] =
+	"humidity21.5\"temperature}21.5,4821.5value21.5sensor,{\"humidityhumidityid,\"\",:48tempera"
+	"turehumidity48temperature\":idsensor48valuetemperature21.5sensor{sensor{,21.5id:id::id21.5"
+	",temperature}valuesensortemperature,humidity{48:";
+static const uint8_t dynamicBlock[] = {
+	0x55, 0x4e, 0x5b, 0x0a, 0x80, 0x30, 0x0c, 0xbb, 0x4b, 0xbf, 0x8b, 0xa0, 0x4c, 0x18, 0xbb, 0xcd,
+	0x60, 0x05, 0x0b, 0x4e, 0x65, 0x0f, 0x41, 0x86, 0x77, 0xd7, 0x4d, 0x87, 0xf3, 0xa3, 0xa4, 0x24,
+	0x6d, 0x92, 0x29, 0x5a, 0x36, 0x1c, 0x8e, 0xa1, 0xef, 0x46, 0x08, 0x64, 0x37, 0x72, 0x3a, 0x44,
+	0x47, 0x67, 0x26, 0x50, 0xc8, 0x0c, 0xbb, 0x9e, 0x23, 0xe5, 0xc5, 0xd3, 0xe2, 0x57, 0x87, 0x09,
+	0xa6, 0xf7, 0xab, 0x22, 0x1b, 0x04, 0x40, 0x25, 0x64, 0xe3, 0x50, 0xb5, 0x1f, 0x09, 0x8a, 0xcd,
+	0xe3, 0x22, 0x64, 0xb1, 0x6d, 0xb4, 0x2f, 0x21, 0xbd, 0x80, 0x99, 0x62, 0x73, 0xff, 0xa8, 0x7b,
+	0x4a, 0xa3, 0xb6, 0x62, 0x31, 0x78, 0x4e, 0x1b, 0x1a, 0x6b, 0x70, 0x12, 0x52, 0x5d,
+};
+
+static const char fixedText[] =
+	"21.5{id}idid48\"sensor,humidity48sensortemperaturevalue},humidity:\"value21.5humiditysenso"
+	"ridhumidity:{temperature:";
+static const uint8_t fixedBlock[] = {
+	0x33, 0x32, 0xd4, 0x33, 0xad, 0xce, 0x4c, 0xa9, 0xcd, 0x4c, 0xc9, 0x4c, 0x31, 0xb1, 0x50, 0x2a,
+	0x4e, 0xcd, 0x2b, 0xce, 0x2f, 0xd2, 0xc9, 0x28, 0xcd, 0x05, 0x0a, 0x94, 0x54, 0x9a, 0x58, 0x40,
+	0x04, 0x4a, 0x52, 0x73, 0x0b, 0x52, 0x8b, 0x12, 0x4b, 0x4a, 0x8b, 0x52, 0xcb, 0x12, 0x73, 0x4a,
+	0x53, 0x6b, 0xe1, 0x2a, 0xac, 0x94, 0xc0, 0x02, 0x46, 0x40, 0x63, 0x60, 0x42, 0x10, 0x2d, 0x99,
+	0x29, 0x70, 0x25, 0xd5, 0x48, 0xda, 0xad, 0x00,
+};
+
+static const uint8_t storedBlock[] = {
+	0x01, 0x71, 0x00, 0x8e, 0xff, 0x32, 0x31, 0x2e, 0x35, 0x7b, 0x69, 0x64, 0x7d, 0x69, 0x64, 0x69,
+	0x64, 0x34, 0x38, 0x22, 0x73, 0x65, 0x6e, 0x73, 0x6f, 0x72, 0x2c, 0x68, 0x75, 0x6d, 0x69, 0x64,
+	0x69, 0x74, 0x79, 0x34, 0x38, 0x73, 0x65, 0x6e, 0x73, 0x6f, 0x72, 0x74, 0x65, 0x6d, 0x70, 0x65,
+	0x72, 0x61, 0x74, 0x75, 0x72, 0x65, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x7d, 0x2c, 0x68, 0x75, 0x6d,
+	0x69, 0x64, 0x69, 0x74, 0x79, 0x3a, 0x22, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x32, 0x31, 0x2e, 0x35,
+	0x68, 0x75, 0x6d, 0x69, 0x64, 0x69, 0x74, 0x79, 0x73, 0x65, 0x6e, 0x73, 0x6f, 0x72, 0x69, 0x64,
+	0x68, 0x75, 0x6d, 0x69, 0x64, 0x69, 0x74, 0x79, 0x3a, 0x7b, 0x74, 0x65, 0x6d, 0x70, 0x65, 0x72,
+	0x61, 0x74, 0x75, 0x72, 0x65, 0x3a,
+};
+
+static void checkInflate(const uint8_t* data, size_t length, const char* expected)
+{
+	uint8_t* out = NULL;
+	int res = raw_inflate(data, length, &out, 4096);
+	TRY(res == (int)strlen(expected));
+	TRY(memcmp(out, expected, res) == 0);
+	free(out);
+}
+
+static void testVectors()
+{
+	checkInflate(helloBlock, sizeof(helloBlock), "Hello");
+	checkInflate(dynamicBlock, sizeof(dynamicBlock), dynamicText);
+	checkInflate(fixedBlock, sizeof(fixedBlock), fixedText);
+	checkInflate(storedBlock, sizeof(storedBlock), fixedText);
+
+	// Sync flush tail may be left in place
+	std::vector<uint8_t> flushed(helloBlock, helloBlock + sizeof(helloBlock));
+	flushed.insert(flushed.end(), {0x00, 0x00, 0xff, 0xff});
+	checkInflate(flushed.data(), flushed.size(), "Hello");
+}
+
+static std::vector<uint8_t> makeInput(int kind, size_t length)
+{
+	std::vector<uint8_t> data;
+	for (size_t i = 0; i < length; i++)
+	{
+		if (kind == 0)
+			data.push_back(rand());
+		else if (kind == 1)
+			data.push_back("abc"[rand() % 3]);
+		else
+			data.push_back(dynamicText[(i * 7 + i / 300) % (sizeof(dynamicText) - 1)]);
+	}
+	return data;
+}
+
+static void testRoundTrip()
+{
+	size_t lengths[] = {0, 1, 2, 3, 100, 1000, 5000, 40000};
+	for (int kind = 0; kind < 3; kind++)
+		for (size_t length : lengths)
+			for (unsigned bits = 8; bits <= 15; bits++)
+			{
+				std::vector<uint8_t> input = makeInput(kind, length);
+				std::vector<uint8_t> packed(length + length / 4 + 64);
+				int final = bits % 2;
+				int packedLength = raw_deflate(input.data(), length, packed.data(), packed.size(), bits, final);
+				TRY(packedLength > 0);
+				if (kind == 2 && length >= 1000)
+					TRY((size_t)packedLength < length / 2);
+
+				uint8_t* out = NULL;
+				int res = raw_inflate(packed.data(), packedLength, &out, length);
+				TRY(res == (int)length);
+				TRY(length == 0 || memcmp(out, input.data(), length) == 0);
+				free(out);
+			}
+}
+
+static void testErrors()
+{
+	uint8_t* out = NULL;
+	uint8_t small[10];
+	std::vector<uint8_t> input = makeInput(0, 1000);
+	TRY(raw_deflate(input.data(), input.size(), small, sizeof(small), 15, 1) == -1);
+
+	TRY(raw_inflate(dynamicBlock, sizeof(dynamicBlock), &out, 100) == -2);
+	TRY(raw_inflate(dynamicBlock, sizeof(dynamicBlock) / 2, &out, 4096) == -1);
+
+	// Any input must fail cleanly or decode, check with CFLAGS=-fsanitize=address
+	for (int i = 0; i < 20000; i++)
+	{
+		uint8_t junk[64];
+		for (unsigned k = 0; k < sizeof(junk); k++)
+			junk[k] = rand();
+		if (i % 2)
+			junk[0] = (junk[0] & ~6) | 4; // Dynamic block header
+		int res = raw_inflate(junk, 1 + rand() % sizeof(junk), &out, 4096);
+		if (res >= 0)
+			free(out);
+	}
+}
+
+int main()
+{
+	srand(1);
+	testVectors();
+	testRoundTrip();
+	testErrors();
+	printf("deflate OK\n");
+	return 0;
+}
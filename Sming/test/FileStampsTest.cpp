@@ -0,0 +1,168 @@
+/*
+ * File change stamps of FileSystem on a SPIFFS in memory, across restarts and newly flashed images
+ */
+
+#include "host/test.h"
+#include "FileSystem.h"
+
+spiffs _filesystemStorageHandle;
+u32_t spiffs_mount_count = 0;
+
+#define FLASH_SIZE 0x40000
+
+static uint8_t flash[FLASH_SIZE];
+static unsigned long randomValue = 1000;
+
+unsigned long os_random()
+{
+	return randomValue;
+}
+
+static s32_t flashRead(u32_t addr, u32_t size, u8_t* dst)
+{
+	memcpy(dst, flash + addr, size);
+	return SPIFFS_OK;
+}
+
+static s32_t flashWrite(u32_t addr, u32_t size, u8_t* src)
+{
+	for (u32_t i = 0; i < size; i++)
+		flash[addr + i] &= src[i];
+	return SPIFFS_OK;
+}
+
+static s32_t flashErase(u32_t addr, u32_t size)
+{
+	memset(flash + addr, 0xFF, size);
+	return SPIFFS_OK;
+}
+
+static u8_t work[256 * 2];
+static u8_t fds[32 * 7];
+static u8_t cache[(256 + 32) * 4];
+
+// Device restarts, or a new image is flashed when format is set
+static void mount(bool format)
+{
+	static spiffs_config cfg;
+	cfg.phys_size = FLASH_SIZE;
+	cfg.phys_addr = 0;
+	cfg.phys_erase_block = 4096;
+	cfg.log_block_size = 8192;
+	cfg.log_page_size = 256;
+	cfg.hal_read_f = flashRead;
+	cfg.hal_write_f = flashWrite;
+	cfg.hal_erase_f = flashErase;
+
+	if (SPIFFS_mounted(&_filesystemStorageHandle))
+		SPIFFS_unmount(&_filesystemStorageHandle);
+	if (format)
+		memset(flash, 0xFF, sizeof(flash));
+	TRY(SPIFFS_mount(&_filesystemStorageHandle, &cfg, work, fds, sizeof(fds), cache, sizeof(cache), NULL) == SPIFFS_OK);
+	spiffs_mount_count++;
+}
+
+static uint32_t getStamp(const char* name, spiffs_stat& stat)
+{
+	TRY(fileStats(name, &stat) >= 0);
+	return fileGetChangeStamp(stat);
+}
+
+static uint32_t getStamp(const char* name)
+{
+	spiffs_stat stat;
+	return getStamp(name, stat);
+}
+
+static void rewrite(const char* name, const char* content)
+{
+	file_t file = fileOpen(name, eFO_WriteOnly);
+	TRY(file >= 0);
+	fileWrite(file, content, strlen(content));
+	fileClose(file);
+}
+
+static void testStamps()
+{
+	mount(true);
+
+	// Files of the image share the base stamp
+	file_t file = SPIFFS_open(&_filesystemStorageHandle, "image.htm", SPIFFS_CREAT | SPIFFS_WRONLY, 0);
+	SPIFFS_write(&_filesystemStorageHandle, file, (void*)"<html>", 6);
+	SPIFFS_close(&_filesystemStorageHandle, file);
+	TRY(getStamp("image.htm") == 1000);
+
+	// Rewritten in place, same object id and size
+	fileSetContent("a.txt", "first");
+	spiffs_stat stat1, stat2;
+	uint32_t stamp1 = getStamp("a.txt", stat1);
+	TRY(stamp1 != 1000);
+	rewrite("a.txt", "other");
+	uint32_t stamp2 = getStamp("a.txt", stat2);
+	TRY(stat1.obj_id == stat2.obj_id && stat1.size == stat2.size);
+	TRY(stamp2 != stamp1);
+
+	// Reading doesn't change it
+	file = fileOpen("a.txt", eFO_ReadOnly);
+	char buffer[8];
+	fileRead(file, buffer, sizeof(buffer));
+	fileClose(file);
+	TRY(getStamp("a.txt") == stamp2);
+
+	// Renamed file keeps content and stamp
+	fileRename("a.txt", "b.txt");
+	TRY(getStamp("b.txt") == stamp2);
+	TRY(getStamp("image.htm") == 1000);
+
+	// Stamps survive a restart
+	mount(false);
+	TRY(getStamp("b.txt") == stamp2);
+	TRY(getStamp("image.htm") == 1000);
+	rewrite("b.txt", "again");
+	uint32_t stamp3 = getStamp("b.txt");
+	TRY(stamp3 != stamp2 && stamp3 != stamp1 && stamp3 != 1000);
+
+	// Object id of a deleted file gets a new stamp
+	fileDelete("b.txt");
+	fileSetContent("c.txt", "again");
+	TRY(getStamp("c.txt") != stamp3);
+}
+
+// Side file is rewritten when it grows, stamps stay
+static void testCompacted()
+{
+	for (int i = 0; i < 300; i++)
+		rewrite("c.txt", i % 2 ? "odd" : "even");
+	uint32_t stamp = getStamp("c.txt");
+	TRY(fileGetSize(".stamps") < 1024 + 8);
+
+	mount(false);
+	TRY(getStamp("c.txt") == stamp);
+	TRY(getStamp("image.htm") == 1000);
+}
+
+// Another image with files at the same object ids and sizes
+static void testFlashed()
+{
+	spiffs_stat before;
+	getStamp("image.htm", before);
+
+	randomValue = 5000;
+	mount(true);
+	file_t file = SPIFFS_open(&_filesystemStorageHandle, "image.htm", SPIFFS_CREAT | SPIFFS_WRONLY, 0);
+	SPIFFS_write(&_filesystemStorageHandle, file, (void*)"<body>", 6);
+	SPIFFS_close(&_filesystemStorageHandle, file);
+
+	spiffs_stat after;
+	TRY(getStamp("image.htm", after) == 5000);
+	TRY(after.obj_id == before.obj_id && after.size == before.size);
+}
+
+int main()
+{
+	testStamps();
+	testCompacted();
+	testFlashed();
+	printf("FileStamps OK\n");
+	return 0;
+}
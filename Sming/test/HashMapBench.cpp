@@ -0,0 +1,148 @@
+/*
+ * HashMap against the linear one it replaced: insert, lookup, remove and heap use
+ */
+
+#include "host/test.h"
+#include "LinearHashMap.h"
+
+static const int rounds = 200000; // Operations timed per case
+
+static double nowNs()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename K> K makeKey(int i);
+
+template<> String makeKey<String>(int i)
+{
+	return String("x-header-") + String(i);
+}
+
+template<> int makeKey<int>(int i)
+{
+	return i * 7919;
+}
+
+struct Result
+{
+	double insert; // ns per item
+	double lookup; // ns per lookup
+	double remove; // ns per remove + insert
+	unsigned allocations; // heap calls to fill the map
+	size_t bytes; // heap held by the filled map
+};
+
+template<typename Map, typename K>
+static Result measure(int items, const std::vector<K>& keys)
+{
+	Result res;
+	int repeat = max(1, rounds / items);
+
+	hostHeapReset();
+	size_t heapStart = hostHeap.used;
+	{
+		Map map;
+		for (int i = 0; i < items; i++)
+			map[keys[i]] = i;
+		res.allocations = hostHeap.allocations;
+		res.bytes = hostHeap.used - heapStart;
+	}
+
+	double start = nowNs();
+	for (int r = 0; r < repeat; r++)
+	{
+		Map map;
+		for (int i = 0; i < items; i++)
+			map[keys[i]] = i;
+	}
+	res.insert = (nowNs() - start) / (repeat * items);
+
+	Map map;
+	for (int i = 0; i < items; i++)
+		map[keys[i]] = i;
+
+	int lookups = max(rounds, items);
+	long sum = 0;
+	start = nowNs();
+	for (int i = 0; i < lookups; i++)
+		sum += map[keys[(i * 31) % items]];
+	res.lookup = (nowNs() - start) / lookups;
+	TRY(sum > 0 || items == 1);
+
+	// Header maps and request parameters are mostly read, items are removed and added back rarely
+	int removes = max(1000, rounds / items);
+	start = nowNs();
+	for (int i = 0; i < removes; i++)
+	{
+		const K& key = keys[(i * 13) % items];
+		map.remove(key);
+		map[key] = i;
+	}
+	res.remove = (nowNs() - start) / removes;
+	TRY((int)map.count() == items);
+
+	return res;
+}
+
+template<typename K>
+static void compare(const char* type, int items)
+{
+	std::vector<K> keys;
+	for (int i = 0; i < items; i++)
+		keys.push_back(makeKey<K>(i));
+
+	Result linear = measure<LinearHashMap<K, int>, K>(items, keys);
+	Result hashed = measure<HashMap<K, int>, K>(items, keys);
+
+	// Lookups which pay for the slower remove, index is rebuilt on every remove
+	double breakEven = (hashed.remove - linear.remove) / (linear.lookup - hashed.lookup);
+
+	printf("%-6s %4d | %7.1f %7.1f | %7.1f %7.1f | %7.1f %7.1f %5.1f | %5u %5u | %6u %6u\n", type, items,
+		   linear.insert, hashed.insert, linear.lookup, hashed.lookup, linear.remove, hashed.remove,
+		   max(breakEven, 0.0), linear.allocations, hashed.allocations, (unsigned)linear.bytes,
+		   (unsigned)hashed.bytes);
+}
+
+// Both maps keep the same content through random operations
+static void checkEqual()
+{
+	LinearHashMap<String, int> linear;
+	HashMap<String, int> hashed;
+	srand(1);
+	for (int i = 0; i < 20000; i++)
+	{
+		String key = makeKey<String>(rand() % 100);
+		if (rand() % 3 == 0)
+		{
+			linear.remove(key);
+			hashed.remove(key);
+		}
+		else
+		{
+			linear[key] = i;
+			hashed[key] = i;
+		}
+		TRY(linear.count() == hashed.count());
+	}
+	for (unsigned i = 0; i < hashed.count(); i++)
+	{
+		TRY(linear.keyAt(i) == hashed.keyAt(i));
+		TRY(linear.valueAt(i) == hashed.valueAt(i));
+	}
+}
+
+int main()
+{
+	checkEqual();
+
+	printf("HashMap, linear | hashed; ns per operation, heap to hold items (%d bit host)\n", (int)sizeof(void*) * 8);
+	printf("key   items |  insert         |  lookup         |  remove+insert  lookups | allocs      | bytes\n");
+	int sizes[] = {4, 8, 16, 32, 128, 512};
+	for (int items : sizes)
+		compare<String>("String", items);
+	for (int items : sizes)
+		compare<int>("int", items);
+	return 0;
+}
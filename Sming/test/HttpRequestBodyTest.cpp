@@ -0,0 +1,197 @@
+/*
+ * Request body passed to body parsers which pause it, and to rBootUploadParser with slow flash writes
+ */
+
+#include "host/test.h"
+#include "Network/HttpRequest.h"
+#include "Network/HttpServer.h"
+#include "Network/HttpServerConnection.h"
+#include "Network/rBootUploadParser.h"
+
+static HttpBodyParserDelegate testParser;
+
+// Only linked, server isn't used otherwise
+bool HttpServer::isHeaderProcessingEnabled(const StringView& name)
+{
+	return true;
+}
+
+HttpBodyParserDelegate HttpServer::getBodyParser(HttpRequest& request)
+{
+	return testParser;
+}
+
+// Requests aren't owned by a connection here, the test parses again after resume
+void HttpServerConnection::onBodyResumed()
+{
+}
+
+alignas(HttpServer) static char serverSpace[sizeof(HttpServer)];
+static HttpServer* server = (HttpServer*)serverSpace;
+
+// Flash of the rBoot parser, sector erase takes 30 ms
+static std::string flash;
+
+rboot_write_status rboot_write_init(uint32 start_addr)
+{
+	rboot_write_status status = {};
+	status.start_addr = start_addr;
+	status.last_sector_erased = -1;
+	flash.clear();
+	return status;
+}
+
+bool rboot_write_flash(rboot_write_status* status, uint8* data, uint16 len)
+{
+	int32 sector = (flash.size() + len - 1) / SECTOR_SIZE;
+	if (len > 0 && sector > status->last_sector_erased)
+	{
+		os_delay_us(30000);
+		status->last_sector_erased = sector;
+	}
+	flash.append((char*)data, len);
+	return true;
+}
+
+bool rboot_write_end(rboot_write_status* status)
+{
+	return true;
+}
+
+// Stores the body, pauses after every chunk until the test resumes it
+static std::string body;
+static std::string events;
+
+static bool pausingParser(HttpRequest& request, const char* at, int length)
+{
+	if (length == PARSE_DATASTART)
+		events += "S";
+	else if (length == PARSE_DATAEND)
+		events += "E";
+	else if (length == PARSE_DATAABORT)
+		events += "A";
+	else
+	{
+		body.append(at, length);
+		request.pauseBody();
+	}
+	return true;
+}
+
+static std::string randomBody(size_t size)
+{
+	std::string data;
+	for (size_t i = 0; i < size; i++)
+		data += (char)rand();
+	return data;
+}
+
+static HttpRequest* parseHeader(const std::string& content)
+{
+	std::string header = "POST /upload HTTP/1.1\r\nContent-Length: " + std::string(String(content.size()).c_str())
+			+ "\r\n\r\n";
+	HostPbufChain chain(header, {});
+	HttpRequest* request = new HttpRequest();
+	int pos = 0;
+	TRY(request->parseHeader(server, chain.head(), pos) == eHPR_Successful);
+	TRY(request->getContentLength() == (int)content.size());
+	return request;
+}
+
+// Body arrives in segments of a few TCP packets, parsing stops while the body is paused
+static void testPaused()
+{
+	std::string content = randomBody(20000);
+	testParser = pausingParser;
+	body.clear();
+	events.clear();
+
+	HttpRequest* request = parseHeader(content);
+	size_t received = 0;
+	int pauses = 0;
+	HttpParseResult res = eHPR_Wait;
+	while (res == eHPR_Wait)
+	{
+		std::vector<size_t> lengths;
+		for (int i = 0; i < 3; i++)
+			lengths.push_back(1 + rand() % 1460);
+		size_t size = min(lengths[0] + lengths[1] + lengths[2], content.size() - received);
+		std::string data = content.substr(received, size); // Chain points into it
+		HostPbufChain chain(data, lengths);
+
+		// Connection keeps data until they are parsed
+		int pos = 0;
+		while (true)
+		{
+			res = request->parsePostData(server, chain.head(), pos);
+			TRY(body.size() == received + pos);
+			if (!request->isBodyPaused())
+				break;
+			TRY(res == eHPR_Wait);
+			TRY(events == "S");
+			pauses++;
+			request->resumeBody();
+		}
+		TRY(pos == (int)size);
+		received += size;
+	}
+
+	TRY(res == eHPR_Successful);
+	TRY(body == content);
+	TRY(events == "SE");
+	TRY(pauses > 10);
+	delete request;
+
+	// Paused body of a lost connection is aborted
+	events.clear();
+	request = parseHeader(content);
+	std::string data = content.substr(0, 100);
+	HostPbufChain chain(data, {});
+	int pos = 0;
+	TRY(request->parsePostData(server, chain.head(), pos) == eHPR_Wait && request->isBodyPaused());
+	delete request;
+	TRY(events == "SA");
+}
+
+// Chunks written after a sector erase wait for the next timer tick
+static void testUpload()
+{
+	rBootUploadParser uploader(0x102000);
+	testParser = HttpBodyParserDelegate(&rBootUploadParser::parse, &uploader);
+	std::string content = randomBody(50000);
+
+	HttpRequest* request = parseHeader(content);
+	int pauses = 0;
+	size_t received = 0;
+	HttpParseResult res = eHPR_Wait;
+	while (res == eHPR_Wait)
+	{
+		size_t size = min((size_t)1460, content.size() - received);
+		std::string data = content.substr(received, size);
+		HostPbufChain chain(data, {});
+		int pos = 0;
+		res = request->parsePostData(server, chain.head(), pos);
+		while (request->isBodyPaused())
+		{
+			pauses++;
+			hostAdvanceTime(1);
+			res = request->parsePostData(server, chain.head(), pos);
+		}
+		TRY(pos == (int)size);
+		received += size;
+	}
+
+	TRY(res == eHPR_Successful);
+	TRY(flash == content);
+	TRY(pauses == (int)(content.size() + SECTOR_SIZE - 1) / SECTOR_SIZE);
+	delete request;
+}
+
+int main()
+{
+	srand(1);
+	testPaused();
+	testUpload();
+	printf("HttpRequestBody OK\n");
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * HttpRequestParser fed with the same request split at random points
+ */
+
+#include "host/test.h"
+#include "Network/HttpRequestParser.h"
+
+class TestParser : public HttpRequestParser
+{
+public:
+	std::string method, path, version;
+	std::map<std::string, std::string> query, headers;
+
+protected:
+	void onRequestMethod(const char* value) { method = value; }
+	void onRequestPath(const char* value) { path = value; }
+	void onQueryParameter(const char* name, const char* value) { query[name] = value; }
+	void onRequestVersion(const char* value) { version = value; }
+	bool onHeaderName(const StringView& name) { return !name.equalsIgnoreCase("skip-me"); }
+	void onHeader(const char* name, const char* value) { headers[name] = value; }
+};
+
+static const std::string longValue(1000, 'y');
+static const std::string request = "GET /api/x?a=1&b=hello%20world&c&d=+x HTTP/1.1\r\n"
+	"Host: esp\r\n"
+	"Skip-Me: zzzz\r\n"
+	"Cookie: a=1; b=2\r\n"
+	"X-Long: " + longValue + "  \r\n"
+	"\r\n"
+	"BODY";
+
+static void checkRequest(TestParser& parser)
+{
+	TRY(parser.method == "GET");
+	TRY(parser.path == "/api/x");
+	TRY(parser.version == "HTTP/1.1");
+	TRY(parser.query.size() == 4);
+	TRY(parser.query["a"] == "1");
+	TRY(parser.query["b"] == "hello world");
+	TRY(parser.query.count("c") == 1);
+	TRY(parser.query["d"] == " x");
+	TRY(parser.headers.size() == 3);
+	TRY(parser.headers["host"] == "esp");
+	TRY(parser.headers["cookie"] == "a=1; b=2");
+	TRY(parser.headers["x-long"] == longValue);
+}
+
+// Request arrives in several receive calls, each one a pbuf chain of several segments
+static void testRandomSplit(int iterations)
+{
+	for (int iter = 0; iter < iterations; iter++)
+	{
+		TestParser parser;
+		HttpParseResult res = eHPR_Wait;
+		size_t pos = 0;
+		std::string body;
+		while (pos < request.size())
+		{
+			size_t chunk = (iter % 3 == 0) ? 1 + rand() % 3 : 1 + rand() % 200;
+			std::string data = request.substr(pos, chunk);
+			pos += data.size();
+
+			if (res == eHPR_Successful)
+			{
+				body += data;
+				continue;
+			}
+
+			std::vector<size_t> lengths;
+			for (int i = rand() % 3; i > 0; i--)
+				lengths.push_back(1 + rand() % 50);
+			HostPbufChain chain(data, lengths);
+			int bufPos = 0;
+			res = parser.parse(chain.head(), bufPos);
+			TRY(res != eHPR_Failed);
+			if (res == eHPR_Successful)
+				body = data.substr(bufPos);
+		}
+
+		TRY(res == eHPR_Successful);
+		TRY(body == "BODY");
+		checkRequest(parser);
+	}
+}
+
+static void testOffset()
+{
+	std::string data = "XXXX" + request;
+	HostPbufChain chain(data, {2, 7});
+	TestParser parser;
+	int bufPos = 4;
+	TRY(parser.parse(chain.head(), bufPos) == eHPR_Successful);
+	TRY(data.substr(bufPos) == "BODY");
+	checkRequest(parser);
+}
+
+static void testTooLong()
+{
+	std::string data = "GET / HTTP/1.1\r\nX: " + std::string(NETWORK_MAX_HTTP_PARSING_LEN + 100, 'a') + "\r\n\r\n";
+	for (size_t split = 1; split < data.size(); split *= 3)
+	{
+		TestParser parser;
+		HttpParseResult res = eHPR_Wait;
+		for (size_t pos = 0; pos < data.size() && res == eHPR_Wait; pos += split)
+		{
+			std::string part = data.substr(pos, split);
+			HostPbufChain chain(part, {});
+			int bufPos = 0;
+			res = parser.parse(chain.head(), bufPos);
+		}
+		TRY(res == eHPR_Failed);
+	}
+}
+
+int main()
+{
+	srand(1);
+	testRandomSplit(3000);
+	testOffset();
+	testTooLong();
+	printf("HttpRequestParser OK\n");
+	return 0;
+}
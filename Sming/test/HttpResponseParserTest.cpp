@@ -0,0 +1,190 @@
+/*
+ * HttpResponseParser fed with a stream of responses split at random points
+ */
+
+#include "host/test.h"
+#include "Network/HttpResponseParser.h"
+
+class TestParser : public HttpResponseParser
+{
+public:
+	int code = 0;
+	std::string headers;
+	std::string body;
+
+protected:
+	void onResponseStatus(int code)
+	{
+		this->code = code;
+	}
+
+	void onResponseHeader(const PbufSlice& name, const PbufSlice& value)
+	{
+		headers += std::string(name.toString().c_str()) + "=" + value.toString().c_str() + "|";
+	}
+
+	void onResponseBody(uint8_t* data, size_t size)
+	{
+		body.append((char*)data, size);
+	}
+};
+
+struct Response
+{
+	int code;
+	std::string headers;
+	std::string body;
+	bool persistent;
+};
+
+// Returns complete responses, failed is set if parser rejected the stream
+static std::vector<Response> run(const std::string& data, bool closeAtEnd, bool& failed, bool& started)
+{
+	std::vector<Response> responses;
+	TestParser parser;
+	failed = false;
+	for (size_t pos = 0; pos < data.size();)
+	{
+		// Receive call of up to three pbufs
+		std::vector<size_t> lengths;
+		size_t total = 0;
+		for (int i = 1 + rand() % 3; i > 0; i--)
+		{
+			size_t length = (rand() % 5 == 0) ? 500 : 1 + rand() % 40;
+			lengths.push_back(length);
+			total += length;
+		}
+		std::string part = data.substr(pos, total);
+		pos += part.size();
+		HostPbufChain chain(part, lengths);
+
+		int bufPos = 0;
+		while (bufPos < (int)part.size())
+		{
+			HttpParseResult res = parser.parse(chain.head(), bufPos);
+			if (res == eHPR_Failed)
+			{
+				failed = true;
+				return responses;
+			}
+			if (res != eHPR_Successful)
+				break;
+
+			responses.push_back({parser.code, parser.headers, parser.body, parser.isPersistent()});
+			parser.headers.clear();
+			parser.body.clear();
+			parser.reset();
+		}
+	}
+
+	if (closeAtEnd && parser.isStarted() && parser.finish())
+		responses.push_back({parser.code, parser.headers, parser.body, parser.isPersistent()});
+	started = parser.isStarted();
+	return responses;
+}
+
+static std::vector<Response> run(const std::string& data, bool closeAtEnd, bool& failed)
+{
+	bool started;
+	return run(data, closeAtEnd, failed, started);
+}
+
+static void testStream()
+{
+	std::string big(3000, 'x');
+	for (size_t i = 0; i < big.size(); i++)
+		big[i] = 'a' + i % 26;
+
+	std::string chunked;
+	for (size_t i = 0; i < big.size(); i += 700)
+	{
+		std::string chunk = big.substr(i, 700);
+		char size[16];
+		sprintf(size, "%X;ext=1\r\n", (unsigned)chunk.size());
+		chunked += size + chunk + "\r\n";
+	}
+	chunked += "0\r\nX-Trailer: 1\r\n\r\n";
+
+	std::string stream = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nContent-Type: text/plain\r\n\r\nhello"
+						 "HTTP/1.1 100 Continue\r\n\r\n"
+						 "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n"
+		+ chunked + "HTTP/1.1 204 No Content\r\n\r\n"
+					"HTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n"
+					"HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 3\r\n\r\nabc"
+					"HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n"
+		+ big;
+
+	for (int round = 0; round < 300; round++)
+	{
+		bool failed;
+		std::vector<Response> res = run(stream, true, failed);
+		TRY(!failed);
+		TRY(res.size() == 6);
+		TRY(res[0].code == 200 && res[0].body == "hello" && res[0].persistent);
+		TRY(res[0].headers == "Content-Length=5|Content-Type=text/plain|");
+		TRY(res[1].code == 201 && res[1].body == big && res[1].persistent);
+		TRY(res[2].code == 204 && res[2].body.empty() && res[2].persistent);
+		TRY(res[3].code == 200 && res[3].body.empty());
+		TRY(res[4].code == 200 && res[4].body == "abc" && res[4].persistent);
+		TRY(res[5].code == 200 && res[5].body == big && !res[5].persistent);
+	}
+}
+
+static void testConnectionEnd()
+{
+	bool failed;
+	bool started;
+
+	// HTTP/1.0 without length ends with the connection
+	std::vector<Response> res = run("HTTP/1.0 200 OK\r\n\r\nbody", false, failed, started);
+	TRY(res.empty() && started);
+	res = run("HTTP/1.0 200 OK\r\n\r\nbody", true, failed);
+	TRY(res.size() == 1 && res[0].body == "body" && !res[0].persistent);
+
+	// Truncated Content-Length body is not complete
+	res = run("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc", true, failed);
+	TRY(res.empty() && !failed);
+}
+
+static void testMalformed()
+{
+	std::string many = "HTTP/1.1 200 OK\r\n";
+	for (int i = 0; i < 100; i++)
+		many += "X-Header: " + std::string(50, 'b') + "\r\n";
+
+	std::string invalid[] = {
+		"FOO 200\r\n\r\n",
+		"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+		"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n",
+		"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nFFFFFFFF\r\n",
+		"HTTP/1.1 200 OK\r\nX: " + std::string(HTTP_RESPONSE_MAX_LINE_LENGTH + 100, 'a') + "\r\n\r\n",
+		many + "\r\n",
+	};
+	for (const std::string& data : invalid)
+	{
+		bool failed;
+		run(data, false, failed);
+		TRY(failed);
+	}
+
+	// Random chunk framing must fail or parse, never crash, check with CFLAGS=-fsanitize=address
+	const char* alphabet = "0123456789aF\r\n;x ";
+	for (int i = 0; i < 2000; i++)
+	{
+		std::string data = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+		for (int n = rand() % 200; n > 0; n--)
+			data += alphabet[rand() % strlen(alphabet)];
+		bool failed;
+		run(data, true, failed);
+	}
+}
+
+int main()
+{
+	srand(1);
+	testStream();
+	testConnectionEnd();
+	testMalformed();
+	printf("HttpResponseParser OK\n");
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * JsonDownloadSink over documents split at random places
+ */
+
+#include "host/test.h"
+#include "Network/HttpClientSink.h"
+
+// Other sinks aren't tested, they only have to link
+rboot_write_status rboot_write_init(uint32 start_addr)
+{
+	rboot_write_status status = {};
+	return status;
+}
+
+bool rboot_write_flash(rboot_write_status* status, uint8* data, uint16 len)
+{
+	return false;
+}
+
+bool rboot_write_end(rboot_write_status* status)
+{
+	return false;
+}
+
+file_t fileOpen(const String name, FileOpenFlags flags)
+{
+	return -1;
+}
+
+void fileClose(file_t file)
+{
+}
+
+size_t fileWrite(file_t file, const void* data, size_t size)
+{
+	return 0;
+}
+
+void fileDelete(const String name)
+{
+}
+
+// Sink doesn't use the client
+alignas(HttpClient) static char clientSpace[sizeof(HttpClient)];
+static HttpClient& client = *(HttpClient*)clientSpace;
+
+static std::string values;
+
+static void onValue(const String& path, const String& value)
+{
+	values += std::string(path.c_str()) + "=" + value.c_str() + ";";
+}
+
+static bool parse(JsonDownloadSink& sink, const std::string& doc, int maxPart)
+{
+	values.clear();
+	if (!sink.write(client, NULL, PARSE_DATASTART, 0, -1))
+		return false;
+
+	for (size_t pos = 0; pos < doc.size();)
+	{
+		size_t size = 1 + rand() % maxPart;
+		size = min(size, doc.size() - pos);
+		if (!sink.write(client, (const uint8_t*)doc.data() + pos, size, pos, doc.size()))
+			return false;
+		pos += size;
+	}
+
+	return sink.write(client, NULL, PARSE_DATAEND, doc.size(), doc.size());
+}
+
+static bool parse(const std::string& doc)
+{
+	JsonDownloadSink sink(onValue);
+	return parse(sink, doc, 7);
+}
+
+static void testValues()
+{
+	std::string doc = " {\"a\": 1, \"b\": {\"c\": \"x\\\"y\\u00e9\\n\", \"d\": [true, false, null, -1.5e3, [], {},"
+			" [\"q\", {\"e\": 2}]]}, \"f\":[]}\r\n";
+	std::string expected = "a=1;b.c=x\"y\xc3\xa9\n;b.d[0]=true;b.d[1]=false;b.d[2]=null;b.d[3]=-1.5e3;"
+			"b.d[6][0]=q;b.d[6][1].e=2;";
+
+	// Same sink is reused for the next response
+	JsonDownloadSink sink(onValue);
+	for (int round = 0; round < 300; round++)
+	{
+		TRY(parse(sink, doc, 1 + round % 20));
+		TRY(values == expected);
+	}
+
+	TRY(parse("42") && values == "=42;");
+	TRY(parse("\"s\"") && values == "=s;");
+	TRY(parse("[[[[[[[[1]]]]]]]]") && values == "[0][0][0][0][0][0][0][0]=1;");
+	TRY(parse("{\"k\": \"" + std::string(JSON_SINK_MAX_TOKEN, 'z') + "\"}"));
+}
+
+static void testInvalid()
+{
+	TRY(!parse(""));
+	TRY(!parse("{\"a\":1"));
+	TRY(!parse("{\"a\":1]"));
+	TRY(!parse("[1,2]x"));
+	TRY(!parse("{\"a\" 1}"));
+	TRY(!parse("[1,]x"));
+	TRY(!parse("[[[[[[[[[1]]]]]]]]]")); // Deeper than JSON_SINK_MAX_DEPTH
+	TRY(!parse("{\"k\": \"" + std::string(JSON_SINK_MAX_TOKEN + 1, 'z') + "\"}"));
+
+	// Lost connection, next response starts over
+	JsonDownloadSink sink(onValue);
+	TRY(sink.write(client, NULL, PARSE_DATASTART, 0, -1));
+	TRY(sink.write(client, (const uint8_t*)"{\"a\": [1", 8, 0, -1));
+	TRY(sink.write(client, NULL, PARSE_DATAABORT, 8, -1));
+	TRY(parse(sink, "[1]", 2) && values == "[0]=1;");
+}
+
+int main()
+{
+	srand(1);
+	testValues();
+	testInvalid();
+	printf("JsonDownloadSink OK\n");
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * HashMap of Sming before the hash index was added: every item allocated on its own,
+ * linear search, capacity grows by one. Reference for HashMapBench.
+ */
+
+#ifndef _SMING_TEST_LINEARHASHMAP_H_
+#define _SMING_TEST_LINEARHASHMAP_H_
+
+template<typename K, typename V>
+class LinearHashMap
+{
+  public:
+    typedef bool (*comparator)(K, K);
+
+    LinearHashMap(comparator compare = 0)
+    {
+      cb_comparator = compare;
+      currentIndex = 0;
+      size = 0;
+      keys = NULL;
+      values = NULL;
+    }
+
+    ~LinearHashMap()
+    {
+    	clear();
+    }
+
+    unsigned int count() const
+    {
+      return currentIndex;
+    }
+
+    K keyAt(unsigned int idx) const
+    {
+      return *keys[idx];
+    }
+
+    V valueAt(unsigned int idx) const
+    {
+      return *values[idx];
+    }
+
+    const V& operator[](const K key) const
+    {
+      return operator[](key);
+    }
+
+    V& operator[](const K key)
+    {
+      if (contains(key))
+      {
+        return *values[indexOf(key)];
+      }
+      if (currentIndex >= size)
+      {
+    	  allocate(currentIndex + 1);
+      }
+      *keys[currentIndex] = key;
+      *values[currentIndex] = nil;
+      currentIndex++;
+      return *values[currentIndex - 1];
+    }
+
+    void allocate(int newSize)
+    {
+    	if (newSize <= size) return;
+
+    	K** nkeys = new K*[newSize];
+    	V** nvalues = new V*[newSize];
+
+    	if (keys != NULL)
+    	{
+			for (int i = 0; i < size; i++)
+			{
+				nkeys[i] = keys[i];
+				nvalues[i] = values[i];
+			}
+
+			delete[] keys;
+			delete[] values;
+    	}
+		for (int i = size; i < newSize; i++)
+		{
+			nkeys[i] = new K();
+			nvalues[i] = new V();
+		}
+
+    	keys = nkeys;
+    	values = nvalues;
+    	size = newSize;
+    }
+
+    unsigned int indexOf(K key) const
+    {
+      for (int i = 0; i < currentIndex; i++)
+      {
+        if (cb_comparator)
+        {
+          if (cb_comparator(key, *keys[i]))
+          {
+            return i;
+          }
+        }
+        else
+        {
+          if (key == *keys[i])
+          {
+            return i;
+          }
+        }
+      }
+      return -1;
+    }
+
+    bool contains(K key) const
+    {
+      for (int i = 0; i < currentIndex; i++)
+      {
+        if (cb_comparator)
+        {
+          if (cb_comparator(key, *keys[i]))
+          {
+            return true;
+          }
+        }
+        else
+        {
+          if (key == *keys[i])
+          {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    void remove(K key)
+    {
+      int index = indexOf(key);
+      if (contains(key))
+      {
+        for (int i = index; i < size - 1; i++)
+        {
+          *keys[i] = *keys[i + 1];
+          *values[i] = *values[i + 1];
+        }
+        currentIndex--;
+      }
+    }
+
+    void clear()
+    {
+    	if (keys != NULL)
+    	{
+    		for (int i = 0; i < size; i++)
+			{
+				delete keys[i];
+				delete values[i];
+			}
+			delete[] keys;
+			delete[] values;
+			keys = NULL;
+			values = NULL;
+    	}
+    	currentIndex = 0;
+    	size = 0;
+    }
+
+    void setMultiple(const LinearHashMap<K, V>& map)
+    {
+    	for (int i = 0; i < map.count(); i++)
+    	{
+    		(*this)[map.keyAt(i)] = map.valueAt(i);
+    	}
+    }
+
+    void setNullValue(V nullv)
+    {
+      nil = nullv;
+    }
+
+  protected:
+    K **keys;
+    V **values;
+    V nil;
+    int16_t currentIndex;
+    int16_t size;
+    comparator cb_comparator;
+
+  private:
+    LinearHashMap(const LinearHashMap<K, V>& that);
+};
+
+#endif /* _SMING_TEST_LINEARHASHMAP_H_ */
@@ -0,0 +1,142 @@
+/*
+ * MqttPacketParser fed with a packet stream cut into segments of any size
+ */
+
+#include "host/test.h"
+#include "Network/MqttPacketParser.h"
+
+class TestParser : public MqttPacketParser
+{
+public:
+	std::string log;
+
+protected:
+	void onPublishData(const StringView& topic, uint8_t flags, uint16_t msgId, size_t offset, uint8_t* data,
+					   size_t size, size_t totalLength)
+	{
+		// Topic stays the same while the message continues in the next receive calls
+		std::string name(topic.data(), topic.length());
+		TRY(offset == message.size());
+		TRY(offset == 0 || name == messageTopic);
+		messageTopic = name;
+		message.append((char*)data, size);
+		if (offset + size < totalLength)
+			return;
+
+		log += "P[" + name + "," + std::to_string(flags) + "," + std::to_string(msgId) + "]";
+		log += message + "|";
+		message.clear();
+	}
+
+	void onPublishSkipped(uint8_t flags, uint16_t msgId)
+	{
+		log += "S[" + std::to_string(flags) + "," + std::to_string(msgId) + "]|";
+	}
+
+	void onPacket(uint8_t type, const uint8_t* body, size_t size, size_t totalLength)
+	{
+		log += "T" + std::to_string(type >> 4) + ":" + std::to_string(size) + "/" + std::to_string(totalLength);
+		for (size_t i = 0; i < size; i++)
+			log += "," + std::to_string(body[i]);
+		log += "|";
+	}
+
+private:
+	std::string message;
+	std::string messageTopic;
+};
+
+static std::string publish(const std::string& topic, const std::string& message, int qos, int msgId)
+{
+	std::string packet(1, 0x30 | (qos << 1));
+	size_t remaining = 2 + topic.size() + (qos ? 2 : 0) + message.size();
+	do
+	{
+		uint8_t digit = remaining % 128;
+		remaining /= 128;
+		packet += (char)(remaining ? digit | 0x80 : digit);
+	} while (remaining);
+
+	packet += (char)(topic.size() >> 8);
+	packet += (char)(topic.size() & 0xff);
+	packet += topic;
+	if (qos)
+	{
+		packet += (char)(msgId >> 8);
+		packet += (char)(msgId & 0xff);
+	}
+	return packet + message;
+}
+
+// Each parse() gets a chain of two segments
+static bool feed(TestParser& parser, const std::string& data, size_t segment)
+{
+	for (size_t pos = 0; pos < data.size(); pos += 2 * segment)
+	{
+		std::string part = data.substr(pos, 2 * segment);
+		HostPbufChain chain(part, {segment});
+		if (!parser.parse(chain.head()))
+			return false;
+	}
+	return true;
+}
+
+static void testSegments()
+{
+	std::string big(20000, 'q');
+	big[19999] = 'E';
+	std::string longTopic(MQTT_MAX_TOPIC_LENGTH + 44, 't');
+
+	std::string data = std::string("\x20\x02\x00\x00", 4) // CONNACK
+		+ publish("a/b", "hello", 0, 0)
+		+ publish("t", "", 1, 258)
+		+ std::string("\xd0\x00", 2) // PINGRESP
+		+ publish("x/y/long-topic", big, 2, 7)
+		+ publish(longTopic, "skipped", 1, 9)
+		+ publish(longTopic, "", 2, 10)
+		+ std::string("\x40\x02\x01\x02", 4) // PUBACK
+		+ std::string("\x90\x03\x00\x05\x01", 5) // SUBACK
+		+ publish("", "z", 0, 0);
+	std::string expected = "T2:2/2,0,0|P[a/b,0,0]hello|P[t,2,258]|T13:0/0|P[x/y/long-topic,4,7]" + big
+		+ "|S[2,9]|S[4,10]|T4:2/2,1,2|T9:3/3,0,5,1|P[,0,0]z|";
+
+	size_t segments[] = {1, 2, 3, 7, 100, 1460, 50000};
+	for (size_t segment : segments)
+	{
+		TestParser parser;
+		TRY(feed(parser, data, segment));
+		TRY(parser.log == expected);
+	}
+}
+
+static void testMalformed()
+{
+	{
+		TestParser parser; // Remaining length of five bytes
+		TRY(!feed(parser, std::string("\x30\xff\xff\xff\xff\x01", 6), 10));
+	}
+	{
+		TestParser parser; // Topic longer than packet
+		TRY(!feed(parser, std::string("\x30\x03\x00\x05\x61", 5), 10));
+	}
+	{
+		TestParser parser; // No room for message id
+		TRY(!feed(parser, std::string("\x32\x03\x00\x01\x61", 5), 10));
+	}
+	{
+		TestParser parser; // Parser stays failed
+		TRY(!feed(parser, std::string("\x30\x03\x00\x05\x61", 5), 10));
+		TRY(!feed(parser, std::string("\xd0\x00", 2), 10));
+		parser.reset();
+		TRY(feed(parser, std::string("\xd0\x00", 2), 10));
+		TRY(parser.log == "T13:0/0|");
+	}
+}
+
+int main()
+{
+	testSegments();
+	testMalformed();
+	printf("MqttPacketParser OK\n");
+	return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * MqttSnClient talking to a scripted gateway
+ */
+
+#include "host/test.h"
+#include "Network/MqttSnClient.h"
+
+// Datagrams are recorded instead of sent
+static std::vector<std::string> sent;
+
+UdpConnection::UdpConnection() : onDataCallback(NULL)
+{
+	udp = NULL;
+}
+
+UdpConnection::~UdpConnection()
+{
+}
+
+bool UdpConnection::listen(int port)
+{
+	return true;
+}
+
+bool UdpConnection::connect(IPAddress ip, uint16_t port)
+{
+	return true;
+}
+
+void UdpConnection::close()
+{
+}
+
+void UdpConnection::send(const char* data, int length)
+{
+	sent.push_back(std::string(data, length));
+}
+
+void UdpConnection::sendTo(IPAddress remoteIP, uint16_t remotePort, const char* data, int length)
+{
+}
+
+void UdpConnection::onReceive(pbuf* buf, IPAddress remoteIP, uint16_t remotePort)
+{
+}
+
+extern "C" u16_t pbuf_copy_partial(struct pbuf* p, void* dataptr, u16_t len, u16_t offset)
+{
+	memcpy(dataptr, (char*)p->payload + offset, len);
+	return len;
+}
+
+class TestClient : public MqttSnClient
+{
+public:
+	TestClient(MqttStringSubscriptionCallback callback) : MqttSnClient(IPAddress(192, 168, 1, 2), 10000, callback)
+	{
+	}
+
+	void receive(const std::string& packet)
+	{
+		HostPbufChain chain(packet, {});
+		onReceive(chain.head(), IPAddress(192, 168, 1, 2), 10000);
+	}
+};
+
+// Packet with one byte length
+static std::string packet(std::initializer_list<int> bytes, const std::string& tail = "")
+{
+	std::string data;
+	for (int b : bytes)
+		data += (char)b;
+	data += tail;
+	return std::string(1, (char)(data.size() + 1)) + data;
+}
+
+static std::vector<std::string> received;
+
+static void onMessage(String topic, String message)
+{
+	received.push_back(std::string(topic.c_str()) + "=" + message.c_str());
+}
+
+static int delivered;
+
+static void onDelivery(uint16_t msgId, int type)
+{
+	delivered++;
+}
+
+int main()
+{
+	TestClient client((MqttStringSubscriptionCallback)onMessage);
+	client.subscribe("cmd/#");
+	client.publish("sensors/node17/temperature", "21.5");
+	client.connect("node17", 60);
+	TRY(sent.size() == 1);
+	TRY(sent[0] == packet({MQTT_SN_CONNECT, MQTT_SN_FLAG_CLEAN_SESSION, 0x01, 0, 60}, "node17"));
+	TRY(client.getState() == eMSCS_Connecting);
+
+	// CONNECT is repeated without answer
+	hostAdvanceTime(MQTT_SN_RETRY_TIMEOUT * 1000);
+	TRY(sent.size() == 2 && sent[1] == sent[0]);
+
+	// Subscription goes first, then the queued message with topic registration
+	client.receive(packet({MQTT_SN_CONNACK, MQTT_SN_ACCEPTED}));
+	TRY(client.getState() == eMSCS_Connected);
+	TRY(sent.size() == 3 && sent[2] == packet({MQTT_SN_SUBSCRIBE, 0x00, 0, 1}, "cmd/#"));
+	client.receive(packet({MQTT_SN_SUBACK, 0, 0, 0, 0, 1, MQTT_SN_ACCEPTED}));
+	TRY(sent.size() == 4 && sent[3] == packet({MQTT_SN_REGISTER, 0, 0, 0, 2}, "sensors/node17/temperature"));
+	client.receive(packet({MQTT_SN_REGACK, 0, 7, 0, 2, MQTT_SN_ACCEPTED}));
+	TRY(sent.size() == 5 && sent[4] == packet({MQTT_SN_PUBLISH, 0x00, 0, 7, 0, 0}, "21.5"));
+	TRY(client.getQueueCount() == 0);
+
+	// Registered topic goes by id only, next message waits for PUBACK
+	client.publishWithQoS("sensors/node17/temperature", "21.6", 1, false, onDelivery);
+	TRY(sent.size() == 6 && sent[5] == packet({MQTT_SN_PUBLISH, MQTT_SN_FLAG_QOS1, 0, 7, 0, 3}, "21.6"));
+	client.publish("ab", "x");
+	TRY(sent.size() == 6);
+	hostAdvanceTime(MQTT_SN_RETRY_TIMEOUT * 1000);
+	TRY(sent.size() == 7 && (uint8_t)sent[6][2] == (MQTT_SN_FLAG_DUP | MQTT_SN_FLAG_QOS1));
+	client.receive(packet({MQTT_SN_PUBACK, 0, 7, 0, 3, MQTT_SN_ACCEPTED}));
+	TRY(delivered == 1);
+	TRY(sent.size() == 8 && sent[7] == packet({MQTT_SN_PUBLISH, MQTT_SN_TOPIC_SHORT, 'a', 'b', 0, 0}, "x"));
+
+	// Rejected topic id is registered again
+	client.publishWithQoS("sensors/node17/temperature", "22", 1);
+	client.receive(packet({MQTT_SN_PUBACK, 0, 7, 0, 4, MQTT_SN_INVALID_TOPIC_ID}));
+	TRY(sent.size() == 10 && sent[9] == packet({MQTT_SN_REGISTER, 0, 0, 0, 5}, "sensors/node17/temperature"));
+	client.receive(packet({MQTT_SN_REGACK, 0, 9, 0, 5, MQTT_SN_ACCEPTED}));
+	TRY(sent.size() == 11 && sent[10] == packet({MQTT_SN_PUBLISH, MQTT_SN_FLAG_QOS1, 0, 9, 0, 6}, "22"));
+	client.receive(packet({MQTT_SN_PUBACK, 0, 9, 0, 6, MQTT_SN_ACCEPTED}));
+
+	// Gateway registers its topic, then publishes to it; unknown topic id is rejected
+	client.receive(packet({MQTT_SN_REGISTER, 0, 33, 0, 50}, "cmd/led"));
+	TRY(sent.back() == packet({MQTT_SN_REGACK, 0, 33, 0, 50, MQTT_SN_ACCEPTED}));
+	client.receive(packet({MQTT_SN_PUBLISH, MQTT_SN_FLAG_QOS1, 0, 33, 0, 51}, "on"));
+	TRY(sent.back() == packet({MQTT_SN_PUBACK, 0, 33, 0, 51, MQTT_SN_ACCEPTED}));
+	TRY(received.size() == 1 && received[0] == "cmd/led=on");
+	client.receive(packet({MQTT_SN_PUBLISH, MQTT_SN_FLAG_QOS1, 0, 34, 0, 52}, "?"));
+	TRY(sent.back() == packet({MQTT_SN_PUBACK, 0, 34, 0, 52, MQTT_SN_INVALID_TOPIC_ID}));
+	TRY(received.size() == 1);
+
+	// PINGREQ after half of keep alive time
+	size_t count = sent.size();
+	hostAdvanceTime(30000);
+	TRY(sent.size() == count + 1 && sent.back() == packet({MQTT_SN_PINGREQ}));
+	client.receive(packet({MQTT_SN_PINGRESP}));
+
+	// Silent gateway: client connects again, subscribes and registers again
+	client.publishWithQoS("sensors/node17/humidity", "40", 1);
+	hostAdvanceTime((MQTT_SN_RETRY_COUNT + 1) * MQTT_SN_RETRY_TIMEOUT * 1000);
+	TRY(client.getState() == eMSCS_Connecting);
+	client.receive(packet({MQTT_SN_CONNACK, MQTT_SN_ACCEPTED}));
+	TRY(sent.back() == packet({MQTT_SN_SUBSCRIBE, 0x00, 0, 8}, "cmd/#"));
+	client.receive(packet({MQTT_SN_SUBACK, 0, 0, 0, 0, 8, MQTT_SN_ACCEPTED}));
+	TRY(sent.back() == packet({MQTT_SN_REGISTER, 0, 0, 0, 9}, "sensors/node17/humidity"));
+	client.receive(packet({MQTT_SN_REGACK, 0, 12, 0, 9, MQTT_SN_ACCEPTED}));
+	client.receive(packet({MQTT_SN_PUBACK, 0, 12, 0, 10, MQTT_SN_ACCEPTED}));
+
+	// Long packet has three byte length: 0x01, length
+	std::string big(300, 'z');
+	client.publish("ab", big.c_str());
+	const std::string& last = sent.back();
+	TRY(last.size() == 309 && last[0] == 0x01 && (uint8_t)last[1] == 0x01 && (uint8_t)last[2] == 0x35);
+	TRY(last[3] == MQTT_SN_PUBLISH);
+
+	// Malformed datagrams are dropped
+	count = sent.size();
+	client.receive(std::string("\x01\x00", 2));
+	client.receive(std::string("\x09\x0c", 2));
+	client.receive(std::string("\x03\x0d\x00", 3));
+	client.receive(std::string("\x01\x00\x02", 3));
+	TRY(sent.size() == count && client.getState() == eMSCS_Connected);
+
+	printf("MqttSnClient OK\n");
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * MqttTopicTrie against a plain MQTT filter matcher
+ */
+
+#include "host/test.h"
+#include "Network/MqttTopicTrie.h"
+
+static std::vector<std::string> hits;
+
+struct Handler
+{
+	std::string filter;
+
+	void call(String topic, String message)
+	{
+		hits.push_back(filter);
+	}
+};
+
+static std::vector<std::string> split(const std::string& s)
+{
+	std::vector<std::string> levels(1);
+	for (char c : s)
+	{
+		if (c == '/')
+			levels.push_back("");
+		else
+			levels.back() += c;
+	}
+	return levels;
+}
+
+// MQTT 3.1.1 section 4.7
+static bool matches(const std::string& filter, const std::string& topic)
+{
+	std::vector<std::string> f = split(filter);
+	std::vector<std::string> t = split(topic);
+	if (topic[0] == '$' && (f[0] == "+" || f[0] == "#"))
+		return false;
+
+	for (size_t i = 0; i < f.size(); i++)
+	{
+		if (f[i] == "#")
+			return true;
+		if (i == t.size() || (f[i] != "+" && f[i] != t[i]))
+			return false;
+	}
+	return f.size() == t.size();
+}
+
+static std::vector<std::string> dispatch(MqttTopicTrie& trie, const std::string& topic)
+{
+	hits.clear();
+	int count = trie.dispatch(topic.c_str(), "m");
+	TRY(count == (int)hits.size());
+	std::sort(hits.begin(), hits.end());
+	return hits;
+}
+
+static void testFilters()
+{
+	const char* invalid[] = {"", "a/#/b", "a#", "a/b+", "+a", "##"};
+	for (const char* filter : invalid)
+		TRY(!MqttTopicTrie::isValidFilter(filter));
+
+	const char* valid[] = {"#", "+", "/", "a//b", "+/+/#", "$SYS/#", "a/+"};
+	for (const char* filter : valid)
+		TRY(MqttTopicTrie::isValidFilter(filter));
+}
+
+// Random filters and topics of few level names, so most of them overlap
+static void testRandom()
+{
+	const char* names[] = {"a", "b", "ab", "", "$SYS", "+", "#"};
+	srand(1);
+	for (int round = 0; round < 200; round++)
+	{
+		MqttTopicTrie trie;
+		std::map<std::string, Handler> handlers;
+		for (int i = 0; i < 40; i++)
+		{
+			std::string filter;
+			for (int depth = 1 + rand() % 4; depth > 0; depth--)
+				filter += std::string(names[rand() % 7]) + (depth > 1 ? "/" : "");
+			bool valid = MqttTopicTrie::isValidFilter(filter.c_str());
+			handlers[filter].filter = filter;
+			TRY(trie.add(filter.c_str(), MqttStringSubscriptionCallback(&Handler::call, &handlers[filter])) == valid);
+			if (!valid)
+				handlers.erase(filter);
+		}
+
+		// Some filters are removed again
+		for (auto it = handlers.begin(); it != handlers.end();)
+		{
+			if (rand() % 4 == 0)
+			{
+				TRY(trie.remove(it->first.c_str()));
+				TRY(!trie.remove(it->first.c_str()));
+				it = handlers.erase(it);
+			}
+			else
+				++it;
+		}
+		TRY(trie.isEmpty() == handlers.empty());
+
+		for (int i = 0; i < 50; i++)
+		{
+			std::string topic;
+			for (int depth = 1 + rand() % 4; depth > 0; depth--)
+				topic += std::string(names[rand() % 5]) + (depth > 1 ? "/" : "");
+			if (topic.empty())
+				continue; // Not a valid topic name
+
+			std::vector<std::string> expected;
+			for (auto& item : handlers)
+				if (matches(item.first, topic))
+					expected.push_back(item.first);
+			TRY(dispatch(trie, topic) == expected);
+		}
+	}
+}
+
+// Literal levels are kept sorted, many siblings must all be found
+static void testManyLiterals()
+{
+	MqttTopicTrie trie;
+	std::vector<Handler> handlers(300);
+	for (int i = 0; i < 300; i++)
+	{
+		handlers[i].filter = "dev/" + std::to_string((i * 7919) % 300) + "/state";
+		TRY(trie.add(handlers[i].filter.c_str(), MqttStringSubscriptionCallback(&Handler::call, &handlers[i])));
+	}
+	for (int i = 0; i < 300; i++)
+	{
+		std::string topic = "dev/" + std::to_string(i) + "/state";
+		TRY(dispatch(trie, topic) == std::vector<std::string>{topic});
+	}
+	for (int i = 0; i < 300; i += 2)
+		TRY(trie.remove(("dev/" + std::to_string(i) + "/state").c_str()));
+	TRY(dispatch(trie, "dev/4/state").empty());
+	TRY(dispatch(trie, "dev/5/state").size() == 1);
+}
+
+static MqttTopicTrie* current;
+
+struct Modifier
+{
+	void unsubscribe(String topic, String message)
+	{
+		current->remove("x/+");
+		current->remove("x/y");
+		hits.push_back("unsubscribe");
+	}
+
+	void clear(String topic, String message)
+	{
+		current->clear();
+		hits.push_back("clear");
+	}
+
+	void nested(String topic, String message)
+	{
+		hits.push_back("nested");
+		if (topic == "n/1")
+			current->dispatch("n/2", message);
+		current->remove("n/+");
+	}
+};
+
+// Handlers may change the trie they are called from
+static void testChangeDuringDispatch()
+{
+	Modifier modifier;
+	MqttTopicTrie trie;
+	current = &trie;
+
+	trie.add("x/+", MqttStringSubscriptionCallback(&Modifier::unsubscribe, &modifier));
+	trie.add("x/y", MqttStringSubscriptionCallback(&Modifier::unsubscribe, &modifier));
+	hits.clear();
+	trie.dispatch("x/y", "");
+	TRY(hits.size() == 1);
+	TRY(dispatch(trie, "x/y").empty());
+	TRY(trie.isEmpty());
+
+	trie.add("c/#", MqttStringSubscriptionCallback(&Modifier::clear, &modifier));
+	trie.add("c/+", MqttStringSubscriptionCallback(&Modifier::clear, &modifier));
+	trie.add("c/d", MqttStringSubscriptionCallback(&Modifier::clear, &modifier));
+	hits.clear();
+	trie.dispatch("c/d", "");
+	TRY(hits.size() == 1);
+	TRY(trie.isEmpty());
+	TRY(dispatch(trie, "c/d").empty());
+
+	trie.add("n/+", MqttStringSubscriptionCallback(&Modifier::nested, &modifier));
+	hits.clear();
+	trie.dispatch("n/1", "");
+	TRY(hits.size() == 2);
+	TRY(trie.isEmpty());
+
+	Handler handler = {"c/d"};
+	TRY(trie.add("c/d", MqttStringSubscriptionCallback(&Handler::call, &handler)));
+	TRY(dispatch(trie, "c/d").size() == 1);
+}
+
+int main()
+{
+	testFilters();
+	testRandom();
+	testManyLiterals();
+	testChangeDuringDispatch();
+	printf("MqttTopicTrie OK\n");
+	return 0;
+}
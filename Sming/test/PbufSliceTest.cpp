@@ -0,0 +1,69 @@
+/*
+ * StringView and PbufSlice, slices compared and searched across every segment split
+ */
+
+#include "host/test.h"
+#include "Network/PbufSlice.h"
+
+static void testStringView()
+{
+	StringView view("  Content-Length: -42 ");
+	TRY(view.trim().startsWith("Content"));
+	TRY(view.indexOf(':') == 16);
+	TRY(view.indexOf("Length") == 10 && view.indexOf("Length", 11) == -1);
+	TRY(view.substring(2, 16).equalsIgnoreCase("content-length"));
+	TRY(!view.substring(2, 16).equals("content-length"));
+	TRY(view.substring(17).toInt() == -42);
+	TRY(StringView("abc").compareTo("abd") < 0 && StringView("ab").compareTo("abc") < 0);
+	TRY(StringView("b").compareTo("abc") > 0 && StringView().compareTo("") == 0);
+	TRY(StringView("x").toString() == "x" && StringView().toString().length() == 0);
+}
+
+static void testSlice()
+{
+	std::string data = "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, Chunked\r\nContent-Length:  1234 \r\n";
+	for (size_t split = 1; split < data.size(); split++)
+	{
+		// Every second segment is one byte long
+		HostPbufChain chain(data, {split, 1, split, 1, split, 1, split, 1, split, 1, split});
+		PbufSlice all(chain.head());
+		TRY(all.length() == (int)data.size());
+		TRY(all.toString() == data.c_str());
+		TRY(all.startsWith("HTTP/1.1") && !all.startsWith("HTTP/1.0"));
+
+		int line = all.indexOf('\n') + 1;
+		PbufSlice header = all.substring(line, all.indexOf('\n', line));
+		int delim = header.indexOf(':');
+		TRY(header.substring(0, delim).equalsIgnoreCase("transfer-encoding"));
+		TRY(!header.substring(0, delim).equals("transfer-encoding"));
+		TRY(header.substring(0, delim).equals("Transfer-Encoding"));
+		TRY(header.indexOfIgnoreCase("chunked") == 25 && header.indexOf("chunked") == -1);
+		TRY(header.substring(delim + 1).trim().compareTo("gzip, Chunked") == 0);
+		TRY(header.substring(delim + 1).trim().compareTo("gzip, Chunkee") < 0);
+
+		int length = all.indexOf("Content-Length:");
+		TRY(length == 51);
+		TRY(all.substring(length + 15).toInt() == 1234);
+		TRY(all.substring(9, 12).toInt() == 200);
+		TRY(all.charAt(length) == 'C' && all.charAt(-1) == 0 && all.charAt(all.length()) == 0);
+
+		char buffer[20];
+		TRY(all.substring(length).copyTo(buffer, sizeof(buffer)) == (int)sizeof(buffer));
+		TRY(memcmp(buffer, data.data() + length, sizeof(buffer)) == 0);
+
+		PbufSlice first = all.substring(0, split);
+		TRY(first.isContiguous() && first.toStringView().equals(StringView(data.data(), split)));
+		TRY(!all.substring(split - 1, split + 1).isContiguous());
+		TRY(all.substring(split - 1, split + 1).toStringView().data() == NULL);
+	}
+
+	TRY(PbufSlice().toString().length() == 0 && PbufSlice().indexOf('a') == -1 && PbufSlice().toInt() == 0);
+}
+
+int main()
+{
+	testStringView();
+	testSlice();
+	printf("PbufSlice OK\n");
+	return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * SslSessionCache matching, replacement, eviction and expiry
+ */
+
+#include "host/test.h"
+#include "Network/SslSessionCache.h"
+#include "Clock.h"
+
+// Contexts aren't real, only their release is counted
+static int freed = 0;
+
+extern "C" void ssl_ctx_free(SSL_CTX* ssl_ctx)
+{
+	freed++;
+}
+
+static SslCachedSession* makeSession(const char* hostname, uint16_t port, const uint8_t* fingerprint = nullptr)
+{
+	SslCachedSession* session = new SslCachedSession();
+	session->hostname = hostname;
+	session->port = port;
+	session->options = 1;
+	session->context = (SSLCTX*)1;
+	session->sessionIdSize = SSL_SESSION_ID_SIZE;
+	session->created = millis();
+	if (fingerprint)
+	{
+		session->hasFingerprint = true;
+		memcpy(session->fingerprint, fingerprint, SSL_SESSION_FINGERPRINT_SIZE);
+	}
+	return session;
+}
+
+static void testMatching()
+{
+	uint8_t fingerprint[SSL_SESSION_FINGERPRINT_SIZE] = {1, 2, 3};
+	uint8_t other[SSL_SESSION_FINGERPRINT_SIZE] = {1, 2, 4};
+
+	SslSessionCache.put(makeSession("a", 443, fingerprint));
+	TRY(SslSessionCache.take("a", 443, 1, false, nullptr) == nullptr);
+	TRY(SslSessionCache.take("a", 443, 1, false, other) == nullptr);
+	TRY(SslSessionCache.take("a", 8443, 1, false, fingerprint) == nullptr);
+	TRY(SslSessionCache.take("a", 443, 0, false, fingerprint) == nullptr);
+	TRY(SslSessionCache.take("a", 443, 1, true, fingerprint) == nullptr);
+	TRY(SslSessionCache.take("b", 443, 1, false, fingerprint) == nullptr);
+
+	// Taken session is owned by the connection
+	SslCachedSession* session = SslSessionCache.take("a", 443, 1, false, fingerprint);
+	TRY(session != nullptr);
+	TRY(SslSessionCache.getCount() == 0);
+	TRY(SslSessionCache.take("a", 443, 1, false, fingerprint) == nullptr);
+
+	// Session without id can't be resumed
+	session->sessionIdSize = 0;
+	SslSessionCache.put(session);
+	TRY(SslSessionCache.getCount() == 0 && freed == 1);
+}
+
+static void testReplaced()
+{
+	freed = 0;
+	SslSessionCache.put(makeSession("a", 443));
+	SslSessionCache.put(makeSession("a", 443));
+	TRY(SslSessionCache.getCount() == 1 && freed == 1);
+
+	// Oldest is evicted
+	SslSessionCache.put(makeSession("b", 443));
+	SslSessionCache.put(makeSession("c", 443));
+	TRY(SslSessionCache.getCount() == SSL_SESSION_CACHE_SIZE && freed == 2);
+	TRY(SslSessionCache.take("a", 443, 1, false, nullptr) == nullptr);
+
+	SslSessionCache.setSize(1);
+	TRY(SslSessionCache.getCount() == 1 && freed == 3);
+	SslCachedSession* session = SslSessionCache.take("c", 443, 1, false, nullptr);
+	TRY(session != nullptr);
+	SslSessionCache.release(session);
+
+	SslSessionCache.setSize(0);
+	SslSessionCache.put(makeSession("d", 443));
+	TRY(SslSessionCache.getCount() == 0 && freed == 5);
+	SslSessionCache.setSize(SSL_SESSION_CACHE_SIZE);
+}
+
+static void testExpired()
+{
+	freed = 0;
+	SslSessionCache.put(makeSession("a", 443));
+	hostAdvanceTime(1000);
+	SslSessionCache.put(makeSession("b", 443));
+
+	hostAdvanceTime(SSL_SESSION_CACHE_LIFETIME * 1000 - 1000);
+	TRY(SslSessionCache.take("a", 443, 1, false, nullptr) == nullptr);
+	TRY(SslSessionCache.getCount() == 1 && freed == 1);
+
+	// Expired while the connection was open
+	SslCachedSession* session = SslSessionCache.take("b", 443, 1, false, nullptr);
+	TRY(session != nullptr);
+	hostAdvanceTime(1000);
+	SslSessionCache.put(session);
+	TRY(SslSessionCache.getCount() == 0 && freed == 2);
+
+	SslSessionCache.put(makeSession("c", 443));
+	SslSessionCache.setLifetime(0);
+	TRY(SslSessionCache.getCount() == 0 && freed == 3);
+	SslSessionCache.setLifetime(SSL_SESSION_CACHE_LIFETIME);
+
+	SslSessionCache.put(makeSession("d", 443));
+	SslSessionCache.clear();
+	TRY(SslSessionCache.getCount() == 0 && freed == 4);
+}
+
+int main()
+{
+	hostAdvanceTime(1000);
+	testMatching();
+	testReplaced();
+	testExpired();
+	printf("SslSessionCache OK\n");
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Heap calls and peak heap of a parsed HTTP request for the String inline capacity it's built with
+ */
+
+#include "host/test.h"
+#include "Network/HttpRequest.h"
+#include "Network/HttpServer.h"
+#include "Network/HttpServerConnection.h"
+
+// Only linked, requests are parsed without server
+bool HttpServer::isHeaderProcessingEnabled(const StringView& name)
+{
+	return false;
+}
+
+HttpBodyParserDelegate HttpServer::getBodyParser(HttpRequest& request)
+{
+	return HttpBodyParserDelegate();
+}
+
+void HttpServerConnection::onBodyResumed()
+{
+}
+
+// Processes headers HttpServer processes by default
+class TestRequest : public HttpRequest
+{
+protected:
+	bool onHeaderName(const StringView& name)
+	{
+		static const char* headers[] = {"cookie", "host", "content-type", "content-length", "connection",
+										"accept-encoding", "if-none-match", "upgrade"};
+		for (unsigned i = 0; i < sizeof(headers) / sizeof(headers[0]); i++)
+			if (name.equalsIgnoreCase(headers[i]))
+				return true;
+		return false;
+	}
+};
+
+// Page and API requests of a browser to the device
+static const char* requests[] = {
+	"GET /index.html HTTP/1.1\r\n"
+	"Host: 192.168.4.1\r\n"
+	"Connection: keep-alive\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/60.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n"
+	"Accept-Encoding: gzip, deflate\r\n"
+	"Accept-Language: en-US,en;q=0.8\r\n"
+	"If-None-Match: \"5d8c72a5\"\r\n"
+	"\r\n",
+
+	"GET /api/state?id=42&mode=full&t=1503051242 HTTP/1.1\r\n"
+	"Host: 192.168.4.1\r\n"
+	"Connection: keep-alive\r\n"
+	"Accept: application/json\r\n"
+	"X-Requested-With: XMLHttpRequest\r\n"
+	"Accept-Encoding: gzip, deflate\r\n"
+	"Cookie: session=7f3a91c2; theme=dark\r\n"
+	"\r\n",
+
+	"POST /api/config HTTP/1.1\r\n"
+	"Host: 192.168.4.1\r\n"
+	"Connection: close\r\n"
+	"Content-Type: application/x-www-form-urlencoded\r\n"
+	"Content-Length: 27\r\n"
+	"\r\n",
+};
+
+// Response headers and template variables, as short as they usually are
+static const char* mapItems[] = {
+	"Content-Type", "text/html", "Content-Length", "1432", "ETag", "\"5d8c72a5\"", "Connection", "keep-alive",
+	"Server", "Sming", "Cache-Control", "max-age=60", "temp", "21.5", "hum", "48", "led", "on", "uptime", "3601",
+};
+
+// Object size on ESP8266: 32 bit pointer and two lengths before the inline buffer, padded to 4 bytes
+#define ESP_STRING_SIZE ((4 + 2 + 2 + STRING_SSO_CAPACITY + 1 + 3) / 4 * 4)
+
+int main()
+{
+	unsigned allocations = 0;
+	size_t peak = 0;
+	size_t requestsHeld = 0;
+	size_t held;
+	hostHeapReset();
+	size_t heapStart = hostHeap.ummUsed;
+
+	for (unsigned i = 0; i < sizeof(requests) / sizeof(requests[0]); i++)
+	{
+		std::string data = requests[i];
+		HostPbufChain chain(data, {536});
+
+		hostHeapReset();
+		HttpRequest* request = new TestRequest();
+		int bufPos = 0;
+		TRY(request->parseHeader(NULL, chain.head(), bufPos) == eHPR_Successful);
+		TRY(request->getHeader("host") == "192.168.4.1");
+		requestsHeld += hostHeap.ummUsed - heapStart;
+
+		// What request handlers usually look at
+		request->getRequestMethod();
+		request->getPath();
+		request->isKeepAlive();
+		request->isAjax();
+		request->getContentType();
+		request->getContentLength();
+		request->getQueryParameter("id");
+		request->getCookie("session");
+		delete request;
+
+		allocations += hostHeap.allocations;
+		peak = max(peak, hostHeap.ummPeak - heapStart);
+	}
+
+	// Strings kept in containers pay for their size even when they're short
+	hostHeapReset();
+	heapStart = hostHeap.ummUsed;
+	{
+		HashMap<String, String> headers;
+		for (unsigned i = 0; i < sizeof(mapItems) / sizeof(mapItems[0]); i += 2)
+			headers[mapItems[i]] = mapItems[i + 1];
+		held = hostHeap.ummUsed - heapStart;
+	}
+
+	// Keys and values are one block of the map capacity, ESP8266 strings there are smaller
+	unsigned count = sizeof(mapItems) / sizeof(mapItems[0]) / 2;
+	unsigned capacity = HASHMAP_MIN_CAPACITY;
+	while (capacity < count)
+		capacity *= 2;
+	size_t espHeld = held - 2 * capacity * (sizeof(String) - ESP_STRING_SIZE);
+
+	printf("%6d %4d %3d | %11u %6u %6u | %6u %6u\n", STRING_SSO_CAPACITY, (int)sizeof(String), ESP_STRING_SIZE,
+		   allocations, (unsigned)requestsHeld, (unsigned)peak, (unsigned)held, (unsigned)espHeld);
+	return 0;
+}
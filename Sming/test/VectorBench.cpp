@@ -0,0 +1,168 @@
+/*
+ * Vector against the pointer based one it replaced: add, access, remove, copy and heap use
+ */
+
+#include "host/test.h"
+#include "PointerVector.h"
+
+static const int rounds = 200000; // Elements handled per case
+
+static double nowNs()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename T> T makeElement(int i);
+
+template<> String makeElement<String>(int i)
+{
+	return String("element-") + String(i);
+}
+
+template<> int makeElement<int>(int i)
+{
+	return i;
+}
+
+static int length(const String& s)
+{
+	return s.length();
+}
+
+static int length(int i)
+{
+	return i;
+}
+
+struct Result
+{
+	double add; // ns per element
+	double access; // ns per element
+	double removeFirst; // ns per element, vector used as queue
+	double copy; // ns per element
+	unsigned allocations; // heap calls to fill the vector
+	size_t bytes; // heap held by the filled vector
+};
+
+template<typename Vec, typename T>
+static Result measure(int items, const std::vector<T>& elements)
+{
+	Result res;
+	int repeat = max(1, rounds / items);
+
+	hostHeapReset();
+	size_t heapStart = hostHeap.used;
+	{
+		Vec vec;
+		for (int i = 0; i < items; i++)
+			vec.add(elements[i]);
+		res.allocations = hostHeap.allocations;
+		res.bytes = hostHeap.used - heapStart;
+	}
+
+	double start = nowNs();
+	for (int r = 0; r < repeat; r++)
+	{
+		Vec vec;
+		for (int i = 0; i < items; i++)
+			vec.add(elements[i]);
+	}
+	res.add = (nowNs() - start) / (repeat * items);
+
+	Vec vec;
+	for (int i = 0; i < items; i++)
+		vec.add(elements[i]);
+
+	long sum = 0;
+	start = nowNs();
+	for (int r = 0; r < repeat; r++)
+		for (unsigned i = 0; i < vec.count(); i++)
+			sum += length(vec[i]);
+	res.access = (nowNs() - start) / (repeat * items);
+	TRY(sum > 0 || items == 1);
+
+	start = nowNs();
+	for (int r = 0; r < repeat; r++)
+	{
+		Vec copy(vec);
+		TRY((int)copy.count() == items);
+	}
+	res.copy = (nowNs() - start) / (repeat * items);
+
+	double time = 0;
+	for (int r = 0; r < repeat; r++)
+	{
+		Vec queue(vec);
+		start = nowNs();
+		while (queue.count() > 0)
+			queue.removeElementAt(0);
+		time += nowNs() - start;
+	}
+	res.removeFirst = time / (repeat * items);
+
+	return res;
+}
+
+template<typename T>
+static void compare(const char* type, int items)
+{
+	std::vector<T> elements;
+	for (int i = 0; i < items; i++)
+		elements.push_back(makeElement<T>(i + 1));
+
+	Result pointers = measure<PointerVector<T>, T>(items, elements);
+	Result values = measure<Vector<T>, T>(items, elements);
+
+	printf("%-6s %4d | %6.1f %6.1f | %6.1f %6.1f | %6.1f %6.1f | %6.1f %6.1f | %5u %5u | %6u %6u\n", type, items,
+		   pointers.add, values.add, pointers.access, values.access, pointers.removeFirst, values.removeFirst,
+		   pointers.copy, values.copy, pointers.allocations, values.allocations, (unsigned)pointers.bytes,
+		   (unsigned)values.bytes);
+}
+
+// Both vectors keep the same content through random operations
+static void checkEqual()
+{
+	PointerVector<String> pointers;
+	Vector<String> values;
+	srand(1);
+	for (int i = 0; i < 20000; i++)
+	{
+		String element = makeElement<String>(i);
+		int op = rand() % 4;
+		if (op == 0 && values.count() > 0)
+		{
+			unsigned index = rand() % values.count();
+			pointers.removeElementAt(index);
+			values.removeElementAt(index);
+		}
+		else if (op == 1)
+		{
+			unsigned index = rand() % (values.count() + 1);
+			pointers.insertElementAt(element, index);
+			values.insertElementAt(element, index);
+		}
+		else
+		{
+			pointers.add(element);
+			values.add(element);
+		}
+		TRY(pointers.count() == values.count());
+	}
+	for (unsigned i = 0; i < values.count(); i++)
+		TRY(pointers[i] == values[i]);
+}
+
+int main()
+{
+	checkEqual();
+
+	printf("Vector, pointers | values; ns per element, heap to hold elements (%d bit host)\n", (int)sizeof(void*) * 8);
+	printf("type  items |  add          |  access       |  remove first |  copy         | allocs      | bytes\n");
+	int sizes[] = {4, 16, 64, 256};
+	for (int items : sizes)
+		compare<String>("String", items);
+	for (int items : sizes)
+		compare<int>("int", items);
+	return 0;
+}
@@ -0,0 +1,2 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
@@ -0,0 +1,26 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+#define PERIPHS_IO_MUX_GPIO0_U 0
+#define PERIPHS_IO_MUX_U0TXD_U 0
+#define PERIPHS_IO_MUX_GPIO2_U 0
+#define PERIPHS_IO_MUX_U0RXD_U 0
+#define PERIPHS_IO_MUX_GPIO4_U 0
+#define PERIPHS_IO_MUX_GPIO5_U 0
+#define PERIPHS_IO_MUX_SD_DATA2_U 0
+#define PERIPHS_IO_MUX_SD_DATA3_U 0
+#define PERIPHS_IO_MUX_MTDI_U 0
+#define PERIPHS_IO_MUX_MTCK_U 0
+#define PERIPHS_IO_MUX_MTMS_U 0
+#define PERIPHS_IO_MUX_MTDO_U 0
+#define FUNC_GPIO0 0
+#define FUNC_GPIO1 0
+#define FUNC_GPIO2 0
+#define FUNC_GPIO3 0
+#define FUNC_GPIO4 0
+#define FUNC_GPIO5 0
+#define FUNC_GPIO9 0
+#define FUNC_GPIO10 0
+#define FUNC_GPIO12 0
+#define FUNC_GPIO13 0
+#define FUNC_GPIO14 0
+#define FUNC_GPIO15 0
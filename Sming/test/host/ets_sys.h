@@ -0,0 +1,20 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+#define BIT0 BIT(0)
+#define BIT1 BIT(1)
+#define BIT2 BIT(2)
+#define BIT3 BIT(3)
+#define BIT4 BIT(4)
+#define BIT5 BIT(5)
+#define BIT6 BIT(6)
+#define BIT7 BIT(7)
+typedef void ETSTimerFunc(void *timer_arg);
+typedef struct _ETSTIMER_ { struct _ETSTIMER_ *timer_next; unsigned timer_expire; unsigned timer_period; ETSTimerFunc *timer_func; void *timer_arg; } ETSTimer;
+#define NOW() 0
+#define TIMER_CLK_FREQ 80000000
+typedef struct _ETSTIMER_ os_timer_t;
+typedef void os_timer_func_t(void *timer_arg);
+typedef unsigned char uint8; 
+typedef struct { unsigned sig; unsigned par; } os_event_t;
+#define ETS_INTR_LOCK()
+#define ETS_INTR_UNLOCK()
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+typedef enum { GPIO_PIN_INTR_DISABLE = 0, GPIO_PIN_INTR_POSEDGE, GPIO_PIN_INTR_NEGEDGE, GPIO_PIN_INTR_ANYEDGE, GPIO_PIN_INTR_LOLEVEL, GPIO_PIN_INTR_HILEVEL } GPIO_INT_TYPE;
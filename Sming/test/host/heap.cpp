@@ -0,0 +1,97 @@
+/*
+ * Heap counters of host benchmarks, replaces C library allocation functions.
+ * Counts requested sizes and what umm_malloc of the firmware would take for them.
+ */
+
+#include "test.h"
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+}
+
+HostHeapStats hostHeap;
+
+// Requested size is kept in front of the block
+static const size_t headerSize = 16;
+
+// umm_malloc blocks are 8 bytes, 4 of the first one hold the header
+static size_t ummSize(size_t size)
+{
+	return size <= 4 ? 8 : (2 + (size - 5) / 8) * 8;
+}
+
+static void* track(void* block, size_t size)
+{
+	if (block == NULL)
+		return NULL;
+
+	*(size_t*)block = size;
+	hostHeap.allocations++;
+	hostHeap.used += size;
+	if (hostHeap.used > hostHeap.peak)
+		hostHeap.peak = hostHeap.used;
+	hostHeap.ummUsed += ummSize(size);
+	if (hostHeap.ummUsed > hostHeap.ummPeak)
+		hostHeap.ummPeak = hostHeap.ummUsed;
+	return (char*)block + headerSize;
+}
+
+static void* untrack(void* ptr)
+{
+	void* block = (char*)ptr - headerSize;
+	size_t size = *(size_t*)block;
+	hostHeap.used -= size;
+	hostHeap.ummUsed -= ummSize(size);
+	return block;
+}
+
+void hostHeapReset()
+{
+	hostHeap.allocations = 0;
+	hostHeap.peak = hostHeap.used;
+	hostHeap.ummPeak = hostHeap.ummUsed;
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+	return track(__libc_malloc(size + headerSize), size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	void* ptr = malloc(count * size);
+	if (ptr != NULL)
+		memset(ptr, 0, count * size);
+	return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	if (ptr == NULL)
+		return malloc(size);
+
+	void* block = untrack(ptr);
+	void* newBlock = __libc_realloc(block, size + headerSize);
+	if (newBlock == NULL)
+	{
+		size_t size = *(size_t*)block;
+		hostHeap.used += size;
+		hostHeap.ummUsed += ummSize(size);
+		return NULL;
+	}
+	return track(newBlock, size);
+}
+
+void free(void* ptr)
+{
+	if (ptr != NULL)
+		__libc_free(untrack(ptr));
+}
+
+}
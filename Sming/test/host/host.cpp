@@ -0,0 +1,112 @@
+/*
+ * SDK and system functions used by host tests.
+ * Time is simulated, it passes and timers fire only in hostAdvanceTime().
+ */
+
+#include "test.h"
+
+extern "C" {
+
+int m_vsnprintf(char *buf, size_t maxLen, const char *fmt, va_list args)
+{
+	return vsnprintf(buf, maxLen, fmt, args);
+}
+
+int m_snprintf(char* buf, int length, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int n = vsnprintf(buf, length, fmt, args);
+	va_end(args);
+	return n;
+}
+
+int m_printf(const char* fmt, ...)
+{
+	if (getenv("HOST_DEBUG") == NULL)
+		return 0;
+
+	va_list args;
+	va_start(args, fmt);
+	int n = vprintf(fmt, args);
+	va_end(args);
+	return n;
+}
+
+char* ltoa(long val, char* buf, int base)
+{
+	sprintf(buf, base == 16 ? "%lx" : "%ld", val);
+	return buf;
+}
+
+char* ultoa(unsigned long val, char* buf, unsigned int base)
+{
+	sprintf(buf, base == 16 ? "%lx" : "%lu", val);
+	return buf;
+}
+
+char* dtostrf(double val, int width, int prec, char* buf)
+{
+	sprintf(buf, "%*.*f", width, prec, val);
+	return buf;
+}
+
+static uint32_t hostTime; // us
+
+uint32_t system_get_time()
+{
+	return hostTime;
+}
+
+// Busy wait, timers can't fire meanwhile
+void os_delay_us(uint32_t us)
+{
+	hostTime += us;
+}
+
+static std::vector<ETSTimer*> timers;
+
+void ets_timer_setfn(ETSTimer *t, ETSTimerFunc *pfunction, void *parg)
+{
+	ets_timer_disarm(t);
+	t->timer_func = pfunction;
+	t->timer_arg = parg;
+}
+
+void ets_timer_arm_new(ETSTimer *t, uint32_t time, bool repeat_flag, int isMstimer)
+{
+	ets_timer_disarm(t);
+	uint32_t period = isMstimer ? time * 1000 : time;
+	t->timer_period = repeat_flag ? period : 0;
+	t->timer_expire = hostTime + period;
+	timers.push_back(t);
+}
+
+void ets_timer_disarm(ETSTimer *t)
+{
+	timers.erase(std::remove(timers.begin(), timers.end(), t), timers.end());
+}
+
+}
+
+void hostAdvanceTime(uint32_t milliseconds)
+{
+	uint32_t end = hostTime + milliseconds * 1000;
+	for (;;)
+	{
+		ETSTimer* next = NULL;
+		for (unsigned i = 0; i < timers.size(); i++)
+			if (next == NULL || (int32_t)(timers[i]->timer_expire - next->timer_expire) < 0)
+				next = timers[i];
+		if (next == NULL || (int32_t)(next->timer_expire - end) > 0)
+			break;
+
+		hostTime = next->timer_expire;
+		if (next->timer_period != 0)
+			next->timer_expire += next->timer_period;
+		else
+			ets_timer_disarm(next);
+		next->timer_func(next->timer_arg);
+	}
+	hostTime = end;
+}
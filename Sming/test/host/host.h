@@ -0,0 +1,24 @@
+/*
+ * Forced include of host builds.
+ * Standard headers go first, Sming defines min/max/abs macros which break them later.
+ */
+
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <utility>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <cstdarg>
+#include <chrono>
+
+// ESP8266 memory sections mean nothing on host, inline functions placed in a section don't compile there
+#define section(name) unused
+
+// lwIP defines its own
+#undef BYTE_ORDER
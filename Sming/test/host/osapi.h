@@ -0,0 +1,29 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+#include "ets_sys.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned system_get_time(void);
+void os_delay_us(unsigned);
+void *pvPortMalloc(unsigned long, const char*, unsigned);
+void *pvPortZalloc(unsigned long, const char*, unsigned);
+void *pvPortCalloc(unsigned long, unsigned long, const char*, unsigned);
+void *pvPortRealloc(void*, unsigned long, const char*, unsigned);
+#ifdef __cplusplus
+}
+#endif
+#define os_malloc(s) malloc(s)
+#define os_realloc(p, s) realloc(p, s)
+#define os_zalloc(s) calloc(1, s)
+#define os_free(p) free(p)
+#define os_memcpy memcpy
+#define os_memset memset
+#define os_memcmp memcmp
+#define os_strlen strlen
+#define os_strcmp strcmp
+#define os_strncmp strncmp
+#define os_strcpy strcpy
+#define os_strncpy strncpy
+#define os_sprintf sprintf
+#define os_printf printf
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+#define PWM_CHANNEL_NUM_MAX 8
@@ -0,0 +1,64 @@
+/*
+ * Helpers of host tests
+ */
+
+#ifndef _SMING_TEST_HOST_TEST_H_
+#define _SMING_TEST_HOST_TEST_H_
+
+#include <WiringFrameworkIncludes.h>
+#include <string>
+#include <vector>
+
+#define TRY(v)   do { \
+  if (!(v)) {\
+    printf("%s:%d: assert failed: %s\n", __FILE__, __LINE__, #v);\
+    fflush(stdout);\
+    abort();\
+  }\
+} while (0)
+
+// Fires timers which expire within the time, in order
+void hostAdvanceTime(uint32_t milliseconds);
+
+// Only in targets linked with host/heap.cpp
+struct HostHeapStats
+{
+	unsigned allocations;
+	size_t used;
+	size_t peak;
+	size_t ummUsed; // With block overhead of umm_malloc
+	size_t ummPeak;
+};
+
+extern HostHeapStats hostHeap;
+// Clears allocation count, peak starts from current use
+void hostHeapReset();
+
+// Chain of pbufs over data split at the given lengths, last segment takes the rest
+struct HostPbufChain
+{
+	std::vector<pbuf> bufs;
+
+	HostPbufChain(const std::string& data, const std::vector<size_t>& lengths)
+	{
+		size_t pos = 0;
+		for (unsigned i = 0; i <= lengths.size() && pos < data.size(); i++)
+		{
+			size_t len = data.size() - pos;
+			if (i < lengths.size() && lengths[i] < len)
+				len = lengths[i];
+			pbuf buf = {};
+			buf.payload = (void*)(data.data() + pos);
+			buf.len = len;
+			buf.tot_len = data.size() - pos;
+			bufs.push_back(buf);
+			pos += len;
+		}
+		for (unsigned i = 0; i + 1 < bufs.size(); i++)
+			bufs[i].next = &bufs[i + 1];
+	}
+
+	pbuf* head() { return bufs.empty() ? NULL : &bufs[0]; }
+};
+
+#endif /* _SMING_TEST_HOST_TEST_H_ */
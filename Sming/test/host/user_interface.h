@@ -0,0 +1,27 @@
+#pragma once
+// Host stand-in of the SDK header, only what Sming headers need
+typedef enum { AUTH_OPEN = 0, AUTH_WEP, AUTH_WPA_PSK, AUTH_WPA2_PSK, AUTH_WPA_WPA2_PSK, AUTH_MAX } AUTH_MODE;
+struct bss_info;
+struct station_config;
+struct softap_config;
+struct ip_info;
+struct rst_info;
+#define STATION_MODE 1
+#define SOFTAP_MODE 2
+#define STATIONAP_MODE 3
+#ifdef __cplusplus
+extern "C" {
+#endif
+unsigned short system_adc_read(void);
+unsigned system_get_free_heap_size(void);
+unsigned system_get_chip_id(void);
+typedef struct _esp_event { unsigned event; } System_Event_t;
+void os_timer_disarm(os_timer_t*);
+void os_timer_setfn(os_timer_t*, os_timer_func_t*, void*);
+void os_timer_arm(os_timer_t*, unsigned, bool);
+void os_timer_arm_us(os_timer_t*, unsigned, bool);
+void system_restart(void);
+unsigned long os_random(void);
+#ifdef __cplusplus
+}
+#endif
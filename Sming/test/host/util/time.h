@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in of the axTLS header, struct timeval comes from the C library
+#include <sys/time.h>
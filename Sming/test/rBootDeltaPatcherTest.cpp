@@ -0,0 +1,164 @@
+/*
+ * rBootDeltaPatcher applying patches made by deltaimg to a simulated flash
+ */
+
+#include "host/test.h"
+#include "Network/rBootDeltaPatcher.h"
+#include "../system/flashmem.h"
+
+#define SOURCE_ADDRESS 0x2003 // Unaligned on purpose
+#define TARGET_ADDRESS 0x102000
+
+static std::string flash(0x200000, '\xff');
+static std::string written;
+
+extern "C" uint32_t flashmem_read(void* to, uint32_t fromaddr, uint32_t size)
+{
+	if (fromaddr + size > flash.size())
+		return 0;
+	memcpy(to, &flash[fromaddr], size);
+	return size;
+}
+
+rboot_write_status rboot_write_init(uint32 start_addr)
+{
+	rboot_write_status status = {};
+	status.start_addr = start_addr;
+	written.clear();
+	return status;
+}
+
+bool rboot_write_flash(rboot_write_status* status, uint8* data, uint16 len)
+{
+	written.append((char*)data, len);
+	return true;
+}
+
+bool rboot_write_end(rboot_write_status* status)
+{
+	return true;
+}
+
+static std::string readFile(const char* name)
+{
+	std::string data;
+	FILE* file = fopen(name, "rb");
+	TRY(file != NULL);
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+		data.append(buf, n);
+	fclose(file);
+	return data;
+}
+
+static void writeFile(const char* name, const std::string& data)
+{
+	FILE* file = fopen(name, "wb");
+	TRY(file != NULL);
+	TRY(fwrite(data.data(), 1, data.size(), file) == data.size());
+	fclose(file);
+}
+
+static std::string makePatch(const std::string& source, const std::string& target)
+{
+	writeFile("test_source.bin", source);
+	writeFile("test_target.bin", target);
+	TRY(system("../deltaimg/deltaimg test_source.bin test_target.bin test_patch.bin > /dev/null") == 0);
+	return readFile("test_patch.bin");
+}
+
+static std::string randomData(size_t size)
+{
+	std::string data;
+	for (size_t i = 0; i < size; i++)
+		data += (char)(rand() % 16 * 17); // Repeats a bit, like code does
+	return data;
+}
+
+// Patch comes in random parts, work is done when some time passes
+static bool apply(const std::string& patch, bool waitEach)
+{
+	rBootDeltaPatcher patcher;
+	if (!patcher.begin(SOURCE_ADDRESS, TARGET_ADDRESS))
+		return false;
+
+	bool ok = true;
+	for (size_t pos = 0; pos < patch.size() && ok;)
+	{
+		size_t size = 1 + rand() % 1460; // Not in min(), it evaluates twice
+		size = min(size, patch.size() - pos);
+		ok = patcher.write((const uint8_t*)patch.data() + pos, size);
+		pos += size;
+		if (waitEach || rand() % 2)
+			hostAdvanceTime(1);
+	}
+
+	for (int i = 0; i < 10000 && patcher.isBusy(); i++)
+		hostAdvanceTime(1);
+	return ok && !patcher.isBusy() && patcher.end();
+}
+
+static void testPatches()
+{
+	std::string source = randomData(100000);
+
+	// Changed, inserted, removed and moved parts of the source
+	std::string edited = source;
+	for (int i = 0; i < 50; i++)
+		edited[rand() % edited.size()] += 1 + rand() % 3;
+	edited.insert(20000, randomData(3000));
+	edited.erase(60000, 5000);
+	edited += source.substr(1000, 8000);
+
+	std::string targets[] = {edited, source, randomData(30000), source.substr(50000), std::string()};
+	flash.replace(SOURCE_ADDRESS, source.size(), source);
+	for (const std::string& target : targets)
+	{
+		std::string patch = makePatch(source, target);
+		for (int round = 0; round < 10; round++)
+		{
+			TRY(apply(patch, round % 2));
+			TRY(written == target);
+		}
+	}
+}
+
+static void testRejected()
+{
+	std::string source = randomData(20000);
+	std::string target = source;
+	target[100] ^= 1;
+	flash.replace(SOURCE_ADDRESS, source.size(), source);
+	std::string patch = makePatch(source, target);
+	TRY(apply(patch, false));
+
+	// Other source than the patch was made for
+	flash[SOURCE_ADDRESS + 10] ^= 1;
+	TRY(!apply(patch, false));
+	flash[SOURCE_ADDRESS + 10] ^= 1;
+
+	// Corrupted patch
+	std::string corrupted = patch;
+	corrupted[patch.size() / 2] ^= 0x40;
+	TRY(!apply(corrupted, false));
+	TRY(!apply(patch.substr(0, patch.size() - 1), false));
+
+	// Target slot over the source
+	rBootDeltaPatcher patcher;
+	TRY(!patcher.begin(SOURCE_ADDRESS, SOURCE_ADDRESS & ~(SECTOR_SIZE - 1)));
+	TRY(patcher.begin(SOURCE_ADDRESS, SOURCE_ADDRESS + SECTOR_SIZE));
+	TRY(!patcher.write((const uint8_t*)patch.data(), patch.size()));
+}
+
+int main()
+{
+	srand(1);
+	testPatches();
+	testRejected();
+	remove("test_source.bin");
+	remove("test_target.bin");
+	remove("test_patch.bin");
+	printf("rBootDeltaPatcher OK\n");
+	return 0;
+}
@@ -44,6 +44,9 @@ void connectOk()
 {
 	Serial.println("I'm CONNECTED");
 
+	// Keep connection to the server open between updates
+	thingSpeak.setKeepAlive(true);
+
 	// Start send data loop
 	procTimer.initializeMs(25 * 1000, sendData).start(); // every 25 seconds
 }
@@ -38,9 +38,7 @@ void wsConnected(WebSocket& socket)
 	totalActiveSockets++;
 
 	// Notify everybody about new connection
-	WebSocketsList &clients = server.getActiveWebSockets();
-	for (int i = 0; i < clients.count(); i++)
-		clients[i].sendString("New friend arrived! Total: " + String(totalActiveSockets));
+	server.broadcast("New friend arrived! Total: " + String(totalActiveSockets));
 }
 
 void wsMessageReceived(WebSocket& socket, const String& message)
@@ -60,9 +58,7 @@ void wsDisconnected(WebSocket& socket)
 	totalActiveSockets--;
 
 	// Notify everybody about lost connection
-	WebSocketsList &clients = server.getActiveWebSockets();
-	for (int i = 0; i < clients.count(); i++)
-		clients[i].sendString("We lost our friend :( Total: " + String(totalActiveSockets));
+	server.broadcast("We lost our friend :( Total: " + String(totalActiveSockets));
 }
 
 void startWebServer()
@@ -73,6 +69,7 @@ void startWebServer()
 
 	// Web Sockets configuration
 	server.enableWebSockets(true);
+	server.setWebSocketCompression(true, 12); // permessage-deflate with 4KB window
 	server.setWebSocketConnectionHandler(wsConnected);
 	server.setWebSocketMessageHandler(wsMessageReceived);
 	server.setWebSocketBinaryHandler(wsBinaryReceived);